@@ -0,0 +1,131 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <unistd.h>
+
+#include "bench.h"
+
+namespace
+{
+	std::atomic<uint64_t> g_allocs{0};
+
+	struct Entry
+	{
+		const char *name;
+		bench::BenchFn fn;
+	};
+
+	std::vector<Entry> &registry()
+	{
+		static std::vector<Entry> entries;
+		return entries;
+	}
+}
+
+void *operator new(size_t size)
+{
+	g_allocs.fetch_add(1, std::memory_order_relaxed);
+	void *p = std::malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	g_allocs.fetch_add(1, std::memory_order_relaxed);
+	void *p = std::malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+bench::Registrar::Registrar(const char *name, BenchFn fn)
+{
+	registry().push_back(Entry{name, fn});
+}
+
+int main(int argc, char **argv)
+{
+	std::string fixtureDir = "bench/fixtures";
+	std::string shareDir = "share";
+	const char *filter = nullptr;
+	double minTime = 0.2;
+	bool verbose = false;
+
+	int c;
+	while ((c = getopt(argc, argv, "d:s:f:t:vh")) != -1)
+	{
+		switch (c)
+		{
+		case 'd': fixtureDir = optarg; break;
+		case 's': shareDir = optarg; break;
+		case 'f': filter = optarg; break;
+		case 't': minTime = atof(optarg); break;
+		case 'v': verbose = true; break;
+		default:
+			fprintf(stderr, "Usage: %s [-d fixture_dir] [-s share_dir] [-f name_filter] [-t min_seconds] [-v]\n", argv[0]);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	/* 插件日志走 stdout，计时期间屏蔽，结果输出到 stderr */
+	if (!verbose)
+	{
+		fflush(stdout);
+		int devnull = open("/dev/null", O_WRONLY);
+		if (devnull >= 0)
+		{
+			dup2(devnull, STDOUT_FILENO);
+			close(devnull);
+		}
+	}
+
+	fprintf(stderr, "%-36s %12s %12s %10s %14s %10s\n",
+	        "benchmark", "iterations", "ns/op", "allocs/op", "ops/s", "MB/s");
+
+	for (const auto &e : registry())
+	{
+		if (filter && !strstr(e.name, filter))
+			continue;
+
+		bench::State st;
+		st.fixtureDir = fixtureDir;
+		st.shareDir = shareDir;
+
+		double elapsed = 0.0;
+		uint64_t allocs = 0;
+		for (uint64_t n = 1;; n *= 2)
+		{
+			st.iterations = n;
+			const uint64_t a0 = g_allocs.load(std::memory_order_relaxed);
+			const auto t0 = std::chrono::steady_clock::now();
+			e.fn(st);
+			const auto t1 = std::chrono::steady_clock::now();
+			allocs = g_allocs.load(std::memory_order_relaxed) - a0;
+			elapsed = std::chrono::duration<double>(t1 - t0).count();
+			if (elapsed >= minTime || n >= (1ULL << 40))
+				break;
+		}
+
+		const double nsPerOp = elapsed * 1e9 / st.iterations;
+		const double opsPerSec = st.iterations / elapsed;
+		char mbps[32] = "-";
+		if (st.bytesPerOp)
+			snprintf(mbps, sizeof(mbps), "%.1f", st.bytesPerOp * opsPerSec / 1e6);
+
+		fprintf(stderr, "%-36s %12llu %12.1f %10.2f %14.0f %10s\n",
+		        e.name, static_cast<unsigned long long>(st.iterations), nsPerOp,
+		        static_cast<double>(allocs) / st.iterations, opsPerSec, mbps);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * 极简微基准框架（make bench）
+ *
+ *   BENCH(Dispatcher_enqueue)
+ *   {
+ *       for (uint64_t i = 0; i < st.iterations; ++i) { ... }
+ *   }
+ *
+ * 运行器会自动加倍迭代次数直到单项耗时超过 -t 指定的时间，
+ * 报告 ns/op、allocs/op（全局 operator new 计数，不含 C malloc）与吞吐。
+ */
+
+namespace bench
+{
+
+struct State
+{
+	uint64_t iterations = 0;
+	std::string fixtureDir;       ///< /proc 录制样本所在目录
+	std::string shareDir;         ///< types.db 等共享配置所在目录
+	uint64_t bytesPerOp = 0;      ///< 非 0 时额外报告 MB/s
+
+	std::string fixture(const char *name) const { return fixtureDir + "/" + name; }
+	std::string share(const char *name) const { return shareDir + "/" + name; }
+};
+
+typedef void (*BenchFn)(State &st);
+
+struct Registrar
+{
+	Registrar(const char *name, BenchFn fn);
+};
+
+/* 防止编译器把基准结果优化掉 */
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace bench
+
+#define BENCH(name)                                                            \
+	static void bench_##name(bench::State &st);                                \
+	static bench::Registrar bench_reg_##name(#name, bench_##name);             \
+	static void bench_##name(bench::State &st)
@@ -0,0 +1,130 @@
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "../daemon/RstDispatcher.h"
+#include "../daemon/utils/utils.h"
+#include "../oconfig/configfile.h"
+#include "../oconfig/types_parser.h"
+
+namespace
+{
+	value_list_t makeValueList(value_t *val)
+	{
+		value_list_t vl = VALUE_LIST_INIT;
+		vl.values = val;
+		vl.values_len = 1;
+		vl.time = cdtime();
+		sstrncpy(vl.plugin, "cpu", sizeof(vl.plugin));
+		sstrncpy(vl.plugin_instance, "0", sizeof(vl.plugin_instance));
+		sstrncpy(vl.type, "percent", sizeof(vl.type));
+		sstrncpy(vl.type_instance, "user", sizeof(vl.type_instance));
+		return vl;
+	}
+
+	/* ConfigManager 只能通过配置文件加载 types.db，生成一个最小配置 */
+	void loadTypesDb(const bench::State &st)
+	{
+		static bool loaded = false;
+		if (loaded)
+			return;
+
+		char conf[] = "/tmp/collect_bench_XXXXXX";
+		int fd = mkstemp(conf);
+		if (fd < 0)
+			return;
+		FILE *fp = fdopen(fd, "w");
+		if (!fp)
+		{
+			close(fd);
+			return;
+		}
+		fprintf(fp, "TypesDB \"%s\"\n", st.share("types.db").c_str());
+		fclose(fp);
+		ConfigManager::Instance().Read(conf);
+		remove(conf);
+		loaded = true;
+	}
+}
+
+BENCH(RstDispatcher_enqueue)
+{
+	value_t val = {.gauge = 42.0};
+	value_list_t vl = makeValueList(&val);
+
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		RstDispatcher::Instance().enqueue(&vl);
+	}
+	RstDispatcher::Instance().waitForQueueEmpty(10000);
+}
+
+BENCH(RstDispatcher_enqueueMultivalues_6)
+{
+	value_t val = {.gauge = 0.0};
+	value_list_t vl = makeValueList(&val);
+	sstrncpy(vl.plugin, "memory", sizeof(vl.plugin));
+	sstrncpy(vl.type, "memory", sizeof(vl.type));
+
+	const std::vector<MetricDataPoint> points = {
+		{"used", 1.0e9}, {"buffered", 2.0e7}, {"cached", 3.0e8},
+		{"free", 4.0e8}, {"slab_unrecl", 5.0e6}, {"slab_recl", 6.0e6},
+	};
+
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		RstDispatcher::Instance().enqueueMultivalues(&vl, false, DS_TYPE_GAUGE, points);
+	}
+	RstDispatcher::Instance().waitForQueueEmpty(10000);
+}
+
+BENCH(ConfigManager_GetDataSetByName)
+{
+	loadTypesDb(st);
+	static const char *const names[] = {"percent", "cpu", "memory", "uptime", "df_complex", "nonexistent"};
+
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		const data_set_t *ds = ConfigManager::Instance().GetDataSetByName(names[i % 6]);
+		bench::doNotOptimize(ds);
+	}
+}
+
+BENCH(TypesDbParser_parse_file)
+{
+	const std::string path = st.share("types.db");
+	struct stat sb{};
+	if (stat(path.c_str(), &sb) == 0)
+		st.bytesPerOp = sb.st_size;
+
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		std::vector<data_set_t> sets;
+		TypesDbParser::parse_file(path.c_str(), sets);
+		bench::doNotOptimize(sets.size());
+		TypesDbParser::free_datasets(sets);
+	}
+}
+
+BENCH(format_name)
+{
+	char buf[512];
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		format_name(buf, sizeof(buf), "cpu", "12", "percent", "softirq");
+		bench::doNotOptimize(buf[0]);
+	}
+}
+
+BENCH(escape_string)
+{
+	char buf[512];
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		sstrncpy(buf, "df-mnt-data/df_complex-used \"x\"", sizeof(buf));
+		escape_string(buf, sizeof(buf));
+		bench::doNotOptimize(buf[0]);
+	}
+}
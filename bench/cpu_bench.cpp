@@ -0,0 +1,21 @@
+#include <sys/stat.h>
+
+#include "bench.h"
+#include "../module/cpu/cpu.h"
+#include "ProcfsCache.h"
+
+BENCH(CCpuModule_parseProcStat)
+{
+	const std::string path = st.fixture("proc_stat");
+	struct stat sb{};
+	if (stat(path.c_str(), &sb) == 0)
+		st.bytesPerOp = sb.st_size;
+
+	CCpuModule cpu;
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		/* 每轮新节拍，计入读文件的开销 */
+		ProcfsCache::Instance().beginTick();
+		cpu.parseProcStat(path.c_str(), static_cast<double>(i + 1));
+	}
+}
@@ -0,0 +1,52 @@
+#include "bench.h"
+#include "../module/csv/csv.h"
+#include "../daemon/utils/utils.h"
+
+namespace
+{
+	data_source_t g_sources[2] = {
+		{"read", DS_TYPE_DERIVE, 0.0, 0.0},
+		{"write", DS_TYPE_DERIVE, 0.0, 0.0},
+	};
+}
+
+BENCH(CCsvModule_vlToString_gauge)
+{
+	CCsvModule csv;
+	data_source_t src = {"value", DS_TYPE_GAUGE, 0.0, 100.1};
+	data_set_t ds = {"percent", 1, &src};
+
+	value_t val = {.gauge = 12.345};
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = &val;
+	vl.values_len = 1;
+	vl.time = cdtime();
+
+	std::string line;
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		csv.vlToString(line, &ds, &vl);
+		bench::doNotOptimize(line.size());
+	}
+}
+
+BENCH(CCsvModule_vlToString_derive2)
+{
+	CCsvModule csv;
+	data_set_t ds = {"ps_disk_ops", 2, g_sources};
+
+	value_t vals[2];
+	vals[0].derive = 123456789;
+	vals[1].derive = 987654321;
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = vals;
+	vl.values_len = 2;
+	vl.time = cdtime();
+
+	std::string line;
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		csv.vlToString(line, &ds, &vl);
+		bench::doNotOptimize(line.size());
+	}
+}
@@ -0,0 +1,18 @@
+#include <sys/stat.h>
+
+#include "bench.h"
+#include "../module/disk/disk.h"
+
+BENCH(CDiskModule_parseDiskstats)
+{
+	const std::string path = st.fixture("diskstats");
+	struct stat sb{};
+	if (stat(path.c_str(), &sb) == 0)
+		st.bytesPerOp = sb.st_size;
+
+	CDiskModule disk;
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		disk.parseDiskstats(path.c_str(), static_cast<cdtime_t>(i + 1));
+	}
+}
@@ -0,0 +1,36 @@
+#include <sys/stat.h>
+
+#include "bench.h"
+#include "ProcfsCache.h"
+#include "../module/irq/irq.h"
+
+BENCH(CIrqModule_parseInterrupts)
+{
+	const std::string path = st.fixture("interrupts");
+	struct stat sb{};
+	if (stat(path.c_str(), &sb) == 0)
+		st.bytesPerOp = sb.st_size;
+
+	CIrqModule irq;
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		/* 每轮新节拍，计入读文件的开销 */
+		ProcfsCache::Instance().beginTick();
+		irq.parseInterrupts(path.c_str(), static_cast<cdtime_t>(i + 1));
+	}
+}
+
+BENCH(CIrqModule_parseSoftirqs)
+{
+	const std::string path = st.fixture("softirqs");
+	struct stat sb{};
+	if (stat(path.c_str(), &sb) == 0)
+		st.bytesPerOp = sb.st_size;
+
+	CIrqModule irq;
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		ProcfsCache::Instance().beginTick();
+		irq.parseSoftirqs(path.c_str(), static_cast<cdtime_t>(i + 1));
+	}
+}
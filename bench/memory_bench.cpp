@@ -0,0 +1,23 @@
+#include <sys/stat.h>
+
+#include "bench.h"
+#include "../module/memory/memory.h"
+#include "ProcfsCache.h"
+
+BENCH(CMemoryModule_parseMemInfo)
+{
+	const std::string path = st.fixture("meminfo");
+	struct stat sb{};
+	if (stat(path.c_str(), &sb) == 0)
+		st.bytesPerOp = sb.st_size;
+
+	CMemoryModule mem;
+	ParsedMemInfo info;
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		/* 每轮新节拍，计入读文件的开销 */
+		ProcfsCache::Instance().beginTick();
+		mem.parseMemInfo(path.c_str(), info);
+		bench::doNotOptimize(info.mem_used);
+	}
+}
@@ -0,0 +1,134 @@
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "../module/tsdb/gorilla.h"
+#include "../module/tsdb/tsdb.h"
+#include "../daemon/utils/utils.h"
+
+namespace
+{
+	const uint32_t kBlockPoints = 120;
+
+	/* 10s 间隔、毫秒级抖动的时间戳，数值为缓慢变化的计数 */
+	void fillBlock(gorilla::Encoder &enc)
+	{
+		for (uint32_t i = 0; i < kBlockPoints; ++i)
+		{
+			enc.append(1700000000000LL + i * 10000LL + (i % 3), 1000.0 + i * 37);
+		}
+	}
+
+	/* 临时目录中的 tsdb：8 条序列各 30 个块，首次使用时写入，进程退出时删除 */
+	struct TsdbFixture
+	{
+		static const int kSeries = 8;
+		static const uint32_t kPoints = 30 * kBlockPoints;
+
+		char dir[32] = "/tmp/tsdb_bench.XXXXXX";
+		CTsdbModule tsdb;
+		bool ok = false;
+		std::string series; ///< 被查询的序列
+		cdtime_t start = TIME_T_TO_CDTIME_T(1700000000);
+
+		TsdbFixture()
+		{
+			if (!mkdtemp(dir))
+				return;
+			tsdb.config("DataDir", dir);
+			tsdb.config("SegmentSize", "4");
+			tsdb.config("BlockPoints", "120");
+			if (tsdb.init() != 0)
+				return;
+
+			data_source_t src = {"value", DS_TYPE_GAUGE, 0.0, 0.0};
+			data_set_t ds = {"gauge", 1, &src};
+			value_t val;
+			value_list_t vl = VALUE_LIST_INIT;
+			vl.values = &val;
+			vl.values_len = 1;
+			sstrncpy(vl.plugin, "bench", sizeof(vl.plugin));
+			sstrncpy(vl.type, "gauge", sizeof(vl.type));
+			for (uint32_t i = 0; i < kPoints; ++i)
+			{
+				vl.time = start + TIME_T_TO_CDTIME_T(10 * i);
+				for (int s = 0; s < kSeries; ++s)
+				{
+					snprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "%d", s);
+					val.gauge = 1000.0 + i * 37 + s;
+					tsdb.write(&ds, &vl);
+				}
+			}
+			tsdb.flush();
+
+			char ident[512];
+			sstrncpy(vl.plugin_instance, "3", sizeof(vl.plugin_instance));
+			FORMAT_VL(ident, sizeof(ident), &vl);
+			series = std::string(ident) + ":value";
+			ok = true;
+		}
+
+		~TsdbFixture()
+		{
+			tsdb.shutdown();
+			if (DIR *d = opendir(dir))
+			{
+				while (struct dirent *de = readdir(d))
+				{
+					if (de->d_name[0] != '.')
+						unlink((std::string(dir) + "/" + de->d_name).c_str());
+				}
+				closedir(d);
+			}
+			rmdir(dir);
+		}
+	};
+}
+
+BENCH(gorilla_Encoder_append_block)
+{
+	gorilla::Encoder enc;
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		enc.reset();
+		fillBlock(enc);
+		bench::doNotOptimize(enc.bytes().size());
+	}
+	st.bytesPerOp = kBlockPoints * (sizeof(int64_t) + sizeof(double));
+}
+
+BENCH(gorilla_decode_block)
+{
+	gorilla::Encoder enc;
+	fillBlock(enc);
+
+	double sum = 0.0;
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		gorilla::decode(enc.bytes().data(), enc.bytes().size(), enc.count(),
+		                [&](int64_t, double v) { sum += v; });
+		bench::doNotOptimize(sum);
+	}
+	st.bytesPerOp = enc.bytes().size();
+}
+
+BENCH(CTsdbModule_query_range)
+{
+	/* 查询一条序列 1/10 的时间范围，跨 3 个已落盘的块 */
+	static TsdbFixture fx;
+	if (!fx.ok)
+		return;
+
+	const cdtime_t from = fx.start + TIME_T_TO_CDTIME_T(10 * (TsdbFixture::kPoints / 2));
+	const cdtime_t to = from + TIME_T_TO_CDTIME_T(10 * (TsdbFixture::kPoints / 10));
+	std::vector<std::pair<cdtime_t, double>> out;
+	for (uint64_t i = 0; i < st.iterations; ++i)
+	{
+		out.clear();
+		fx.tsdb.query(fx.series, from, to, out);
+		bench::doNotOptimize(out.size());
+	}
+	st.bytesPerOp = out.size() * (sizeof(int64_t) + sizeof(double));
+}
@@ -0,0 +1,521 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Aggregation.h"
+#include "RstDispatcher.h"
+#include "utils/utils.h"
+#include "utils/utils_config.h"
+#include "../oconfig/configfile.h"
+#include "../oconfig/oconfig.h"
+
+namespace
+{
+	const char *const kFieldKeys[] = {
+		"Plugin", "PluginInstance", "Type", "TypeInstance"
+	};
+
+	int fieldIndex(const std::string &key)
+	{
+		for (int f = 0; f < 4; ++f)
+		{
+			if (key == kFieldKeys[f])
+				return f;
+		}
+		return -1;
+	}
+
+	const char *fieldOf(const value_list_t *vl, int field)
+	{
+		switch (field)
+		{
+		case 0:  return vl->plugin;
+		case 1:  return vl->plugin_instance;
+		case 2:  return vl->type;
+		default: return vl->type_instance;
+		}
+	}
+
+	/* 只有 GAUGE 与 sketch 数据源可以跨序列聚合 */
+	bool aggregatable(const data_set_t *ds)
+	{
+		for (size_t i = 0; i < ds->ds_num; ++i)
+		{
+			if (ds->ds[i].type != DS_TYPE_GAUGE && ds->ds[i].type != DS_TYPE_SKETCH)
+				return false;
+		}
+		return true;
+	}
+}
+
+/* ---------- P² ---------- */
+
+void P2Quantile::add(double x)
+{
+	if (m_n < 5)
+	{
+		m_q[m_n++] = x;
+		if (m_n == 5)
+		{
+			std::sort(m_q, m_q + 5);
+			for (int i = 0; i < 5; ++i)
+			{
+				m_pos[i] = i + 1;
+			}
+			m_want[0] = 1;
+			m_want[1] = 1 + 2 * m_p;
+			m_want[2] = 1 + 4 * m_p;
+			m_want[3] = 3 + 2 * m_p;
+			m_want[4] = 5;
+			m_step[0] = 0;
+			m_step[1] = m_p / 2;
+			m_step[2] = m_p;
+			m_step[3] = (1 + m_p) / 2;
+			m_step[4] = 1;
+		}
+		return;
+	}
+
+	int k;
+	if (x < m_q[0])
+	{
+		m_q[0] = x;
+		k = 0;
+	}
+	else if (x >= m_q[4])
+	{
+		m_q[4] = x;
+		k = 3;
+	}
+	else
+	{
+		k = 0;
+		while (k < 3 && x >= m_q[k + 1])
+			++k;
+	}
+
+	for (int i = k + 1; i < 5; ++i)
+	{
+		m_pos[i] += 1;
+	}
+	for (int i = 0; i < 5; ++i)
+	{
+		m_want[i] += m_step[i];
+	}
+	++m_n;
+
+	/* 中间三个标记点偏离期望位置超过 1 时调整高度 */
+	for (int i = 1; i <= 3; ++i)
+	{
+		const double d = m_want[i] - m_pos[i];
+		if ((d >= 1 && m_pos[i + 1] - m_pos[i] > 1) || (d <= -1 && m_pos[i - 1] - m_pos[i] < -1))
+		{
+			const int s = d > 0 ? 1 : -1;
+			const double q = parabolic(i, s);
+			m_q[i] = (m_q[i - 1] < q && q < m_q[i + 1]) ? q : linear(i, s);
+			m_pos[i] += s;
+		}
+	}
+}
+
+double P2Quantile::parabolic(int i, double d) const
+{
+	return m_q[i] + d / (m_pos[i + 1] - m_pos[i - 1]) *
+	       ((m_pos[i] - m_pos[i - 1] + d) * (m_q[i + 1] - m_q[i]) / (m_pos[i + 1] - m_pos[i]) +
+	        (m_pos[i + 1] - m_pos[i] - d) * (m_q[i] - m_q[i - 1]) / (m_pos[i] - m_pos[i - 1]));
+}
+
+double P2Quantile::linear(int i, int d) const
+{
+	return m_q[i] + d * (m_q[i + d] - m_q[i]) / (m_pos[i + d] - m_pos[i]);
+}
+
+double P2Quantile::value() const
+{
+	if (m_n == 0)
+		return NAN;
+	if (m_n >= 5)
+		return m_q[2];
+
+	/* 不足 5 个样本时直接取精确分位 */
+	double tmp[5];
+	std::copy(m_q, m_q + m_n, tmp);
+	std::sort(tmp, tmp + m_n);
+	const size_t idx = static_cast<size_t>(std::lround(m_p * (m_n - 1)));
+	return tmp[idx];
+}
+
+/* ---------- Aggregation ---------- */
+
+Aggregation &Aggregation::Instance()
+{
+	static Aggregation inst;
+	return inst;
+}
+
+int Aggregation::configure(const OConfigItem &ci)
+{
+	std::unique_ptr<Rule> rule(new Rule);
+
+	for (auto &child : ci.children)
+	{
+		const std::string &key = child->key;
+		if (child->values.empty())
+		{
+			ERROR("aggregation: option '%s' needs a value.", key.c_str());
+			return -1;
+		}
+
+		const int f = fieldIndex(key);
+		if (f >= 0)
+		{
+			if (child->values[0].type != OConfigType::STRING ||
+			    rule->match[f].parse(child->values[0].getString(), "aggregation") != 0)
+				return -1;
+		}
+		else if (key == "GroupBy")
+		{
+			for (auto &v : child->values)
+			{
+				const int g = (v.type == OConfigType::STRING) ? fieldIndex(v.getString()) : -1;
+				if (g < 0)
+				{
+					ERROR("aggregation: GroupBy accepts Plugin, PluginInstance, Type, TypeInstance.");
+					return -1;
+				}
+				rule->keep[g] = true;
+			}
+		}
+		else if (key == "CalculateSum" || key == "CalculateAverage" || key == "CalculateMinimum" ||
+		         key == "CalculateMaximum" || key == "CalculateNum")
+		{
+			const unsigned bit = key == "CalculateSum"     ? AGG_SUM
+			                   : key == "CalculateAverage" ? AGG_AVERAGE
+			                   : key == "CalculateMinimum" ? AGG_MIN
+			                   : key == "CalculateMaximum" ? AGG_MAX
+			                                               : AGG_NUM;
+			if (booleanOf(child->values[0]))
+				rule->funcs |= bit;
+			else
+				rule->funcs &= ~bit;
+		}
+		else if (key == "Percentile")
+		{
+			for (auto &v : child->values)
+			{
+				const double p = numberOf(v);
+				if (!(p > 0.0 && p < 100.0))
+				{
+					ERROR("aggregation: Percentile must be between 0 and 100.");
+					return -1;
+				}
+				rule->percentiles.push_back(p);
+			}
+		}
+		else if (key == "ReplaceRaw")
+		{
+			rule->replace = booleanOf(child->values[0]);
+		}
+		else if (key == "Interval")
+		{
+			const double sec = numberOf(child->values[0]);
+			if (!(sec > 0.0))
+			{
+				ERROR("aggregation: Interval must be positive.");
+				return -1;
+			}
+			rule->interval = DOUBLE_TO_CDTIME_T(sec);
+		}
+		else
+		{
+			ERROR("aggregation: unknown option '%s'.", key.c_str());
+			return -1;
+		}
+	}
+
+	if (rule->funcs == 0 && rule->percentiles.empty())
+	{
+		ERROR("aggregation: no Calculate* or Percentile option enabled.");
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lk(m_mutex);
+	m_rules.push_back(std::move(rule));
+	return 0;
+}
+
+Aggregation::Route &Aggregation::route(const value_list_t *vl)
+{
+	m_key.clear();
+	for (int f = 0; f < F_NUM; ++f)
+	{
+		m_key.append(fieldOf(vl, f));
+		m_key.push_back('\0');
+	}
+
+	auto it = m_routes.find(m_key);
+	if (it != m_routes.end())
+		return it->second;
+
+	/* 缓存满时整体清空重建；组本身不受影响，只需重新求值 */
+	if (m_routes.size() >= kMaxRoutes)
+		m_routes.clear();
+
+	/* 新序列：逐条规则求值一次，结果缓存 */
+	Route r;
+	const data_set_t *ds = ConfigManager::Instance().GetDataSetByName(vl->type);
+	if (ds && ds->ds_num == vl->values_len)
+	{
+		for (auto &rule : m_rules)
+		{
+			bool hit = true;
+			for (int f = 0; f < F_NUM && hit; ++f)
+			{
+				hit = rule->match[f].match(fieldOf(vl, f));
+			}
+			if (!hit)
+				continue;
+			if (!aggregatable(ds))
+			{
+				if (!rule->warned)
+					WARNING("aggregation: type '%s' has non-GAUGE data sources, passing it through unaggregated.",
+					        vl->type);
+				rule->warned = true;
+				continue;
+			}
+
+			std::string gkey;
+			for (int f = 0; f < F_NUM; ++f)
+			{
+				if (rule->keep[f])
+					gkey.append(fieldOf(vl, f));
+				gkey.push_back('\0');
+			}
+
+			Group &g = rule->groups[gkey];
+			if (!g.ds)
+			{
+				for (int f = 0; f < F_NUM; ++f)
+				{
+					if (rule->keep[f])
+						g.fields[f] = fieldOf(vl, f);
+				}
+				g.ds = ds;
+				for (size_t i = 0; i < ds->ds_num; ++i)
+				{
+					g.sketch = g.sketch || ds->ds[i].type == DS_TYPE_SKETCH;
+				}
+				g.interval = rule->interval ? rule->interval
+				           : vl->interval   ? vl->interval
+				           : DOUBLE_TO_CDTIME_T(ConfigManager::Instance().GetDefaultInterval());
+				g.acc.resize(ds->ds_num);
+				for (auto &a : g.acc)
+				{
+					for (double p : rule->percentiles)
+					{
+						a.quantiles.emplace_back(p / 100.0);
+					}
+				}
+			}
+			r.groups.emplace_back(rule.get(), &g);
+			r.replace = r.replace || rule->replace;
+		}
+	}
+	return m_routes.emplace(m_key, std::move(r)).first->second;
+}
+
+void Aggregation::emit(const Rule &rule, Group &g)
+{
+	auto push = [&](const char *func, auto valueOf) {
+		Output out;
+		value_list_t vl = VALUE_LIST_INIT;
+		out.vl = vl;
+		out.ds = g.ds;
+		out.vl.time = g.lastTime;
+		out.vl.interval = g.interval;
+		snprintf(out.vl.plugin, sizeof(out.vl.plugin), "%s", g.fields[F_PLUGIN].c_str());
+		if (g.fields[F_PLUGIN_INSTANCE].empty())
+			snprintf(out.vl.plugin_instance, sizeof(out.vl.plugin_instance), "%s", func);
+		else
+			snprintf(out.vl.plugin_instance, sizeof(out.vl.plugin_instance), "%s-%s",
+			         g.fields[F_PLUGIN_INSTANCE].c_str(), func);
+		snprintf(out.vl.type, sizeof(out.vl.type), "%s", g.fields[F_TYPE].c_str());
+		snprintf(out.vl.type_instance, sizeof(out.vl.type_instance), "%s",
+		         g.fields[F_TYPE_INSTANCE].c_str());
+
+		out.values.resize(g.acc.size());
+		for (size_t i = 0; i < g.acc.size(); ++i)
+		{
+			if (g.ds->ds[i].type == DS_TYPE_SKETCH)
+				out.sketches.push_back(g.acc[i].merged);
+			else
+				out.values[i].gauge = valueOf(g.acc[i]);
+		}
+		m_pending.push_back(std::move(out));
+	};
+
+	if (g.sketch)
+	{
+		push("merged", [](const Acc &a) { return a.sum; });
+	}
+	else
+	{
+		if (rule.funcs & AGG_SUM)
+			push("sum", [](const Acc &a) { return a.n ? a.sum : NAN; });
+		if (rule.funcs & AGG_AVERAGE)
+			push("average", [](const Acc &a) { return a.n ? a.sum / a.n : NAN; });
+		if (rule.funcs & AGG_MIN)
+			push("min", [](const Acc &a) { return a.n ? a.min : NAN; });
+		if (rule.funcs & AGG_MAX)
+			push("max", [](const Acc &a) { return a.n ? a.max : NAN; });
+		if (rule.funcs & AGG_NUM)
+			push("num", [](const Acc &a) { return static_cast<double>(a.n); });
+
+		for (size_t q = 0; q < rule.percentiles.size(); ++q)
+		{
+			char name[16];
+			snprintf(name, sizeof(name), "p%g", rule.percentiles[q]);
+			push(name, [q](const Acc &a) { return a.quantiles[q].value(); });
+		}
+	}
+
+	g.n = 0;
+	for (auto &a : g.acc)
+	{
+		a.n = 0;
+		a.merged.clear();
+		for (auto &q : a.quantiles)
+		{
+			q.reset();
+		}
+	}
+}
+
+void Aggregation::dispatchPending()
+{
+	std::vector<Output> out;
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		if (m_pending.empty())
+			return;
+		out.swap(m_pending);
+	}
+
+	/* 聚合结果跳过聚合阶段，仍经过过滤链 */
+	for (auto &o : out)
+	{
+		size_t k = 0;
+		for (size_t i = 0; i < o.values.size() && !o.sketches.empty(); ++i)
+		{
+			if (o.ds->ds[i].type == DS_TYPE_SKETCH)
+				o.values[i].sketch = &o.sketches[k++];
+		}
+		o.vl.values = o.values.data();
+		o.vl.values_len = o.values.size();
+		RstDispatcher::Instance().enqueueNoAggregate(&o.vl);
+	}
+}
+
+bool Aggregation::fold(const value_list_t *vl)
+{
+	if (m_rules.empty())
+		return false;
+
+	bool replace;
+	bool emitted;
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		Route &r = route(vl);
+		if (r.groups.empty())
+			return false;
+		replace = r.replace;
+
+		const cdtime_t t = vl->time ? vl->time : cdtime();
+		for (auto &rg : r.groups)
+		{
+			const Rule &rule = *rg.first;
+			Group &g = *rg.second;
+			const uint64_t window = t / g.interval;
+
+			/* 进入新周期：输出上一周期；迟到的样本并入当前周期 */
+			if (g.n > 0 && window > g.window)
+				emit(rule, g);
+			if (g.n == 0)
+				g.window = window;
+
+			for (size_t i = 0; i < g.acc.size(); ++i)
+			{
+				if (g.ds->ds[i].type == DS_TYPE_SKETCH)
+				{
+					if (vl->values[i].sketch)
+						g.acc[i].merged.merge(*vl->values[i].sketch);
+					continue;
+				}
+
+				const double x = vl->values[i].gauge;
+				if (std::isnan(x))
+					continue;
+
+				Acc &a = g.acc[i];
+				if (a.n++ == 0)
+				{
+					a.sum = x;
+					a.min = x;
+					a.max = x;
+				}
+				else
+				{
+					a.sum += x;
+					a.min = std::min(a.min, x);
+					a.max = std::max(a.max, x);
+				}
+				for (auto &q : a.quantiles)
+				{
+					q.add(x);
+				}
+			}
+			++g.n;
+			g.lastTime = std::max(g.lastTime, t);
+		}
+		emitted = !m_pending.empty();
+	}
+
+	if (emitted)
+		dispatchPending();
+	return replace;
+}
+
+void Aggregation::flushExpired(cdtime_t now)
+{
+	if (m_rules.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		bool pruned = false;
+		for (auto &rule : m_rules)
+		{
+			for (auto it = rule->groups.begin(); it != rule->groups.end();)
+			{
+				Group &g = it->second;
+				const uint64_t window = now / g.interval;
+				if (g.n > 0 && window >= g.window + 2)
+					emit(*rule, g);
+				if (g.n == 0 && window >= g.window + kIdleWindows)
+				{
+					it = rule->groups.erase(it);
+					pruned = true;
+				}
+				else
+					++it;
+			}
+		}
+		/* 路由缓存持有组的指针，删除组后整体重建 */
+		if (pruned)
+			m_routes.clear();
+	}
+
+	dispatchPending();
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FieldMatcher.h"
+#include "ModuleDef.h"
+#include "QuantileSketch.h"
+
+class OConfigItem;
+
+/*
+ * 流式聚合：在过滤链之后、RstDispatcher 入队之前把匹配的样本按 GroupBy 字段归组，
+ * 每个采集周期输出组内的 sum / average / min / max / num 及分位数，
+ * 默认替换原始序列（原始样本不再入队）。
+ *
+ * 配置示例（把每核 CPU 百分比聚合成全机统计）：
+ *   <Aggregation>
+ *     Plugin "cpu"
+ *     Type "percent"
+ *     GroupBy "Plugin" "TypeInstance"     # Type 总是保留
+ *     CalculateAverage true
+ *     CalculateMaximum true
+ *     Percentile 95
+ *     ReplaceRaw true
+ *     Interval 10                         # 缺省取样本自身的 interval
+ *   </Aggregation>
+ *
+ * 匹配值规则与过滤链相同（FieldMatcher）："..." 精确匹配；含 * ? [ 时按 glob；"/.../" 按扩展正则。
+ * 只聚合 GAUGE 与 sketch 数据源：counter / derive / absolute 的原始值是累计量，跨序列取
+ * min / max / 分位数没有意义，这类序列不参与聚合并原样放行（每条规则告警一次）。
+ * 输出序列：未保留的字段置空，plugin_instance 为 "<保留的 plugin_instance>-<函数名>"
+ * 或仅函数名（sum / average / min / max / num / pNN）。
+ *
+ * 统计量随样本到达增量更新，分位数使用 P² 估计器（每个分位数 5 个标记点），不缓存样本。
+ * 含 sketch 数据源的类型只输出一条 "merged" 序列：sketch 按桶合并，其余数据源求和。
+ * 某组收到下一个周期的样本时输出上一周期；无新样本的组在 readAll 时补发，
+ * 连续 kIdleWindows 个周期没有样本的组被删除。
+ */
+
+/* P² 分位数估计（Jain & Chlamtac, 1985），O(1) 内存 */
+class P2Quantile
+{
+public:
+	explicit P2Quantile(double p = 0.5) : m_p(p) {}
+
+	void add(double x);
+	double value() const;
+	void reset() { m_n = 0; }
+
+private:
+	double parabolic(int i, double d) const;
+	double linear(int i, int d) const;
+
+	double m_p;
+	uint64_t m_n = 0;
+	double m_q[5] = {};      ///< 标记点高度
+	double m_pos[5] = {};    ///< 标记点实际位置
+	double m_want[5] = {};   ///< 标记点期望位置
+	double m_step[5] = {};   ///< 期望位置增量
+};
+
+class Aggregation
+{
+public:
+	static Aggregation &Instance();
+
+	/* 解析一个 <Aggregation> 配置块 */
+	int configure(const OConfigItem &ci);
+
+	bool empty() const { return m_rules.empty(); }
+
+	/* 并入匹配的聚合组；返回 true 表示原始样本被替换，调用方不再入队 */
+	bool fold(const value_list_t *vl);
+
+	/* 输出已超过一个周期未收到新样本的组 */
+	void flushExpired(cdtime_t now);
+
+private:
+	Aggregation() = default;
+	~Aggregation() = default;
+
+	Aggregation(const Aggregation &) = delete;
+	Aggregation &operator=(const Aggregation &) = delete;
+
+	enum Field { F_PLUGIN = 0, F_PLUGIN_INSTANCE, F_TYPE, F_TYPE_INSTANCE, F_NUM };
+
+	/* 序列路由缓存的上限 */
+	static constexpr size_t kMaxRoutes = 1 << 16;
+	/* 组空闲多少个周期后删除 */
+	static constexpr uint64_t kIdleWindows = 5;
+
+	enum Func
+	{
+		AGG_SUM = 1 << 0,
+		AGG_AVERAGE = 1 << 1,
+		AGG_MIN = 1 << 2,
+		AGG_MAX = 1 << 3,
+		AGG_NUM = 1 << 4
+	};
+
+	struct Acc
+	{
+		uint64_t n = 0; ///< 本周期有效（非 NaN）值的个数
+		double sum = 0.0;
+		double min = 0.0;
+		double max = 0.0;
+		std::vector<P2Quantile> quantiles;
+		QuantileSketch merged; ///< 仅 sketch 数据源使用
+	};
+
+	struct Group
+	{
+		std::array<std::string, F_NUM> fields; ///< 输出标识，未保留的字段为空
+		const data_set_t *ds = nullptr;
+		bool sketch = false; ///< 数据集中含 sketch 数据源
+		cdtime_t interval = 0;
+		uint64_t window = 0;
+		cdtime_t lastTime = 0;
+		uint64_t n = 0;
+		std::vector<Acc> acc; ///< 每个数据源一个
+	};
+
+	struct Rule
+	{
+		std::array<FieldMatcher, F_NUM> match;
+		std::array<bool, F_NUM> keep{{false, false, true, false}};
+		unsigned funcs = 0;
+		std::vector<double> percentiles;
+		bool replace = true;
+		cdtime_t interval = 0;
+		bool warned = false; ///< 已就非 GAUGE 类型告警过
+		std::unordered_map<std::string, Group> groups;
+	};
+
+	/* 每条原始序列命中的组（首次出现时求值并缓存） */
+	struct Route
+	{
+		std::vector<std::pair<Rule *, Group *>> groups;
+		bool replace = false;
+	};
+
+	struct Output
+	{
+		value_list_t vl;
+		const data_set_t *ds;
+		std::vector<value_t> values;
+		std::vector<QuantileSketch> sketches; ///< 按数据源顺序存放 sketch 值
+	};
+
+	Route &route(const value_list_t *vl);
+	void emit(const Rule &rule, Group &g);
+	void dispatchPending();
+
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<Rule>> m_rules;
+	std::unordered_map<std::string, Route> m_routes;
+	std::string m_key; ///< 复用的序列键缓冲
+	std::vector<Output> m_pending;
+};
@@ -11,7 +11,9 @@
 #include <unistd.h>
 
 #include "Collect.h"
+#include "FlushPool.h"
 #include "PluginService.h"
+#include "Trace.h"
 #include "../oconfig/configfile.h"
 #include "utils/cJSON.h"
 #include "UserConfigManager.h"
@@ -59,7 +61,7 @@ void CollectDaemon::configure(int argc, char **argv)
 void CollectDaemon::parseCmdline(int argc, char **argv)
 {
     int c;
-    while ((c = ::getopt(argc, argv, "BhtTfC:P:F")) != -1)
+    while ((c = ::getopt(argc, argv, "BhtTfC:P:FR:")) != -1)
     {
         switch (c)
         {
@@ -85,6 +87,10 @@ void CollectDaemon::parseCmdline(int argc, char **argv)
         case 'F':
             opt_.test_flushall = true;
             break;
+        case 'R':
+            opt_.trace_file = optarg;
+            Tracer::Instance().setOutputPath(opt_.trace_file);
+            break;
         case 'h':
             std::printf("Usage: collect [OPTIONS]\n"
                         "  -C <file>  Config file\n"
@@ -94,6 +100,7 @@ void CollectDaemon::parseCmdline(int argc, char **argv)
                         "  -B         Don't create BaseDir\n"
                         "  -t         Test config only\n"
                         "  -T         Test read all\n"
+                        "  -R <file>  Dump hot-path trace (Chrome JSON) on exit / SIGPROF\n"
                         "  -h         Help\n");
             std::exit(EXIT_SUCCESS);
         default:
@@ -143,6 +150,12 @@ int CollectDaemon::run()
     {
         initialize();
         int rc = loop();
+        /* 超时被放弃的 flush 线程可能仍在执行插件代码，退出前限时等待 */
+        FlushPool::Instance().drain();
+        if (!opt_.trace_file.empty())
+        {
+            Tracer::Instance().dump();
+        }
         return rc;
     }
     catch (const std::exception &e)
@@ -298,6 +311,12 @@ void CollectDaemon::setupSignals()
 	sa.sa_handler = sigUsr2Handler;
 	sigaction(SIGUSR2, &sa, nullptr);
 
+	if (Tracer::enabled())
+	{
+		sa.sa_handler = sigProfHandler;
+		sigaction(SIGPROF, &sa, nullptr);
+	}
+
 }
 
 void CollectDaemon::sigIntHandler(int)
@@ -337,6 +356,23 @@ void CollectDaemon::sigUsr1Handler(int)
 	pthread_attr_destroy(&attr);
 }
 
+void *CollectDaemon::traceDumpThread(void *)
+{
+    INFO("Trace dump: start.");
+    Tracer::Instance().dump();
+    return nullptr;
+}
+
+void CollectDaemon::sigProfHandler(int)
+{
+	pthread_t th;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_create(&th, &attr, traceDumpThread, nullptr);
+	pthread_attr_destroy(&attr);
+}
+
 void *CollectDaemon::configThread(void*)
 {
     INFO("正在加载用户配置...");
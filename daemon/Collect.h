@@ -18,6 +18,7 @@ struct CmdOptions
     bool test_flushall = false;
     std::string config_file = CONFIGFILE;
     std::string pid_file = PIDFILE;
+    std::string trace_file;
 };
 
 class CollectDaemon
@@ -56,7 +57,11 @@ private:
     static void sigIntHandler(int);
     static void sigTermHandler(int);
     static void sigUsr1Handler(int);
+    static void sigUsr2Handler(int);
+    static void sigProfHandler(int);
     static void *flushThread(void *);
+    static void *configThread(void *);
+    static void *traceDumpThread(void *);
 
 private:
     CmdOptions opt_;
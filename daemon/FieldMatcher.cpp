@@ -0,0 +1,54 @@
+#include <fnmatch.h>
+
+#include "FieldMatcher.h"
+#include "ModuleDef.h"
+
+int FieldMatcher::parse(const std::string &value, const char *what)
+{
+	pattern = value;
+	re.reset();
+
+	if (value.size() >= 2 && value.front() == '/' && value.back() == '/')
+	{
+		const std::string expr = value.substr(1, value.size() - 2);
+		std::unique_ptr<regex_t> compiled(new regex_t);
+		int status = regcomp(compiled.get(), expr.c_str(), REG_EXTENDED | REG_NOSUB);
+		if (status != 0)
+		{
+			char errbuf[256];
+			regerror(status, compiled.get(), errbuf, sizeof(errbuf));
+			ERROR("%s: invalid regex '%s': %s", what, expr.c_str(), errbuf);
+			return -1;
+		}
+		re = std::shared_ptr<regex_t>(compiled.release(), [](regex_t *p) {
+			regfree(p);
+			delete p;
+		});
+		kind = REGEX;
+	}
+	else if (value.find_first_of("*?[") != std::string::npos)
+	{
+		kind = GLOB;
+	}
+	else
+	{
+		kind = EXACT;
+	}
+	return 0;
+}
+
+bool FieldMatcher::match(const char *str) const
+{
+	switch (kind)
+	{
+	case ANY:
+		return true;
+	case EXACT:
+		return pattern == str;
+	case GLOB:
+		return fnmatch(pattern.c_str(), str, 0) == 0;
+	case REGEX:
+		return regexec(re.get(), str, 0, nullptr, 0) == 0;
+	}
+	return false;
+}
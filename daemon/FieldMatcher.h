@@ -0,0 +1,25 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <regex.h>
+
+/*
+ * 标识字段的配置匹配值，过滤链与聚合共用：
+ *   "..."   精确匹配
+ *   含 * ? [ 时按 glob（fnmatch）
+ *   "/.../" 按扩展正则
+ * 未配置的字段为 ANY，总是命中。
+ */
+struct FieldMatcher
+{
+	enum Kind { ANY, EXACT, GLOB, REGEX } kind = ANY;
+	std::string pattern;
+	std::shared_ptr<regex_t> re;
+
+	/* 解析配置值；what 为错误日志的前缀，如 "filter chain" */
+	int parse(const std::string &value, const char *what);
+
+	bool match(const char *str) const;
+};
@@ -0,0 +1,382 @@
+#include <cstring>
+#include <cstdlib>
+
+#include "FilterChain.h"
+#include "../oconfig/oconfig.h"
+
+namespace
+{
+	const char *const kFieldKeys[FC_FIELD_NUM] = {
+		"Plugin", "PluginInstance", "Type", "TypeInstance"
+	};
+
+	int fieldIndex(const std::string &key)
+	{
+		for (int f = 0; f < FC_FIELD_NUM; ++f)
+		{
+			if (key == kFieldKeys[f])
+				return f;
+		}
+		return -1;
+	}
+
+	const char *fieldOf(const value_list_t *vl, int field)
+	{
+		switch (field)
+		{
+		case FC_PLUGIN:          return vl->plugin;
+		case FC_PLUGIN_INSTANCE: return vl->plugin_instance;
+		case FC_TYPE:            return vl->type;
+		default:                 return vl->type_instance;
+		}
+	}
+}
+
+FilterChain &FilterChain::Instance()
+{
+	static FilterChain inst;
+	return inst;
+}
+
+uint32_t FilterChain::intern(const char *str)
+{
+	std::string_view sv(str);
+	auto it = m_ids.find(sv);
+	if (it != m_ids.end())
+		return it->second;
+
+	m_names.emplace_back(sv);
+	const uint32_t id = static_cast<uint32_t>(m_names.size() - 1);
+	m_ids.emplace(std::string_view(m_names.back()), id);
+	return id;
+}
+
+void FilterChain::recycleNames()
+{
+	for (auto it = m_ids.begin(); it != m_ids.end();)
+	{
+		if (it->second >= m_pinned)
+			it = m_ids.erase(it);
+		else
+			++it;
+	}
+	m_names.resize(m_pinned);
+
+	/* 位图与 ratelimit 状态以 id 为键，一并清掉 */
+	auto clearTargets = [](std::vector<std::unique_ptr<Target>> &targets) {
+		for (auto &t : targets)
+		{
+			t->lastPass.clear();
+		}
+	};
+	for (auto &chain : m_chains)
+	{
+		for (auto &masks : chain.masks)
+		{
+			if (masks.size() > m_pinned)
+				masks.resize(m_pinned);
+		}
+		for (auto &rule : chain.rules)
+		{
+			clearTargets(rule.targets);
+		}
+		clearTargets(chain.defaults);
+	}
+}
+
+uint64_t FilterChain::fieldMask(Chain &chain, int field, uint32_t id)
+{
+	auto &masks = chain.masks[field];
+	if (id < masks.size() && (masks[id] & kMaskValid))
+		return masks[id];
+
+	/* 新字符串：对每条 Rule 的该字段求值一次，结果缓存 */
+	uint64_t mask = kMaskValid;
+	const char *str = m_names[id].c_str();
+	for (size_t r = 0; r < chain.rules.size(); ++r)
+	{
+		if (chain.rules[r].match[field].match(id, str))
+			mask |= (1ULL << r);
+	}
+
+	if (id >= masks.size())
+		masks.resize(id + 1, 0);
+	masks[id] = mask;
+	return mask;
+}
+
+bool FilterChain::runTargets(std::vector<std::unique_ptr<Target>> &targets,
+                             SeriesKey &key, cdtime_t now, FcDecision &out)
+{
+	for (auto &t : targets)
+	{
+		switch (t->kind)
+		{
+		case Target::DROP:
+			return false;
+
+		case Target::RENAME:
+			for (int f = 0; f < FC_FIELD_NUM; ++f)
+			{
+				if (t->renameId[f] != kNoId)
+				{
+					key.ids[f] = t->renameId[f];
+					out.rename[f] = m_names[t->renameId[f]].c_str();
+				}
+			}
+			break;
+
+		case Target::WRITE:
+			out.writers = &t->writers;
+			break;
+
+		case Target::RATELIMIT:
+		{
+			/* 距上次放行已满一个间隔的序列下次必然放行，记录可以删掉 */
+			if (now >= t->nextSweep)
+			{
+				for (auto it = t->lastPass.begin(); it != t->lastPass.end();)
+				{
+					if (it->second + t->interval <= now)
+						it = t->lastPass.erase(it);
+					else
+						++it;
+				}
+				t->nextSweep = now + t->interval;
+			}
+
+			auto it = t->lastPass.find(key);
+			if (it != t->lastPass.end() && now - it->second < t->interval)
+				return false;
+			t->lastPass[key] = now;
+			break;
+		}
+		}
+	}
+	return true;
+}
+
+int FilterChain::evaluate(const value_list_t *vl, FcDecision &out)
+{
+	if (!vl)
+		return EINVAL;
+	if (m_chains.empty())
+		return 0;
+
+	const cdtime_t now = (vl->time != 0) ? vl->time : cdtime();
+
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	if (m_names.size() >= kMaxNames)
+		recycleNames();
+
+	SeriesKey key;
+	for (int f = 0; f < FC_FIELD_NUM; ++f)
+	{
+		key.ids[f] = intern(fieldOf(vl, f));
+	}
+
+	for (auto &chain : m_chains)
+	{
+		uint64_t hit = chain.allRules;
+		for (int f = 0; f < FC_FIELD_NUM && hit; ++f)
+		{
+			hit &= fieldMask(chain, f, key.ids[f]);
+		}
+
+		auto &targets = hit ? chain.rules[__builtin_ctzll(hit)].targets
+		                    : chain.defaults;
+		if (!runTargets(targets, key, now, out))
+		{
+			out.drop = true;
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return 0;
+		}
+	}
+	return 0;
+}
+
+void FilterChain::apply(const FcDecision &dec, value_list_t *vl)
+{
+	if (dec.rename[FC_PLUGIN])
+		snprintf(vl->plugin, sizeof(vl->plugin), "%s", dec.rename[FC_PLUGIN]);
+	if (dec.rename[FC_PLUGIN_INSTANCE])
+		snprintf(vl->plugin_instance, sizeof(vl->plugin_instance), "%s", dec.rename[FC_PLUGIN_INSTANCE]);
+	if (dec.rename[FC_TYPE])
+		snprintf(vl->type, sizeof(vl->type), "%s", dec.rename[FC_TYPE]);
+	if (dec.rename[FC_TYPE_INSTANCE])
+		snprintf(vl->type_instance, sizeof(vl->type_instance), "%s", dec.rename[FC_TYPE_INSTANCE]);
+}
+
+int FilterChain::parseMatcher(const std::string &value, Matcher &m)
+{
+	if (m.parse(value, "filter chain") != 0)
+		return -1;
+	if (m.kind == Matcher::EXACT)
+		m.exactId = intern(value.c_str());
+	return 0;
+}
+
+int FilterChain::parseTarget(const OConfigItem &ci, std::unique_ptr<Target> &out)
+{
+	if (ci.values.empty())
+	{
+		ERROR("filter chain: Target needs a name.");
+		return -1;
+	}
+
+	const std::string kind = ci.values[0].getString();
+	auto t = std::make_unique<Target>();
+
+	if (kind == "drop")
+	{
+		t->kind = Target::DROP;
+	}
+	else if (kind == "rename")
+	{
+		t->kind = Target::RENAME;
+		for (auto &child : ci.children)
+		{
+			int f = fieldIndex(child->key);
+			if (f < 0 || child->values.empty())
+			{
+				ERROR("filter chain: rename: invalid option '%s'.", child->key.c_str());
+				return -1;
+			}
+			t->renameId[f] = intern(child->values[0].getString().c_str());
+		}
+	}
+	else if (kind == "write")
+	{
+		t->kind = Target::WRITE;
+		for (auto &child : ci.children)
+		{
+			if (child->key != "Plugin" || child->values.empty())
+			{
+				ERROR("filter chain: write: invalid option '%s'.", child->key.c_str());
+				return -1;
+			}
+			t->writers.push_back(child->values[0].getString());
+		}
+	}
+	else if (kind == "ratelimit")
+	{
+		t->kind = Target::RATELIMIT;
+		for (auto &child : ci.children)
+		{
+			if (child->key != "Interval" || child->values.empty())
+			{
+				ERROR("filter chain: ratelimit: invalid option '%s'.", child->key.c_str());
+				return -1;
+			}
+			double sec = atof(child->values[0].getString().c_str());
+			if (sec <= 0.0)
+			{
+				ERROR("filter chain: ratelimit: Interval must be positive.");
+				return -1;
+			}
+			t->interval = DOUBLE_TO_CDTIME_T(sec);
+		}
+		if (t->interval == 0)
+		{
+			ERROR("filter chain: ratelimit: Interval is required.");
+			return -1;
+		}
+	}
+	else
+	{
+		ERROR("filter chain: unknown target '%s'.", kind.c_str());
+		return -1;
+	}
+
+	out = std::move(t);
+	return 0;
+}
+
+int FilterChain::parseRule(const OConfigItem &ci, Rule &rule)
+{
+	rule.name = ci.values.empty() ? "" : ci.values[0].getString();
+
+	for (auto &child : ci.children)
+	{
+		if (child->key == "Match")
+		{
+			for (auto &m : child->children)
+			{
+				int f = fieldIndex(m->key);
+				if (f < 0 || m->values.empty())
+				{
+					ERROR("filter chain: rule '%s': invalid match '%s'.",
+					      rule.name.c_str(), m->key.c_str());
+					return -1;
+				}
+				if (parseMatcher(m->values[0].getString(), rule.match[f]) != 0)
+					return -1;
+			}
+		}
+		else if (child->key == "Target")
+		{
+			std::unique_ptr<Target> t;
+			if (parseTarget(*child, t) != 0)
+				return -1;
+			rule.targets.push_back(std::move(t));
+		}
+		else
+		{
+			ERROR("filter chain: rule '%s': unknown option '%s'.",
+			      rule.name.c_str(), child->key.c_str());
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int FilterChain::configure(const OConfigItem &ci)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	Chain chain;
+	chain.name = ci.values.empty() ? "" : ci.values[0].getString();
+
+	for (auto &child : ci.children)
+	{
+		if (child->key == "Rule")
+		{
+			if (chain.rules.size() >= FC_MAX_RULES)
+			{
+				ERROR("filter chain '%s': too many rules (max %d).",
+				      chain.name.c_str(), FC_MAX_RULES);
+				return -1;
+			}
+			Rule rule;
+			if (parseRule(*child, rule) != 0)
+				return -1;
+			chain.rules.push_back(std::move(rule));
+		}
+		else if (child->key == "Target")
+		{
+			std::unique_ptr<Target> t;
+			if (parseTarget(*child, t) != 0)
+				return -1;
+			chain.defaults.push_back(std::move(t));
+		}
+		else
+		{
+			ERROR("filter chain '%s': unknown option '%s'.",
+			      chain.name.c_str(), child->key.c_str());
+			return -1;
+		}
+	}
+
+	for (size_t r = 0; r < chain.rules.size(); ++r)
+	{
+		chain.allRules |= (1ULL << r);
+	}
+
+	INFO("filter chain '%s': %zu rule(s), %zu default target(s).",
+	     chain.name.c_str(), chain.rules.size(), chain.defaults.size());
+
+	m_chains.push_back(std::move(chain));
+	m_pinned = m_names.size();
+	return 0;
+}
@@ -1,3 +1,175 @@
+#pragma once
 
-//TODO:过滤链，后续完善过滤规则及诊断报警等功能
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
+#include "FieldMatcher.h"
+#include "ModuleDef.h"
+
+class OConfigItem;
+
+/*
+ * 过滤链：在聚合与 RstDispatcher 入队（深拷贝）之前对每个样本做匹配，
+ * 支持 drop / rename / write(路由到指定 writer) / ratelimit 四种 target。
+ *
+ * 配置示例：
+ *   <Chain "PreCache">
+ *     <Rule "no_idle">
+ *       <Match>
+ *         Plugin "cpu"
+ *         TypeInstance "/^(idle|steal)$/"
+ *       </Match>
+ *       Target "drop"
+ *     </Rule>
+ *     <Target "write">
+ *       Plugin "csv"
+ *     </Target>
+ *   </Chain>
+ *
+ * 匹配值："..." 精确匹配；含 * ? [ 时按 glob；"/.../" 按扩展正则。
+ * 每条 Chain 最多 FC_MAX_RULES 条 Rule，按配置顺序命中第一条即停止本链，
+ * 未命中时执行链级别的默认 Target，随后进入下一条 Chain。
+ *
+ * 样本字段的驻留表超过 kMaxNames 时整体回收（配置中出现的字符串保留），
+ * ratelimit 只保留一个间隔内放行过的序列，序列不断变化时内存也有上界。
+ */
+
+#define FC_MAX_RULES 63
+
+enum FcField
+{
+	FC_PLUGIN = 0,
+	FC_PLUGIN_INSTANCE,
+	FC_TYPE,
+	FC_TYPE_INSTANCE,
+	FC_FIELD_NUM
+};
+
+/* 单个样本的过滤结果 */
+struct FcDecision
+{
+	bool drop = false;
+	/* 非空表示该字段被 rename 成的新值 */
+	std::array<const char *, FC_FIELD_NUM> rename{};
+	/* 非空表示只投递给列表中的 writer，否则投递给全部 */
+	const std::vector<std::string> *writers = nullptr;
+};
+
+class FilterChain
+{
+public:
+	static FilterChain &Instance();
+
+	/* 解析并编译一个 <Chain> 配置块 */
+	int configure(const OConfigItem &ci);
+
+	bool empty() const { return m_chains.empty(); }
+
+	/* 对样本求值；未配置任何 Chain 时直接放行 */
+	int evaluate(const value_list_t *vl, FcDecision &out);
+
+	/* 把 rename 结果写回（已拷贝的）样本 */
+	static void apply(const FcDecision &dec, value_list_t *vl);
+
+	uint64_t droppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+	FilterChain() = default;
+	~FilterChain() = default;
+
+	FilterChain(const FilterChain &) = delete;
+	FilterChain &operator=(const FilterChain &) = delete;
+
+	static constexpr uint32_t kNoId = UINT32_MAX;
+	/* 驻留表的回收阈值 */
+	static constexpr size_t kMaxNames = 1 << 16;
+	/* 掩码最高位用作 "已计算" 标记，其余位对应 Rule 下标 */
+	static constexpr uint64_t kMaskValid = 1ULL << 63;
+
+	/* 精确匹配改为比较驻留 id */
+	struct Matcher : FieldMatcher
+	{
+		uint32_t exactId = kNoId;
+
+		bool match(uint32_t id, const char *str) const
+		{
+			return kind == EXACT ? id == exactId : FieldMatcher::match(str);
+		}
+	};
+
+	struct SeriesKey
+	{
+		std::array<uint32_t, FC_FIELD_NUM> ids;
+		bool operator==(const SeriesKey &o) const { return ids == o.ids; }
+	};
+
+	struct SeriesKeyHash
+	{
+		size_t operator()(const SeriesKey &k) const
+		{
+			uint64_t h = 1469598103934665603ULL;
+			for (uint32_t id : k.ids)
+			{
+				h = (h ^ id) * 1099511628211ULL;
+			}
+			return static_cast<size_t>(h);
+		}
+	};
+
+	struct Target
+	{
+		enum Kind { DROP, RENAME, WRITE, RATELIMIT } kind = DROP;
+		std::array<uint32_t, FC_FIELD_NUM> renameId{{kNoId, kNoId, kNoId, kNoId}};
+		std::vector<std::string> writers;
+		cdtime_t interval = 0;
+		std::unordered_map<SeriesKey, cdtime_t, SeriesKeyHash> lastPass;
+		cdtime_t nextSweep = 0; ///< 下次清理 lastPass 中已过间隔的序列
+	};
+
+	struct Rule
+	{
+		std::string name;
+		std::array<Matcher, FC_FIELD_NUM> match;
+		std::vector<std::unique_ptr<Target>> targets;
+	};
+
+	struct Chain
+	{
+		std::string name;
+		std::vector<Rule> rules;
+		std::vector<std::unique_ptr<Target>> defaults;
+		uint64_t allRules = 0;
+		/* 每个字段：字符串 id -> 命中的 Rule 位图（惰性计算） */
+		std::array<std::vector<uint64_t>, FC_FIELD_NUM> masks;
+	};
+
+	uint32_t intern(const char *str);
+	/* 丢弃样本带来的驻留字符串及依赖其 id 的缓存，只保留配置中的 */
+	void recycleNames();
+	uint64_t fieldMask(Chain &chain, int field, uint32_t id);
+	/* 返回 false 表示样本被丢弃 */
+	bool runTargets(std::vector<std::unique_ptr<Target>> &targets,
+	                SeriesKey &key, cdtime_t now, FcDecision &out);
+
+	int parseRule(const OConfigItem &ci, Rule &rule);
+	int parseMatcher(const std::string &value, Matcher &m);
+	int parseTarget(const OConfigItem &ci, std::unique_ptr<Target> &out);
+
+	std::mutex m_mutex;
+	std::vector<Chain> m_chains;
+
+	/* 字符串驻留表：deque 保证元素地址稳定，可安全作为 string_view 的底层存储 */
+	std::deque<std::string> m_names;
+	std::unordered_map<std::string_view, uint32_t> m_ids;
+	size_t m_pinned = 0; ///< 前 m_pinned 个为配置中的字符串，回收时保留
+
+	std::atomic<uint64_t> m_dropped{0};
+};
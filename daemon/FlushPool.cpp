@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "FlushPool.h"
+#include "ModuleBase.h"
+#include "ModuleLoader.h"
+#include "PluginService.h"
+#include "Trace.h"
+#include "utils/utils_config.h"
+#include "../oconfig/configfile.h"
+#include "../oconfig/oconfig.h"
+
+namespace
+{
+	const char *outcomeName(FlushResult::Outcome o)
+	{
+		switch (o)
+		{
+		case FlushResult::FLUSH_OK:      return "ok";
+		case FlushResult::FLUSH_FAILED:  return "failed";
+		case FlushResult::FLUSH_TIMEOUT: return "timed out";
+		default:                         return "busy";
+		}
+	}
+}
+
+FlushPool &FlushPool::Instance()
+{
+	static FlushPool inst;
+	return inst;
+}
+
+FlushPool::~FlushPool()
+{
+	/* 静态析构时仍未结束的线程无法 join，只能放手；正常退出路径已先调用 drain */
+	for (auto &w : m_workers)
+	{
+		if (w.exited)
+			w.thread.join();
+		else
+			w.thread.detach();
+	}
+}
+
+int FlushPool::configure(const OConfigItem &ci)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	for (auto &child : ci.children)
+	{
+		if (child->key == "Plugin")
+		{
+			if (child->values.empty() || child->values[0].type != OConfigType::STRING)
+			{
+				ERROR("flush: <Plugin> needs a plugin name.");
+				return -1;
+			}
+			const std::string plugin = child->values[0].getString();
+			for (auto &opt : child->children)
+			{
+				if (opt->key != "Timeout" || opt->values.empty() || !(numberOf(opt->values[0]) > 0))
+				{
+					ERROR("flush: invalid option '%s' in <Plugin \"%s\">.", opt->key.c_str(), plugin.c_str());
+					return -1;
+				}
+				m_pluginTimeout[plugin] = numberOf(opt->values[0]);
+			}
+			continue;
+		}
+
+		const double v = child->values.empty() ? 0.0 : numberOf(child->values[0]);
+		if (child->key == "Threads" && v >= 1)
+			m_threads = static_cast<size_t>(v);
+		else if (child->key == "Timeout" && v > 0)
+			m_timeout = v;
+		else if (child->key == "ShutdownTimeout" && v >= 0)
+			m_shutdownTimeout = v;
+		else
+		{
+			ERROR("flush: invalid option '%s'.", child->key.c_str());
+			return -1;
+		}
+	}
+	return 0;
+}
+
+double FlushPool::timeoutOf(const std::string &plugin) const
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	auto it = m_pluginTimeout.find(plugin);
+	return it != m_pluginTimeout.end() ? it->second : m_timeout;
+}
+
+bool FlushPool::acquire(const std::string &plugin)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	return !m_draining && m_inFlight.insert(plugin).second;
+}
+
+bool FlushPool::busy(const std::string &plugin) const
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	return m_inFlight.count(plugin) != 0;
+}
+
+void FlushPool::release(const std::string &plugin)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	m_inFlight.erase(plugin);
+}
+
+void FlushPool::spawnWorker(const std::shared_ptr<Batch> &batch)
+{
+	/* run 不等待超时的任务；句柄留在池中，线程退出后由 reap 或 drain 回收 */
+	std::lock_guard<std::mutex> lk(m_mutex);
+	m_workers.emplace_back();
+	Worker &w = m_workers.back();
+	w.thread = std::thread(&FlushPool::work, this, batch, &w);
+}
+
+void FlushPool::reap()
+{
+	for (auto it = m_workers.begin(); it != m_workers.end();)
+	{
+		if (!it->exited)
+		{
+			++it;
+			continue;
+		}
+		it->thread.join();
+		it = m_workers.erase(it);
+	}
+}
+
+size_t FlushPool::drain()
+{
+	std::unique_lock<std::mutex> lk(m_mutex);
+	m_draining = true;
+	m_exitCv.wait_for(lk, std::chrono::duration<double>(m_shutdownTimeout), [this] {
+		return std::all_of(m_workers.begin(), m_workers.end(), [](const Worker &w) { return w.exited; });
+	});
+	reap();
+	if (!m_workers.empty())
+		WARNING("flush: %zu flush thread(s) still running after %.1f s.", m_workers.size(), m_shutdownTimeout);
+	return m_workers.size();
+}
+
+void FlushPool::work(std::shared_ptr<Batch> batch, Worker *self)
+{
+	std::unique_lock<std::mutex> lk(batch->mutex);
+	while (batch->next < batch->queue.size())
+	{
+		Job &job = batch->jobs[batch->queue[batch->next++]];
+		job.state = Job::RUNNING;
+		job.start = cdtime();
+		/* 让 run 按新任务的期限重新计算等待时间 */
+		batch->cv.notify_all();
+		lk.unlock();
+
+		int status;
+		{
+			TRACE_SCOPE("plugin", "flush", job.result.plugin.c_str());
+			status = job.mod->flush();
+		}
+		const cdtime_t elapsed = cdtime() - job.start;
+		release(job.result.plugin);
+
+		lk.lock();
+		if (job.state == Job::ABANDONED)
+		{
+			INFO("flush: %s finished %.3f s after its deadline (status %d).", job.result.plugin.c_str(),
+			     CDTIME_T_TO_DOUBLE(elapsed - job.timeout), status);
+			continue;
+		}
+		job.state = Job::DONE;
+		job.result.status = status;
+		job.result.elapsedNs = CDTIME_T_TO_NS(elapsed);
+		job.result.outcome = status == 0 ? FlushResult::FLUSH_OK : FlushResult::FLUSH_FAILED;
+		batch->cv.notify_all();
+	}
+	lk.unlock();
+
+	{
+		std::lock_guard<std::mutex> plk(m_mutex);
+		self->exited = true;
+	}
+	m_exitCv.notify_all();
+}
+
+int FlushPool::run(const std::vector<std::string> &plugins, double timeout,
+                   std::vector<FlushResult> *report)
+{
+	const cdtime_t begin = cdtime();
+	{
+		std::lock_guard<std::mutex> plk(m_mutex);
+		reap();
+	}
+	auto batch = std::make_shared<Batch>();
+	batch->jobs.resize(plugins.size());
+
+	/* 上次超时仍未返回的插件本次跳过，避免同一插件的 flush 叠加 */
+	for (size_t i = 0; i < plugins.size(); ++i)
+	{
+		Job &job = batch->jobs[i];
+		job.result.plugin = plugins[i];
+		job.timeout = DOUBLE_TO_CDTIME_T(timeout > 0 ? timeout : timeoutOf(plugins[i]));
+		job.mod = ModuleLoader::Instance().GetUserModuleImpl(plugins[i]);
+		if (job.mod && acquire(plugins[i]))
+		{
+			batch->queue.push_back(i);
+			continue;
+		}
+		job.state = Job::DONE;
+		job.result.outcome = job.mod ? FlushResult::FLUSH_BUSY : FlushResult::FLUSH_FAILED;
+	}
+
+	std::unique_lock<std::mutex> lk(batch->mutex);
+	const size_t workers = std::min(batch->queue.size(), std::max<size_t>(1, m_threads));
+	for (size_t i = 0; i < workers; ++i)
+	{
+		spawnWorker(batch);
+	}
+
+	for (;;)
+	{
+		const cdtime_t now = cdtime();
+		cdtime_t wake = 0;
+		bool open = false;
+		for (size_t i : batch->queue)
+		{
+			Job &job = batch->jobs[i];
+			if (job.state == Job::PENDING)
+			{
+				open = true;
+			}
+			else if (job.state == Job::RUNNING)
+			{
+				const cdtime_t deadline = job.start + job.timeout;
+				if (now < deadline)
+				{
+					open = true;
+					wake = wake == 0 ? deadline : std::min(wake, deadline);
+					continue;
+				}
+				/* 放弃等待；该线程被占住，补一个线程给排队的任务 */
+				job.state = Job::ABANDONED;
+				job.result.outcome = FlushResult::FLUSH_TIMEOUT;
+				job.result.elapsedNs = CDTIME_T_TO_NS(now - job.start);
+				if (batch->next < batch->queue.size())
+					spawnWorker(batch);
+			}
+		}
+		if (!open)
+			break;
+		if (wake == 0)
+			batch->cv.wait(lk);
+		else
+			batch->cv.wait_for(lk, std::chrono::nanoseconds(CDTIME_T_TO_NS(wake - now)));
+	}
+
+	/* 完成报告 */
+	std::vector<FlushResult> results;
+	results.reserve(batch->jobs.size());
+	size_t counts[4] = {};
+	FlushResult slowest;
+	for (const auto &job : batch->jobs)
+	{
+		results.push_back(job.result);
+		++counts[job.result.outcome];
+		if (job.result.outcome == FlushResult::FLUSH_BUSY)
+			WARNING("flush: %s skipped, its previous flush is still running.", job.result.plugin.c_str());
+		else if (job.result.outcome != FlushResult::FLUSH_OK)
+			WARNING("flush: %s %s after %.3f s.", job.result.plugin.c_str(),
+			        outcomeName(job.result.outcome), job.result.elapsedNs / 1e9);
+		if (job.result.elapsedNs >= slowest.elapsedNs)
+			slowest = job.result;
+	}
+	lk.unlock();
+
+	INFO("flush: %zu plugins in %.3f s (ok %zu, failed %zu, timed out %zu, busy %zu), slowest %s %.3f s.",
+	     results.size(), CDTIME_T_TO_DOUBLE(cdtime() - begin),
+	     counts[FlushResult::FLUSH_OK], counts[FlushResult::FLUSH_FAILED],
+	     counts[FlushResult::FLUSH_TIMEOUT], counts[FlushResult::FLUSH_BUSY],
+	     slowest.plugin.empty() ? "-" : slowest.plugin.c_str(), slowest.elapsedNs / 1e9);
+
+	if (report)
+		*report = std::move(results);
+	return counts[FlushResult::FLUSH_OK] == plugins.size() ? 0 : -1;
+}
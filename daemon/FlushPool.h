@@ -0,0 +1,126 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ModuleDef.h"
+
+class OConfigItem;
+class CAbstractUserModule;
+
+/*
+ * 插件 flush 的执行器：PluginService::flushAll / flush 把每个插件的 flush() 作为一个任务，
+ * 由若干工作线程并发执行，手动 flush（SIGUSR1）的耗时取决于最慢的插件而不是各插件之和。
+ *
+ * 每个任务有自己的期限（从开始执行算起）。超期的任务记为超时并放弃等待：
+ * 其线程继续跑完后自行退出，同时补起一个工作线程执行排队中的任务；
+ * 该插件在跑完前再次 flush 时直接跳过（busy），不会叠加。
+ * 全部任务结束或超时后返回，逐个插件的结果写入报告并记日志。
+ *
+ * 工作线程的句柄都保留在池中，退出后回收。进程退出、卸载插件前调用 drain，
+ * 限时等待仍在执行的 flush（含已超时放弃等待的）结束；之后不再接受新的 flush。
+ * 仍未结束的插件不能销毁，由调用方用 busy 判断。
+ *
+ * 配置示例：
+ *   <Flush>
+ *     Threads 8            # 并发数，缺省 8
+ *     Timeout 30           # 每个插件的期限（秒），缺省 30
+ *     ShutdownTimeout 5    # drain 的最长等待（秒），缺省 5
+ *     <Plugin "memory">
+ *       Timeout 10
+ *     </Plugin>
+ *   </Flush>
+ */
+
+/* 一个插件本次 flush 的结果 */
+struct FlushResult
+{
+	enum Outcome { FLUSH_OK = 0, FLUSH_FAILED, FLUSH_TIMEOUT, FLUSH_BUSY };
+
+	std::string plugin;
+	Outcome outcome = FLUSH_OK;
+	int status = 0;        ///< flush() 返回值（超时、busy 时无意义）
+	uint64_t elapsedNs = 0;
+};
+
+class FlushPool
+{
+public:
+	static FlushPool &Instance();
+
+	/* 解析一个 <Flush> 配置块 */
+	int configure(const OConfigItem &ci);
+
+	/*
+	 * 并发执行 plugins 中各插件的 flush()，timeout > 0 时覆盖配置的期限（秒）。
+	 * report 非空时按 plugins 的顺序填入各插件结果；全部成功返回 0，否则 -1。
+	 */
+	int run(const std::vector<std::string> &plugins, double timeout = 0.0,
+	        std::vector<FlushResult> *report = nullptr);
+
+	/* 停止接受新的 flush，等待工作线程退出，最多 ShutdownTimeout 秒；返回仍在运行的线程数 */
+	size_t drain();
+
+	/* plugin 的 flush() 是否仍在执行（含超时后放弃等待的） */
+	bool busy(const std::string &plugin) const;
+
+private:
+	FlushPool() = default;
+	~FlushPool();
+
+	FlushPool(const FlushPool &) = delete;
+	FlushPool &operator=(const FlushPool &) = delete;
+
+	struct Job
+	{
+		enum State { PENDING = 0, RUNNING, DONE, ABANDONED };
+
+		CAbstractUserModule *mod = nullptr;
+		cdtime_t timeout = 0;
+		cdtime_t start = 0;
+		State state = PENDING;
+		FlushResult result;
+	};
+
+	struct Worker
+	{
+		std::thread thread;
+		bool exited = false; ///< work 已返回，可以 join
+	};
+
+	/* 一次 run 的共享状态；超时的线程可能比 run 活得久，故以 shared_ptr 持有 */
+	struct Batch
+	{
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::vector<Job> jobs;      ///< 与调用方的插件顺序一致，工作线程启动后不再增删
+		std::vector<size_t> queue;  ///< 需要执行的任务下标
+		size_t next = 0;            ///< queue 中下一个待领取的位置
+	};
+
+	double timeoutOf(const std::string &plugin) const;
+	bool acquire(const std::string &plugin);
+	void release(const std::string &plugin);
+	void spawnWorker(const std::shared_ptr<Batch> &batch);
+	void work(std::shared_ptr<Batch> batch, Worker *self);
+	/* join 已退出的工作线程，调用时持有 m_mutex */
+	void reap();
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_exitCv;
+	size_t m_threads = 8;
+	double m_timeout = 30.0;
+	double m_shutdownTimeout = 5.0;
+	bool m_draining = false;
+	std::unordered_map<std::string, double> m_pluginTimeout;
+	std::unordered_set<std::string> m_inFlight; ///< flush() 尚未返回的插件
+	std::list<Worker> m_workers;                ///< 尚未回收的工作线程，元素地址稳定
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cerrno>
+
 #include "ModuleDef.h"
 
 class CAbstractUserModule
@@ -17,7 +19,8 @@ public:
 
     virtual int complex_read() { return 0; }
 
-    virtual int write(const data_set_t *ds, const value_list_t *vl) { return 0; }
+    /* 未覆盖 write 的模块返回 ENOSYS，分发端据此把它移出 writer 列表 */
+    virtual int write(const data_set_t *ds, const value_list_t *vl) { return ENOSYS; }
 
     virtual int flush() { return 0; }
 
@@ -31,6 +34,6 @@ public:
 
     virtual int logmsg() { return 0; }
 
-    virtual int notification() { return 0; }
+    virtual int notification(const notification_t *n) { return 0; }
 };
 
@@ -8,6 +8,7 @@
 #define DS_TYPE_DERIVE 2
 #define DS_TYPE_ABSOLUTE 3
 #define DS_TYPE_UNDEFINED 4
+#define DS_TYPE_SKETCH 5
 
 #define DS_TYPE_TO_STRING(t)                                                   \
   (t == DS_TYPE_COUNTER)                                                       \
@@ -16,7 +17,9 @@
             ? "gauge"                                                          \
             : (t == DS_TYPE_DERIVE)                                            \
                   ? "derive"                                                   \
-                  : (t == DS_TYPE_ABSOLUTE) ? "absolute" : "unknown"
+                  : (t == DS_TYPE_ABSOLUTE)                                    \
+                        ? "absolute"                                           \
+                        : (t == DS_TYPE_SKETCH) ? "sketch" : "unknown"
 
 #ifndef LOG_ERR
 #define LOG_ERR 6
@@ -59,11 +62,20 @@ typedef double gauge_t;
 typedef int64_t derive_t;
 typedef uint64_t absolute_t;
 
+/* 分位数 sketch（见 QuantileSketch.h），DS_TYPE_SKETCH 的值以指针传递 */
+#ifdef __cplusplus
+class QuantileSketch;
+typedef QuantileSketch sketch_t;
+#else
+typedef struct QuantileSketch sketch_t;
+#endif
+
 union value_u {
 	counter_t counter;
 	gauge_t gauge;
 	derive_t derive;
 	absolute_t absolute;
+	sketch_t *sketch;
 };
 typedef union value_u value_t;
 
@@ -1,10 +1,17 @@
 #include <iostream>
 #include <cstdarg>
+#include <algorithm>
 
 #include "RstDispatcher.h"
 #include "PluginService.h"
 #include "ModuleBase.h"
 #include "ModuleDef.h"
+#include "Aggregation.h"
+#include "FlushPool.h"
+#include "ProcfsCache.h"
+#include "SelfStats.h"
+#include "Spool.h"
+#include "Trace.h"
 
 PluginService &PluginService::Instance()
 {
@@ -34,6 +41,9 @@ bool PluginService::isLoaded(const char *pluginName) const
 int PluginService::initAll()
 {
     int status = 0;
+    if (SpoolManager::Instance().openAll() != 0)
+        return -1;
+
     for (auto &name : ModuleLoader::Instance().GetLoadedPluginNames())
     {
         auto mod = ModuleLoader::Instance().GetUserModuleImpl(name);
@@ -44,17 +54,34 @@ int PluginService::initAll()
             return status;
         }
     }
+
+    m_writers.clear();
+    for (auto &name : ModuleLoader::Instance().GetLoadedPluginNames())
+    {
+        auto mod = ModuleLoader::Instance().GetUserModuleImpl(name);
+        if (mod)
+            m_writers.push_back({name, mod, SpoolManager::Instance().find(name), true});
+    }
     return 0;
 }
 
 int PluginService::readAllOnce()
 {
     int status = 0;
+    /* 本轮各插件共享同一份 procfs 快照 */
+    ProcfsCache::Instance().beginTick();
     for (auto &name : ModuleLoader::Instance().GetLoadedPluginNames())
     {
         auto mod = ModuleLoader::Instance().GetUserModuleImpl(name);
 		std::cerr << "[read] plugin:" << name << "\n";
-        if (mod && mod->read() != 0)
+        if (!mod)
+            continue;
+
+        TRACE_SCOPE("plugin", "read", name.c_str());
+        SelfStatsTimer timer;
+        const bool ok = (mod->read() == 0);
+        SelfStats::Instance().recordRead(name, timer.elapsedNs(), ok);
+        if (!ok)
         {
             std::cerr << "[plugin] read failed: " << name << "\n";
             status = -1;
@@ -66,18 +93,33 @@ int PluginService::readAllOnce()
 void PluginService::readAll()
 {
     // 简单起见，这里直接调用一次性读；你可以改成多线程或定时调度
+    Aggregation::Instance().flushExpired(cdtime());
     readAllOnce();
 }
 
-int PluginService::write(const data_set_t *ds, const value_list_t *vl)
+int PluginService::write(const data_set_t *ds, const value_list_t *vl,
+                         const std::vector<std::string> *writers)
 {
     if (!vl)
         return EINVAL;
-    for (auto &name : ModuleLoader::Instance().GetLoadedPluginNames())
+    for (auto &w : m_writers)
     {
-        auto mod = ModuleLoader::Instance().GetUserModuleImpl(name);
-        if (mod)
-            mod->write(ds, vl);
+        if (!w.active)
+            continue;
+        if (writers && std::find(writers->begin(), writers->end(), w.name) == writers->end())
+            continue;
+
+        TRACE_SCOPE("plugin", "write", w.name.c_str());
+        /* 配置了 spool 的 writer 经由 spool 投递，故障期间样本落盘 */
+        SelfStatsTimer timer;
+        const int status = w.spool ? w.spool->deliver(w.mod, ds, vl) : w.mod->write(ds, vl);
+        if (status == ENOSYS && !w.spool)
+        {
+            /* 只采集不输出的模块，此后跳过 */
+            w.active = false;
+            continue;
+        }
+        SelfStats::Instance().recordWrite(w.name, timer.elapsedNs(), status == 0);
     }
     return 0;
 }
@@ -86,27 +128,23 @@ int PluginService::flush(const char *pluginName,
                          cdtime_t timeout,
                          const char *ident)
 {
+    std::vector<std::string> names;
     for (auto &name : ModuleLoader::Instance().GetLoadedPluginNames())
     {
         if (!pluginName || name == pluginName)
-        {
-            auto mod = ModuleLoader::Instance().GetUserModuleImpl(name);
-            if (mod)
-                mod->flush();
-        }
+            names.push_back(name);
     }
-    return 0;
+    if (names.empty())
+        return 0;
+    /* timeout 非 0 时覆盖 <Flush> 中配置的期限 */
+    return FlushPool::Instance().run(names, timeout ? CDTIME_T_TO_DOUBLE(timeout) : 0.0);
 }
 
 int PluginService::flushAll()
 {
-    for (auto &name : ModuleLoader::Instance().GetLoadedPluginNames())
-    {
-        auto mod = ModuleLoader::Instance().GetUserModuleImpl(name);
-        if (mod)
-            mod->flush();
-    }
-    return 0;
+    SpoolManager::Instance().syncAll();
+    /* 各插件 flush 并发执行，总耗时取决于最慢的一个 */
+    return FlushPool::Instance().run(ModuleLoader::Instance().GetLoadedPluginNames());
 }
 
 
@@ -144,7 +182,7 @@ int PluginService::dispatchNotification(const notification_t *notif)
     {
         auto mod = ModuleLoader::Instance().GetUserModuleImpl(name);
         if (mod)
-            mod->notification();
+            mod->notification(notif);
     }
     return 0;
 }
@@ -152,8 +190,17 @@ int PluginService::dispatchNotification(const notification_t *notif)
 int PluginService::shutdownAll()
 {
     int status = 0;
+    SpoolManager::Instance().syncAll();
+    FlushPool::Instance().drain();
     for (auto &name : ModuleLoader::Instance().GetLoadedPluginNames())
     {
+        // flush 仍在执行（超时后放弃等待）的插件不能销毁
+        if (FlushPool::Instance().busy(name))
+        {
+            std::cerr << "[plugin] flush still running, not unloaded: " << name << "\n";
+            status = -1;
+            continue;
+        }
         auto mod = ModuleLoader::Instance().GetUserModuleImpl(name);
         if (mod && mod->shutdown() != 0)
         {
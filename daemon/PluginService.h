@@ -1,10 +1,13 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "ModuleLoader.h"
 #include "ModuleDef.h"
 
+class WriterSpool;
+
 class PluginService
 {
 public:
@@ -23,7 +26,8 @@ public:
     void readAll(); // 常规循环里调用
 
     // 分发接口
-    int write(const data_set_t *ds, const value_list_t *vl);
+    int write(const data_set_t *ds, const value_list_t *vl,
+              const std::vector<std::string> *writers = nullptr);
     int flush(const char *pluginName, cdtime_t timeout, const char *ident);
 	int flushAll();
     int dispatchMissing(const value_list_t *vl);
@@ -46,5 +50,15 @@ public:
 private:
     PluginService() = default;
     ~PluginService() = default;
+
+    /* initAll 时按加载顺序登记，只由分发线程在 write() 中读写 */
+    struct Writer
+    {
+        std::string name;
+        CAbstractUserModule *mod;
+        WriterSpool *spool;     ///< 未配置 spool 时为 nullptr
+        bool active;            ///< write() 返回 ENOSYS 后置 false，不再分发和计时
+    };
+    std::vector<Writer> m_writers;
 };
 
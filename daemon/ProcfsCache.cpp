@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ProcfsCache.h"
+#include "SelfStats.h"
+
+namespace
+{
+	/* 连续这么多个节拍未访问的文件被回收 */
+	const uint64_t kIdleTicks = 4;
+	/* 初始读缓冲：/proc/<pid> 下的小文件居多，大文件首次读取时倍增 */
+	const size_t kInitialBuf = 256;
+}
+
+ProcfsCache &ProcfsCache::Instance()
+{
+	static ProcfsCache inst;
+	return inst;
+}
+
+void ProcfsCache::beginTick()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_tick;
+	for (auto it = m_entries.begin(); it != m_entries.end();)
+	{
+		if (it->second.lastUsed + kIdleTicks < m_tick)
+			it = m_entries.erase(it);
+		else
+			++it;
+	}
+}
+
+int ProcfsCache::readFile(const char *path, std::string &buf)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return errno;
+
+	/* procfs 文件的 st_size 为 0，只能读到 EOF；缓冲读满则倍增，容量保留给下次复用 */
+	buf.resize(std::max(buf.capacity(), kInitialBuf));
+	size_t len = 0;
+	for (;;)
+	{
+		if (len == buf.size())
+			buf.resize(buf.size() * 2);
+		ssize_t n = ::read(fd, &buf[len], buf.size() - len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+		{
+			const int err = errno;
+			close(fd);
+			return err;
+		}
+		if (n == 0)
+			break;
+		len += static_cast<size_t>(n);
+	}
+	close(fd);
+	buf.resize(len);
+	return 0;
+}
+
+ProcfsFileStats *ProcfsCache::statsOf(const char *path)
+{
+	/* 纯数字的路径分量归并为 "pid"，避免按进程 / 线程号无限增长 */
+	std::string key;
+	const char *p = path;
+	while (*p)
+	{
+		const char *end = strchr(p, '/');
+		if (!end)
+			end = p + strlen(p);
+		bool digits = end > p;
+		for (const char *q = p; q < end && digits; ++q)
+		{
+			digits = *q >= '0' && *q <= '9';
+		}
+		if (digits)
+			key.append("pid");
+		else
+			key.append(p, end);
+		if (*end == '/')
+			key.push_back('/');
+		p = *end ? end + 1 : end;
+	}
+
+	ProcfsFileStats &s = m_stats[key];
+	if (s.path.empty())
+		s.path = key;
+	return &s;
+}
+
+int ProcfsCache::get(const char *path, ProcfsSnapshot &out, bool refresh)
+{
+	if (!path)
+		return EINVAL;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_key.assign(path);
+	Entry &e = m_entries[m_key];
+	if (!e.stats)
+		e.stats = statsOf(path);
+	e.lastUsed = m_tick;
+
+	if (e.tick == m_tick && !refresh)
+	{
+		++e.stats->hits;
+	}
+	else
+	{
+		/* 旧内容仍被别处持有时换一块新缓冲，持有者看到的内容保持不变 */
+		if (!e.data || e.data.use_count() > 1)
+		{
+			auto fresh = std::make_shared<std::string>();
+			if (e.data)
+				fresh->reserve(e.data->capacity());
+			e.data = std::move(fresh);
+		}
+
+		SelfStatsTimer timer;
+		const int status = readFile(path, *e.data);
+		e.stats->ns += timer.elapsedNs();
+		++e.stats->reads;
+		if (status != 0)
+		{
+			++e.stats->errors;
+			e.tick = 0;
+			return status;
+		}
+		e.stats->bytes += e.data->size();
+		e.tick = m_tick;
+	}
+	out.m_data = e.data;
+	return 0;
+}
+
+void ProcfsCache::snapshot(std::vector<ProcfsFileStats> &out)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	out.clear();
+	out.reserve(m_stats.size());
+	for (const auto &kv : m_stats)
+	{
+		out.push_back(kv.second);
+	}
+}
+
+int procfs_cache_read(const char *path, char *buf, size_t size, size_t *len)
+{
+	if (!buf || !len)
+		return EINVAL;
+
+	ProcfsSnapshot snap;
+	const int status = ProcfsCache::Instance().get(path, snap);
+	if (status != 0)
+		return status;
+	const std::string_view view = snap.view();
+	*len = std::min(view.size(), size);
+	memcpy(buf, view.data(), *len);
+	return 0;
+}
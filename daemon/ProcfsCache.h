@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * procfs 快照缓存：同一采集节拍内每个文件至多读一次，多个插件共享同一份内容，
+ * 例如 cpu 与 vmstat 插件都解析 /proc/stat，但每个周期只产生一次读取。
+ *
+ * PluginService::readAllOnce 在调用各插件 read() 之前执行 beginTick()，之后首次访问时重新读文件。
+ * 交出的快照（ProcfsSnapshot）只读且带引用计数：flush 线程 refresh、beginTick 回收等
+ * 都只替换缓存中的条目，不会改写或释放仍被持有的内容。无人持有的缓冲在下次读取时原地复用，
+ * 插件在函数内用完即释放快照时，稳态下不再分配内存。
+ * 连续若干节拍未被访问的文件（已退出的进程 / 线程）在 beginTick() 时回收。
+ *
+ * 每个文件累计读取次数、命中次数、字节数与耗时，路径中的数字目录
+ * （/proc/<pid>、task/<tid>）归并为 "pid"，由 self 插件上报。
+ */
+
+#ifdef __cplusplus
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct ProcfsFileStats
+{
+	std::string path;    ///< 归并后的路径，如 /proc/pid/task/pid/stat
+	uint64_t reads = 0;  ///< 实际读文件次数
+	uint64_t hits = 0;   ///< 由本节拍快照直接返回的次数
+	uint64_t errors = 0;
+	uint64_t bytes = 0;
+	uint64_t ns = 0;     ///< 读文件累计耗时
+};
+
+/* 某个文件一次读取的内容；持有期间内容不变 */
+class ProcfsSnapshot
+{
+public:
+	std::string_view view() const { return m_data ? std::string_view(*m_data) : std::string_view(); }
+	void reset() { m_data.reset(); }
+
+private:
+	friend class ProcfsCache;
+	std::shared_ptr<const std::string> m_data;
+};
+
+class ProcfsCache
+{
+public:
+	static ProcfsCache &Instance();
+
+	/* 开始新的采集节拍 */
+	void beginTick();
+
+	/*
+	 * 取 path 在本节拍的内容，本节拍首次访问时读文件；成功返回 0，失败返回 errno。
+	 * refresh 为 true 时无视快照重新读取（如 thread 插件 flush 中间隔 1 秒的两次采样）。
+	 * 可在任意线程调用；插件应在本周期内用完并释放快照，以便缓冲被复用。
+	 */
+	int get(const char *path, ProcfsSnapshot &out, bool refresh = false);
+
+	/* 各文件的累计读取开销 */
+	void snapshot(std::vector<ProcfsFileStats> &out);
+
+private:
+	ProcfsCache() = default;
+	~ProcfsCache() = default;
+
+	ProcfsCache(const ProcfsCache &) = delete;
+	ProcfsCache &operator=(const ProcfsCache &) = delete;
+
+	struct Entry
+	{
+		std::shared_ptr<std::string> data; ///< 交出时以 const 共享
+		uint64_t tick = 0;     ///< 内容所属节拍，0 表示尚未读过
+		uint64_t lastUsed = 0; ///< 最近一次访问的节拍
+		ProcfsFileStats *stats = nullptr;
+	};
+
+	static int readFile(const char *path, std::string &buf);
+	ProcfsFileStats *statsOf(const char *path);
+
+	std::mutex m_mutex;
+	std::unordered_map<std::string, Entry> m_entries;
+	std::unordered_map<std::string, ProcfsFileStats> m_stats; ///< 节点地址稳定，Entry 直接持有指针
+	std::string m_key; ///< 复用的查找键，避免每次分配
+	uint64_t m_tick = 1;
+};
+
+extern "C"
+{
+#endif
+
+	/*
+	 * C 接口（供 utils.c 使用）：同 ProcfsCache::get()，内容复制到调用方的 buf（至多 size 字节，
+	 * 不以 '\0' 结尾），*len 为复制的字节数
+	 */
+	int procfs_cache_read(const char *path, char *buf, size_t size, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
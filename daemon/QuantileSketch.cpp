@@ -0,0 +1,414 @@
+#include <algorithm>
+#include <cerrno>
+#include <cfloat>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include "QuantileSketch.h"
+
+namespace
+{
+	const uint8_t kVersion = 1;
+	/* 绝对值小于该阈值的样本计入零桶 */
+	const double kMinIndexable = 1e-9;
+	/* 反序列化时单个桶存储允许的最大桶数 */
+	const uint64_t kMaxSerializedBuckets = 1 << 16;
+	/* 反序列化接受的最小 alpha：保证有限 double 的桶下标落在 int32 内 */
+	const double kMinAlpha = 1e-6;
+
+	void putVarint(std::string &out, uint64_t v)
+	{
+		while (v >= 0x80)
+		{
+			out += static_cast<char>((v & 0x7F) | 0x80);
+			v >>= 7;
+		}
+		out += static_cast<char>(v);
+	}
+
+	size_t varintSize(uint64_t v)
+	{
+		size_t n = 1;
+		while (v >= 0x80)
+		{
+			v >>= 7;
+			++n;
+		}
+		return n;
+	}
+
+	void putDouble(std::string &out, double d)
+	{
+		char b[sizeof(double)];
+		memcpy(b, &d, sizeof(b));
+		out.append(b, sizeof(b));
+	}
+
+	uint64_t zigzag(int64_t v)
+	{
+		return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+	}
+
+	int64_t unzigzag(uint64_t v)
+	{
+		return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+	}
+
+	struct Reader
+	{
+		const uint8_t *p;
+		const uint8_t *end;
+		bool ok = true;
+
+		uint64_t varint()
+		{
+			uint64_t v = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				if (p >= end)
+					break;
+				const uint8_t b = *p++;
+				v |= static_cast<uint64_t>(b & 0x7F) << shift;
+				if (!(b & 0x80))
+					return v;
+			}
+			ok = false;
+			return 0;
+		}
+
+		double dbl()
+		{
+			double d = 0.0;
+			if (end - p < static_cast<ptrdiff_t>(sizeof(d)))
+			{
+				ok = false;
+				return 0.0;
+			}
+			memcpy(&d, p, sizeof(d));
+			p += sizeof(d);
+			return d;
+		}
+	};
+}
+
+/* ---------- Store ---------- */
+
+void QuantileSketch::Store::add(int32_t index, uint64_t n, size_t maxBuckets)
+{
+	if (counts.empty())
+	{
+		offset = index;
+		counts.assign(1, n);
+		return;
+	}
+
+	/*
+	 * 先算出容纳 index 后保留的最低桶：总跨度超过上限时只保留最高的 maxBuckets 个，
+	 * 低于它的旧桶和样本并入该桶。下标用 int64 计算，间隔再大也不会先分配再合并。
+	 */
+	const int64_t top = std::max<int64_t>(index, static_cast<int64_t>(offset) + static_cast<int64_t>(counts.size()) - 1);
+	const int64_t low = std::max<int64_t>(std::min<int64_t>(index, offset),
+	                                      top - static_cast<int64_t>(maxBuckets) + 1);
+	collapseTo(low);
+
+	const int64_t target = std::max<int64_t>(index, low);
+	if (target < offset)
+	{
+		counts.insert(counts.begin(), static_cast<size_t>(offset - target), 0);
+		offset = static_cast<int32_t>(target);
+	}
+	else if (static_cast<size_t>(target - offset) >= counts.size())
+	{
+		counts.resize(static_cast<size_t>(target - offset) + 1, 0);
+	}
+	counts[static_cast<size_t>(target - offset)] += n;
+}
+
+void QuantileSketch::Store::collapseTo(int64_t low)
+{
+	if (low <= offset)
+		return;
+
+	const size_t shift = static_cast<size_t>(low - offset);
+	if (shift >= counts.size())
+	{
+		/* 全部旧桶都在 low 以下 */
+		uint64_t total = 0;
+		for (uint64_t c : counts)
+		{
+			total += c;
+		}
+		counts.assign(1, total);
+	}
+	else
+	{
+		uint64_t total = 0;
+		for (size_t i = 0; i <= shift; ++i)
+		{
+			total += counts[i];
+		}
+		counts.erase(counts.begin(), counts.begin() + shift);
+		counts.front() = total;
+	}
+	offset = static_cast<int32_t>(low);
+}
+
+void QuantileSketch::Store::merge(const Store &o, size_t maxBuckets)
+{
+	for (size_t i = 0; i < o.counts.size(); ++i)
+	{
+		if (o.counts[i])
+			add(o.offset + static_cast<int32_t>(i), o.counts[i], maxBuckets);
+	}
+}
+
+/* ---------- QuantileSketch ---------- */
+
+QuantileSketch::QuantileSketch(double alpha, size_t maxBuckets)
+	: m_alpha(alpha), m_gamma((1 + alpha) / (1 - alpha)),
+	  m_lnGamma(std::log(m_gamma)), m_maxBuckets(maxBuckets)
+{
+}
+
+int32_t QuantileSketch::indexOf(double absx) const
+{
+	return static_cast<int32_t>(std::ceil(std::log(absx) / m_lnGamma));
+}
+
+double QuantileSketch::valueOf(int32_t index) const
+{
+	/* 桶 (γ^(i-1), γ^i] 内相对误差最小的代表值 */
+	return 2.0 * std::exp(index * m_lnGamma) / (m_gamma + 1.0);
+}
+
+void QuantileSketch::add(double x, uint64_t n)
+{
+	if (!std::isfinite(x) || n == 0)
+		return;
+
+	if (x > kMinIndexable)
+		m_pos.add(indexOf(x), n, m_maxBuckets);
+	else if (x < -kMinIndexable)
+		m_neg.add(indexOf(-x), n, m_maxBuckets);
+	else
+		m_zero += n;
+
+	if (m_count == 0)
+	{
+		m_min = x;
+		m_max = x;
+	}
+	else
+	{
+		m_min = std::min(m_min, x);
+		m_max = std::max(m_max, x);
+	}
+	m_count += n;
+	m_sum += x * static_cast<double>(n);
+}
+
+int QuantileSketch::merge(const QuantileSketch &other)
+{
+	if (std::fabs(other.m_alpha - m_alpha) > 1e-12)
+		return EINVAL;
+	if (other.m_count == 0)
+		return 0;
+
+	m_pos.merge(other.m_pos, m_maxBuckets);
+	m_neg.merge(other.m_neg, m_maxBuckets);
+	m_zero += other.m_zero;
+
+	if (m_count == 0)
+	{
+		m_min = other.m_min;
+		m_max = other.m_max;
+	}
+	else
+	{
+		m_min = std::min(m_min, other.m_min);
+		m_max = std::max(m_max, other.m_max);
+	}
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+	return 0;
+}
+
+double QuantileSketch::quantile(double q) const
+{
+	if (m_count == 0)
+		return NAN;
+	if (q <= 0.0)
+		return m_min;
+	if (q >= 1.0)
+		return m_max;
+
+	const double rank = q * static_cast<double>(m_count - 1);
+	double seen = 0.0;
+	double v = m_max;
+	bool found = false;
+
+	/* 负值：下标越大越小，从高到低遍历 */
+	for (size_t i = m_neg.counts.size(); i-- > 0 && !found;)
+	{
+		seen += static_cast<double>(m_neg.counts[i]);
+		if (seen > rank)
+		{
+			v = -valueOf(m_neg.offset + static_cast<int32_t>(i));
+			found = true;
+		}
+	}
+	if (!found)
+	{
+		seen += static_cast<double>(m_zero);
+		if (seen > rank)
+		{
+			v = 0.0;
+			found = true;
+		}
+	}
+	for (size_t i = 0; i < m_pos.counts.size() && !found; ++i)
+	{
+		seen += static_cast<double>(m_pos.counts[i]);
+		if (seen > rank)
+		{
+			v = valueOf(m_pos.offset + static_cast<int32_t>(i));
+			found = true;
+		}
+	}
+	return std::min(std::max(v, m_min), m_max);
+}
+
+void QuantileSketch::clear()
+{
+	m_pos.clear();
+	m_neg.clear();
+	m_zero = 0;
+	m_count = 0;
+	m_sum = 0.0;
+	m_min = 0.0;
+	m_max = 0.0;
+}
+
+void QuantileSketch::serialize(std::string &out) const
+{
+	out += static_cast<char>(kVersion);
+	putDouble(out, m_alpha);
+	putVarint(out, m_count);
+	putDouble(out, m_sum);
+	putDouble(out, m_min);
+	putDouble(out, m_max);
+	putVarint(out, m_zero);
+	for (const Store *s : {&m_pos, &m_neg})
+	{
+		putVarint(out, zigzag(s->offset));
+		putVarint(out, s->counts.size());
+		for (uint64_t c : s->counts)
+		{
+			putVarint(out, c);
+		}
+	}
+}
+
+size_t QuantileSketch::serializedSize() const
+{
+	size_t n = 1 + 4 * sizeof(double) + varintSize(m_count) + varintSize(m_zero);
+	for (const Store *s : {&m_pos, &m_neg})
+	{
+		n += varintSize(zigzag(s->offset)) + varintSize(s->counts.size());
+		for (uint64_t c : s->counts)
+		{
+			n += varintSize(c);
+		}
+	}
+	return n;
+}
+
+int QuantileSketch::deserialize(const uint8_t *data, size_t len)
+{
+	Reader r{data, data + len};
+	if (len < 1 || *r.p++ != kVersion)
+		return EINVAL;
+
+	const double alpha = r.dbl();
+	const uint64_t count = r.varint();
+	const double sum = r.dbl();
+	const double mn = r.dbl();
+	const double mx = r.dbl();
+	const uint64_t zero = r.varint();
+	if (!r.ok || !(alpha >= kMinAlpha && alpha < 1.0))
+		return EINVAL;
+
+	/* 桶下标只能落在有限 double（|x| > kMinIndexable）可达的范围内 */
+	const double lnGamma = std::log((1 + alpha) / (1 - alpha));
+	const int64_t minIndex = static_cast<int64_t>(std::ceil(std::log(kMinIndexable) / lnGamma));
+	const int64_t maxIndex = static_cast<int64_t>(std::ceil(std::log(DBL_MAX) / lnGamma));
+
+	Store stores[2];
+	uint64_t total = zero;
+	for (Store &s : stores)
+	{
+		const int64_t offset = unzigzag(r.varint());
+		const uint64_t n = r.varint();
+		if (!r.ok || n > kMaxSerializedBuckets || n > static_cast<uint64_t>(r.end - r.p))
+			return EINVAL;
+		if (n > 0 && (offset < minIndex || offset + static_cast<int64_t>(n) - 1 > maxIndex))
+			return EINVAL;
+		s.offset = static_cast<int32_t>(offset);
+		s.counts.resize(n);
+		for (uint64_t i = 0; i < n; ++i)
+		{
+			s.counts[i] = r.varint();
+			total += s.counts[i];
+		}
+	}
+	if (!r.ok || r.p != r.end || total != count)
+		return EINVAL;
+
+	m_alpha = alpha;
+	m_gamma = (1 + alpha) / (1 - alpha);
+	m_lnGamma = lnGamma;
+	m_maxBuckets = std::max<size_t>(m_maxBuckets,
+	                                std::max(stores[0].counts.size(), stores[1].counts.size()));
+	m_pos = std::move(stores[0]);
+	m_neg = std::move(stores[1]);
+	m_zero = zero;
+	m_count = count;
+	m_sum = sum;
+	m_min = mn;
+	m_max = mx;
+	return 0;
+}
+
+/* ---------- SketchAccumulator ---------- */
+
+SketchAccumulator::SketchAccumulator(double alpha)
+	: m_alpha(alpha)
+{
+	for (auto &s : m_shards)
+	{
+		s.sketch = QuantileSketch(alpha);
+	}
+}
+
+void SketchAccumulator::add(double x)
+{
+	static thread_local const size_t shard =
+		std::hash<std::thread::id>()(std::this_thread::get_id()) % kShards;
+
+	Shard &s = m_shards[shard];
+	std::lock_guard<std::mutex> lk(s.mutex);
+	s.sketch.add(x);
+}
+
+void SketchAccumulator::collect(QuantileSketch &out, bool reset)
+{
+	out = QuantileSketch(m_alpha);
+	for (auto &s : m_shards)
+	{
+		std::lock_guard<std::mutex> lk(s.mutex);
+		out.merge(s.sketch);
+		if (reset)
+			s.sketch.clear();
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ModuleDef.h"
+
+/*
+ * 可合并的分位数 sketch（DDSketch）：按相对误差 alpha 划分对数桶，
+ * 任意分位数的估计值相对误差不超过 alpha；同参数的 sketch 可直接按桶相加合并。
+ *
+ * 作为 DS_TYPE_SKETCH 数据源的取值（value_t::sketch）提交：
+ *   types.db:  latency  value:SKETCH:0:U
+ *
+ *   QuantileSketch sk;              // 或 SketchAccumulator 供多线程累积
+ *   sk.add(0.0123);
+ *   value_t v; v.sketch = &sk;
+ *   vl.values = &v; vl.values_len = 1;
+ *   PluginService::Instance().dispatchValues(&vl);   // 分发时深拷贝，调用方可立即清空
+ *
+ * 桶数超过上限时合并最低的桶（低分位精度下降，高分位保持误差界）。
+ */
+class QuantileSketch
+{
+public:
+	explicit QuantileSketch(double alpha = 0.01, size_t maxBuckets = 2048);
+
+	void add(double x, uint64_t n = 1);
+
+	/* alpha 不同返回 EINVAL */
+	int merge(const QuantileSketch &other);
+
+	/* q ∈ [0, 1]；空 sketch 返回 NaN */
+	double quantile(double q) const;
+
+	uint64_t count() const { return m_count; }
+	double sum() const { return m_sum; }
+	double min() const { return m_min; }
+	double max() const { return m_max; }
+	double alpha() const { return m_alpha; }
+	bool empty() const { return m_count == 0; }
+
+	void clear();
+
+	/* 紧凑二进制格式（varint 桶计数），用于线上传输与落盘 */
+	void serialize(std::string &out) const;
+	size_t serializedSize() const;
+	/* 成功返回 0，格式错误返回 EINVAL */
+	int deserialize(const uint8_t *data, size_t len);
+
+private:
+	struct Store
+	{
+		int32_t offset = 0;            ///< counts[0] 对应的桶下标
+		std::vector<uint64_t> counts;
+
+		void add(int32_t index, uint64_t n, size_t maxBuckets);
+		void merge(const Store &o, size_t maxBuckets);
+		/* 把低于 low 的桶并入 low 桶 */
+		void collapseTo(int64_t low);
+		void clear()
+		{
+			offset = 0;
+			counts.clear();
+		}
+	};
+
+	int32_t indexOf(double absx) const;
+	double valueOf(int32_t index) const;
+
+	double m_alpha;
+	double m_gamma;
+	double m_lnGamma;
+	size_t m_maxBuckets;
+
+	Store m_pos;
+	Store m_neg;
+	uint64_t m_zero = 0;
+	uint64_t m_count = 0;
+	double m_sum = 0.0;
+	double m_min = 0.0;
+	double m_max = 0.0;
+};
+
+/*
+ * 多线程累积：按线程分片加锁写入，collect 时合并所有分片。
+ * 热路径只竞争本线程所在分片的锁。
+ */
+class SketchAccumulator
+{
+public:
+	explicit SketchAccumulator(double alpha = 0.01);
+
+	void add(double x);
+
+	/* 合并所有分片到 out（out 被重置为同一 alpha）；reset 为 true 时清空分片开始新周期 */
+	void collect(QuantileSketch &out, bool reset = true);
+
+private:
+	enum { kShards = 16 };
+
+	struct alignas(64) Shard
+	{
+		std::mutex mutex;
+		QuantileSketch sketch;
+	};
+
+	double m_alpha;
+	Shard m_shards[kShards];
+};
+
+/* 数值型 writer 把 sketch 降为标量时统一取中位数 */
+inline double sketch_scalar(const value_t &v)
+{
+	return v.sketch ? v.sketch->quantile(0.5) : NAN;
+}
@@ -9,13 +9,26 @@
 #include <chrono>
 
 #include "RstDispatcher.h"
+#include "Aggregation.h"
+#include "FilterChain.h"
+#include "QuantileSketch.h"
+#include "SelfStats.h"
+#include "Threshold.h"
+#include "Trace.h"
 #include "ModuleLoader.h"
 #include "PluginService.h"
 #include "../oconfig/configfile.h"
 
 struct RstDispatcher::Impl
 {
-    std::deque<std::shared_ptr<value_list_t>> queue;
+    struct Item
+    {
+        std::shared_ptr<value_list_t> vl;
+        const std::vector<std::string> *writers = nullptr; ///< 过滤链路由结果，nullptr 表示全部 writer
+        const data_set_t *ds = nullptr;
+    };
+
+    std::deque<Item> queue;
     std::mutex              mtx;
     std::condition_variable cv;
     std::atomic<bool>       exit{false};
@@ -27,20 +40,21 @@ struct RstDispatcher::Impl
             /* 若有 thread_set_name，可以在此调用 */
             while (!exit.load(std::memory_order_acquire))
             {
-                std::shared_ptr<value_list_t> vl;
+                Item item;
                 {
                     std::unique_lock<std::mutex> lk(mtx);
                     cv.wait(lk, [this]{ return exit || !queue.empty(); });
                     if (exit && queue.empty()) break;
-                    vl = std::move(queue.front());
+                    item = std::move(queue.front());
                     queue.pop_front();
+                    SelfStats::Instance().recordDequeue(queue.size());
                 }
 
-                /* todo: 过滤链钩子占位 */
-
-                /* 分发给所有 writer 插件 */
-				const data_set_t* ds = ConfigManager::Instance().GetDataSetByName(vl.get()->type);
-				PluginService::Instance().write(ds, vl.get());
+                /* 过滤链已在 enqueue 时求值，这里按路由结果分发给 writer 插件 */
+                TRACE_SCOPE("dispatcher", "dequeue", item.vl->type);
+                Threshold::Instance().check(item.ds, item.vl.get());
+				PluginService::Instance().write(item.ds, item.vl.get(), item.writers);
+				SelfStats::Instance().recordWritten();
             }
         });
     }
@@ -62,11 +76,32 @@ RstDispatcher& RstDispatcher::Instance()
 RstDispatcher::RstDispatcher()  : pImpl_(new Impl) {}
 RstDispatcher::~RstDispatcher() = default;
 
-std::shared_ptr<value_list_t> RstDispatcher::vl_clone(const value_list_t *src)
+std::shared_ptr<value_list_t> RstDispatcher::vl_clone(const value_list_t *src, const data_set_t *ds)
 {
 	if (!src) return nullptr;
 
-	auto dst = std::make_shared<value_list_t>();
+	bool sketches = false;
+	if (ds && ds->ds_num == src->values_len)
+	{
+		for (size_t i = 0; i < ds->ds_num; ++i)
+		{
+			sketches = sketches || ds->ds[i].type == DS_TYPE_SKETCH;
+		}
+	}
+
+	/* values 为 new[] 分配，需随样本一起释放；sketch 值为深拷贝，同样在此释放 */
+	std::shared_ptr<value_list_t> dst(new value_list_t, [ds, sketches](value_list_t *p) {
+		if (sketches && p->values)
+		{
+			for (size_t i = 0; i < p->values_len; ++i)
+			{
+				if (ds->ds[i].type == DS_TYPE_SKETCH)
+					delete p->values[i].sketch;
+			}
+		}
+		delete[] p->values;
+		delete p;
+	});
 
 	dst->values_len = src->values_len;
 	
@@ -89,6 +124,16 @@ std::shared_ptr<value_list_t> RstDispatcher::vl_clone(const value_list_t *src)
 	{
 		dst->values = new value_t[src->values_len];
 		memcpy(dst->values, src->values, src->values_len * sizeof(value_t));
+		if (sketches)
+		{
+			for (size_t i = 0; i < src->values_len; ++i)
+			{
+				if (ds->ds[i].type == DS_TYPE_SKETCH)
+					dst->values[i].sketch = src->values[i].sketch
+					                        ? new QuantileSketch(*src->values[i].sketch)
+					                        : nullptr;
+			}
+		}
 	}
 	else
 	{
@@ -102,12 +147,59 @@ int RstDispatcher::enqueue(const value_list_t *vl)
 {
 	if (!vl) return EINVAL;
 
-	auto clone_vl = vl_clone(vl);
-	if (!clone_vl) return ENOMEM;
+	/* 先过滤：被丢弃的样本既不并入聚合组，也不产生任何分配 */
+	FcDecision dec;
+	if (FilterChain::Instance().evaluate(vl, dec) != 0) return EINVAL;
+	if (dec.drop) return 0;
+
+	/* 命中聚合规则的样本按 rename 后的标识并入聚合组，替换原始序列时不再入队 */
+	if (!Aggregation::Instance().empty())
+	{
+		const bool renamed = dec.rename[FC_PLUGIN] || dec.rename[FC_PLUGIN_INSTANCE] ||
+		                     dec.rename[FC_TYPE] || dec.rename[FC_TYPE_INSTANCE];
+		value_list_t tmp;
+		const value_list_t *folded = vl;
+		if (renamed)
+		{
+			tmp = *vl;
+			FilterChain::apply(dec, &tmp);
+			folded = &tmp;
+		}
+		if (Aggregation::Instance().fold(folded)) return 0;
+	}
+
+	return push(vl, dec);
+}
+
+int RstDispatcher::enqueueNoAggregate(const value_list_t *vl)
+{
+	if (!vl) return EINVAL;
+
+	FcDecision dec;
+	if (FilterChain::Instance().evaluate(vl, dec) != 0) return EINVAL;
+	if (dec.drop) return 0;
+
+	return push(vl, dec);
+}
+
+int RstDispatcher::push(const value_list_t *vl, const FcDecision &dec)
+{
+	/* 数据集在入队时解析一次，供深拷贝与 writer 共用 */
+	const data_set_t *ds = ConfigManager::Instance().GetDataSetByName(vl->type);
+	auto clone_vl = vl_clone(vl, ds);
+	if (!clone_vl)
+	{
+		SelfStats::Instance().recordDropped();
+		return ENOMEM;
+	}
+	FilterChain::apply(dec, clone_vl.get());
+	if (dec.rename[FC_TYPE])
+		ds = ConfigManager::Instance().GetDataSetByName(clone_vl->type);
 
 	{
 		std::lock_guard<std::mutex> lk(pImpl_->mtx);
-		pImpl_->queue.emplace_back(clone_vl);
+		pImpl_->queue.push_back(Impl::Item{std::move(clone_vl), dec.writers, ds});
+		SelfStats::Instance().recordEnqueue(pImpl_->queue.size());
 	}
 
 	pImpl_->cv.notify_one();
@@ -4,6 +4,8 @@
 
 #include "ModuleDef.h"
 
+struct FcDecision;
+
 /* 负责把采集到的 value_list_t 异步分发给所有 writer-plugin 的单例 */
 class RstDispatcher
 {
@@ -13,6 +15,9 @@ public:
     /* 把数据入队 – 内部会做深拷贝，立即返回 */
     int  enqueue(const value_list_t *vl);
 
+    /* 过滤后跳过聚合阶段直接入队（聚合结果经此回到分发队列） */
+    int  enqueueNoAggregate(const value_list_t *vl);
+
     int enqueueMultivalues(const value_list_t* vl_template,
                            bool store_percentage_if_gauge,
                            int common_store_type,
@@ -34,7 +39,11 @@ private:
     RstDispatcher(const RstDispatcher&)            = delete;
     RstDispatcher& operator=(const RstDispatcher&) = delete;
 
-    static std::shared_ptr<value_list_t> vl_clone(const value_list_t *src);
+    /* ds 用于识别需要深拷贝的 sketch 值，可为 nullptr */
+    static std::shared_ptr<value_list_t> vl_clone(const value_list_t *src, const data_set_t *ds);
+
+    /* 按过滤结果深拷贝并放入队列 */
+    int push(const value_list_t *vl, const FcDecision &dec);
 
     struct Impl;
     std::unique_ptr<Impl> pImpl_;
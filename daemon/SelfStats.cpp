@@ -0,0 +1,172 @@
+#include <ctime>
+#include <mutex>
+
+#include "SelfStats.h"
+
+namespace
+{
+	int bucketOf(uint64_t ns)
+	{
+		uint64_t us = ns / 1000;
+		int b = 0;
+		while (us > 1 && b < SELF_HIST_BUCKETS - 1)
+		{
+			us >>= 1;
+			++b;
+		}
+		return b;
+	}
+
+	void load(const LatencyHistogram &h, LatencySummary &out)
+	{
+		for (int i = 0; i < SELF_HIST_BUCKETS; ++i)
+		{
+			out.buckets[i] = h.buckets[i].load(std::memory_order_relaxed);
+		}
+		out.count = h.count.load(std::memory_order_relaxed);
+		out.sumNs = h.sumNs.load(std::memory_order_relaxed);
+		out.maxNs = h.maxNs.load(std::memory_order_relaxed);
+		out.errors = h.errors.load(std::memory_order_relaxed);
+	}
+
+	/* cur 为累计值，last 为上次快照；返回增量并把 last 更新为 cur */
+	LatencySummary delta(const LatencySummary &cur, LatencySummary &last)
+	{
+		LatencySummary d;
+		for (int i = 0; i < SELF_HIST_BUCKETS; ++i)
+		{
+			d.buckets[i] = cur.buckets[i] - last.buckets[i];
+		}
+		d.count = cur.count - last.count;
+		d.sumNs = cur.sumNs - last.sumNs;
+		d.maxNs = cur.maxNs;
+		d.errors = cur.errors - last.errors;
+		last = cur;
+		return d;
+	}
+}
+
+void LatencyHistogram::record(uint64_t ns, bool ok)
+{
+	buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sumNs.fetch_add(ns, std::memory_order_relaxed);
+	if (!ok)
+	{
+		errors.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	uint64_t prev = maxNs.load(std::memory_order_relaxed);
+	while (ns > prev && !maxNs.compare_exchange_weak(prev, ns, std::memory_order_relaxed))
+	{
+	}
+}
+
+LatencySummary LatencyHistogram::deltaSince(LatencySummary &last)
+{
+	LatencySummary cur;
+	load(*this, cur);
+	maxNs.store(0, std::memory_order_relaxed);
+	return delta(cur, last);
+}
+
+double LatencySummary::quantile(double q) const
+{
+	if (count == 0)
+		return 0.0;
+
+	const uint64_t rank = static_cast<uint64_t>(q * count + 0.5);
+	uint64_t seen = 0;
+	for (int i = 0; i < SELF_HIST_BUCKETS; ++i)
+	{
+		seen += buckets[i];
+		if (seen >= rank && seen > 0)
+		{
+			/* 桶上界 2^(i+1) 微秒，不超过本周期最大值 */
+			const double bound = static_cast<double>(2ULL << i) / 1e6;
+			return (maxNs > 0 && bound > maxNs / 1e9) ? maxNs / 1e9 : bound;
+		}
+	}
+	return maxNs / 1e9;
+}
+
+SelfStats &SelfStats::Instance()
+{
+	static SelfStats inst;
+	return inst;
+}
+
+uint64_t SelfStats::nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+SelfStats::Entry &SelfStats::entry(const std::string &plugin)
+{
+	{
+		std::shared_lock<std::shared_mutex> lk(m_mutex);
+		auto it = m_entries.find(plugin);
+		if (it != m_entries.end())
+			return *it->second;
+	}
+
+	std::unique_lock<std::shared_mutex> lk(m_mutex);
+	auto &slot = m_entries[plugin];
+	if (!slot)
+		slot.reset(new Entry);
+	return *slot;
+}
+
+void SelfStats::recordRead(const std::string &plugin, uint64_t ns, bool ok)
+{
+	entry(plugin).read.record(ns, ok);
+}
+
+void SelfStats::recordWrite(const std::string &plugin, uint64_t ns, bool ok)
+{
+	entry(plugin).write.record(ns, ok);
+}
+
+void SelfStats::recordEnqueue(uint64_t depth)
+{
+	m_enqueued.fetch_add(1, std::memory_order_relaxed);
+	m_depth.store(depth, std::memory_order_relaxed);
+
+	uint64_t prev = m_highWater.load(std::memory_order_relaxed);
+	while (depth > prev && !m_highWater.compare_exchange_weak(prev, depth, std::memory_order_relaxed))
+	{
+	}
+}
+
+void SelfStats::recordDequeue(uint64_t depth)
+{
+	m_depth.store(depth, std::memory_order_relaxed);
+}
+
+void SelfStats::snapshot(SelfStatsSnapshot &out)
+{
+	out = SelfStatsSnapshot{};
+
+	{
+		std::unique_lock<std::shared_mutex> lk(m_mutex);
+		out.plugins.reserve(m_entries.size());
+		for (auto &kv : m_entries)
+		{
+			Entry &e = *kv.second;
+
+			PluginLatency pl;
+			pl.plugin = kv.first;
+			pl.read = e.read.deltaSince(e.lastRead);
+			pl.write = e.write.deltaSince(e.lastWrite);
+			out.plugins.push_back(std::move(pl));
+		}
+	}
+
+	out.enqueued = m_enqueued.load(std::memory_order_relaxed);
+	out.written = m_written.load(std::memory_order_relaxed);
+	out.dropped = m_dropped.load(std::memory_order_relaxed);
+	out.queueDepth = m_depth.load(std::memory_order_relaxed);
+	out.queueHighWater = m_highWater.exchange(out.queueDepth, std::memory_order_relaxed);
+}
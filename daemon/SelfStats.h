@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 守护进程自身运行指标：由 PluginService / RstDispatcher 在热路径上打点，
+ * self 插件每个周期读取快照并作为普通样本分发。
+ * 所有计数均为原子变量，打点不加全局锁。
+ */
+
+/* log2 直方图：第 i 个桶覆盖 [2^i, 2^(i+1)) 微秒，最后一个桶兜底 */
+#define SELF_HIST_BUCKETS 24
+
+struct LatencySummary;
+
+struct LatencyHistogram
+{
+	std::array<std::atomic<uint64_t>, SELF_HIST_BUCKETS> buckets{};
+	std::atomic<uint64_t> count{0};
+	std::atomic<uint64_t> sumNs{0};
+	std::atomic<uint64_t> maxNs{0};
+	std::atomic<uint64_t> errors{0};
+
+	void record(uint64_t ns, bool ok);
+
+	/* 返回距 last 的增量并把 last 更新为当前累计值；最大值按周期统计，随之清零 */
+	LatencySummary deltaSince(LatencySummary &last);
+};
+
+/* 某个周期内的直方图快照（已与上次快照做差） */
+struct LatencySummary
+{
+	std::array<uint64_t, SELF_HIST_BUCKETS> buckets{};
+	uint64_t count = 0;
+	uint64_t sumNs = 0;
+	uint64_t maxNs = 0;
+	uint64_t errors = 0;
+
+	/* 按桶上界估算分位数，单位秒 */
+	double quantile(double q) const;
+	double average() const { return count ? (sumNs / 1e9) / count : 0.0; }
+};
+
+struct PluginLatency
+{
+	std::string plugin;
+	LatencySummary read;
+	LatencySummary write;
+};
+
+struct SelfStatsSnapshot
+{
+	std::vector<PluginLatency> plugins;
+	uint64_t enqueued = 0;     ///< 累计入队样本数
+	uint64_t written = 0;      ///< 累计完成 writer 分发的样本数
+	uint64_t dropped = 0;      ///< 累计入队失败样本数
+	uint64_t queueDepth = 0;   ///< 当前队列长度
+	uint64_t queueHighWater = 0; ///< 本周期队列最高水位
+};
+
+class SelfStats
+{
+public:
+	static SelfStats &Instance();
+
+	void recordRead(const std::string &plugin, uint64_t ns, bool ok);
+	void recordWrite(const std::string &plugin, uint64_t ns, bool ok);
+
+	void recordEnqueue(uint64_t depth);
+	void recordDequeue(uint64_t depth);
+	void recordWritten() { m_written.fetch_add(1, std::memory_order_relaxed); }
+	void recordDropped() { m_dropped.fetch_add(1, std::memory_order_relaxed); }
+
+	/* 生成快照：直方图为距上次快照的增量，高水位随之复位 */
+	void snapshot(SelfStatsSnapshot &out);
+
+	static uint64_t nowNs();
+
+private:
+	SelfStats() = default;
+	~SelfStats() = default;
+
+	SelfStats(const SelfStats &) = delete;
+	SelfStats &operator=(const SelfStats &) = delete;
+
+	struct Entry
+	{
+		LatencyHistogram read;
+		LatencyHistogram write;
+		/* 上次快照时的累计值，用于求增量 */
+		LatencySummary lastRead;
+		LatencySummary lastWrite;
+	};
+
+	Entry &entry(const std::string &plugin);
+
+	std::shared_mutex m_mutex;
+	std::unordered_map<std::string, std::unique_ptr<Entry>> m_entries;
+
+	std::atomic<uint64_t> m_enqueued{0};
+	std::atomic<uint64_t> m_written{0};
+	std::atomic<uint64_t> m_dropped{0};
+	std::atomic<uint64_t> m_depth{0};
+	std::atomic<uint64_t> m_highWater{0};
+};
+
+/* 计时辅助：构造时取时间，elapsedNs() 返回已过去的纳秒数 */
+class SelfStatsTimer
+{
+public:
+	SelfStatsTimer() : m_start(SelfStats::nowNs()) {}
+	uint64_t elapsedNs() const { return SelfStats::nowNs() - m_start; }
+
+private:
+	uint64_t m_start;
+};
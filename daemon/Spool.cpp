@@ -0,0 +1,639 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Spool.h"
+#include "ModuleBase.h"
+#include "utils/utils.h"
+#include "utils/utils_config.h"
+#include "../oconfig/configfile.h"
+#include "../oconfig/oconfig.h"
+
+namespace
+{
+	const char *const kCursorFile = "/cursor";
+	const uint32_t kCursorMagic = 0x52435053u; /* "SPCR" */
+	const size_t kDirectAlign = 4096;
+	/* 每次回放最多处理的帧数，避免长时间占用分发线程 */
+	const int kReplayFrames = 64;
+	/* 未成帧样本在内存中停留的最长时间（秒） */
+	const double kPendingAge = 1.0;
+
+	struct CursorRecord
+	{
+		uint32_t magic;
+		uint32_t crc;
+		uint64_t seq;
+		uint64_t offset;
+		uint64_t skip;
+	};
+
+	uint64_t alignUp(uint64_t n)
+	{
+		return (n + kDirectAlign - 1) & ~static_cast<uint64_t>(kDirectAlign - 1);
+	}
+
+	int writeFull(int fd, const void *buf, size_t len, uint64_t off)
+	{
+		const char *p = static_cast<const char *>(buf);
+		while (len > 0)
+		{
+			ssize_t n = pwrite(fd, p, len, static_cast<off_t>(off));
+			if (n < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			p += n;
+			len -= static_cast<size_t>(n);
+			off += static_cast<uint64_t>(n);
+		}
+		return 0;
+	}
+
+	bool readFull(int fd, void *buf, size_t len, uint64_t off)
+	{
+		char *p = static_cast<char *>(buf);
+		while (len > 0)
+		{
+			ssize_t n = pread(fd, p, len, static_cast<off_t>(off));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			p += n;
+			len -= static_cast<size_t>(n);
+			off += static_cast<uint64_t>(n);
+		}
+		return true;
+	}
+}
+
+WriterSpool::WriterSpool(const std::string &writer)
+	: m_writer(writer), m_retry(TIME_T_TO_CDTIME_T(10))
+{
+}
+
+WriterSpool::~WriterSpool()
+{
+	if (m_wfd >= 0)
+		close(m_wfd);
+	if (m_rfd >= 0)
+		close(m_rfd);
+	free(m_aligned);
+}
+
+int WriterSpool::configure(const OConfigItem &ci)
+{
+	for (auto &child : ci.children)
+	{
+		if (child->values.size() != 1)
+		{
+			ERROR("spool '%s': option '%s' needs exactly one argument.",
+			      m_writer.c_str(), child->key.c_str());
+			return -1;
+		}
+		const OConfigValue &v = child->values[0];
+
+		if (child->key == "Directory" && v.type == OConfigType::STRING)
+		{
+			m_dir = v.getString();
+			while (m_dir.size() > 1 && m_dir.back() == '/')
+				m_dir.pop_back();
+		}
+		else if (child->key == "MaxSize" || child->key == "SegmentSize")
+		{
+			const double mib = numberOf(v);
+			if (!(mib >= 1.0))
+			{
+				ERROR("spool '%s': %s must be at least 1 (MiB).",
+				      m_writer.c_str(), child->key.c_str());
+				return -1;
+			}
+			const uint64_t bytes = static_cast<uint64_t>(mib * (1 << 20));
+			if (child->key == "MaxSize")
+				m_maxBytes = bytes;
+			else
+				m_segmentBytes = bytes;
+		}
+		else if (child->key == "Sync" && v.type == OConfigType::STRING)
+		{
+			const std::string mode = v.getString();
+			if (mode == "none")
+				m_sync = SPOOL_SYNC_NONE;
+			else if (mode == "batch")
+				m_sync = SPOOL_SYNC_BATCH;
+			else if (mode == "always")
+				m_sync = SPOOL_SYNC_ALWAYS;
+			else
+			{
+				ERROR("spool '%s': Sync must be none, batch or always.", m_writer.c_str());
+				return -1;
+			}
+		}
+		else if (child->key == "Direct")
+		{
+			m_direct = booleanOf(v);
+		}
+		else if (child->key == "RetryInterval")
+		{
+			const double sec = numberOf(v);
+			if (!(sec > 0.0))
+			{
+				ERROR("spool '%s': RetryInterval must be positive.", m_writer.c_str());
+				return -1;
+			}
+			m_retry = DOUBLE_TO_CDTIME_T(sec);
+		}
+		else
+		{
+			ERROR("spool '%s': unknown option '%s'.", m_writer.c_str(), child->key.c_str());
+			return -1;
+		}
+	}
+
+	if (m_dir.empty())
+	{
+		ERROR("spool '%s': Directory is required.", m_writer.c_str());
+		return -1;
+	}
+	if (m_segmentBytes > m_maxBytes)
+		m_segmentBytes = m_maxBytes;
+	return 0;
+}
+
+std::string WriterSpool::segmentPath(uint64_t seq) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/wal-%08llu.log", static_cast<unsigned long long>(seq));
+	return m_dir + name;
+}
+
+int WriterSpool::open()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	m_dir += "/" + m_writer;
+	if (check_create_dir((m_dir + "/").c_str()) != 0)
+	{
+		ERROR("spool '%s': cannot create %s.", m_writer.c_str(), m_dir.c_str());
+		return -1;
+	}
+
+	DIR *dir = opendir(m_dir.c_str());
+	if (!dir)
+	{
+		ERROR("spool '%s': opendir %s failed: %s", m_writer.c_str(), m_dir.c_str(), strerror(errno));
+		return -1;
+	}
+
+	std::vector<uint64_t> seqs;
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != nullptr)
+	{
+		unsigned long long seq = 0;
+		char tail[8] = {0};
+		if (sscanf(ent->d_name, "wal-%8llu.%7s", &seq, tail) == 2 && strcmp(tail, "log") == 0)
+			seqs.push_back(seq);
+	}
+	closedir(dir);
+	std::sort(seqs.begin(), seqs.end());
+
+	for (uint64_t seq : seqs)
+	{
+		struct stat st{};
+		if (stat(segmentPath(seq).c_str(), &st) != 0)
+			continue;
+		m_segments.push_back(Segment{seq, static_cast<uint64_t>(st.st_size)});
+		m_totalBytes += static_cast<uint64_t>(st.st_size);
+		m_nextSeq = seq + 1;
+	}
+
+	if (m_segments.empty())
+		return 0;
+
+	/* 上次遗留的段：从 cursor 处继续回放，新数据总是写入新段，不在可能残缺的尾部追加 */
+	if (loadCursor() != 0 || m_cursor.seq < m_segments.front().seq)
+		m_cursor = Cursor{m_segments.front().seq, 0, 0};
+	m_backlog = true;
+	m_nextRetry = 0;
+	INFO("spool '%s': %zu segment(s) / %llu byte(s) pending replay.",
+	     m_writer.c_str(), m_segments.size(), static_cast<unsigned long long>(m_totalBytes));
+	return 0;
+}
+
+int WriterSpool::loadCursor()
+{
+	const std::string path = m_dir + kCursorFile;
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	CursorRecord rec{};
+	const bool ok = readFull(fd, &rec, sizeof(rec), 0);
+	close(fd);
+	if (!ok || rec.magic != kCursorMagic ||
+	    rec.crc != vc_crc32(&rec.seq, sizeof(rec) - offsetof(CursorRecord, seq)))
+	{
+		WARNING("spool '%s': ignoring invalid cursor file.", m_writer.c_str());
+		return -1;
+	}
+
+	m_cursor.seq = rec.seq;
+	m_cursor.offset = rec.offset;
+	m_cursor.skip = rec.skip;
+	return 0;
+}
+
+void WriterSpool::saveCursor()
+{
+	CursorRecord rec{};
+	rec.magic = kCursorMagic;
+	rec.seq = m_cursor.seq;
+	rec.offset = m_cursor.offset;
+	rec.skip = m_cursor.skip;
+	rec.crc = vc_crc32(&rec.seq, sizeof(rec) - offsetof(CursorRecord, seq));
+
+	/* 不做 fsync：崩溃后最多重复回放少量样本（至少一次语义） */
+	const std::string path = m_dir + kCursorFile;
+	int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0 || writeFull(fd, &rec, sizeof(rec), 0) != 0)
+		ERROR("spool '%s': write cursor failed: %s", m_writer.c_str(), strerror(errno));
+	if (fd >= 0)
+		close(fd);
+}
+
+int WriterSpool::openSegment(uint64_t seq)
+{
+	if (m_wfd >= 0)
+	{
+		close(m_wfd);
+		m_wfd = -1;
+	}
+
+	const std::string path = segmentPath(seq);
+	int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+	if (m_direct)
+	{
+		m_wfd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+		if (m_wfd < 0 && errno == EINVAL)
+		{
+			WARNING("spool '%s': O_DIRECT not supported in %s, using buffered I/O.",
+			        m_writer.c_str(), m_dir.c_str());
+			m_direct = false;
+		}
+	}
+	if (m_wfd < 0)
+		m_wfd = ::open(path.c_str(), flags, 0644);
+	if (m_wfd < 0)
+	{
+		ERROR("spool '%s': open %s failed: %s", m_writer.c_str(), path.c_str(), strerror(errno));
+		return -1;
+	}
+
+	if (m_segments.empty())
+		m_cursor = Cursor{seq, 0, 0};
+	m_segments.push_back(Segment{seq, 0});
+	return 0;
+}
+
+void WriterSpool::enforceLimit()
+{
+	while (m_totalBytes > m_maxBytes && m_segments.size() > 1)
+	{
+		const Segment oldest = m_segments.front();
+		m_segments.pop_front();
+		if (m_rfd >= 0 && m_rseq == oldest.seq)
+		{
+			close(m_rfd);
+			m_rfd = -1;
+		}
+		unlink(segmentPath(oldest.seq).c_str());
+		m_totalBytes -= oldest.size;
+		if (m_cursor.seq <= oldest.seq)
+			m_cursor = Cursor{m_segments.front().seq, 0, 0};
+
+		WARNING("spool '%s': MaxSize reached, dropped segment %llu (%llu bytes).",
+		        m_writer.c_str(), static_cast<unsigned long long>(oldest.seq),
+		        static_cast<unsigned long long>(oldest.size));
+	}
+}
+
+int WriterSpool::appendFrame()
+{
+	if (m_enc.empty())
+		return 0;
+
+	const size_t samples = m_enc.count();
+	m_frame.clear();
+	m_enc.finish(m_frame, true);
+	m_pendingSince = 0;
+
+	const void *buf = m_frame.data();
+	size_t len = m_frame.size();
+	if (m_direct)
+	{
+		/* O_DIRECT 要求缓冲、长度、偏移均按块对齐，帧尾补零；回放时遇到零魔数跳到下一块 */
+		len = alignUp(len);
+		if (len > m_alignedCap)
+		{
+			free(m_aligned);
+			m_aligned = nullptr;
+			m_alignedCap = 0;
+			void *p = nullptr;
+			if (posix_memalign(&p, kDirectAlign, len) != 0)
+			{
+				m_dropped += samples;
+				return -1;
+			}
+			m_aligned = static_cast<uint8_t *>(p);
+			m_alignedCap = len;
+		}
+		memcpy(m_aligned, m_frame.data(), m_frame.size());
+		memset(m_aligned + m_frame.size(), 0, len - m_frame.size());
+		buf = m_aligned;
+	}
+
+	if (m_wfd < 0 || (m_segments.back().size > 0 &&
+	                  m_segments.back().size + len > m_segmentBytes))
+	{
+		if (openSegment(m_nextSeq++) != 0)
+		{
+			m_dropped += samples;
+			return -1;
+		}
+	}
+
+	Segment &seg = m_segments.back();
+	if (writeFull(m_wfd, buf, len, seg.size) != 0)
+	{
+		/* 写失败的段不再追加，下一帧换新段 */
+		ERROR("spool '%s': write failed: %s", m_writer.c_str(), strerror(errno));
+		close(m_wfd);
+		m_wfd = -1;
+		m_dropped += samples;
+		return -1;
+	}
+	if (m_sync != SPOOL_SYNC_NONE && fdatasync(m_wfd) != 0)
+		ERROR("spool '%s': fdatasync failed: %s", m_writer.c_str(), strerror(errno));
+
+	seg.size += len;
+	m_totalBytes += len;
+	enforceLimit();
+	return 0;
+}
+
+int WriterSpool::spool(const data_set_t *ds, const value_list_t *vl, cdtime_t now)
+{
+	if (!ds || ds->ds_num != vl->values_len)
+	{
+		++m_dropped;
+		return -1;
+	}
+
+	if (!m_enc.empty() && m_enc.estimate(ds, vl) > m_batchBytes)
+		appendFrame();
+	if (m_enc.add(ds, vl) != 0)
+	{
+		++m_dropped;
+		return -1;
+	}
+	++m_spooled;
+
+	if (m_pendingSince == 0)
+		m_pendingSince = now;
+	if (m_sync == SPOOL_SYNC_ALWAYS || m_enc.size() >= m_batchBytes ||
+	    now - m_pendingSince >= DOUBLE_TO_CDTIME_T(kPendingAge))
+		appendFrame();
+	return 0;
+}
+
+void WriterSpool::finishReplay()
+{
+	if (m_rfd >= 0)
+	{
+		close(m_rfd);
+		m_rfd = -1;
+	}
+	if (m_wfd >= 0)
+	{
+		close(m_wfd);
+		m_wfd = -1;
+	}
+	for (const Segment &seg : m_segments)
+	{
+		unlink(segmentPath(seg.seq).c_str());
+	}
+	m_segments.clear();
+	m_totalBytes = 0;
+	m_cursor = Cursor{};
+	unlink((m_dir + kCursorFile).c_str());
+	m_backlog = false;
+
+	INFO("spool '%s': writer recovered, %llu sample(s) spooled, %llu replayed, %llu dropped.",
+	     m_writer.c_str(), static_cast<unsigned long long>(m_spooled),
+	     static_cast<unsigned long long>(m_replayed),
+	     static_cast<unsigned long long>(m_dropped));
+	m_spooled = m_replayed = m_dropped = 0;
+}
+
+void WriterSpool::replay(CAbstractUserModule *mod, cdtime_t now)
+{
+	/* 内存中尚未成帧的样本先落盘，保证回放顺序 */
+	appendFrame();
+
+	bool failed = false;
+	for (int frames = 0; frames < kReplayFrames && !failed;)
+	{
+		if (m_segments.empty())
+		{
+			finishReplay();
+			return;
+		}
+
+		/* 已回放完的段随即删除，cursor 总在最旧的段上 */
+		const Segment seg = m_segments.front();
+		if (m_cursor.seq != seg.seq)
+			m_cursor = Cursor{seg.seq, 0, 0};
+
+		if (m_cursor.offset >= seg.size)
+		{
+			if (m_segments.size() == 1)
+			{
+				finishReplay();
+				return;
+			}
+			if (m_rfd >= 0 && m_rseq == seg.seq)
+			{
+				close(m_rfd);
+				m_rfd = -1;
+			}
+			unlink(segmentPath(seg.seq).c_str());
+			m_totalBytes -= seg.size;
+			m_segments.pop_front();
+			continue;
+		}
+
+		if (m_rfd < 0 || m_rseq != seg.seq)
+		{
+			if (m_rfd >= 0)
+				close(m_rfd);
+			m_rseq = seg.seq;
+			m_rfd = ::open(segmentPath(seg.seq).c_str(), O_RDONLY | O_CLOEXEC);
+			if (m_rfd < 0)
+			{
+				ERROR("spool '%s': open segment %llu failed: %s", m_writer.c_str(),
+				      static_cast<unsigned long long>(seg.seq), strerror(errno));
+				m_cursor.offset = seg.size;
+				continue;
+			}
+		}
+
+		ValueFrameHeader hdr;
+		if (!readFull(m_rfd, &hdr, sizeof(hdr), m_cursor.offset))
+		{
+			m_cursor.offset = seg.size;
+			continue;
+		}
+		if (hdr.magic == 0)
+		{
+			m_cursor.offset = alignUp(m_cursor.offset + 1);
+			continue;
+		}
+
+		const size_t total = sizeof(hdr) + hdr.payloadLen;
+		size_t used = 0;
+		int status = EINVAL;
+		if (hdr.magic == VC_MAGIC && hdr.payloadLen <= VC_MAX_FRAME)
+		{
+			m_rbuf.resize(total);
+			if (readFull(m_rfd, m_rbuf.data(), total, m_cursor.offset))
+			{
+				uint64_t index = 0;
+				status = m_dec.decode(m_rbuf.data(), total, used,
+					[&](value_list_t &vl, const uint8_t *dsTypes) {
+						/* 跳过本帧中上次已成功回放的样本 */
+						if (failed || index++ < m_cursor.skip)
+							return;
+						const data_set_t *ds = ConfigManager::Instance().GetDataSetByName(vl.type);
+						if (!vc_match_dataset(ds, vl, dsTypes))
+						{
+							/* types.db 中已不存在该类型或定义已改变，无法再投递 */
+							++m_cursor.skip;
+							++m_dropped;
+							return;
+						}
+						if (mod->write(ds, &vl) != 0)
+						{
+							failed = true;
+							return;
+						}
+						++m_cursor.skip;
+						++m_replayed;
+					});
+			}
+		}
+
+		if (status != 0)
+		{
+			/* 残缺或损坏的帧（如崩溃时的尾部）：放弃该段剩余部分 */
+			WARNING("spool '%s': corrupt frame in segment %llu at offset %llu, skipping the rest.",
+			        m_writer.c_str(), static_cast<unsigned long long>(seg.seq),
+			        static_cast<unsigned long long>(m_cursor.offset));
+			m_cursor.offset = seg.size;
+			m_cursor.skip = 0;
+			continue;
+		}
+		if (failed)
+			break;
+
+		m_cursor.offset += used;
+		m_cursor.skip = 0;
+		++frames;
+	}
+
+	if (failed)
+		m_nextRetry = now + m_retry;
+	saveCursor();
+}
+
+int WriterSpool::deliver(CAbstractUserModule *mod, const data_set_t *ds, const value_list_t *vl)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	const cdtime_t now = cdtime();
+
+	if (m_backlog && now >= m_nextRetry)
+		replay(mod, now);
+
+	if (!m_backlog)
+	{
+		if (mod->write(ds, vl) == 0)
+			return 0;
+
+		m_backlog = true;
+		m_nextRetry = now + m_retry;
+		WARNING("spool '%s': writer failed, spooling to %s.", m_writer.c_str(), m_dir.c_str());
+	}
+	return spool(ds, vl, now);
+}
+
+void WriterSpool::sync()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	appendFrame();
+	if (m_wfd >= 0 && fdatasync(m_wfd) != 0)
+		ERROR("spool '%s': fdatasync failed: %s", m_writer.c_str(), strerror(errno));
+}
+
+SpoolManager &SpoolManager::Instance()
+{
+	static SpoolManager inst;
+	return inst;
+}
+
+int SpoolManager::configure(const OConfigItem &ci)
+{
+	if (ci.values.size() != 1 || ci.values[0].type != OConfigType::STRING)
+	{
+		ERROR("spool: <Spool> needs the writer plugin name.");
+		return -1;
+	}
+
+	const std::string writer = ci.values[0].getString();
+	if (m_spools.count(writer))
+	{
+		ERROR("spool: duplicate <Spool \"%s\"> block.", writer.c_str());
+		return -1;
+	}
+
+	std::unique_ptr<WriterSpool> spool(new WriterSpool(writer));
+	if (spool->configure(ci) != 0)
+		return -1;
+	m_spools.emplace(writer, std::move(spool));
+	return 0;
+}
+
+int SpoolManager::openAll()
+{
+	for (auto &kv : m_spools)
+	{
+		if (kv.second->open() != 0)
+			return -1;
+	}
+	return 0;
+}
+
+void SpoolManager::syncAll()
+{
+	for (auto &kv : m_spools)
+	{
+		kv.second->sync();
+	}
+}
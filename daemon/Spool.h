@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ModuleDef.h"
+#include "ValueCodec.h"
+
+class OConfigItem;
+class CAbstractUserModule;
+
+/*
+ * writer 故障时的磁盘缓冲（spool）：位于 RstDispatcher 与单个 writer 之间。
+ *
+ * writer 的 write() 失败后进入积压状态，此后该 writer 的样本按顺序编码成
+ * ValueCodec 帧（带 CRC32）追加到分段的预写日志；每隔 RetryInterval 尝试按序回放，
+ * 全部回放成功后删除日志并恢复直接写入。回放进度记录在 cursor 文件中，重启后继续。
+ *
+ * 配置示例：
+ *   <Spool "tsdb">
+ *     Directory "/var/spool/collect"   # 实际目录为 <Directory>/<writer>
+ *     MaxSize 1024          # 磁盘占用上限（MiB），超出时丢弃最旧的段
+ *     SegmentSize 16        # 单段大小（MiB）
+ *     Sync "batch"          # none：只写页缓存；batch：每帧 fdatasync；always：每个样本一帧并 fdatasync
+ *     Direct false          # true 时以 O_DIRECT 写入，帧按 4KiB 对齐补零
+ *     RetryInterval 10      # 秒
+ *   </Spool>
+ */
+
+enum SpoolSync
+{
+	SPOOL_SYNC_NONE = 0,
+	SPOOL_SYNC_BATCH,
+	SPOOL_SYNC_ALWAYS
+};
+
+class WriterSpool
+{
+public:
+	explicit WriterSpool(const std::string &writer);
+	~WriterSpool();
+
+	int configure(const OConfigItem &ci);
+
+	/* 创建目录并载入上次遗留的日志段 */
+	int open();
+
+	/*
+	 * 投递一个样本：无积压时直接调用 writer，失败则转入日志；
+	 * 有积压时先按重试间隔回放，再把样本追加到日志尾部以保持顺序。
+	 */
+	int deliver(CAbstractUserModule *mod, const data_set_t *ds, const value_list_t *vl);
+
+	/* 把内存中未成帧的样本落盘并同步 */
+	void sync();
+
+	bool backlogged() const { return m_backlog; }
+
+private:
+	struct Segment
+	{
+		uint64_t seq;
+		uint64_t size;
+	};
+
+	struct Cursor
+	{
+		uint64_t seq = 0;
+		uint64_t offset = 0;
+		uint64_t skip = 0; ///< 当前帧内已回放的样本数
+	};
+
+	std::string segmentPath(uint64_t seq) const;
+	int spool(const data_set_t *ds, const value_list_t *vl, cdtime_t now);
+	int appendFrame();
+	int openSegment(uint64_t seq);
+	void enforceLimit();
+	void replay(CAbstractUserModule *mod, cdtime_t now);
+	void finishReplay();
+	int loadCursor();
+	void saveCursor();
+
+	std::string m_writer;
+	std::string m_dir;
+	uint64_t m_maxBytes = 1024ULL << 20;
+	uint64_t m_segmentBytes = 16ULL << 20;
+	size_t m_batchBytes = 64 * 1024;
+	int m_sync = SPOOL_SYNC_BATCH;
+	bool m_direct = false;
+	cdtime_t m_retry = 0;
+
+	std::mutex m_mutex;
+	bool m_backlog = false;
+	cdtime_t m_nextRetry = 0;
+	cdtime_t m_pendingSince = 0;
+
+	ValueEncoder m_enc;
+	std::string m_frame;
+	uint8_t *m_aligned = nullptr; ///< O_DIRECT 写缓冲
+	size_t m_alignedCap = 0;
+
+	std::deque<Segment> m_segments; ///< 从旧到新，最后一个为当前写入段
+	uint64_t m_totalBytes = 0;
+	int m_wfd = -1;
+	uint64_t m_nextSeq = 1;
+
+	Cursor m_cursor;
+	int m_rfd = -1;
+	uint64_t m_rseq = 0;
+	ValueDecoder m_dec;
+	std::vector<uint8_t> m_rbuf;
+
+	uint64_t m_spooled = 0;
+	uint64_t m_replayed = 0;
+	uint64_t m_dropped = 0;
+};
+
+class SpoolManager
+{
+public:
+	static SpoolManager &Instance();
+
+	/* 解析一个 <Spool "writer"> 配置块 */
+	int configure(const OConfigItem &ci);
+
+	int openAll();
+	void syncAll();
+
+	/* 未配置 spool 的 writer 返回 nullptr */
+	WriterSpool *find(const std::string &writer)
+	{
+		if (m_spools.empty())
+			return nullptr;
+		auto it = m_spools.find(writer);
+		return it == m_spools.end() ? nullptr : it->second.get();
+	}
+
+private:
+	SpoolManager() = default;
+	~SpoolManager() = default;
+
+	SpoolManager(const SpoolManager &) = delete;
+	SpoolManager &operator=(const SpoolManager &) = delete;
+
+	std::unordered_map<std::string, std::unique_ptr<WriterSpool>> m_spools;
+};
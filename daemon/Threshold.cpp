@@ -0,0 +1,424 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Threshold.h"
+#include "PluginService.h"
+#include "utils/utils.h"
+#include "utils/utils_config.h"
+#include "../oconfig/configfile.h"
+#include "../oconfig/oconfig.h"
+
+namespace
+{
+	/* 未命中集合的上限，超过时整体清空重新积累 */
+	const size_t kMaxMisses = 1 << 16;
+
+	const char *stateName(int state)
+	{
+		switch (state)
+		{
+		case 1:  return "warning";
+		case 2:  return "failure";
+		default: return "okay";
+		}
+	}
+
+	/* 待分发的通知；meta 链表在分发时指向本结构内的字段 */
+	struct PendingNotification
+	{
+		notification_t n;
+		std::string dataSource;
+		double value;
+	};
+}
+
+Threshold &Threshold::Instance()
+{
+	static Threshold inst;
+	return inst;
+}
+
+int Threshold::Rule::score() const
+{
+	/* 与 collectd 的查找顺序一致：plugin_instance > type_instance > plugin */
+	int s = 0;
+	if (!pluginInstance.empty())
+		s += 8;
+	if (!plugin.empty())
+		s += 4;
+	if (!typeInstance.empty())
+		s += 2;
+	if (!dataSource.empty())
+		s += 1;
+	return s;
+}
+
+int Threshold::parseType(const OConfigItem &ci, const Rule &base)
+{
+	if (ci.values.empty() || ci.values[0].type != OConfigType::STRING)
+	{
+		ERROR("threshold: <Type> needs a type name.");
+		return -1;
+	}
+
+	std::unique_ptr<Rule> rule(new Rule(base));
+	rule->type = ci.values[0].getString();
+
+	for (auto &child : ci.children)
+	{
+		const std::string &key = child->key;
+		if (child->values.empty())
+		{
+			ERROR("threshold: option '%s' needs a value.", key.c_str());
+			return -1;
+		}
+		const OConfigValue &v = child->values[0];
+
+		if (key == "Instance")
+			rule->typeInstance = v.getString();
+		else if (key == "DataSource")
+			rule->dataSource = v.getString();
+		else if (key == "WarningMin")
+			rule->warningMin = numberOf(v);
+		else if (key == "WarningMax")
+			rule->warningMax = numberOf(v);
+		else if (key == "FailureMin")
+			rule->failureMin = numberOf(v);
+		else if (key == "FailureMax")
+			rule->failureMax = numberOf(v);
+		else if (key == "Hysteresis")
+			rule->hysteresis = numberOf(v);
+		else if (key == "Hits")
+			rule->hits = static_cast<int>(numberOf(v));
+		else if (key == "Invert")
+			rule->invert = booleanOf(v);
+		else if (key == "Percentage")
+			rule->percentage = booleanOf(v);
+		else if (key == "Persist")
+			rule->persist = booleanOf(v);
+		else if (key == "PersistOK")
+			rule->persistOK = booleanOf(v);
+		else
+		{
+			ERROR("threshold: unknown option '%s' in <Type \"%s\">.", key.c_str(), rule->type.c_str());
+			return -1;
+		}
+	}
+
+	if (!(rule->hysteresis >= 0.0) || rule->hits < 0)
+	{
+		ERROR("threshold: Hysteresis and Hits must not be negative.");
+		return -1;
+	}
+
+	m_rules.push_back(std::move(rule));
+	return 0;
+}
+
+int Threshold::parsePlugin(const OConfigItem &ci)
+{
+	if (ci.values.empty() || ci.values[0].type != OConfigType::STRING)
+	{
+		ERROR("threshold: <Plugin> needs a plugin name.");
+		return -1;
+	}
+
+	Rule base;
+	base.plugin = ci.values[0].getString();
+
+	/* Instance 可能写在 Type 块之后，先取出再解析 Type */
+	for (auto &child : ci.children)
+	{
+		if (child->key == "Instance" && !child->values.empty())
+			base.pluginInstance = child->values[0].getString();
+	}
+
+	for (auto &child : ci.children)
+	{
+		if (child->key == "Instance")
+			continue;
+		if (child->key != "Type")
+		{
+			ERROR("threshold: unknown option '%s' in <Plugin \"%s\">.",
+			      child->key.c_str(), base.plugin.c_str());
+			return -1;
+		}
+		if (parseType(*child, base) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+int Threshold::configure(const OConfigItem &ci)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	for (auto &child : ci.children)
+	{
+		int status;
+		if (child->key == "Type")
+			status = parseType(*child, Rule());
+		else if (child->key == "Plugin")
+			status = parsePlugin(*child);
+		else
+		{
+			ERROR("threshold: unknown option '%s'.", child->key.c_str());
+			status = -1;
+		}
+		if (status != 0)
+			return status;
+	}
+
+	/* 规则变化后重建索引并重新编译 */
+	m_byType.clear();
+	for (auto &r : m_rules)
+	{
+		m_byType[r->type].push_back(r.get());
+	}
+	m_series.clear();
+	m_misses.clear();
+	return 0;
+}
+
+Threshold::Series *Threshold::lookup(const data_set_t *ds, const value_list_t *vl)
+{
+	m_typeKey.assign(vl->type);
+	auto rules = m_byType.find(m_typeKey);
+	if (rules == m_byType.end())
+		return nullptr;
+
+	m_key.assign(vl->plugin).push_back('\0');
+	m_key.append(vl->plugin_instance).push_back('\0');
+	m_key.append(vl->type).push_back('\0');
+	m_key.append(vl->type_instance);
+
+	auto it = m_series.find(m_key);
+	if (it != m_series.end() && it->second.ds == ds)
+		return &it->second;
+	if (m_misses.count(m_key))
+		return nullptr;
+
+	/* 新序列：为每个数据源挑出最具体的规则；没有规则适用的序列只记入未命中集合 */
+	Series s;
+	s.ds = ds;
+	for (size_t i = 0; i < ds->ds_num; ++i)
+	{
+		const Rule *best = nullptr;
+		for (const Rule *r : rules->second)
+		{
+			if ((!r->plugin.empty() && r->plugin != vl->plugin) ||
+			    (!r->pluginInstance.empty() && r->pluginInstance != vl->plugin_instance) ||
+			    (!r->typeInstance.empty() && r->typeInstance != vl->type_instance) ||
+			    (!r->dataSource.empty() && r->dataSource != ds->ds[i].name))
+				continue;
+			if (!best || r->score() > best->score())
+				best = r;
+		}
+		if (!best || ds->ds[i].type == DS_TYPE_SKETCH)
+			continue;
+
+		Check c;
+		c.rule = best;
+		c.index = i;
+		/* 百分比规则的取值范围与数据源无关，不套用 types.db */
+		c.failureMin = (std::isnan(best->failureMin) && !best->percentage) ? ds->ds[i].min : best->failureMin;
+		c.failureMax = (std::isnan(best->failureMax) && !best->percentage) ? ds->ds[i].max : best->failureMax;
+		s.checks.push_back(c);
+	}
+	if (s.checks.empty())
+	{
+		if (it != m_series.end())
+			m_series.erase(it);
+		if (m_misses.size() >= kMaxMisses)
+			m_misses.clear();
+		m_misses.insert(m_key);
+		return nullptr;
+	}
+	for (size_t i = 0; i < ds->ds_num; ++i)
+	{
+		s.rates = s.rates || ds->ds[i].type != DS_TYPE_GAUGE;
+	}
+
+	if (it != m_series.end())
+	{
+		it->second = std::move(s);
+		return &it->second;
+	}
+	return &m_series.emplace(m_key, std::move(s)).first->second;
+}
+
+int Threshold::evaluate(const Check &c, double value, int state) const
+{
+	const Rule &r = *c.rule;
+
+	/* 已处于告警 / 故障状态时界限收紧 Hysteresis，避免在边界附近抖动 */
+	const double hf = (state == ST_FAILURE) ? r.hysteresis : 0.0;
+	const double hw = (state == ST_WARNING) ? r.hysteresis : 0.0;
+
+	if ((!std::isnan(c.failureMin) && c.failureMin + hf > value) ||
+	    (!std::isnan(c.failureMax) && c.failureMax - hf < value))
+		return r.invert ? ST_OKAY : ST_FAILURE;
+
+	if ((!std::isnan(r.warningMin) && r.warningMin + hw > value) ||
+	    (!std::isnan(r.warningMax) && r.warningMax - hw < value))
+		return r.invert ? ST_OKAY : ST_WARNING;
+
+	return r.invert ? ST_FAILURE : ST_OKAY;
+}
+
+void Threshold::format(notification_t &n, const data_set_t *ds, const value_list_t *vl,
+                       const Check &c, double value, int state) const
+{
+	const Rule &r = *c.rule;
+	const char *dsName = ds->ds[c.index].name;
+	const char *unit = r.percentage ? "%" : "";
+
+	memset(&n, 0, sizeof(n));
+	n.severity = state == ST_FAILURE ? NOTIF_FAILURE : state == ST_WARNING ? NOTIF_WARNING : NOTIF_OKAY;
+	n.time = vl->time ? vl->time : cdtime();
+	snprintf(n.plugin, sizeof(n.plugin), "%s", vl->plugin);
+	snprintf(n.plugin_instance, sizeof(n.plugin_instance), "%s", vl->plugin_instance);
+	snprintf(n.type, sizeof(n.type), "%s", vl->type);
+	snprintf(n.type_instance, sizeof(n.type_instance), "%s", vl->type_instance);
+
+	int len = snprintf(n.message, sizeof(n.message), "%s%s%s/%s%s%s: ",
+	                   vl->plugin, vl->plugin_instance[0] ? "-" : "", vl->plugin_instance,
+	                   vl->type, vl->type_instance[0] ? "-" : "", vl->type_instance);
+	if (len < 0 || static_cast<size_t>(len) >= sizeof(n.message))
+		return;
+	char *buf = n.message + len;
+	const size_t cap = sizeof(n.message) - len;
+
+	if (state == ST_OKAY)
+	{
+		snprintf(buf, cap, "Data source \"%s\" is within range again, currently %g%s.",
+		         dsName, value, unit);
+		return;
+	}
+
+	const bool failure = state == ST_FAILURE;
+	const double min = failure ? c.failureMin : r.warningMin;
+	const double max = failure ? c.failureMax : r.warningMax;
+	if (r.invert)
+	{
+		snprintf(buf, cap, "Data source \"%s\" is currently %g%s. That is within the %s region of %g%s and %g%s.",
+		         dsName, value, unit, stateName(state), min, unit, max, unit);
+	}
+	else
+	{
+		const bool below = !std::isnan(min) && (std::isnan(max) || value < min + r.hysteresis);
+		snprintf(buf, cap, "Data source \"%s\" is currently %g%s. That is %s the %s threshold of %g%s.",
+		         dsName, value, unit, below ? "below" : "above", stateName(state),
+		         below ? min : max, unit);
+	}
+}
+
+void Threshold::check(const data_set_t *ds, const value_list_t *vl)
+{
+	if (m_rules.empty() || !ds || !vl || ds->ds_num != vl->values_len)
+		return;
+
+	std::vector<PendingNotification> pending;
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		Series *s = lookup(ds, vl);
+		if (!s)
+			return;
+
+		/* 换算成 gauge：counter / derive 取速率，absolute 除以时间间隔 */
+		m_values.resize(ds->ds_num);
+		const double dt = s->prevTime && vl->time > s->prevTime
+		                ? CDTIME_T_TO_DOUBLE(vl->time - s->prevTime) : 0.0;
+		for (size_t i = 0; i < ds->ds_num; ++i)
+		{
+			const value_t &v = vl->values[i];
+			double x;
+			switch (ds->ds[i].type)
+			{
+			case DS_TYPE_GAUGE:
+				x = v.gauge;
+				break;
+			case DS_TYPE_COUNTER:
+				/* 计数器回绕或重置时本次不判定 */
+				x = (dt > 0.0 && v.counter >= s->prev[i].counter)
+				  ? (v.counter - s->prev[i].counter) / dt : NAN;
+				break;
+			case DS_TYPE_DERIVE:
+				x = dt > 0.0 ? (v.derive - s->prev[i].derive) / dt : NAN;
+				break;
+			case DS_TYPE_ABSOLUTE:
+				x = vl->interval ? v.absolute / CDTIME_T_TO_DOUBLE(vl->interval) : NAN;
+				break;
+			default:
+				x = NAN;
+				break;
+			}
+			m_values[i] = x;
+		}
+		if (s->rates)
+		{
+			s->prev.assign(vl->values, vl->values + vl->values_len);
+			s->prevTime = vl->time;
+		}
+
+		double total = NAN;
+		for (auto &c : s->checks)
+		{
+			double value = m_values[c.index];
+			if (c.rule->percentage)
+			{
+				if (std::isnan(total))
+				{
+					total = 0.0;
+					for (double x : m_values)
+					{
+						if (!std::isnan(x))
+							total += x;
+					}
+				}
+				value = total != 0.0 ? 100.0 * value / total : NAN;
+			}
+			if (std::isnan(value))
+				continue;
+
+			const int state = evaluate(c, value, c.state);
+
+			/* 连续越限达到 Hits 次才认定状态变化 */
+			if (state == ST_OKAY)
+				c.hits = 0;
+			else if (c.hits < c.rule->hits)
+				++c.hits;
+			if (state != ST_OKAY && c.hits < c.rule->hits)
+				continue;
+
+			const bool report = state != c.state ||
+			                    (state != ST_OKAY && c.rule->persist) ||
+			                    (state == ST_OKAY && c.rule->persistOK);
+			c.state = state;
+			if (!report)
+				continue;
+
+			pending.emplace_back();
+			PendingNotification &p = pending.back();
+			p.dataSource = ds->ds[c.index].name;
+			p.value = value;
+			format(p.n, ds, vl, c, value, state);
+		}
+	}
+
+	for (auto &p : pending)
+	{
+		notification_meta_t meta[2];
+		memset(meta, 0, sizeof(meta));
+		snprintf(meta[0].name, sizeof(meta[0].name), "DataSource");
+		meta[0].type = NM_TYPE_STRING;
+		meta[0].nm_value.nm_string = p.dataSource.c_str();
+		meta[0].next = &meta[1];
+		snprintf(meta[1].name, sizeof(meta[1].name), "CurrentValue");
+		meta[1].type = NM_TYPE_DOUBLE;
+		meta[1].nm_value.nm_double = p.value;
+		p.n.meta = meta;
+		PluginService::Instance().dispatchNotification(&p.n);
+	}
+}
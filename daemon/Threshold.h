@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ModuleDef.h"
+
+class OConfigItem;
+
+/*
+ * 阈值检查：分发线程在把样本交给 writer 之前逐值比较告警 / 故障上下限，
+ * 状态变化时生成 notification_t 并经 PluginService::dispatchNotification 分发。
+ *
+ * 配置示例：
+ *   <Threshold>
+ *     <Type "load">
+ *       DataSource "midterm"
+ *       WarningMax 4
+ *       FailureMax 8
+ *       Hits 3                  # 连续越限 3 次才报告
+ *       Hysteresis 0.5          # 恢复时需回到界限内 0.5
+ *     </Type>
+ *     <Plugin "interface">
+ *       Instance "eth0"
+ *       <Type "if_octets">
+ *         FailureMax 10000000
+ *       </Type>
+ *     </Plugin>
+ *   </Threshold>
+ *
+ * 每个 Type 块可用选项：Instance、DataSource、WarningMin/Max、FailureMin/Max、
+ * Invert、Percentage、Persist、PersistOK、Hits、Hysteresis。
+ * 未配置的 FailureMin/Max 取 types.db 中数据源的 min/max；counter / derive / absolute
+ * 按速率比较。同一序列命中多条规则时取最具体的一条（plugin_instance > type_instance > plugin），
+ * 指定 DataSource 的规则优先。
+ *
+ * 规则按 type 建索引，没有规则的 type 只需一次哈希查找；有规则的序列在首次出现时编译成
+ * 逐数据源的检查项并缓存，之后每个样本只有一次哈希查找。type 有规则但序列无一适用时，
+ * 序列键记入有上限的未命中集合，不再逐条比对规则；只为有规则适用的序列保存状态。
+ */
+class Threshold
+{
+public:
+	static Threshold &Instance();
+
+	/* 解析一个 <Threshold> 配置块 */
+	int configure(const OConfigItem &ci);
+
+	bool empty() const { return m_rules.empty(); }
+
+	/* 检查一个样本，必要时分发通知 */
+	void check(const data_set_t *ds, const value_list_t *vl);
+
+private:
+	Threshold() = default;
+	~Threshold() = default;
+
+	Threshold(const Threshold &) = delete;
+	Threshold &operator=(const Threshold &) = delete;
+
+	enum State { ST_OKAY = 0, ST_WARNING, ST_FAILURE };
+
+	struct Rule
+	{
+		std::string plugin;
+		std::string pluginInstance;
+		std::string type;
+		std::string typeInstance;
+		std::string dataSource;
+
+		double warningMin = NAN;
+		double warningMax = NAN;
+		double failureMin = NAN;
+		double failureMax = NAN;
+		double hysteresis = 0.0;
+		int hits = 0;
+		bool invert = false;
+		bool percentage = false;
+		bool persist = false;
+		bool persistOK = false;
+
+		int score() const;
+	};
+
+	/* 某序列某数据源的检查项及其状态 */
+	struct Check
+	{
+		const Rule *rule = nullptr;
+		size_t index = 0;
+		double failureMin = NAN; ///< 已并入 types.db 缺省值
+		double failureMax = NAN;
+		int state = ST_OKAY;
+		int hits = 0;
+	};
+
+	struct Series
+	{
+		const data_set_t *ds = nullptr;
+		std::vector<Check> checks;
+		/* 非 gauge 数据源的上一个原始值，用于换算速率 */
+		std::vector<value_t> prev;
+		cdtime_t prevTime = 0;
+		bool rates = false;
+	};
+
+	int parseType(const OConfigItem &ci, const Rule &base);
+	int parsePlugin(const OConfigItem &ci);
+	/* 没有规则适用时返回 nullptr */
+	Series *lookup(const data_set_t *ds, const value_list_t *vl);
+	int evaluate(const Check &c, double value, int state) const;
+	void format(notification_t &n, const data_set_t *ds, const value_list_t *vl,
+	            const Check &c, double value, int state) const;
+
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<Rule>> m_rules;
+	std::unordered_map<std::string, std::vector<const Rule *>> m_byType; ///< type -> 规则
+	std::unordered_map<std::string, Series> m_series;
+	std::unordered_set<std::string> m_misses; ///< 无规则适用的序列键，满 kMaxMisses 时清空
+	std::string m_typeKey;       ///< 复用的 type 查找缓冲
+	std::string m_key;           ///< 复用的序列键缓冲
+	std::vector<double> m_values; ///< 复用的速率缓冲
+};
@@ -0,0 +1,170 @@
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "Trace.h"
+#include "ModuleDef.h"
+
+Tracer &Tracer::Instance()
+{
+	static Tracer inst;
+	return inst;
+}
+
+uint64_t Tracer::nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+void Tracer::setOutputPath(const std::string &path)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	m_path = path;
+}
+
+std::string Tracer::outputPath()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	return m_path;
+}
+
+Tracer::RingOwner::~RingOwner()
+{
+	if (!ring)
+		return;
+	Tracer &t = Tracer::Instance();
+	std::lock_guard<std::mutex> lk(t.m_mutex);
+	t.m_free.push_back(ring);
+}
+
+Tracer::Ring *Tracer::threadRing()
+{
+	thread_local RingOwner owner;
+	if (!owner.ring)
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		if (!m_free.empty())
+		{
+			owner.ring = m_free.back();
+			m_free.pop_back();
+			owner.ring->head.store(0, std::memory_order_release);
+		}
+		else
+		{
+			owner.ring = new Ring;
+			m_rings.push_back(owner.ring);
+		}
+		owner.ring->tid = syscall(SYS_gettid);
+	}
+	return owner.ring;
+}
+
+void Tracer::record(const char *cat, const char *name, const char *arg,
+                    uint64_t beginNs, uint64_t endNs)
+{
+	Ring *ring = threadRing();
+	const uint64_t head = ring->head.load(std::memory_order_relaxed);
+	TraceEvent &ev = ring->events[head % TRACE_RING_CAPACITY];
+
+	ev.cat = cat;
+	ev.name = name;
+	ev.beginNs = beginNs;
+	ev.durNs = endNs - beginNs;
+	if (arg)
+		snprintf(ev.arg, sizeof(ev.arg), "%s", arg);
+	else
+		ev.arg[0] = '\0';
+
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+namespace
+{
+	/* 事件名、参数均为插件名等简单标识，仅需转义引号与反斜杠 */
+	void writeJsonString(FILE *fp, const char *s)
+	{
+		fputc('"', fp);
+		for (; *s; ++s)
+		{
+			if (*s == '"' || *s == '\\')
+				fputc('\\', fp);
+			if (static_cast<unsigned char>(*s) >= 0x20)
+				fputc(*s, fp);
+		}
+		fputc('"', fp);
+	}
+}
+
+int Tracer::dump(const std::string &path)
+{
+	if (!enabled())
+	{
+		ERROR("trace: tracing is not compiled in (build with TRACE=1).");
+		return -1;
+	}
+
+	const std::string out = path.empty() ? outputPath() : path;
+	if (out.empty())
+	{
+		ERROR("trace: no output path configured.");
+		return -1;
+	}
+
+	FILE *fp = fopen(out.c_str(), "w");
+	if (!fp)
+	{
+		ERROR("trace: open %s failed: %s", out.c_str(), strerror(errno));
+		return -1;
+	}
+
+	std::vector<Ring *> rings;
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		rings = m_rings;
+	}
+
+	const int pid = static_cast<int>(getpid());
+	size_t total = 0;
+	bool first = true;
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for (Ring *ring : rings)
+	{
+		/* 导出期间所属线程可能仍在写入，最旧的少量事件可能被覆盖，可接受 */
+		const uint64_t head = ring->head.load(std::memory_order_acquire);
+		const uint64_t n = head < TRACE_RING_CAPACITY ? head : TRACE_RING_CAPACITY;
+
+		for (uint64_t i = head - n; i < head; ++i)
+		{
+			const TraceEvent &ev = ring->events[i % TRACE_RING_CAPACITY];
+			fprintf(fp, "%s\n{\"ph\":\"X\",\"pid\":%d,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f,\"cat\":",
+			        first ? "" : ",", pid, ring->tid, ev.beginNs / 1000.0, ev.durNs / 1000.0);
+			writeJsonString(fp, ev.cat);
+			fprintf(fp, ",\"name\":");
+			writeJsonString(fp, ev.name);
+			if (ev.arg[0])
+			{
+				fprintf(fp, ",\"args\":{\"arg\":");
+				writeJsonString(fp, ev.arg);
+				fputc('}', fp);
+			}
+			fputc('}', fp);
+			first = false;
+			++total;
+		}
+	}
+	fprintf(fp, "\n]}\n");
+
+	if (fclose(fp) != 0)
+	{
+		ERROR("trace: write %s failed: %s", out.c_str(), strerror(errno));
+		return -1;
+	}
+
+	INFO("trace: %zu events from %zu threads written to %s", total, rings.size(), out.c_str());
+	return 0;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * 热路径追踪（编译期可选，make TRACE=1 开启，即 -DCOLLECT_TRACE=1）
+ *
+ * TRACE_SCOPE(cat, name, arg) 在作用域结束时把一个完整事件写入当前线程的
+ * 环形缓冲区（固定容量，满后覆盖最旧事件），时间戳取 CLOCK_MONOTONIC_RAW。
+ * Tracer::dump() 把所有线程的缓冲导出为 Chrome trace_event JSON，
+ * 可直接在 Perfetto / chrome://tracing 中打开。
+ * 线程退出时缓冲归还空闲链表，新线程复用时丢弃旧事件，缓冲个数以同时存活的线程数为上限。
+ * 未开启时宏展开为空语句，不产生任何开销。
+ */
+
+#define TRACE_RING_CAPACITY 16384
+#define TRACE_ARG_LEN 32
+
+struct TraceEvent
+{
+	const char *cat;
+	const char *name;
+	uint64_t beginNs;
+	uint64_t durNs;
+	char arg[TRACE_ARG_LEN];
+};
+
+class Tracer
+{
+public:
+	static Tracer &Instance();
+
+	static constexpr bool enabled()
+	{
+#if COLLECT_TRACE
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	static uint64_t nowNs();
+
+	void setOutputPath(const std::string &path);
+	std::string outputPath();
+
+	/* 导出为 Chrome trace JSON；path 为空时使用 setOutputPath 设置的路径 */
+	int dump(const std::string &path = std::string());
+
+	void record(const char *cat, const char *name, const char *arg,
+	            uint64_t beginNs, uint64_t endNs);
+
+private:
+	Tracer() = default;
+	~Tracer() = default;
+
+	Tracer(const Tracer &) = delete;
+	Tracer &operator=(const Tracer &) = delete;
+
+	/* 单生产者（所属线程）环形缓冲，导出时按 head 读取最近的事件 */
+	struct Ring
+	{
+		long tid = 0;
+		std::atomic<uint64_t> head{0};
+		TraceEvent events[TRACE_RING_CAPACITY];
+	};
+
+	/* thread_local 持有者，析构（线程退出）时归还缓冲 */
+	struct RingOwner
+	{
+		Ring *ring = nullptr;
+		~RingOwner();
+	};
+
+	Ring *threadRing();
+
+	std::mutex m_mutex;
+	std::vector<Ring *> m_rings; ///< 全部已分配的缓冲，进程生命周期内有效
+	std::vector<Ring *> m_free;  ///< 所属线程已退出、可复用的缓冲
+	std::string m_path;
+};
+
+#if COLLECT_TRACE
+
+class TraceScope
+{
+public:
+	TraceScope(const char *cat, const char *name, const char *arg = nullptr)
+		: m_cat(cat), m_name(name), m_arg(arg), m_begin(Tracer::nowNs()) {}
+
+	~TraceScope()
+	{
+		Tracer::Instance().record(m_cat, m_name, m_arg, m_begin, Tracer::nowNs());
+	}
+
+private:
+	const char *m_cat;
+	const char *m_name;
+	const char *m_arg;
+	uint64_t m_begin;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(cat, name, arg) \
+	TraceScope TRACE_CONCAT(_traceScope, __LINE__)((cat), (name), (arg))
+
+#else /* COLLECT_TRACE */
+
+#define TRACE_SCOPE(cat, name, arg) do {} while (0)
+
+#endif /* ! COLLECT_TRACE */
@@ -0,0 +1,535 @@
+#include <cerrno>
+#include <cstring>
+
+#include "ValueCodec.h"
+
+namespace
+{
+	/* LZ4 块格式参数 */
+	const int kHashLog = 12;
+	const size_t kMinMatch = 4;
+	const size_t kLastLiterals = 5;
+	const size_t kMfLimit = 12;
+
+	uint32_t crcTable[256];
+
+	struct CrcInit
+	{
+		CrcInit()
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t c = i;
+				for (int k = 0; k < 8; ++k)
+				{
+					c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				}
+				crcTable[i] = c;
+			}
+		}
+	} crcInit;
+
+	uint32_t read32(const uint8_t *p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	void putVarint(std::string &out, uint64_t v)
+	{
+		while (v >= 0x80)
+		{
+			out += static_cast<char>((v & 0x7F) | 0x80);
+			v >>= 7;
+		}
+		out += static_cast<char>(v);
+	}
+
+	uint64_t zigzag(int64_t v)
+	{
+		return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+	}
+
+	int64_t unzigzag(uint64_t v)
+	{
+		return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+	}
+
+	/* 有界读取器：越界时 ok 置 false，之后的读取均返回 0 */
+	struct Reader
+	{
+		const uint8_t *p;
+		const uint8_t *end;
+		bool ok = true;
+
+		uint64_t varint()
+		{
+			uint64_t v = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				if (p >= end)
+				{
+					ok = false;
+					return 0;
+				}
+				const uint8_t b = *p++;
+				v |= static_cast<uint64_t>(b & 0x7F) << shift;
+				if (!(b & 0x80))
+					return v;
+			}
+			ok = false;
+			return 0;
+		}
+
+		uint8_t byte()
+		{
+			if (p >= end)
+			{
+				ok = false;
+				return 0;
+			}
+			return *p++;
+		}
+
+		const uint8_t *bytes(size_t n)
+		{
+			if (static_cast<size_t>(end - p) < n)
+			{
+				ok = false;
+				return nullptr;
+			}
+			const uint8_t *r = p;
+			p += n;
+			return r;
+		}
+	};
+
+	void putLength(uint8_t *&op, size_t len)
+	{
+		while (len >= 255)
+		{
+			*op++ = 255;
+			len -= 255;
+		}
+		*op++ = static_cast<uint8_t>(len);
+	}
+}
+
+uint32_t vc_crc32(const void *data, size_t len, uint32_t crc)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(data);
+	crc = ~crc;
+	while (len--)
+	{
+		crc = crcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+size_t vc_lz4_bound(size_t len)
+{
+	return len + len / 255 + 16;
+}
+
+size_t vc_lz4_compress(const uint8_t *src, size_t len, uint8_t *dst)
+{
+	uint32_t table[1 << kHashLog] = {0}; /* 位置 + 1，0 表示空 */
+	uint8_t *op = dst;
+	size_t anchor = 0;
+	size_t ip = 0;
+
+	auto emit = [&](size_t litEnd, size_t offset, size_t matchLen) {
+		const size_t litLen = litEnd - anchor;
+		uint8_t *token = op++;
+		*token = static_cast<uint8_t>((litLen >= 15 ? 15 : litLen) << 4);
+		if (litLen >= 15)
+			putLength(op, litLen - 15);
+		memcpy(op, src + anchor, litLen);
+		op += litLen;
+		if (matchLen == 0)
+			return;
+
+		*op++ = static_cast<uint8_t>(offset & 0xFF);
+		*op++ = static_cast<uint8_t>(offset >> 8);
+		const size_t ml = matchLen - kMinMatch;
+		*token |= static_cast<uint8_t>(ml >= 15 ? 15 : ml);
+		if (ml >= 15)
+			putLength(op, ml - 15);
+	};
+
+	if (len > kMfLimit)
+	{
+		const size_t limit = len - kMfLimit;
+		const size_t matchEnd = len - kLastLiterals;
+		while (ip < limit)
+		{
+			const uint32_t seq = read32(src + ip);
+			const uint32_t h = (seq * 2654435761u) >> (32 - kHashLog);
+			const uint32_t ref = table[h];
+			table[h] = static_cast<uint32_t>(ip + 1);
+
+			if (ref != 0 && ip - (ref - 1) < 65536 && read32(src + ref - 1) == seq)
+			{
+				const size_t r = ref - 1;
+				size_t m = kMinMatch;
+				while (ip + m < matchEnd && src[r + m] == src[ip + m])
+					++m;
+				emit(ip, ip - r, m);
+				ip += m;
+				anchor = ip;
+			}
+			else
+			{
+				++ip;
+			}
+		}
+	}
+
+	/* 末尾字面量 */
+	emit(len, 0, 0);
+	return static_cast<size_t>(op - dst);
+}
+
+long vc_lz4_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap)
+{
+	const uint8_t *ip = src;
+	const uint8_t *const iend = src + len;
+	uint8_t *op = dst;
+	uint8_t *const oend = dst + cap;
+
+	auto readLength = [&](size_t &n) -> bool {
+		uint8_t b;
+		do
+		{
+			if (ip >= iend)
+				return false;
+			b = *ip++;
+			n += b;
+		} while (b == 255);
+		return true;
+	};
+
+	while (ip < iend)
+	{
+		const uint8_t token = *ip++;
+
+		size_t lit = token >> 4;
+		if (lit == 15 && !readLength(lit))
+			return -1;
+		if (static_cast<size_t>(iend - ip) < lit || static_cast<size_t>(oend - op) < lit)
+			return -1;
+		memcpy(op, ip, lit);
+		ip += lit;
+		op += lit;
+
+		if (ip == iend)
+			break; /* 最后一个序列只有字面量 */
+
+		if (iend - ip < 2)
+			return -1;
+		const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+		ip += 2;
+		if (offset == 0 || offset > static_cast<size_t>(op - dst))
+			return -1;
+
+		size_t ml = token & 0x0F;
+		if (ml == 15 && !readLength(ml))
+			return -1;
+		ml += kMinMatch;
+		if (static_cast<size_t>(oend - op) < ml)
+			return -1;
+
+		/* 可能与输出重叠，逐字节复制 */
+		const uint8_t *match = op - offset;
+		for (size_t i = 0; i < ml; ++i)
+		{
+			op[i] = match[i];
+		}
+		op += ml;
+	}
+	return static_cast<long>(op - dst);
+}
+
+bool vc_match_dataset(const data_set_t *ds, const value_list_t &vl, const uint8_t *dsTypes)
+{
+	if (!ds || vl.values_len != ds->ds_num)
+		return false;
+	for (size_t i = 0; i < ds->ds_num; ++i)
+	{
+		if (dsTypes[i] != ds->ds[i].type)
+			return false;
+	}
+	return true;
+}
+
+uint32_t ValueEncoder::intern(const char *s)
+{
+	m_scratch.assign(s);
+	auto it = m_ids.find(m_scratch);
+	if (it != m_ids.end())
+		return it->second;
+
+	const uint32_t id = static_cast<uint32_t>(m_ids.size());
+	m_ids.emplace(m_scratch, id);
+
+	m_buf += static_cast<char>(VC_REC_STRING);
+	putVarint(m_buf, id);
+	putVarint(m_buf, m_scratch.size());
+	m_buf += m_scratch;
+	return id;
+}
+
+size_t ValueEncoder::estimate(const data_set_t *ds, const value_list_t *vl) const
+{
+	/* 4 个字符串记录 + 样本记录，每个 varint 最多 10 字节 */
+	size_t n = m_buf.size() + 4 * (1 + 10 + 10) + (m_buf.empty() ? 1 + 10 + m_host.size() : 0) +
+	           strlen(vl->plugin) + strlen(vl->plugin_instance) +
+	           strlen(vl->type) + strlen(vl->type_instance) +
+	           1 + 4 * 10 + 10 + 10 + 10 + vl->values_len * 11;
+	if (ds && ds->ds_num == vl->values_len)
+	{
+		for (size_t i = 0; i < ds->ds_num; ++i)
+		{
+			if (ds->ds[i].type == DS_TYPE_SKETCH && vl->values[i].sketch)
+				n += vl->values[i].sketch->serializedSize();
+		}
+	}
+	return n;
+}
+
+int ValueEncoder::add(const data_set_t *ds, const value_list_t *vl)
+{
+	if (!ds || !vl || ds->ds_num != vl->values_len)
+		return EINVAL;
+
+	if (m_buf.empty() && !m_host.empty())
+	{
+		m_buf += static_cast<char>(VC_REC_HOST);
+		putVarint(m_buf, m_host.size());
+		m_buf += m_host;
+	}
+
+	const uint32_t ids[4] = {intern(vl->plugin), intern(vl->plugin_instance),
+	                         intern(vl->type), intern(vl->type_instance)};
+
+	m_buf += static_cast<char>(VC_REC_SAMPLE);
+	for (uint32_t id : ids)
+	{
+		putVarint(m_buf, id);
+	}
+	putVarint(m_buf, zigzag(static_cast<int64_t>(vl->time - m_lastTime)));
+	m_lastTime = vl->time;
+	putVarint(m_buf, vl->interval);
+	putVarint(m_buf, vl->values_len);
+
+	for (size_t i = 0; i < vl->values_len; ++i)
+	{
+		const int type = ds->ds[i].type;
+		m_buf += static_cast<char>(type);
+		switch (type)
+		{
+		case DS_TYPE_GAUGE:
+			m_buf.append(reinterpret_cast<const char *>(&vl->values[i].gauge), sizeof(gauge_t));
+			break;
+		case DS_TYPE_DERIVE:
+			putVarint(m_buf, zigzag(vl->values[i].derive));
+			break;
+		case DS_TYPE_COUNTER:
+			putVarint(m_buf, vl->values[i].counter);
+			break;
+		case DS_TYPE_SKETCH:
+			/* 长度前缀 + QuantileSketch 序列化；空指针按空 sketch 编码 */
+			m_scratch.clear();
+			if (vl->values[i].sketch)
+				vl->values[i].sketch->serialize(m_scratch);
+			else
+				QuantileSketch().serialize(m_scratch);
+			putVarint(m_buf, m_scratch.size());
+			m_buf += m_scratch;
+			break;
+		default:
+			putVarint(m_buf, vl->values[i].absolute);
+			break;
+		}
+	}
+	++m_count;
+	return 0;
+}
+
+void ValueEncoder::finish(std::string &out, bool compress)
+{
+	ValueFrameHeader hdr{};
+	hdr.magic = VC_MAGIC;
+	hdr.version = VC_VERSION;
+	hdr.rawLen = static_cast<uint32_t>(m_buf.size());
+
+	const size_t base = out.size();
+	out.resize(base + sizeof(hdr) + (compress ? vc_lz4_bound(m_buf.size()) : m_buf.size()));
+	uint8_t *payload = reinterpret_cast<uint8_t *>(&out[base + sizeof(hdr)]);
+
+	size_t plen = m_buf.size();
+	if (compress)
+	{
+		plen = vc_lz4_compress(reinterpret_cast<const uint8_t *>(m_buf.data()), m_buf.size(), payload);
+		if (plen < m_buf.size())
+		{
+			hdr.flags |= VC_FLAG_LZ4;
+		}
+		else
+		{
+			/* 压缩无收益时发送原文 */
+			plen = m_buf.size();
+			memcpy(payload, m_buf.data(), plen);
+		}
+	}
+	else
+	{
+		memcpy(payload, m_buf.data(), plen);
+	}
+
+	hdr.payloadLen = static_cast<uint32_t>(plen);
+	hdr.crc = vc_crc32(payload, plen);
+	memcpy(&out[base], &hdr, sizeof(hdr));
+	out.resize(base + sizeof(hdr) + plen);
+	reset();
+}
+
+void ValueEncoder::reset()
+{
+	m_buf.clear();
+	m_ids.clear();
+	m_lastTime = 0;
+	m_count = 0;
+}
+
+int ValueDecoder::decode(const uint8_t *data, size_t len, size_t &consumed, const Callback &cb)
+{
+	if (len < sizeof(ValueFrameHeader))
+		return EAGAIN;
+
+	ValueFrameHeader hdr;
+	memcpy(&hdr, data, sizeof(hdr));
+	if (hdr.magic != VC_MAGIC || hdr.version != VC_VERSION ||
+	    hdr.payloadLen > VC_MAX_FRAME || hdr.rawLen > VC_MAX_FRAME)
+		return EINVAL;
+	if (len - sizeof(hdr) < hdr.payloadLen)
+		return EAGAIN;
+
+	const uint8_t *payload = data + sizeof(hdr);
+	if (vc_crc32(payload, hdr.payloadLen) != hdr.crc)
+		return EINVAL;
+	consumed = sizeof(hdr) + hdr.payloadLen;
+
+	const uint8_t *raw = payload;
+	size_t rawLen = hdr.payloadLen;
+	if (hdr.flags & VC_FLAG_LZ4)
+	{
+		m_raw.resize(hdr.rawLen);
+		long n = vc_lz4_decompress(payload, hdr.payloadLen, m_raw.data(), m_raw.size());
+		if (n != static_cast<long>(hdr.rawLen))
+			return EINVAL;
+		raw = m_raw.data();
+		rawLen = hdr.rawLen;
+	}
+
+	Reader r{raw, raw + rawLen};
+	m_strings.clear();
+	m_host.clear();
+	cdtime_t time = 0;
+
+	if (r.p < r.end && *r.p == VC_REC_HOST)
+	{
+		r.byte();
+		const uint64_t n = r.varint();
+		const uint8_t *s = r.ok && n < DATA_MAX_NAME_LEN ? r.bytes(n) : nullptr;
+		if (!s)
+			return EINVAL;
+		m_host.assign(reinterpret_cast<const char *>(s), n);
+	}
+
+	while (r.ok && r.p < r.end)
+	{
+		const uint8_t kind = r.byte();
+		if (kind == VC_REC_STRING)
+		{
+			const uint64_t id = r.varint();
+			const uint64_t n = r.varint();
+			const uint8_t *s = r.bytes(n);
+			if (!r.ok || id != m_strings.size())
+				return EINVAL;
+			m_strings.emplace_back(reinterpret_cast<const char *>(s), n);
+		}
+		else if (kind == VC_REC_SAMPLE)
+		{
+			value_list_t vl = VALUE_LIST_INIT;
+			char *fields[4] = {vl.plugin, vl.plugin_instance, vl.type, vl.type_instance};
+			for (char *f : fields)
+			{
+				const uint64_t id = r.varint();
+				if (!r.ok || id >= m_strings.size())
+					return EINVAL;
+				const std::string &s = m_strings[id];
+				const size_t n = s.size() < DATA_MAX_NAME_LEN - 1 ? s.size() : DATA_MAX_NAME_LEN - 1;
+				memcpy(f, s.data(), n);
+				f[n] = '\0';
+			}
+			time += static_cast<cdtime_t>(unzigzag(r.varint()));
+			vl.time = time;
+			vl.interval = r.varint();
+			const uint64_t nvals = r.varint();
+			if (!r.ok || nvals == 0 || nvals > 64)
+				return EINVAL;
+
+			m_values.resize(nvals);
+			m_types.resize(nvals);
+			if (m_sketches.size() < nvals)
+				m_sketches.resize(nvals);
+			for (uint64_t i = 0; i < nvals; ++i)
+			{
+				m_types[i] = r.byte();
+				switch (m_types[i])
+				{
+				case DS_TYPE_GAUGE:
+				{
+					const uint8_t *b = r.bytes(sizeof(gauge_t));
+					if (b)
+						memcpy(&m_values[i].gauge, b, sizeof(gauge_t));
+					break;
+				}
+				case DS_TYPE_DERIVE:
+					m_values[i].derive = unzigzag(r.varint());
+					break;
+				case DS_TYPE_COUNTER:
+					m_values[i].counter = r.varint();
+					break;
+				case DS_TYPE_ABSOLUTE:
+					m_values[i].absolute = r.varint();
+					break;
+				case DS_TYPE_SKETCH:
+				{
+					const uint64_t n = r.varint();
+					const uint8_t *b = r.ok ? r.bytes(n) : nullptr;
+					if (!b || m_sketches[i].deserialize(b, n) != 0)
+						return EINVAL;
+					m_values[i].sketch = &m_sketches[i];
+					break;
+				}
+				default:
+					return EINVAL;
+				}
+			}
+			if (!r.ok)
+				return EINVAL;
+
+			vl.values = m_values.data();
+			vl.values_len = nvals;
+			cb(vl, m_types.data());
+		}
+		else
+		{
+			return EINVAL;
+		}
+	}
+	return r.ok ? 0 : EINVAL;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ModuleDef.h"
+#include "QuantileSketch.h"
+
+/*
+ * 样本二进制编码：network_out / network_in 的线上格式，也是 spool 的落盘格式。
+ *
+ * 帧 = ValueFrameHeader + 负载（可选 LZ4 块压缩）
+ * 负载由若干记录组成，每条记录以 1 字节类型开头：
+ *   VC_REC_HOST    varint 长度, 字节                 发送端标识，可选，只能是帧内第一条记录
+ *   VC_REC_STRING  varint id, varint 长度, 字节       帧内字符串驻留表
+ *   VC_REC_SAMPLE  varint plugin/plugin_instance/type/type_instance 的字符串 id,
+ *                  zigzag varint 时间（与上一条样本的差，首条为绝对值）,
+ *                  varint interval, varint 值个数, 每个值：1 字节数据源类型 + 值
+ *                  （gauge 为 8 字节原始 double，derive 为 zigzag varint，
+ *                    counter/absolute 为 varint，sketch 为 varint 长度 + QuantileSketch 序列化）
+ * 每帧自带驻留表，UDP 丢包不影响后续帧的解码。
+ */
+
+#define VC_MAGIC 0x314E4C43u /* "CLN1" */
+#define VC_VERSION 1
+#define VC_FLAG_LZ4 0x01
+/* 单帧负载（压缩前后）上限，防止畸形帧导致超大分配 */
+#define VC_MAX_FRAME (16u << 20)
+
+#define VC_REC_STRING 0x01
+#define VC_REC_SAMPLE 0x02
+#define VC_REC_HOST 0x03
+
+struct ValueFrameHeader
+{
+	uint32_t magic;
+	uint8_t version;
+	uint8_t flags;
+	uint16_t reserved;
+	uint32_t rawLen;     ///< 解压后负载长度
+	uint32_t payloadLen; ///< 实际负载长度
+	uint32_t crc;        ///< 负载（压缩后）的 CRC32
+};
+
+/* CRC32（IEEE 802.3，与 zlib 相同） */
+uint32_t vc_crc32(const void *data, size_t len, uint32_t crc = 0);
+
+/* LZ4 块格式压缩 / 解压；压缩缓冲至少 vc_lz4_bound(len) 字节，解压失败返回 -1 */
+size_t vc_lz4_bound(size_t len);
+size_t vc_lz4_compress(const uint8_t *src, size_t len, uint8_t *dst);
+long vc_lz4_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap);
+
+/*
+ * 解码出的样本与 types.db 中的定义是否一致（值个数及每个值的数据源类型）。
+ * 下游按 ds 解释 value_t（如 sketch 指针），来自网络或磁盘的样本投递前必须校验。
+ */
+bool vc_match_dataset(const data_set_t *ds, const value_list_t &vl, const uint8_t *dsTypes);
+
+class ValueEncoder
+{
+public:
+	/* 此后每帧携带的发送端标识，空串表示不携带 */
+	void setHost(const std::string &host) { m_host = host; }
+
+	/* ds 提供各值的数据源类型；vl->values_len 必须等于 ds->ds_num */
+	int add(const data_set_t *ds, const value_list_t *vl);
+
+	/* 再加入 vl 后负载长度的上界，用于按包大小切帧 */
+	size_t estimate(const data_set_t *ds, const value_list_t *vl) const;
+
+	size_t size() const { return m_buf.size(); }
+	size_t count() const { return m_count; }
+	bool empty() const { return m_count == 0; }
+
+	/* 生成完整帧（头 + 负载）追加到 out，随后清空编码器 */
+	void finish(std::string &out, bool compress);
+	void reset();
+
+private:
+	uint32_t intern(const char *s);
+
+	std::string m_buf;
+	std::string m_host;
+	std::unordered_map<std::string, uint32_t> m_ids;
+	cdtime_t m_lastTime = 0;
+	size_t m_count = 0;
+	std::string m_scratch;
+};
+
+class ValueDecoder
+{
+public:
+	using Callback = std::function<void(value_list_t &vl, const uint8_t *dsTypes)>;
+
+	/*
+	 * 从 data 开头解码一帧：成功返回 0 并设置 consumed；
+	 * 数据不足一帧返回 EAGAIN（流式接收时继续读），格式/校验错误返回 EINVAL。
+	 */
+	int decode(const uint8_t *data, size_t len, size_t &consumed, const Callback &cb);
+
+	/* 当前帧的发送端标识（无则为空），回调期间有效 */
+	const std::string &host() const { return m_host; }
+
+private:
+	/* 复用的解码缓冲，避免每帧分配 */
+	std::vector<uint8_t> m_raw;
+	std::vector<std::string> m_strings;
+	std::string m_host;
+	std::vector<value_t> m_values;
+	std::vector<uint8_t> m_types;
+	std::vector<QuantileSketch> m_sketches; ///< sketch 值的存储，回调期间有效
+};
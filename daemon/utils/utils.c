@@ -12,6 +12,7 @@
 #include <dirent.h>
 
 #include "utils.h"
+#include "../ProcfsCache.h"
 
 #define P_ERROR(format, ...) fprintf(stderr, "ERROR: " format "\n", ##__VA_ARGS__)
 
@@ -405,11 +406,10 @@ int get_pid_by_name(const char *task_name, int *pid, int *pid_array_len)
 {
 	DIR *dir = NULL;
 	struct dirent *ptr = NULL;
-	FILE *fp = NULL;
 	int ret = -2;
 	char filepath[384] = {0};
-	char cur_task_name[128] = {0};
-	char buf[256] = {0};
+	char comm[64];
+	size_t comm_len = 0;
 	int array_len = 0;
 	int idx = 0;
 	if ((NULL == task_name) || (NULL == pid) 
@@ -433,42 +433,31 @@ int get_pid_by_name(const char *task_name, int *pid, int *pid_array_len)
 
 			}
 
-			if (DT_DIR != ptr->d_type)
+			/* 只看进程目录，跳过 self、sys 等 */
+			if (DT_DIR != ptr->d_type || ptr->d_name[0] < '0' || ptr->d_name[0] > '9')
 			{
 				continue;
 			}
 
-			snprintf(filepath, sizeof(filepath), "/proc/%s/status", ptr->d_name);
-			
-			fp = fopen(filepath, "r");
-
-			if (NULL != fp)
+			/* comm 即 status 首行的 Name，经 procfs 缓存读取，同一周期内多次查询只读一次 */
+			snprintf(filepath, sizeof(filepath), "/proc/%s/comm", ptr->d_name);
+			if (procfs_cache_read(filepath, comm, sizeof(comm), &comm_len) != 0)
 			{
-				memset(buf, 0, sizeof(buf));
-				if (fgets(buf, sizeof(buf) - 1, fp) == NULL)
-				{
-					fclose(fp);
-					fp = NULL;
-					continue;
-				}
+				continue;
+			}
 
-				sscanf(buf, "%*s %s", cur_task_name);
-				if (strcmp(task_name, cur_task_name) == 0)
-				{
-					pid[idx] = atoi(ptr->d_name);
-					fclose(fp);
-					fp = NULL;
-					ret = 0;
-					idx++;
-					if (idx >= array_len)
-					{
-						break;
-					}
-				}
-				else
+			while (comm_len > 0 && comm[comm_len - 1] == '\n')
+			{
+				comm_len--;
+			}
+			if (strlen(task_name) == comm_len && strncmp(task_name, comm, comm_len) == 0)
+			{
+				pid[idx] = atoi(ptr->d_name);
+				ret = 0;
+				idx++;
+				if (idx >= array_len)
 				{
-					fclose(fp);
-					fp = NULL;
+					break;
 				}
 			}
 		}
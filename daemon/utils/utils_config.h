@@ -0,0 +1,33 @@
+#ifndef UTILS_CONFIG_H
+#define UTILS_CONFIG_H 1
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "utils.h"
+#include "../../oconfig/oconfig.h"
+
+/* 配置块选项值的取值，仅 C++ 可用 */
+
+/* 数值既可写成数字也可写成字符串；其他类型返回 NAN，调用方按 !(v > x) 校验 */
+inline double numberOf(const OConfigValue &v)
+{
+	if (v.type == OConfigType::NUMBER)
+		return v.getNumber();
+	if (v.type == OConfigType::STRING)
+		return atof(v.getString().c_str());
+	return NAN;
+}
+
+/* 布尔值既可写成 true/false 也可写成字符串（true、yes、on 为真） */
+inline bool booleanOf(const OConfigValue &v)
+{
+	if (v.type == OConfigType::BOOLEAN)
+		return v.getBoolean();
+	if (v.type == OConfigType::STRING)
+		return IS_TRUE(v.getString().c_str());
+	return false;
+}
+
+#endif /* UTILS_CONFIG_H */
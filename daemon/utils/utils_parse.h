@@ -0,0 +1,33 @@
+#ifndef UTILS_PARSE_H
+#define UTILS_PARSE_H 1
+
+#include <stdint.h>
+
+/*
+ * procfs / sysfs 文本的就地解析，供各采集插件在热路径上使用；
+ * 均按 [p, end) 区间处理，不要求以 '\0' 结尾。仅 C++ 可用。
+ */
+
+/* 跳过空格与制表符 */
+inline const char *skipSpace(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++p;
+	return p;
+}
+
+/* 解析十进制计数，返回数字之后的位置；未读到数字返回 nullptr */
+inline const char *parseU64(const char *p, const char *end, uint64_t &out)
+{
+	uint64_t v = 0;
+	const char *start = p;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		v = v * 10 + static_cast<uint64_t>(*p - '0');
+		++p;
+	}
+	out = v;
+	return p == start ? nullptr : p;
+}
+
+#endif /* UTILS_PARSE_H */
@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "anomaly.h"
+#include "../daemon/PluginService.h"
+
+int CAnomalyModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Plugin")
+		m_plugins.insert(val);
+	else if (key == "Alpha")
+		m_alpha = atof(val.c_str());
+	else if (key == "Beta")
+		m_beta = atof(val.c_str());
+	else if (key == "Gamma")
+		m_gamma = atof(val.c_str());
+	else if (key == "Season")
+		m_season = static_cast<uint32_t>(strtoul(val.c_str(), nullptr, 10));
+	else if (key == "ZScore")
+		m_zscore = atof(val.c_str());
+	else if (key == "TrendHorizon")
+		m_horizon = atof(val.c_str());
+	else if (key == "MinSamples")
+		m_minSamples = strtoull(val.c_str(), nullptr, 10);
+	else if (key == "IdleTimeout")
+	{
+		const double seconds = atof(val.c_str());
+		if (!(seconds > 0.0))
+		{
+			ERROR("anomaly plugin: IdleTimeout must be positive.");
+			return -1;
+		}
+		m_idleTimeout = DOUBLE_TO_CDTIME_T(seconds);
+	}
+	else
+		return -1;
+	return 0;
+}
+
+int CAnomalyModule::init()
+{
+	if (!(m_alpha > 0.0 && m_alpha <= 1.0) || !(m_beta >= 0.0 && m_beta <= 1.0) ||
+	    !(m_gamma >= 0.0 && m_gamma <= 1.0))
+	{
+		ERROR("anomaly plugin: Alpha must be in (0, 1], Beta and Gamma in [0, 1].");
+		return -1;
+	}
+	if (!(m_zscore > 0.0) || !(m_horizon >= 0.0))
+	{
+		ERROR("anomaly plugin: ZScore must be positive and TrendHorizon not negative.");
+		return -1;
+	}
+	/* 季节模型至少要看满一个周期才有意义 */
+	if (m_minSamples < 2ULL * m_season)
+		m_minSamples = 2ULL * m_season;
+
+	INFO("anomaly plugin: z-score %g, season %u, %zu plugin filter(s).",
+	     m_zscore, m_season, m_plugins.size());
+	return 0;
+}
+
+uint32_t CAnomalyModule::slotOf(const data_set_t *ds, const value_list_t *vl, cdtime_t now)
+{
+	m_key.assign(vl->plugin).push_back('\0');
+	m_key.append(vl->plugin_instance).push_back('\0');
+	m_key.append(vl->type).push_back('\0');
+	m_key.append(vl->type_instance);
+
+	auto it = m_index.find(m_key);
+	if (it != m_index.end())
+	{
+		it->second.lastSeen = now;
+		return it->second.base;
+	}
+
+	/* 新序列：优先复用同样数据源个数的空闲下标并清零，否则每个数据源追加一个下标 */
+	const uint32_t num = static_cast<uint32_t>(ds->ds_num);
+	uint32_t base;
+	auto fit = m_free.find(num);
+	if (fit != m_free.end() && !fit->second.empty())
+	{
+		base = fit->second.back();
+		fit->second.pop_back();
+		const size_t end = static_cast<size_t>(base) + num;
+		std::fill(m_level.begin() + base, m_level.begin() + end, 0.0);
+		std::fill(m_trend.begin() + base, m_trend.begin() + end, 0.0);
+		std::fill(m_var.begin() + base, m_var.begin() + end, 0.0);
+		std::fill(m_prevRaw.begin() + base, m_prevRaw.begin() + end, NAN);
+		std::fill(m_prevTime.begin() + base, m_prevTime.begin() + end, 0);
+		std::fill(m_count.begin() + base, m_count.begin() + end, 0);
+		std::fill(m_alarm.begin() + base, m_alarm.begin() + end, 0);
+		std::fill(m_seasonal.begin() + base * m_season, m_seasonal.begin() + end * m_season, 0.0f);
+	}
+	else
+	{
+		base = static_cast<uint32_t>(m_level.size());
+		const size_t n = static_cast<size_t>(base) + num;
+		m_level.resize(n, 0.0);
+		m_trend.resize(n, 0.0);
+		m_var.resize(n, 0.0);
+		m_prevRaw.resize(n, NAN);
+		m_prevTime.resize(n, 0);
+		m_count.resize(n, 0);
+		m_alarm.resize(n, 0);
+		m_seasonal.resize(n * m_season, 0.0f);
+	}
+
+	m_index.emplace(m_key, Entry{base, num, now});
+	return base;
+}
+
+void CAnomalyModule::evictIdle(cdtime_t now)
+{
+	if (now < m_nextSweep)
+		return;
+	m_nextSweep = now + m_idleTimeout / 2;
+
+	for (auto it = m_index.begin(); it != m_index.end();)
+	{
+		if (now - it->second.lastSeen > m_idleTimeout)
+		{
+			m_free[it->second.num].push_back(it->second.base);
+			it = m_index.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+double CAnomalyModule::update(uint32_t s, double x, double &trendZ)
+{
+	const uint64_t n = m_count[s]++;
+	float *season = m_season ? &m_seasonal[static_cast<size_t>(s) * m_season] : nullptr;
+	trendZ = 0.0;
+
+	/* 首个周期原样记录，周期结束时以均值为水平、与均值之差为季节项 */
+	if (season && n < m_season)
+	{
+		season[n] = static_cast<float>(x);
+		if (n + 1 == m_season)
+		{
+			double mean = 0.0;
+			for (uint32_t i = 0; i < m_season; ++i)
+			{
+				mean += season[i];
+			}
+			mean /= m_season;
+			for (uint32_t i = 0; i < m_season; ++i)
+			{
+				season[i] = static_cast<float>(season[i] - mean);
+			}
+			m_level[s] = mean;
+		}
+		return 0.0;
+	}
+	if (!season && n == 0)
+	{
+		m_level[s] = x;
+		return 0.0;
+	}
+
+	const uint32_t idx = season ? static_cast<uint32_t>(n % m_season) : 0;
+	const double seas = season ? season[idx] : 0.0;
+
+	/* 先用更新前的模型预测，残差相对历史残差标准差得到 z 值；
+	   标准差下限取预测值的 0.1%，恒定序列上的突变同样能被发现 */
+	const double forecast = m_level[s] + m_trend[s] + seas;
+	const double r = x - forecast;
+	const double sigma = std::max(std::sqrt(m_var[s]), std::fabs(forecast) * 1e-3);
+	if (!(sigma > 0.0))
+	{
+		m_level[s] = x;
+		return 0.0;
+	}
+	const double z = r / sigma;
+	trendZ = m_trend[s] * m_horizon / sigma;
+
+	/* 预热结束后残差截断在阈值处再更新模型（稳健 Holt-Winters）：
+	   离群点不计入方差、只把基线推动有限的一步，持续的偏移被逐步吸收 */
+	const double limit = m_zscore * sigma;
+	const bool outlier = n >= m_minSamples && std::fabs(r) > limit;
+	const double rc = outlier ? std::copysign(limit, r) : r;
+	const double xc = forecast + rc;
+
+	const double level = m_alpha * (xc - seas) + (1.0 - m_alpha) * (m_level[s] + m_trend[s]);
+	m_trend[s] = m_beta * (level - m_level[s]) + (1.0 - m_beta) * m_trend[s];
+	m_level[s] = level;
+	if (season)
+		season[idx] = static_cast<float>(m_gamma * (xc - level) + (1.0 - m_gamma) * seas);
+	/* 方差平滑取 Alpha 的 1/4：样本太少时估计值偏小，z 值分布尾部过重 */
+	if (!outlier)
+		m_var[s] += (m_alpha / 4) * (r * r - m_var[s]);
+	return z;
+}
+
+void CAnomalyModule::report(const value_list_t *vl, const char *dsName, uint32_t s, double x,
+                            double z, double trendZ, bool anomalous)
+{
+	m_pending.emplace_back();
+	Pending &p = m_pending.back();
+	notification_t &n = p.n;
+	memset(&n, 0, sizeof(n));
+	p.z = z;
+	p.trendZ = trendZ;
+
+	n.severity = anomalous ? NOTIF_WARNING : NOTIF_OKAY;
+	n.time = vl->time ? vl->time : cdtime();
+	snprintf(n.plugin, sizeof(n.plugin), "%s", vl->plugin);
+	snprintf(n.plugin_instance, sizeof(n.plugin_instance), "%s", vl->plugin_instance);
+	snprintf(n.type, sizeof(n.type), "%s", vl->type);
+	snprintf(n.type_instance, sizeof(n.type_instance), "%s", vl->type_instance);
+
+	const int len = snprintf(n.message, sizeof(n.message), "anomaly: %s%s%s/%s%s%s ",
+	                         vl->plugin, vl->plugin_instance[0] ? "-" : "", vl->plugin_instance,
+	                         vl->type, vl->type_instance[0] ? "-" : "", vl->type_instance);
+	if (len < 0 || static_cast<size_t>(len) >= sizeof(n.message))
+		return;
+
+	if (anomalous)
+		snprintf(n.message + len, sizeof(n.message) - len,
+		         "\"%s\" is %g, baseline %g, z-score %.1f, trend %+g per sample (z-score %.1f).",
+		         dsName, x, m_level[s], z, m_trend[s], trendZ);
+	else
+		snprintf(n.message + len, sizeof(n.message) - len,
+		         "\"%s\" is within the expected range again, currently %g.", dsName, x);
+}
+
+int CAnomalyModule::write(const data_set_t *ds, const value_list_t *vl)
+{
+	if (!ds || !vl || ds->ds_num != vl->values_len)
+		return -1;
+	if (!m_plugins.empty() && !m_plugins.count(vl->plugin))
+		return 0;
+
+	std::vector<Pending> pending;
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		const cdtime_t now = cdtime();
+		evictIdle(now);
+		const uint32_t base = slotOf(ds, vl, now);
+
+		for (size_t i = 0; i < ds->ds_num; ++i)
+		{
+			const uint32_t s = base + static_cast<uint32_t>(i);
+			const value_t &v = vl->values[i];
+
+			/* counter / derive 按速率建模，首个样本只记录原始值 */
+			double x;
+			switch (ds->ds[i].type)
+			{
+			case DS_TYPE_GAUGE:
+				x = v.gauge;
+				break;
+			case DS_TYPE_ABSOLUTE:
+				x = static_cast<double>(v.absolute);
+				break;
+			case DS_TYPE_COUNTER:
+			case DS_TYPE_DERIVE:
+			{
+				const double raw = ds->ds[i].type == DS_TYPE_COUNTER
+				                 ? static_cast<double>(v.counter) : static_cast<double>(v.derive);
+				x = NAN;
+				if (m_prevTime[s] && vl->time > m_prevTime[s] &&
+				    (ds->ds[i].type == DS_TYPE_DERIVE || raw >= m_prevRaw[s]))
+					x = (raw - m_prevRaw[s]) / CDTIME_T_TO_DOUBLE(vl->time - m_prevTime[s]);
+				m_prevRaw[s] = raw;
+				m_prevTime[s] = vl->time;
+				break;
+			}
+			default:
+				x = NAN;
+				break;
+			}
+			if (std::isnan(x))
+				continue;
+
+			double trendZ;
+			const double z = update(s, x, trendZ);
+			if (m_count[s] <= m_minSamples)
+				continue;
+
+			/* 残差或趋势任一越限即告警；回落到阈值一半以内才算恢复，避免在边界附近反复告警 */
+			const double mag = std::max(std::fabs(z), std::fabs(trendZ));
+			const bool alarm = m_alarm[s] ? mag > m_zscore / 2 : mag > m_zscore;
+			if (alarm != static_cast<bool>(m_alarm[s]))
+			{
+				m_alarm[s] = alarm;
+				report(vl, ds->ds[i].name, s, x, z, trendZ, alarm);
+			}
+		}
+		pending.swap(m_pending);
+	}
+
+	for (auto &p : pending)
+	{
+		notification_meta_t meta[2];
+		memset(meta, 0, sizeof(meta));
+		snprintf(meta[0].name, sizeof(meta[0].name), "ZScore");
+		meta[0].type = NM_TYPE_DOUBLE;
+		meta[0].nm_value.nm_double = p.z;
+		meta[0].next = &meta[1];
+		snprintf(meta[1].name, sizeof(meta[1].name), "TrendZScore");
+		meta[1].type = NM_TYPE_DOUBLE;
+		meta[1].nm_value.nm_double = p.trendZ;
+		p.n.meta = meta;
+		PluginService::Instance().dispatchNotification(&p.n);
+	}
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CAnomalyModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != NULL);
+
+	delete pUserModule;
+	pUserModule = NULL;
+}
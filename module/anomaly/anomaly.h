@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ModuleBase.h"
+
+/*
+ * 设备端异常检测 writer：为每条序列的每个数据源在线维护基线，
+ * 样本偏离基线超过 ZScore 个标准差时发出告警通知，回落后发出恢复通知。
+ *
+ *   Season 为 0：基线为 EWMA 均值；
+ *   Season > 0：基线为 Holt-Winters 加性预测（水平 + 趋势 + 季节项，周期为 Season 个样本）。
+ *   残差方差同样以 EWMA 估计；counter / derive 按速率建模。
+ *   除单点残差外还检查趋势：TrendHorizon 个样本内的累计漂移超过 ZScore 个标准差
+ *   同样告警，用于发现内存泄漏这类缓慢增长。预热后残差截断在阈值处再更新模型，
+ *   离群点不会拉偏基线。
+ *
+ * 配置示例（检测内存泄漏与线程失控）：
+ *   <Plugin anomaly>
+ *     Plugin "memory"          # 可重复；缺省处理全部序列
+ *     Plugin "thread"
+ *     Alpha 0.1                # 水平 / 均值平滑系数
+ *     Beta 0.01                # 趋势平滑系数
+ *     Gamma 0.1                # 季节项平滑系数
+ *     Season 0
+ *     ZScore 4
+ *     TrendHorizon 60          # 趋势检查的样本跨度，0 关闭
+ *     MinSamples 30            # 预热样本数，之前只学习不告警
+ *     IdleTimeout 600          # 序列空闲超过该秒数后释放状态
+ *   </Plugin>
+ *
+ * 状态按结构数组（SoA）存放：每个检查项占一个下标，逐字段连续存储，
+ * 季节项为 Season 个 float 一组的平铺数组；每个样本一次哈希查找。
+ * 空闲序列的下标按数据源个数归入空闲链表，新序列优先复用，线程等短命序列不会让状态无限增长。
+ */
+class CAnomalyModule final : public CAbstractUserModule
+{
+public:
+	CAnomalyModule() = default;
+	~CAnomalyModule() override = default;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int write(const data_set_t *ds, const value_list_t *vl) override;
+
+private:
+	struct Pending
+	{
+		notification_t n;
+		double z;
+		double trendZ;
+	};
+
+	struct Entry
+	{
+		uint32_t base;      ///< 该序列首个数据源的下标
+		uint32_t num;       ///< 数据源个数
+		cdtime_t lastSeen;
+	};
+
+	uint32_t slotOf(const data_set_t *ds, const value_list_t *vl, cdtime_t now);
+	void evictIdle(cdtime_t now);
+	double update(uint32_t s, double x, double &trendZ);
+	void report(const value_list_t *vl, const char *dsName, uint32_t s, double x,
+	            double z, double trendZ, bool anomalous);
+
+	double m_alpha = 0.1;
+	double m_beta = 0.01;
+	double m_gamma = 0.1;
+	uint32_t m_season = 0;
+	double m_zscore = 4.0;
+	double m_horizon = 60.0;
+	uint64_t m_minSamples = 30;
+	cdtime_t m_idleTimeout = TIME_T_TO_CDTIME_T(600);
+	std::set<std::string> m_plugins;
+
+	std::mutex m_mutex;
+	std::unordered_map<std::string, Entry> m_index;              ///< 序列键 -> 下标
+	std::unordered_map<uint32_t, std::vector<uint32_t>> m_free;  ///< 数据源个数 -> 空闲的首下标
+	cdtime_t m_nextSweep = 0;
+	std::string m_key;
+
+	/* SoA：下标为检查项编号 */
+	std::vector<double> m_level;    ///< EWMA 均值或 Holt-Winters 水平
+	std::vector<double> m_trend;
+	std::vector<double> m_var;      ///< 残差方差
+	std::vector<double> m_prevRaw;  ///< counter / derive 的上一个原始值
+	std::vector<cdtime_t> m_prevTime;
+	std::vector<uint64_t> m_count;
+	std::vector<uint8_t> m_alarm;
+	std::vector<float> m_seasonal;  ///< 每个检查项 m_season 个
+
+	std::vector<Pending> m_pending;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+
+#ifdef __cplusplus
+};
+#endif
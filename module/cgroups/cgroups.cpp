@@ -0,0 +1,413 @@
+#include <assert.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "cgroups.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/utils/utils.h"
+#include "../daemon/utils/utils_parse.h"
+
+namespace
+{
+	const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+	/* 逐行遍历 "<name> <value>" 格式内容（cpu.stat、memory.stat），取出 names 中各键的值 */
+	template <size_t N>
+	void scanKeys(const char *p, const char *end, const char *const (&names)[N],
+	              uint64_t (&values)[N], bool (&found)[N])
+	{
+		size_t remain = N;
+		while (p < end && remain > 0)
+		{
+			const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+			if (!eol)
+				eol = end;
+			const char *nameEnd = p;
+			while (nameEnd < eol && *nameEnd != ' ')
+				++nameEnd;
+			const size_t len = static_cast<size_t>(nameEnd - p);
+
+			for (size_t i = 0; i < N; ++i)
+			{
+				if (found[i] || strncmp(names[i], p, len) != 0 || names[i][len] != '\0')
+					continue;
+				if (parseU64(skipSpace(nameEnd, eol), eol, values[i]))
+				{
+					found[i] = true;
+					--remain;
+				}
+				break;
+			}
+			p = eol + 1;
+		}
+	}
+
+	bool exists(const char *path)
+	{
+		return access(path, F_OK) == 0;
+	}
+}
+
+CCgroupsModule::~CCgroupsModule()
+{
+	shutdown();
+}
+
+int CCgroupsModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Mountpoint")
+		m_mount = val;
+	else if (key == "CGroup")
+		m_globs.push_back(val);
+	else if (key == "IgnoreSelected")
+		m_ignoreSelected = IS_TRUE(val.c_str());
+	else
+		return -1;
+	return 0;
+}
+
+bool CCgroupsModule::isSelected(const std::string &rel) const
+{
+	if (m_globs.empty())
+		return true;
+
+	bool hit = false;
+	for (size_t i = 0; i < m_globs.size() && !hit; ++i)
+	{
+		hit = fnmatch(m_globs[i].c_str(), rel.c_str(), FNM_PATHNAME) == 0;
+	}
+	return hit != m_ignoreSelected;
+}
+
+void CCgroupsModule::addTree(const std::string &rel)
+{
+	const std::string abs = rel.empty() ? m_mount : m_mount + "/" + rel;
+
+	/* 先加监视再列目录：两者之间新建的子目录要么在列表中，要么产生事件，重复添加无害 */
+	if (m_inotifyFd >= 0)
+	{
+		const int wd = inotify_add_watch(m_inotifyFd, abs.c_str(), kWatchMask);
+		if (wd >= 0)
+			m_watches[wd] = rel;
+		else if (errno != ENOENT)
+			WARNING("cgroups plugin: inotify_add_watch %s failed: %s", abs.c_str(), strerror(errno));
+	}
+
+	if (!rel.empty() && m_groups.find(rel) == m_groups.end())
+	{
+		Group &g = m_groups[rel];
+		g.instance = rel;
+		for (char &c : g.instance)
+		{
+			if (c == '/')
+				c = '_';
+		}
+		g.selected = isSelected(rel);
+	}
+
+	DIR *dir = opendir(abs.c_str());
+	if (!dir)
+		return;
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != nullptr)
+	{
+		if (ent->d_type != DT_DIR || ent->d_name[0] == '.')
+			continue;
+		addTree(rel.empty() ? std::string(ent->d_name) : rel + "/" + ent->d_name);
+	}
+	closedir(dir);
+}
+
+void CCgroupsModule::removeTree(const std::string &rel)
+{
+	/* m_groups 按路径有序，rel 的子孙紧随其后 */
+	const std::string prefix = rel + "/";
+	auto it = m_groups.lower_bound(rel);
+	while (it != m_groups.end() && (it->first == rel || it->first.compare(0, prefix.size(), prefix) == 0))
+	{
+		it = m_groups.erase(it);
+	}
+}
+
+void CCgroupsModule::rebuild()
+{
+	if (m_inotifyFd >= 0)
+		close(m_inotifyFd);
+	m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotifyFd < 0)
+		WARNING("cgroups plugin: inotify_init1 failed: %s, rescanning every interval.", strerror(errno));
+
+	m_watches.clear();
+	m_groups.clear();
+	addTree("");
+}
+
+void CCgroupsModule::drainEvents()
+{
+	alignas(struct inotify_event) char buf[4096];
+	bool overflow = false;
+	for (;;)
+	{
+		const ssize_t n = ::read(m_inotifyFd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+
+		for (const char *p = buf; p < buf + n;)
+		{
+			const struct inotify_event *ev = reinterpret_cast<const struct inotify_event *>(p);
+			p += sizeof(struct inotify_event) + ev->len;
+
+			if (ev->mask & IN_Q_OVERFLOW)
+			{
+				overflow = true;
+				continue;
+			}
+			if (ev->mask & IN_IGNORED)
+			{
+				m_watches.erase(ev->wd);
+				continue;
+			}
+			auto w = m_watches.find(ev->wd);
+			if (w == m_watches.end() || !(ev->mask & IN_ISDIR) || ev->len == 0)
+				continue;
+
+			const std::string child = w->second.empty() ? std::string(ev->name) : w->second + "/" + ev->name;
+			if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+				addTree(child);
+			else if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+				removeTree(child);
+		}
+	}
+
+	if (overflow)
+	{
+		WARNING("cgroups plugin: inotify queue overflowed, rescanning %s.", m_mount.c_str());
+		rebuild();
+	}
+}
+
+int CCgroupsModule::init()
+{
+	if (m_mount.empty())
+	{
+		/* 纯 v2 挂在 /sys/fs/cgroup；hybrid 模式下 v2 层级在 unified 子目录 */
+		if (exists("/sys/fs/cgroup/cgroup.controllers"))
+			m_mount = "/sys/fs/cgroup";
+		else if (exists("/sys/fs/cgroup/unified/cgroup.controllers"))
+			m_mount = "/sys/fs/cgroup/unified";
+		else
+		{
+			ERROR("cgroups plugin: no cgroup v2 hierarchy found, set Mountpoint.");
+			return -1;
+		}
+	}
+	else if (!exists((m_mount + "/cgroup.controllers").c_str()))
+	{
+		ERROR("cgroups plugin: %s is not a cgroup v2 mount.", m_mount.c_str());
+		return -1;
+	}
+
+	rebuild();
+	return 0;
+}
+
+int CCgroupsModule::readFile(const std::string &path)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (m_buf.empty())
+		m_buf.resize(4096);
+	size_t len = 0;
+	for (;;)
+	{
+		if (len == m_buf.size())
+			m_buf.resize(m_buf.size() * 2);
+		ssize_t n = ::read(fd, m_buf.data() + len, m_buf.size() - len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+		{
+			const int err = errno;
+			close(fd);
+			errno = err;
+			return -1;
+		}
+		if (n == 0)
+			break;
+		len += static_cast<size_t>(n);
+	}
+	close(fd);
+	return static_cast<int>(len);
+}
+
+void CCgroupsModule::readGroup(const std::string &rel, const Group &g)
+{
+	value_t values[3];
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = values;
+	sstrncpy(vl.plugin, "cgroups", sizeof(vl.plugin));
+	sstrncpy(vl.plugin_instance, g.instance.c_str(), sizeof(vl.plugin_instance));
+
+	auto dispatch = [&](const char *type, const char *typeInstance, size_t n) {
+		vl.values_len = n;
+		sstrncpy(vl.type, type, sizeof(vl.type));
+		sstrncpy(vl.type_instance, typeInstance, sizeof(vl.type_instance));
+		PluginService::Instance().dispatchValues(&vl);
+	};
+	/* 控制器未开启时文件不存在；cgroup 在两次事件之间被删除时为 ENODEV */
+	auto load = [&](const char *file) -> int {
+		m_path.assign(m_mount).append("/").append(rel).append("/").append(file);
+		const int len = readFile(m_path);
+		if (len < 0 && errno != ENOENT && errno != ENODEV)
+			ERROR("cgroups plugin: read %s failed: %s", m_path.c_str(), strerror(errno));
+		return len;
+	};
+
+	int len;
+	if ((len = load("cpu.stat")) >= 0)
+	{
+		enum { USAGE = 0, USER, SYSTEM, PERIODS, THROTTLED, THROTTLED_USEC };
+		static const char *const kNames[] = {"usage_usec", "user_usec", "system_usec",
+		                                     "nr_periods", "nr_throttled", "throttled_usec"};
+		uint64_t v[6] = {};
+		bool found[6] = {};
+		scanKeys(m_buf.data(), m_buf.data() + len, kNames, v, found);
+		if (found[USAGE] && found[USER] && found[SYSTEM])
+		{
+			values[0].derive = static_cast<derive_t>(v[USAGE]);
+			values[1].derive = static_cast<derive_t>(v[USER]);
+			values[2].derive = static_cast<derive_t>(v[SYSTEM]);
+			dispatch("cgroup_cpu", "", 3);
+		}
+		if (found[PERIODS] && found[THROTTLED] && found[THROTTLED_USEC])
+		{
+			values[0].derive = static_cast<derive_t>(v[PERIODS]);
+			values[1].derive = static_cast<derive_t>(v[THROTTLED]);
+			values[2].derive = static_cast<derive_t>(v[THROTTLED_USEC]);
+			dispatch("cgroup_throttle", "", 3);
+		}
+	}
+
+	uint64_t u;
+	if ((len = load("memory.current")) > 0 && parseU64(m_buf.data(), m_buf.data() + len, u))
+	{
+		values[0].gauge = static_cast<gauge_t>(u);
+		dispatch("memory", "current", 1);
+	}
+
+	if ((len = load("memory.stat")) >= 0)
+	{
+		static const char *const kNames[] = {"anon", "file", "kernel", "slab", "sock", "shmem",
+		                                     "pgfault", "pgmajfault"};
+		const size_t kFaults = 6;
+		uint64_t v[8] = {};
+		bool found[8] = {};
+		scanKeys(m_buf.data(), m_buf.data() + len, kNames, v, found);
+		for (size_t i = 0; i < kFaults; ++i)
+		{
+			if (!found[i])
+				continue;
+			values[0].gauge = static_cast<gauge_t>(v[i]);
+			dispatch("memory", kNames[i], 1);
+		}
+		if (found[kFaults] && found[kFaults + 1])
+		{
+			/* pgfault 含主缺页 */
+			const uint64_t major = v[kFaults + 1];
+			values[0].derive = static_cast<derive_t>(v[kFaults] >= major ? v[kFaults] - major : 0);
+			values[1].derive = static_cast<derive_t>(major);
+			dispatch("vmpage_faults", "", 2);
+		}
+	}
+
+	if ((len = load("io.stat")) >= 0)
+	{
+		/* 每行 "MAJ:MIN rbytes=.. wbytes=.. rios=.. wios=.. dbytes=.. dios=.."，各设备求和 */
+		uint64_t rbytes = 0, wbytes = 0, rios = 0, wios = 0;
+		const char *p = m_buf.data();
+		const char *end = p + len;
+		while (p < end)
+		{
+			const char *eq = static_cast<const char *>(memchr(p, '=', end - p));
+			if (!eq)
+				break;
+			const char *key = eq;
+			while (key > p && key[-1] != ' ' && key[-1] != '\n')
+				--key;
+			uint64_t v = 0;
+			const char *q = parseU64(eq + 1, end, v);
+			const size_t klen = static_cast<size_t>(eq - key);
+			if (klen == 6 && memcmp(key, "rbytes", 6) == 0)
+				rbytes += v;
+			else if (klen == 6 && memcmp(key, "wbytes", 6) == 0)
+				wbytes += v;
+			else if (klen == 4 && memcmp(key, "rios", 4) == 0)
+				rios += v;
+			else if (klen == 4 && memcmp(key, "wios", 4) == 0)
+				wios += v;
+			p = q ? q : eq + 1;
+		}
+		if (len > 0)
+		{
+			values[0].derive = static_cast<derive_t>(rbytes);
+			values[1].derive = static_cast<derive_t>(wbytes);
+			dispatch("disk_octets", "", 2);
+			values[0].derive = static_cast<derive_t>(rios);
+			values[1].derive = static_cast<derive_t>(wios);
+			dispatch("disk_ops", "", 2);
+		}
+	}
+
+	if ((len = load("pids.current")) > 0 && parseU64(m_buf.data(), m_buf.data() + len, u))
+	{
+		values[0].gauge = static_cast<gauge_t>(u);
+		dispatch("count", "tasks", 1);
+	}
+}
+
+int CCgroupsModule::read()
+{
+	if (m_inotifyFd >= 0)
+		drainEvents();
+	else
+		rebuild();
+
+	for (const auto &kv : m_groups)
+	{
+		if (kv.second.selected)
+			readGroup(kv.first, kv.second);
+	}
+	return 0;
+}
+
+int CCgroupsModule::shutdown()
+{
+	if (m_inotifyFd >= 0)
+		close(m_inotifyFd);
+	m_inotifyFd = -1;
+	m_watches.clear();
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CCgroupsModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != NULL);
+
+	delete pUserModule;
+	pUserModule = NULL;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ModuleBase.h"
+
+/*
+ * cgroup v2 资源统计：按配置的路径通配符选取 cgroup，每个周期读取
+ *   cpu.stat        cgroup_cpu       usage, user, system（微秒）       DERIVE
+ *                   cgroup_throttle  periods, throttled, throttled_usec DERIVE（开启 cpu 控制器时）
+ *   memory.current  memory-current                                    GAUGE
+ *   memory.stat     memory-anon / file / kernel / slab / sock / shmem  GAUGE
+ *                   vmpage_faults    minflt, majflt                   DERIVE
+ *   io.stat         disk_octets / disk_ops  read, write（各设备之和）   DERIVE
+ *   pids.current    count-tasks                                       GAUGE
+ * plugin_instance 为相对挂载点的 cgroup 路径，'/' 替换为 '_'；未开启的控制器对应文件不存在，跳过。
+ *
+ * 目录索引在 init() 时遍历一次，之后由 inotify（IN_CREATE / IN_DELETE）增量维护，
+ * read() 开头以非阻塞方式取出积压事件；事件队列溢出或 inotify 不可用时退回整树重扫。
+ *
+ * 配置示例：
+ *   <Plugin cgroups>
+ *     Mountpoint "/sys/fs/cgroup"     # 缺省自动探测（含 hybrid 模式的 /sys/fs/cgroup/unified）
+ *     CGroup "*.slice"                # 可重复；fnmatch 通配，'*' 不跨越 '/'；缺省全部非根 cgroup
+ *     CGroup "system.slice/sshd.service"
+ *     IgnoreSelected false
+ *   </Plugin>
+ */
+class CCgroupsModule final : public CAbstractUserModule
+{
+public:
+	CCgroupsModule() = default;
+	~CCgroupsModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int read() override;
+	int shutdown() override;
+
+private:
+	struct Group
+	{
+		std::string instance; ///< 上报用的 plugin_instance
+		bool selected = false;
+	};
+
+	bool isSelected(const std::string &rel) const;
+	void addTree(const std::string &rel);
+	void removeTree(const std::string &rel);
+	void rebuild();
+	void drainEvents();
+
+	int readFile(const std::string &path);
+	void readGroup(const std::string &rel, const Group &g);
+
+	std::string m_mount;
+	std::vector<std::string> m_globs;
+	bool m_ignoreSelected = false;
+
+	std::map<std::string, Group> m_groups;            ///< 相对路径 -> cgroup，按路径有序便于删除整棵子树
+	std::unordered_map<int, std::string> m_watches;   ///< inotify wd -> 相对路径
+	int m_inotifyFd = -1;
+
+	std::vector<char> m_buf;  ///< 复用的读缓冲，按需倍增
+	std::string m_path;       ///< 复用的文件路径
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+
+#ifdef __cplusplus
+};
+#endif
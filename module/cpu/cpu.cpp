@@ -1,12 +1,13 @@
-#include <fstream>
-#include <sstream>
 #include <cstring>
 #include <chrono>
+#include <string_view>
 #include <assert.h>
 
 #include "cpu.h"
 #include "../daemon/PluginService.h"
+#include "../daemon/ProcfsCache.h"
 #include "../daemon/utils/utils.h"
+#include "../daemon/utils/utils_parse.h"
 
 /* --------- 工具宏 --------- */
 #define RATE_ADD(sum,val)  do{ if(std::isnan(sum)) (sum)=(val); \
@@ -40,42 +41,68 @@ int CCpuModule::init()
 int CCpuModule::read()
 {
     const double now = cdtime();
-    std::ifstream fin("/proc/stat");
-    if (!fin.is_open()) {
-        ERROR("cpu: open /proc/stat fail");
+    if (parseProcStat("/proc/stat", now) != 0)
+        return -1;
+
+    /* commit & reset */
+	m_reportNumCpu = true;
+    if (m_reportNumCpu) submitNumCpu(static_cast<double>(m_cpuSeen));
+    if (m_reportByState && m_reportByCpu && !m_reportPercent)
+        commitDeriveRaw();
+    else
+        commitPercentages();
+    resetIteration();
+    return 0;
+}
+
+int CCpuModule::parseProcStat(const char *path, double now)
+{
+    /* 与 vmstat 插件共享本周期的 /proc/stat 快照 */
+    ProcfsSnapshot snap;
+    if (ProcfsCache::Instance().get(path, snap) != 0) {
+        ERROR("cpu: read %s fail", path);
         return -1;
     }
+    const std::string_view text = snap.view();
 
-    std::string line;
-    while (std::getline(fin,line))
+    const char *p = text.data();
+    const char *end = p + text.size();
+    while (p < end)
     {
-        if (line.compare(0,3,"cpu")!=0 || !isdigit(line[3])) continue;
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        const char *line = p;
+        p = eol + 1;
+
+        if (eol - line < 4 || memcmp(line, "cpu", 3) != 0 || !isdigit(line[3])) continue;
 
-        std::istringstream iss(line);
-        std::string label;  iss>>label;               /* cpuN */
-        const size_t cpuIdx = static_cast<size_t>(std::stoi(label.substr(3)));
-        ERROR("cpu: cpuIdx:%d", cpuIdx);
+        uint64_t idx = 0;
+        const char *q = parseU64(line + 3, eol, idx);          /* cpuN */
+        const size_t cpuIdx = static_cast<size_t>(idx);
 
         if (cpuIdx >= m_cpus.size()) m_cpus.resize(cpuIdx+1);
-        uint64_t v[11]={0};
-        for(int i=0;i<11 && iss>>v[i];++i){}
+        /* user nice system idle iowait irq softirq steal guest guest_nice，旧内核字段较少 */
+        uint64_t v[10]={0};
+        int n = 0;
+        for (; n<10 && q; ++n) q = parseU64(skipSpace(q, eol), eol, v[n]);
+        if (!q) --n;
+        if (n < 4) continue;
 
         uint64_t user=v[0], nice=v[1];
-        /* 2=system,3=idle,... 按 /proc/stat 顺序 */
         stage(cpuIdx, SYSTEM , v[2], now);
         stage(cpuIdx, IDLE   , v[3], now);
-        if(iss.good()){ stage(cpuIdx, WAIT    , v[4], now); }
-        if(iss.good()){ stage(cpuIdx, INTERRUPT, v[5], now); }
-        if(iss.good()){ stage(cpuIdx, SOFTIRQ , v[6], now); }
-        if(iss.good()){ stage(cpuIdx, STEAL   , v[7], now); }
+        if(n > 4){ stage(cpuIdx, WAIT    , v[4], now); }
+        if(n > 5){ stage(cpuIdx, INTERRUPT, v[5], now); }
+        if(n > 6){ stage(cpuIdx, SOFTIRQ , v[6], now); }
+        if(n > 7){ stage(cpuIdx, STEAL   , v[7], now); }
 
-        if (iss.good()) {
+        if (n > 8) {
             if (m_reportGuest) {
                 uint64_t guest=v[8]; stage(cpuIdx,GUEST,guest,now);
                 if(m_subGuest && user>=guest) user-=guest;
             }
         }
-        if (iss.good()) {
+        if (n > 9) {
             if (m_reportGuest) {
                 uint64_t guestNice=v[9]; stage(cpuIdx,GUEST_NICE,guestNice,now);
                 if(m_subGuest && nice>=guestNice) nice-=guestNice;
@@ -87,15 +114,6 @@ int CCpuModule::read()
         /* mark cpu count */
         if (m_cpuSeen <= cpuIdx) m_cpuSeen = cpuIdx+1;
     }
-
-    /* commit & reset */
-	m_reportNumCpu = true;
-    if (m_reportNumCpu) submitNumCpu(static_cast<double>(m_cpuSeen));
-    if (m_reportByState && m_reportByCpu && !m_reportPercent)
-        commitDeriveRaw();
-    else
-        commitPercentages();
-    resetIteration();
     return 0;
 }
 
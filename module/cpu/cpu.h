@@ -18,6 +18,9 @@ public:
     int  init   ()                           override;
     int  read   ()                           override;
 
+    /* 解析 /proc/stat 格式文件并暂存各状态计数（不提交），bench 亦直接调用 */
+    int  parseProcStat(const char *path, double now);
+
 private:
     /* -------- 与 collectd 同名常量 -------- */
     enum CpuState : int {
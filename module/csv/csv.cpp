@@ -11,6 +11,7 @@
 
 #include "csv.h"
 #include "../daemon/PluginService.h"
+#include "../daemon/QuantileSketch.h"
 #include "../daemon/utils/utils.h"
 
 /* ───────────────────────────────────────────
@@ -82,6 +83,16 @@ int CCsvModule::vlToString(std::string &out,
         {
             oss << ',' << val.gauge;
         }
+        else if (dsrc.type == DS_TYPE_SKETCH)
+        {
+            /* sketch 写成 count:p50:p90:p99:max */
+            const QuantileSketch *sk = val.sketch;
+            if (!sk || sk->empty())
+                oss << ",0:nan:nan:nan:nan";
+            else
+                oss << ',' << sk->count() << ':' << sk->quantile(0.5) << ':'
+                    << sk->quantile(0.9) << ':' << sk->quantile(0.99) << ':' << sk->max();
+        }
         else if (_storeRates)
         {
 			#if 0
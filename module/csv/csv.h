@@ -16,10 +16,12 @@ public:
     int write(const data_set_t *ds,
               const value_list_t *vl) override;
 
-private:
+    /* 把 value_list 转成一行 CSV 文本（bench 亦直接调用） */
     int vlToString(std::string &out,
                    const data_set_t *ds,
                    const value_list_t *vl) const;
+
+private:
     int vlToPath(std::string &path,
                  const value_list_t *vl) const;
     bool touchCsv(const std::string &file,
@@ -0,0 +1,278 @@
+#include <assert.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "disk.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/utils/utils.h"
+#include "../daemon/utils/utils_parse.h"
+
+namespace
+{
+	/* diskstats 中的扇区固定为 512 字节，与设备实际扇区大小无关 */
+	const uint64_t kSectorSize = 512;
+}
+
+CDiskModule::~CDiskModule()
+{
+	for (regex_t *re : m_regex)
+	{
+		regfree(re);
+		delete re;
+	}
+}
+
+int CDiskModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Disk")
+	{
+		if (val.size() >= 2 && val.front() == '/' && val.back() == '/')
+		{
+			regex_t *re = new regex_t;
+			const std::string expr = val.substr(1, val.size() - 2);
+			if (regcomp(re, expr.c_str(), REG_EXTENDED | REG_NOSUB) != 0)
+			{
+				ERROR("disk plugin: invalid regex '%s'.", expr.c_str());
+				delete re;
+				return -1;
+			}
+			m_regex.push_back(re);
+		}
+		else
+		{
+			m_exact.push_back(val);
+		}
+	}
+	else if (key == "IgnoreSelected")
+		m_ignoreSelected = IS_TRUE(val.c_str());
+	else
+		return -1;
+	return 0;
+}
+
+bool CDiskModule::isSelected(const char *name) const
+{
+	if (m_exact.empty() && m_regex.empty())
+		return true;
+
+	bool hit = false;
+	for (auto &e : m_exact)
+	{
+		hit = hit || e == name;
+	}
+	for (size_t i = 0; i < m_regex.size() && !hit; ++i)
+	{
+		hit = regexec(m_regex[i], name, 0, nullptr, 0) == 0;
+	}
+	return hit != m_ignoreSelected;
+}
+
+int CDiskModule::readFile(const char *path)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		ERROR("disk plugin: open %s failed: %s", path, strerror(errno));
+		return -1;
+	}
+
+	/* procfs 按页返回，读满缓冲则倍增后继续，直到 EOF */
+	if (m_buf.empty())
+		m_buf.resize(16384);
+	size_t len = 0;
+	for (;;)
+	{
+		if (len == m_buf.size())
+			m_buf.resize(m_buf.size() * 2);
+		ssize_t n = ::read(fd, m_buf.data() + len, m_buf.size() - len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+		{
+			ERROR("disk plugin: read %s failed: %s", path, strerror(errno));
+			close(fd);
+			return -1;
+		}
+		if (n == 0)
+			break;
+		len += static_cast<size_t>(n);
+	}
+	close(fd);
+	return static_cast<int>(len);
+}
+
+size_t CDiskModule::slotOf(size_t line, const char *name, size_t len)
+{
+	/* 设备列表通常不变：先按行号命中上次的下标 */
+	if (line < m_lineSlot.size())
+	{
+		const Disk &d = m_disks[m_lineSlot[line]];
+		if (strncmp(d.name, name, len) == 0 && d.name[len] == '\0')
+			return m_lineSlot[line];
+	}
+
+	const std::string key(name, len);
+	size_t slot;
+	auto it = m_index.find(key);
+	if (it != m_index.end())
+	{
+		slot = it->second;
+	}
+	else
+	{
+		slot = m_disks.size();
+		m_disks.emplace_back();
+		Disk &d = m_disks.back();
+		sstrncpy(d.name, key.c_str(), sizeof(d.name));
+		d.selected = isSelected(d.name);
+		m_index.emplace(key, slot);
+	}
+
+	if (line >= m_lineSlot.size())
+		m_lineSlot.resize(line + 1);
+	m_lineSlot[line] = slot;
+	return slot;
+}
+
+int CDiskModule::parseDiskstats(const char *path, cdtime_t now)
+{
+	const int len = readFile(path);
+	if (len < 0)
+		return -1;
+
+	for (auto &d : m_disks)
+	{
+		d.seen = false;
+	}
+
+	const char *p = m_buf.data();
+	const char *end = p + len;
+	size_t line = 0;
+	while (p < end)
+	{
+		const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+		if (!eol)
+			eol = end;
+
+		/* major minor name 之后至少 11 个计数；新内核追加的 discard / flush 字段忽略 */
+		uint64_t major, minor;
+		const char *q = parseU64(skipSpace(p, eol), eol, major);
+		if (q)
+			q = parseU64(skipSpace(q, eol), eol, minor);
+		if (q)
+		{
+			const char *name = skipSpace(q, eol);
+			const char *nameEnd = name;
+			while (nameEnd < eol && *nameEnd != ' ' && *nameEnd != '\t')
+				++nameEnd;
+
+			uint64_t v[COUNTER_NUM];
+			q = nameEnd;
+			int n = 0;
+			for (; n < COUNTER_NUM && q; ++n)
+			{
+				q = parseU64(skipSpace(q, eol), eol, v[n]);
+			}
+
+			const size_t nameLen = static_cast<size_t>(nameEnd - name);
+			if (n == COUNTER_NUM && q && nameLen > 0 && nameLen < DATA_MAX_NAME_LEN)
+			{
+				Disk &d = m_disks[slotOf(line, name, nameLen)];
+				memcpy(d.prev, d.cur, sizeof(d.cur));
+				memcpy(d.cur, v, sizeof(v));
+				d.prevTime = d.curTime;
+				d.curTime = now;
+				d.seen = true;
+			}
+		}
+
+		++line;
+		p = eol + 1;
+	}
+	return 0;
+}
+
+void CDiskModule::submit(const Disk &d)
+{
+	value_t values[2];
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = values;
+	sstrncpy(vl.plugin, "disk", sizeof(vl.plugin));
+	sstrncpy(vl.plugin_instance, d.name, sizeof(vl.plugin_instance));
+
+	auto dispatch = [&](const char *type, const char *typeInstance, size_t n) {
+		vl.values_len = n;
+		sstrncpy(vl.type, type, sizeof(vl.type));
+		sstrncpy(vl.type_instance, typeInstance, sizeof(vl.type_instance));
+		PluginService::Instance().dispatchValues(&vl);
+	};
+	auto derive2 = [&](const char *type, uint64_t a, uint64_t b) {
+		values[0].derive = static_cast<derive_t>(a);
+		values[1].derive = static_cast<derive_t>(b);
+		dispatch(type, "", 2);
+	};
+
+	const uint64_t *c = d.cur;
+	derive2("disk_ops", c[READ_OPS], c[WRITE_OPS]);
+	derive2("disk_octets", c[READ_SECTORS] * kSectorSize, c[WRITE_SECTORS] * kSectorSize);
+	derive2("disk_merged", c[READ_MERGED], c[WRITE_MERGED]);
+	derive2("disk_time", c[READ_TIME], c[WRITE_TIME]);
+	derive2("disk_io_time", c[IO_TIME], c[WEIGHTED_IO_TIME]);
+
+	values[0].gauge = static_cast<gauge_t>(c[IN_PROGRESS]);
+	dispatch("pending_operations", "", 1);
+
+	/* 平均延迟与利用率需要上一周期的计数；计数回绕（32 位内核）时跳过本周期 */
+	const uint64_t *p = d.prev;
+	if (!d.prevTime || d.curTime <= d.prevTime)
+		return;
+	for (int i : {READ_OPS, READ_TIME, WRITE_OPS, WRITE_TIME, IO_TIME})
+	{
+		if (c[i] < p[i])
+			return;
+	}
+
+	const uint64_t readOps = c[READ_OPS] - p[READ_OPS];
+	const uint64_t writeOps = c[WRITE_OPS] - p[WRITE_OPS];
+	values[0].gauge = readOps ? static_cast<double>(c[READ_TIME] - p[READ_TIME]) / readOps : 0.0;
+	values[1].gauge = writeOps ? static_cast<double>(c[WRITE_TIME] - p[WRITE_TIME]) / writeOps : 0.0;
+	dispatch("disk_latency", "", 2);
+
+	const double elapsedMs = CDTIME_T_TO_DOUBLE(d.curTime - d.prevTime) * 1000.0;
+	const double util = 100.0 * static_cast<double>(c[IO_TIME] - p[IO_TIME]) / elapsedMs;
+	values[0].gauge = util > 100.0 ? 100.0 : util;
+	dispatch("percent", "utilization", 1);
+}
+
+int CDiskModule::read()
+{
+	if (parseDiskstats("/proc/diskstats", cdtime()) != 0)
+		return -1;
+
+	for (const auto &d : m_disks)
+	{
+		if (!d.seen || !d.selected)
+			continue;
+		/* 与 collectd 相同：从未有过读写的设备（未使用的 loop、ram 等）不上报 */
+		if (d.cur[READ_OPS] == 0 && d.cur[WRITE_OPS] == 0)
+			continue;
+		submit(d);
+	}
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CDiskModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != NULL);
+
+	delete pUserModule;
+	pUserModule = NULL;
+}
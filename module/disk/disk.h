@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <regex.h>
+
+#include "ModuleBase.h"
+
+/*
+ * 磁盘 I/O 统计：每个周期一次 read() 读入 /proc/diskstats，
+ * 上一周期的计数按设备存放在平铺数组中（行号即缓存下标，设备增删时回退到名字查找）。
+ *
+ * 每个设备（plugin_instance 为设备名）上报：
+ *   disk_ops / disk_octets / disk_merged / disk_time   read, write     DERIVE
+ *   disk_io_time                                        io_time, weighted_io_time  DERIVE
+ *   pending_operations                                  当前在途请求数  GAUGE
+ *   disk_latency                                        本周期平均每次读 / 写耗时（毫秒）GAUGE
+ *   percent-utilization                                 本周期 io_time 占比  GAUGE
+ *
+ * 配置示例：
+ *   <Plugin disk>
+ *     Disk "sda"                 # 可重复；"/.../" 为正则
+ *     Disk "/^mmcblk[0-9]+$/"
+ *     IgnoreSelected false       # true 时改为排除所列设备
+ *   </Plugin>
+ * 从未有过 I/O 的设备不上报。
+ */
+class CDiskModule final : public CAbstractUserModule
+{
+public:
+	CDiskModule() = default;
+	~CDiskModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int read() override;
+
+	/* 解析 /proc/diskstats 格式文件并暂存各设备本周期增量（不提交），bench 亦直接调用 */
+	int parseDiskstats(const char *path, cdtime_t now);
+
+private:
+	enum Counter
+	{
+		READ_OPS = 0, READ_MERGED, READ_SECTORS, READ_TIME,
+		WRITE_OPS, WRITE_MERGED, WRITE_SECTORS, WRITE_TIME,
+		IN_PROGRESS, IO_TIME, WEIGHTED_IO_TIME,
+		COUNTER_NUM
+	};
+
+	struct Disk
+	{
+		char name[DATA_MAX_NAME_LEN] = {};
+		uint64_t cur[COUNTER_NUM] = {};
+		uint64_t prev[COUNTER_NUM] = {};
+		cdtime_t curTime = 0;
+		cdtime_t prevTime = 0;
+		bool selected = false;
+		bool seen = false;    ///< 本周期出现在 diskstats 中
+	};
+
+	size_t slotOf(size_t line, const char *name, size_t len);
+	int readFile(const char *path);
+	bool isSelected(const char *name) const;
+	void submit(const Disk &d);
+
+	std::vector<std::string> m_exact;
+	std::vector<regex_t *> m_regex;
+	bool m_ignoreSelected = false;
+
+	std::vector<Disk> m_disks;
+	std::unordered_map<std::string, size_t> m_index;
+	std::vector<size_t> m_lineSlot; ///< 上次解析时第 n 行对应的设备下标
+	std::vector<char> m_buf; ///< 复用的读缓冲，按需倍增
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+
+#ifdef __cplusplus
+};
+#endif
@@ -0,0 +1,451 @@
+#include <assert.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fsactivity.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/utils/utils.h"
+
+namespace
+{
+	const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY |
+	                            IN_CLOSE_WRITE | IN_EXCL_UNLINK | IN_ONLYDIR;
+
+	/* 脏文件统一 stat 的间隔 */
+	const int kFlushMs = 1000;
+
+	inline void bump(std::atomic<uint64_t> &c, uint64_t n = 1)
+	{
+		c.fetch_add(n, std::memory_order_relaxed);
+	}
+}
+
+CFsActivityModule::~CFsActivityModule()
+{
+	shutdown();
+}
+
+int CFsActivityModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Directory")
+	{
+		std::unique_ptr<Root> r(new Root());
+		r->path = val;
+		while (r->path.size() > 1 && r->path.back() == '/')
+			r->path.pop_back();
+		if (r->path == "/")
+		{
+			r->instance = "root";
+		}
+		else
+		{
+			r->instance = r->path[0] == '/' ? r->path.substr(1) : r->path;
+			for (char &c : r->instance)
+			{
+				if (c == '/')
+					c = '-';
+			}
+		}
+		m_roots.push_back(std::move(r));
+	}
+	else if (key == "Recursive")
+		m_recursive = IS_TRUE(val.c_str());
+	else if (key == "MaxWatches")
+		m_maxWatches = strtoul(val.c_str(), nullptr, 10);
+	else
+		return -1;
+	return 0;
+}
+
+int CFsActivityModule::addWatch(size_t root, const std::string &path)
+{
+	if (m_watches.size() >= m_maxWatches)
+	{
+		if (!m_limitLogged)
+			WARNING("fsactivity plugin: MaxWatches (%zu) reached, %s and further directories are not watched.",
+			        m_maxWatches, path.c_str());
+		m_limitLogged = true;
+		return -1;
+	}
+
+	const int wd = inotify_add_watch(m_inotifyFd, path.c_str(), kWatchMask);
+	if (wd < 0)
+	{
+		if (errno == ENOSPC)
+		{
+			if (!m_limitLogged)
+				WARNING("fsactivity plugin: fs.inotify.max_user_watches reached at %s.", path.c_str());
+			m_limitLogged = true;
+		}
+		else if (errno != ENOENT && errno != ENOTDIR)
+		{
+			WARNING("fsactivity plugin: inotify_add_watch %s failed: %s", path.c_str(), strerror(errno));
+		}
+		return -1;
+	}
+
+	/* 同一 inode 重复添加返回原 wd：嵌套配置时保留先到的归属，目录改名时更新路径 */
+	auto it = m_watches.find(wd);
+	if (it == m_watches.end())
+	{
+		Watch &w = m_watches[wd];
+		w.root = root;
+		w.path = path;
+	}
+	else if (it->second.root == root)
+	{
+		it->second.path = path;
+	}
+	m_watchCount.store(m_watches.size(), std::memory_order_relaxed);
+	return wd;
+}
+
+void CFsActivityModule::addTree(size_t root, const std::string &path, bool counting)
+{
+	/* 先加监视再列目录：两者之间新建的文件要么在列表中，要么产生事件 */
+	const int wd = addWatch(root, path);
+	if (wd < 0)
+		return;
+	Watch &w = m_watches[wd];
+	Counters &c = m_roots[root]->counters;
+
+	DIR *dir = opendir(path.c_str());
+	if (!dir)
+		return;
+	std::vector<std::string> subdirs;
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != nullptr)
+	{
+		if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+			continue;
+
+		struct stat st;
+		if (fstatat(dirfd(dir), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+		{
+			if (m_recursive)
+				subdirs.push_back(path + "/" + ent->d_name);
+		}
+		else if (S_ISREG(st.st_mode))
+		{
+			const uint64_t size = static_cast<uint64_t>(st.st_size);
+			if (counting && w.sizes.find(ent->d_name) == w.sizes.end())
+			{
+				bump(c.creates);
+				bump(c.grown, size);
+			}
+			w.sizes[ent->d_name] = size;
+		}
+	}
+	closedir(dir);
+
+	/* 递归会向 m_watches 插入元素，w 此后可能失效 */
+	for (const auto &sub : subdirs)
+	{
+		addTree(root, sub, counting);
+	}
+}
+
+void CFsActivityModule::settle(Watch &w, const std::string &name)
+{
+	w.dirty.erase(name);
+
+	m_pathBuf.assign(w.path).append(1, '/').append(name);
+	struct stat st;
+	if (lstat(m_pathBuf.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		w.sizes.erase(name);
+		return;
+	}
+
+	/* 未见过的文件（监视建立前已存在且未遍历到）以当前大小为基线 */
+	const uint64_t size = static_cast<uint64_t>(st.st_size);
+	auto it = w.sizes.find(name);
+	if (it == w.sizes.end())
+	{
+		w.sizes.emplace(name, size);
+		return;
+	}
+	if (size > it->second)
+		bump(m_roots[w.root]->counters.grown, size - it->second);
+	it->second = size;
+}
+
+void CFsActivityModule::flushDirty()
+{
+	for (auto &kv : m_watches)
+	{
+		Watch &w = kv.second;
+		while (!w.dirty.empty())
+		{
+			const std::string name = *w.dirty.begin();
+			settle(w, name);
+		}
+	}
+}
+
+void CFsActivityModule::handleEvent(const struct inotify_event *ev)
+{
+	if (ev->mask & IN_Q_OVERFLOW)
+	{
+		WARNING("fsactivity plugin: inotify queue overflowed, events lost.");
+		return;
+	}
+
+	auto it = m_watches.find(ev->wd);
+	if (it == m_watches.end())
+		return;
+	if (ev->mask & IN_IGNORED)
+	{
+		/* 目录被删除或所在文件系统卸载 */
+		m_watches.erase(it);
+		m_watchCount.store(m_watches.size(), std::memory_order_relaxed);
+		return;
+	}
+	if (ev->len == 0)
+		return;
+
+	const size_t root = it->second.root;
+	Counters &c = m_roots[root]->counters;
+	const std::string name(ev->name);
+
+	if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+	{
+		bump(c.deletes);
+		if (ev->mask & IN_MOVED_FROM)
+		{
+			m_moveCookie = ev->cookie;
+			m_moveRoot = root;
+		}
+		if (ev->mask & IN_ISDIR)
+		{
+			/* 移出的子树停止监视；若移到树内，随后的 IN_MOVED_TO 以新路径重新添加 */
+			if (ev->mask & IN_MOVED_FROM)
+			{
+				const std::string prefix = it->second.path + "/" + name;
+				for (auto w = m_watches.begin(); w != m_watches.end();)
+				{
+					const std::string &p = w->second.path;
+					if (p.compare(0, prefix.size(), prefix) == 0 && (p.size() == prefix.size() || p[prefix.size()] == '/'))
+					{
+						inotify_rm_watch(m_inotifyFd, w->first);
+						w = m_watches.erase(w);
+					}
+					else
+					{
+						++w;
+					}
+				}
+				m_watchCount.store(m_watches.size(), std::memory_order_relaxed);
+			}
+			return;
+		}
+		it->second.sizes.erase(name);
+		it->second.dirty.erase(name);
+		return;
+	}
+
+	if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+	{
+		bump(c.creates);
+		/* 同一目录树内改名不算增长 */
+		const bool renamed = (ev->mask & IN_MOVED_TO) && ev->cookie == m_moveCookie && root == m_moveRoot;
+		if (ev->mask & IN_ISDIR)
+		{
+			if (m_recursive)
+				addTree(root, it->second.path + "/" + name, !renamed);
+			return;
+		}
+
+		Watch &w = it->second;
+		m_pathBuf.assign(w.path).append(1, '/').append(name);
+		struct stat st;
+		if (lstat(m_pathBuf.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+		{
+			const uint64_t size = static_cast<uint64_t>(st.st_size);
+			if (!renamed)
+				bump(c.grown, size);
+			w.sizes[name] = size;
+		}
+		return;
+	}
+
+	if (ev->mask & IN_ISDIR)
+		return;
+	if (ev->mask & IN_MODIFY)
+	{
+		bump(c.writes);
+		it->second.dirty.insert(name);
+	}
+	if (ev->mask & IN_CLOSE_WRITE)
+		settle(it->second, name);
+}
+
+void CFsActivityModule::watchLoop()
+{
+	struct pollfd fds[2] = {{m_wakeFd, POLLIN, 0}, {m_inotifyFd, POLLIN, 0}};
+	alignas(struct inotify_event) char buf[16384];
+	cdtime_t nextFlush = cdtime() + (MS_TO_CDTIME_T(kFlushMs));
+
+	while (m_running.load(std::memory_order_acquire))
+	{
+		const int n = poll(fds, 2, kFlushMs);
+		if (n < 0 && errno != EINTR)
+		{
+			ERROR("fsactivity plugin: poll failed: %s", strerror(errno));
+			break;
+		}
+		if (n > 0 && (fds[0].revents & POLLIN))
+			return;
+
+		if (n > 0 && (fds[1].revents & POLLIN))
+		{
+			ssize_t len;
+			while ((len = ::read(m_inotifyFd, buf, sizeof(buf))) > 0)
+			{
+				for (const char *p = buf; p < buf + len;)
+				{
+					const struct inotify_event *ev = reinterpret_cast<const struct inotify_event *>(p);
+					p += sizeof(struct inotify_event) + ev->len;
+					handleEvent(ev);
+				}
+			}
+			if (len < 0 && errno != EAGAIN && errno != EINTR)
+				ERROR("fsactivity plugin: read inotify events failed: %s", strerror(errno));
+		}
+
+		const cdtime_t now = cdtime();
+		if (now >= nextFlush)
+		{
+			flushDirty();
+			nextFlush = now + (MS_TO_CDTIME_T(kFlushMs));
+		}
+	}
+}
+
+int CFsActivityModule::init()
+{
+	if (m_roots.empty())
+	{
+		ERROR("fsactivity plugin: no Directory configured.");
+		return -1;
+	}
+
+	m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotifyFd < 0)
+	{
+		ERROR("fsactivity plugin: inotify_init1 failed: %s", strerror(errno));
+		return -1;
+	}
+
+	/* 线程启动前完成初始遍历，之后 m_watches 只由监视线程访问 */
+	for (size_t i = 0; i < m_roots.size(); ++i)
+	{
+		const size_t before = m_watches.size();
+		addTree(i, m_roots[i]->path, false);
+		if (m_watches.size() == before)
+			WARNING("fsactivity plugin: cannot watch %s.", m_roots[i]->path.c_str());
+	}
+	if (m_watches.empty())
+	{
+		ERROR("fsactivity plugin: no directory could be watched.");
+		shutdown();
+		return -1;
+	}
+
+	m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_wakeFd < 0)
+	{
+		ERROR("fsactivity plugin: eventfd failed: %s", strerror(errno));
+		shutdown();
+		return -1;
+	}
+	m_running.store(true);
+	m_thread = std::thread(&CFsActivityModule::watchLoop, this);
+	return 0;
+}
+
+int CFsActivityModule::read()
+{
+	value_t value;
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = &value;
+	vl.values_len = 1;
+	sstrncpy(vl.plugin, "fsactivity", sizeof(vl.plugin));
+
+	for (const auto &r : m_roots)
+	{
+		const Counters &c = r->counters;
+		sstrncpy(vl.plugin_instance, r->instance.c_str(), sizeof(vl.plugin_instance));
+
+		sstrncpy(vl.type, "fs_events", sizeof(vl.type));
+		const struct
+		{
+			const char *name;
+			const std::atomic<uint64_t> &counter;
+		} events[] = {{"create", c.creates}, {"write", c.writes}, {"delete", c.deletes}};
+		for (const auto &e : events)
+		{
+			sstrncpy(vl.type_instance, e.name, sizeof(vl.type_instance));
+			value.derive = static_cast<derive_t>(e.counter.load(std::memory_order_relaxed));
+			PluginService::Instance().dispatchValues(&vl);
+		}
+
+		sstrncpy(vl.type, "fs_growth", sizeof(vl.type));
+		vl.type_instance[0] = '\0';
+		value.derive = static_cast<derive_t>(c.grown.load(std::memory_order_relaxed));
+		PluginService::Instance().dispatchValues(&vl);
+	}
+
+	vl.plugin_instance[0] = '\0';
+	sstrncpy(vl.type, "count", sizeof(vl.type));
+	sstrncpy(vl.type_instance, "watches", sizeof(vl.type_instance));
+	value.gauge = static_cast<gauge_t>(m_watchCount.load(std::memory_order_relaxed));
+	PluginService::Instance().dispatchValues(&vl);
+	return 0;
+}
+
+int CFsActivityModule::shutdown()
+{
+	if (m_running.exchange(false))
+	{
+		uint64_t one = 1;
+		if (::write(m_wakeFd, &one, sizeof(one)) < 0)
+			ERROR("fsactivity plugin: wake watch thread failed: %s", strerror(errno));
+	}
+	if (m_thread.joinable())
+		m_thread.join();
+
+	if (m_inotifyFd >= 0)
+		close(m_inotifyFd);
+	m_inotifyFd = -1;
+	if (m_wakeFd >= 0)
+		close(m_wakeFd);
+	m_wakeFd = -1;
+	m_watches.clear();
+	m_watchCount.store(0, std::memory_order_relaxed);
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CFsActivityModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != NULL);
+
+	delete pUserModule;
+	pUserModule = NULL;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ModuleBase.h"
+
+struct inotify_event;
+
+/*
+ * 目录变化速率：用 inotify 监视配置的目录（缺省含全部子目录），按目录（plugin_instance，
+ * 命名同 df：/mnt/log -> mnt-log）上报
+ *   fs_events-create / write / delete   DERIVE   新建（含移入）、写入、删除（含移出）事件数
+ *   fs_growth                           DERIVE   文件增长的字节数（截断、删除不抵扣）
+ *   count-watches                       GAUGE    当前 inotify 监视数（plugin_instance 为空）
+ * 无需周期性 du 即可定位哪个目录在涨。
+ *
+ * 后台线程读取 inotify 事件并累加到各目录的原子计数，read() 只读计数，两侧不加锁。
+ * 增长量按文件大小之差计算：写入只把文件记为脏，IN_CLOSE_WRITE 或每秒统一 stat 一次，
+ * 持续追加的日志文件不会每次 write 都触发 stat。启动时遍历一次目录记录已有文件大小；
+ * 运行中新建或移入的子目录补加监视并把其中已有文件计为新建。
+ *
+ * 嵌套配置的目录归属先配置的那个；监视数受 MaxWatches 与 fs.inotify.max_user_watches 限制，
+ * 超出后新子目录不再监视。队列溢出（IN_Q_OVERFLOW）时丢失的事件无法补回，只记日志。
+ *
+ * 配置示例：
+ *   <Plugin fsactivity>
+ *     Directory "/mnt/log"   # 可重复
+ *     Recursive true
+ *     MaxWatches 8192
+ *   </Plugin>
+ */
+class CFsActivityModule final : public CAbstractUserModule
+{
+public:
+	CFsActivityModule() = default;
+	~CFsActivityModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int read() override;
+	int shutdown() override;
+
+private:
+	/* 监视线程写、read() 读，均为 relaxed 原子操作 */
+	struct Counters
+	{
+		std::atomic<uint64_t> creates{0};
+		std::atomic<uint64_t> writes{0};
+		std::atomic<uint64_t> deletes{0};
+		std::atomic<uint64_t> grown{0};
+	};
+
+	struct Root
+	{
+		std::string path;
+		std::string instance;
+		Counters counters;
+	};
+
+	/* 以下仅监视线程访问（init 中线程启动前除外） */
+	struct Watch
+	{
+		size_t root = 0;
+		std::string path;
+		std::unordered_map<std::string, uint64_t> sizes; ///< 已知普通文件大小
+		std::unordered_set<std::string> dirty;           ///< 有写入、尚未 stat 的文件
+	};
+
+	int addWatch(size_t root, const std::string &path);
+	void addTree(size_t root, const std::string &path, bool counting);
+	void handleEvent(const struct inotify_event *ev);
+	void settle(Watch &w, const std::string &name);
+	void flushDirty();
+	void watchLoop();
+
+	std::vector<std::unique_ptr<Root>> m_roots; ///< 线程运行期间不增删，计数地址稳定
+	bool m_recursive = true;
+	size_t m_maxWatches = 8192;
+
+	std::unordered_map<int, Watch> m_watches;
+	std::atomic<uint64_t> m_watchCount{0};
+	bool m_limitLogged = false;
+	uint32_t m_moveCookie = 0; ///< 最近一次 IN_MOVED_FROM，用于识别树内改名
+	size_t m_moveRoot = 0;
+	std::string m_pathBuf;
+
+	int m_inotifyFd = -1;
+	int m_wakeFd = -1;
+	std::thread m_thread;
+	std::atomic<bool> m_running{false};
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+
+#ifdef __cplusplus
+};
+#endif
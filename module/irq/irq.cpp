@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <assert.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#include "irq.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/ProcfsCache.h"
+#include "../daemon/utils/utils.h"
+#include "../daemon/utils/utils_parse.h"
+
+int CIrqModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "ReportByCpu")
+		m_byCpu = IS_TRUE(val.c_str());
+	else if (key == "Softirqs")
+		m_softirqs = IS_TRUE(val.c_str());
+	else if (key == "TopN")
+		m_topN = strtoul(val.c_str(), nullptr, 10);
+	else
+		return -1;
+	return 0;
+}
+
+size_t CIrqModule::rowOf(Table &t, size_t line, const char *label, size_t len)
+{
+	/* 中断源列表通常不变：先按行号命中上次的下标 */
+	if (line < t.lineSlot.size())
+	{
+		const std::string &l = t.labels[t.lineSlot[line]];
+		if (l.size() == len && memcmp(l.data(), label, len) == 0)
+			return t.lineSlot[line];
+	}
+
+	const std::string key(label, len);
+	size_t row;
+	auto it = t.index.find(key);
+	if (it != t.index.end())
+	{
+		row = it->second;
+	}
+	else
+	{
+		row = t.labels.size();
+		t.labels.push_back(key);
+		t.cur.resize(t.cur.size() + t.cpus.size());
+		t.prev.resize(t.prev.size() + t.cpus.size());
+		t.gen.push_back(0);
+		t.valid.push_back(0);
+		t.index.emplace(key, row);
+	}
+
+	if (line >= t.lineSlot.size())
+		t.lineSlot.resize(line + 1);
+	t.lineSlot[line] = row;
+	return row;
+}
+
+int CIrqModule::parse(Table &t, const char *path, cdtime_t now)
+{
+	ProcfsSnapshot snap;
+	const int status = ProcfsCache::Instance().get(path, snap);
+	if (status != 0)
+	{
+		ERROR("irq plugin: read %s failed: %s", path, strerror(status));
+		return -1;
+	}
+	const std::string_view text = snap.view();
+
+	const char *p = text.data();
+	const char *end = p + text.size();
+	const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+	if (!eol)
+		eol = end;
+
+	/* 表头 "CPU0 CPU1 ..."，离线 CPU 不出现，编号未必连续 */
+	m_header.clear();
+	for (const char *q = skipSpace(p, eol); q < eol; q = skipSpace(q, eol))
+	{
+		uint64_t id;
+		const char *r = eol - q > 3 && memcmp(q, "CPU", 3) == 0 ? parseU64(q + 3, eol, id) : nullptr;
+		if (!r)
+			break;
+		m_header.push_back(static_cast<int>(id));
+		q = r;
+	}
+	if (m_header.empty())
+	{
+		ERROR("irq plugin: no CPU columns in %s.", path);
+		return -1;
+	}
+	if (m_header != t.cpus)
+	{
+		/* CPU 上下线后列含义变化，丢弃历史 */
+		t = Table();
+		t.cpus = m_header;
+	}
+	const size_t ncpu = t.cpus.size();
+
+	/* 上次的计数整体成为 prev，本次直接写入 cur 对应行 */
+	std::swap(t.cur, t.prev);
+	t.prevTime = t.curTime;
+	t.curTime = now;
+	const uint64_t gen = ++t.parses;
+
+	size_t line = 0;
+	for (p = eol + 1; p < end; p = eol + 1)
+	{
+		eol = static_cast<const char *>(memchr(p, '\n', end - p));
+		if (!eol)
+			eol = end;
+
+		const char *label = skipSpace(p, eol);
+		const char *colon = static_cast<const char *>(memchr(label, ':', eol - label));
+		if (!colon)
+			continue;
+		const size_t len = static_cast<size_t>(colon - label);
+		const size_t thisLine = line++;
+		/* 只有一列的全局计数 */
+		if (len == 3 && (memcmp(label, "ERR", 3) == 0 || memcmp(label, "MIS", 3) == 0))
+			continue;
+
+		const size_t row = rowOf(t, thisLine, label, len);
+		uint64_t *cur = t.cur.data() + row * ncpu;
+		const char *q = colon + 1;
+		size_t c = 0;
+		for (; c < ncpu && q; ++c)
+		{
+			q = parseU64(skipSpace(q, eol), eol, cur[c]);
+		}
+
+		const bool complete = q != nullptr;
+		t.valid[row] = complete && t.gen[row] != 0 && t.gen[row] + 1 == gen;
+		t.gen[row] = complete ? gen : 0;
+	}
+
+	/* 本次未出现的行不可求差 */
+	for (size_t r = 0; r < t.gen.size(); ++r)
+	{
+		if (t.gen[r] != gen)
+			t.valid[r] = 0;
+	}
+	return 0;
+}
+
+void CIrqModule::submit(const Table &t, const char *type)
+{
+	if (!t.prevTime || t.curTime <= t.prevTime)
+		return;
+	const double dt = CDTIME_T_TO_DOUBLE(t.curTime - t.prevTime);
+	const size_t ncpu = t.cpus.size();
+	const size_t rows = t.labels.size();
+
+	/* 各行本周期总次数，计数回绕的单元按 0 计 */
+	m_total.assign(rows, 0.0);
+	m_order.clear();
+	for (size_t r = 0; r < rows; ++r)
+	{
+		if (!t.valid[r])
+			continue;
+		const uint64_t *cur = t.cur.data() + r * ncpu;
+		const uint64_t *prev = t.prev.data() + r * ncpu;
+		uint64_t sum = 0;
+		for (size_t c = 0; c < ncpu; ++c)
+		{
+			sum += cur[c] >= prev[c] ? cur[c] - prev[c] : 0;
+		}
+		m_total[r] = static_cast<double>(sum);
+		/* 只取最忙的 N 行时，本周期没有中断的行不占名额 */
+		if (m_topN == 0 || sum > 0)
+			m_order.push_back(r);
+	}
+	if (m_topN > 0 && m_order.size() > m_topN)
+	{
+		std::nth_element(m_order.begin(), m_order.begin() + m_topN, m_order.end(),
+		                 [this](size_t a, size_t b) { return m_total[a] > m_total[b]; });
+		m_order.resize(m_topN);
+	}
+
+	value_t value;
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = &value;
+	vl.values_len = 1;
+	sstrncpy(vl.plugin, "irq", sizeof(vl.plugin));
+	sstrncpy(vl.type, type, sizeof(vl.type));
+
+	for (size_t r : m_order)
+	{
+		sstrncpy(vl.type_instance, t.labels[r].c_str(), sizeof(vl.type_instance));
+		if (!m_byCpu)
+		{
+			vl.plugin_instance[0] = '\0';
+			value.gauge = m_total[r] / dt;
+			PluginService::Instance().dispatchValues(&vl);
+			continue;
+		}
+
+		const uint64_t *cur = t.cur.data() + r * ncpu;
+		const uint64_t *prev = t.prev.data() + r * ncpu;
+		for (size_t c = 0; c < ncpu; ++c)
+		{
+			snprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "%d", t.cpus[c]);
+			value.gauge = cur[c] >= prev[c] ? static_cast<double>(cur[c] - prev[c]) / dt : 0.0;
+			PluginService::Instance().dispatchValues(&vl);
+		}
+	}
+}
+
+int CIrqModule::read()
+{
+	const cdtime_t now = cdtime();
+	int status = 0;
+
+	if (parseInterrupts("/proc/interrupts", now) == 0)
+		submit(m_irq, "irq_rate");
+	else
+		status = -1;
+
+	if (m_softirqs)
+	{
+		if (parseSoftirqs("/proc/softirqs", now) == 0)
+			submit(m_softirq, "softirq_rate");
+		else
+			status = -1;
+	}
+	return status;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CIrqModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != NULL);
+
+	delete pUserModule;
+	pUserModule = NULL;
+}
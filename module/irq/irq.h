@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ModuleBase.h"
+
+/*
+ * 中断分布：解析 /proc/interrupts 与 /proc/softirqs（每行一个中断源、每列一个 CPU），
+ * 按两次采样之差上报每秒次数：
+ *   irq_rate-<中断号或名称>       plugin_instance 为 CPU 编号   GAUGE
+ *   softirq_rate-<NET_RX 等>       plugin_instance 为 CPU 编号   GAUGE
+ * ReportByCpu 为 false 时改为各行在全部 CPU 上的总和（plugin_instance 为空）。
+ * ERR、MIS 等只有一列的全局计数不上报。
+ *
+ * 计数按行优先存放在平铺矩阵中（行 × CPU 列），行号即缓存下标，
+ * 中断源增减或 CPU 热插拔时按表头重建；两个文件经 ProcfsCache 读取，缓冲全部复用。
+ *
+ * TopN > 0 时每个文件只上报本周期总次数最多的 N 行（不含本周期为 0 的行），限制多核主机上的序列数。
+ *
+ * 配置示例：
+ *   <Plugin irq>
+ *     ReportByCpu true
+ *     Softirqs true
+ *     TopN 16          # 0 表示全部上报
+ *   </Plugin>
+ */
+class CIrqModule final : public CAbstractUserModule
+{
+public:
+	CIrqModule() = default;
+	~CIrqModule() override = default;
+
+	int config(const std::string &key, const std::string &val) override;
+	int read() override;
+
+	/* 解析 /proc/interrupts 与 /proc/softirqs 格式文件并暂存计数（不提交），bench 亦直接调用 */
+	int parseInterrupts(const char *path, cdtime_t now) { return parse(m_irq, path, now); }
+	int parseSoftirqs(const char *path, cdtime_t now) { return parse(m_softirq, path, now); }
+
+private:
+	struct Table
+	{
+		std::vector<int> cpus;                 ///< 表头中的 CPU 编号（离线 CPU 不出现）
+		std::vector<std::string> labels;       ///< 每行的中断源
+		std::vector<uint64_t> cur;             ///< rows × cpus，行优先
+		std::vector<uint64_t> prev;
+		std::vector<uint64_t> gen;             ///< 每行最近一次被解析时的 parses
+		std::vector<uint8_t> valid;            ///< 本次与上次解析都有该行，可求差
+		std::vector<size_t> lineSlot;          ///< 第 n 个数据行对应的行下标
+		std::unordered_map<std::string, size_t> index;
+		uint64_t parses = 0;
+		cdtime_t curTime = 0;
+		cdtime_t prevTime = 0;
+	};
+
+	int parse(Table &t, const char *path, cdtime_t now);
+	size_t rowOf(Table &t, size_t line, const char *label, size_t len);
+	void submit(const Table &t, const char *type);
+
+	bool m_byCpu = true;
+	bool m_softirqs = true;
+	size_t m_topN = 0;
+
+	Table m_irq;
+	Table m_softirq;
+
+	/* submit 复用的临时缓冲 */
+	std::vector<double> m_total;
+	std::vector<size_t> m_order;
+	std::vector<int> m_header;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+
+#ifdef __cplusplus
+};
+#endif
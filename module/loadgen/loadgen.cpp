@@ -0,0 +1,319 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cassert>
+#include <chrono>
+#include <algorithm>
+
+#include "loadgen.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/utils/utils.h"
+#include "../oconfig/configfile.h"
+
+namespace
+{
+	const char *const kSummaryInstance = "summary";
+
+	/* 单次调度最多提交的序列数，保证 shutdown 能及时生效 */
+	const uint64_t kMaxBurst = 65536;
+
+	uint64_t splitmix64(uint64_t x)
+	{
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+
+	int parseDsType(const std::string &val)
+	{
+		if (val == "gauge")    return DS_TYPE_GAUGE;
+		if (val == "derive")   return DS_TYPE_DERIVE;
+		if (val == "counter")  return DS_TYPE_COUNTER;
+		if (val == "absolute") return DS_TYPE_ABSOLUTE;
+		return -1;
+	}
+}
+
+int CLoadgenModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Series")
+	{
+		m_series = strtoull(val.c_str(), nullptr, 10);
+		if (m_series == 0)
+		{
+			ERROR("loadgen plugin: Series must be positive.");
+			return -1;
+		}
+	}
+	else if (key == "ValuesPerSeries")
+	{
+		m_valuesPerSeries = strtoul(val.c_str(), nullptr, 10);
+		if (m_valuesPerSeries == 0)
+		{
+			ERROR("loadgen plugin: ValuesPerSeries must be positive.");
+			return -1;
+		}
+	}
+	else if (key == "DataSourceType")
+	{
+		m_dsType = parseDsType(val);
+		if (m_dsType < 0)
+		{
+			ERROR("loadgen plugin: unknown DataSourceType '%s'.", val.c_str());
+			return -1;
+		}
+	}
+	else if (key == "Rate")
+	{
+		m_rate = atof(val.c_str());
+		if (m_rate < 0.0)
+		{
+			ERROR("loadgen plugin: Rate must not be negative.");
+			return -1;
+		}
+	}
+	else if (key == "Seed") m_seed = strtoull(val.c_str(), nullptr, 10);
+	else if (key == "Type") m_type = val;
+	else return -1;
+
+	return 0;
+}
+
+int CLoadgenModule::resolveType()
+{
+	const data_set_t *found = nullptr;
+
+	if (!m_type.empty())
+	{
+		/* 显式指定 Type 时以 types.db 的定义为准 */
+		found = ConfigManager::Instance().GetDataSetByName(m_type);
+		if (!found)
+		{
+			ERROR("loadgen plugin: type '%s' not found in types.db.", m_type.c_str());
+			return -1;
+		}
+	}
+	else
+	{
+		/* 单值时优先使用与数据源类型同名的通用类型（gauge/derive/counter/absolute） */
+		if (m_valuesPerSeries == 1)
+			found = ConfigManager::Instance().GetDataSetByName(DS_TYPE_TO_STRING(m_dsType));
+
+		for (const auto &ds : ConfigManager::Instance().GetTypeDataSets())
+		{
+			if (found)
+				break;
+			if (ds.ds_num != m_valuesPerSeries)
+				continue;
+			bool same = true;
+			for (size_t i = 0; i < ds.ds_num && same; ++i)
+			{
+				same = (ds.ds[i].type == m_dsType);
+			}
+			if (same)
+				found = &ds;
+		}
+		if (!found)
+		{
+			ERROR("loadgen plugin: no type in types.db has %zu %s value(s); set Type explicitly.",
+			      m_valuesPerSeries, DS_TYPE_TO_STRING(m_dsType));
+			return -1;
+		}
+	}
+
+	m_type = found->type;
+	m_dsTypes.clear();
+	for (size_t i = 0; i < found->ds_num; ++i)
+	{
+		m_dsTypes.push_back(found->ds[i].type);
+	}
+	m_values.assign(m_dsTypes.size(), value_t{});
+	return 0;
+}
+
+int CLoadgenModule::init()
+{
+	if (resolveType() != 0)
+		return -1;
+
+	INFO("loadgen plugin: %llu series of type '%s' (%zu value(s))",
+	     static_cast<unsigned long long>(m_series), m_type.c_str(), m_dsTypes.size());
+
+	if (m_rate > 0.0)
+	{
+		INFO("loadgen plugin: pacing at %.0f series/s", m_rate);
+		m_running.store(true);
+		m_pacer = std::thread(&CLoadgenModule::pacerLoop, this);
+	}
+	return 0;
+}
+
+void CLoadgenModule::generateValues(uint64_t series, uint64_t seq, value_t *values) const
+{
+	for (size_t i = 0; i < m_dsTypes.size(); ++i)
+	{
+		const uint64_t h = splitmix64(m_seed ^ (series << 20) ^ (seq << 4) ^ i);
+		switch (m_dsTypes[i])
+		{
+		case DS_TYPE_GAUGE:
+			/* [0, 100) 区间内的伪随机值 */
+			values[i].gauge = (h >> 11) * (100.0 / 9007199254740992.0);
+			break;
+		case DS_TYPE_DERIVE:
+			values[i].derive = static_cast<derive_t>(seq * (series % 97 + 1) * (i + 1));
+			break;
+		case DS_TYPE_COUNTER:
+			values[i].counter = static_cast<counter_t>(seq * (series % 97 + 1) * (i + 1));
+			break;
+		case DS_TYPE_ABSOLUTE:
+			values[i].absolute = static_cast<absolute_t>(h % 1000);
+			break;
+		}
+	}
+}
+
+uint64_t CLoadgenModule::submitSeries(uint64_t count)
+{
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = m_values.data();
+	vl.values_len = m_values.size();
+	sstrncpy(vl.plugin, "loadgen", sizeof(vl.plugin));
+	sstrncpy(vl.type, m_type.c_str(), sizeof(vl.type));
+
+	uint64_t failed = 0;
+	for (uint64_t n = 0; n < count; ++n)
+	{
+		generateValues(m_cursor, m_round, vl.values);
+		snprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "s%llu",
+		         static_cast<unsigned long long>(m_cursor));
+		vl.time = cdtime();
+
+		if (PluginService::Instance().dispatchValues(&vl) != 0)
+			++failed;
+
+		if (++m_cursor == m_series)
+		{
+			m_cursor = 0;
+			++m_round;
+		}
+	}
+
+	m_sent.fetch_add(count - failed, std::memory_order_relaxed);
+	m_failed.fetch_add(failed, std::memory_order_relaxed);
+	return failed;
+}
+
+void CLoadgenModule::pacerLoop()
+{
+	using namespace std::chrono;
+
+	const auto start = steady_clock::now();
+	uint64_t emitted = 0;
+
+	while (m_running.load(std::memory_order_acquire))
+	{
+		const double elapsed = duration<double>(steady_clock::now() - start).count();
+		const uint64_t due = static_cast<uint64_t>(m_rate * elapsed);
+		if (due > emitted)
+		{
+			const uint64_t n = std::min(due - emitted, kMaxBurst);
+			submitSeries(n);
+			emitted += n;
+		}
+		else
+		{
+			std::this_thread::sleep_for(milliseconds(1));
+		}
+	}
+}
+
+int CLoadgenModule::write(const data_set_t * /*ds*/, const value_list_t *vl)
+{
+	if (strcmp(vl->plugin, "loadgen") != 0 || strcmp(vl->plugin_instance, kSummaryInstance) == 0)
+		return 0;
+
+	const cdtime_t now = cdtime();
+	const uint64_t ns = (now > vl->time) ? CDTIME_T_TO_NS(now - vl->time) : 0;
+	m_latency.record(ns, true);
+	m_received.fetch_add(1, std::memory_order_relaxed);
+	return 0;
+}
+
+void CLoadgenModule::submitGauge(const char *type, const char *typeInstance,
+                                 gauge_t value, cdtime_t now)
+{
+	value_list_t vl = VALUE_LIST_INIT;
+	value_t tmp = {.gauge = value};
+
+	vl.values = &tmp;
+	vl.values_len = 1;
+	vl.time = now;
+
+	sstrncpy(vl.plugin, "loadgen", sizeof(vl.plugin));
+	sstrncpy(vl.plugin_instance, kSummaryInstance, sizeof(vl.plugin_instance));
+	sstrncpy(vl.type, type, sizeof(vl.type));
+	sstrncpy(vl.type_instance, typeInstance, sizeof(vl.type_instance));
+
+	PluginService::Instance().dispatchValues(&vl);
+}
+
+void CLoadgenModule::submitSummary(cdtime_t now)
+{
+	const LatencySummary s = m_latency.deltaSince(m_lastLatency);
+	const uint64_t sent = m_sent.load(std::memory_order_relaxed);
+	const uint64_t received = m_received.load(std::memory_order_relaxed);
+
+	if (m_lastTime != 0 && now > m_lastTime)
+	{
+		const double elapsed = CDTIME_T_TO_DOUBLE(now - m_lastTime);
+		const double sentRate = (sent - m_lastSent) / elapsed;
+		const double recvRate = (received - m_lastReceived) / elapsed;
+
+		submitGauge("operations_per_second", "sent", sentRate, now);
+		submitGauge("operations_per_second", "received", recvRate, now);
+		submitGauge("latency", "avg", s.average(), now);
+		submitGauge("latency", "max", s.maxNs / 1e9, now);
+		submitGauge("latency", "p50", s.quantile(0.50), now);
+		submitGauge("latency", "p90", s.quantile(0.90), now);
+		submitGauge("latency", "p99", s.quantile(0.99), now);
+		submitGauge("count", "failed",
+		            static_cast<gauge_t>(m_failed.exchange(0, std::memory_order_relaxed)), now);
+
+		INFO("loadgen plugin: sent %.0f/s received %.0f/s, latency avg %.3fms p50 %.3fms p99 %.3fms max %.3fms",
+		     sentRate, recvRate, s.average() * 1e3, s.quantile(0.50) * 1e3,
+		     s.quantile(0.99) * 1e3, s.maxNs / 1e6);
+	}
+
+	m_lastSent = sent;
+	m_lastReceived = received;
+	m_lastTime = now;
+}
+
+int CLoadgenModule::read()
+{
+	if (m_rate <= 0.0)
+		submitSeries(m_series);
+
+	submitSummary(cdtime());
+	return 0;
+}
+
+int CLoadgenModule::shutdown()
+{
+	m_running.store(false, std::memory_order_release);
+	if (m_pacer.joinable())
+		m_pacer.join();
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CLoadgenModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != nullptr);
+	delete pUserModule;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ModuleBase.h"
+#include "../daemon/SelfStats.h"
+
+/*
+ * 合成负载生成器：按配置的序列数 / 每序列值个数 / 数据源类型 / 速率
+ * 生成确定性样本并经 PluginService::dispatchValues 提交，
+ * 同时作为 writer 统计样本从提交到 writer 收到的端到端延迟。
+ *
+ * 配置示例：
+ *   <Plugin loadgen>
+ *     Series 10000
+ *     ValuesPerSeries 2
+ *     DataSourceType "derive"
+ *     Rate 50000          # 每秒提交的序列数，0 表示每个 Interval 全量提交一次
+ *     Seed 1
+ *   </Plugin>
+ *
+ * 未配置 Type 时，从 types.db 中选取第一个值个数与数据源类型都匹配的类型；
+ * 多值序列通常需要显式指定 Type（如 ps_disk_ops 为 2 个 derive）。
+ * 若过滤链把样本路由到指定 writer，需把 loadgen 也加入路由才能统计延迟。
+ */
+class CLoadgenModule final : public CAbstractUserModule
+{
+public:
+	CLoadgenModule() = default;
+	~CLoadgenModule() override = default;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int read() override;
+	int write(const data_set_t *ds, const value_list_t *vl) override;
+	int shutdown() override;
+
+private:
+	int resolveType();
+	/* 从游标处起提交 count 个序列，返回提交失败的个数 */
+	uint64_t submitSeries(uint64_t count);
+	void generateValues(uint64_t series, uint64_t seq, value_t *values) const;
+	void pacerLoop();
+	void submitSummary(cdtime_t now);
+	void submitGauge(const char *type, const char *typeInstance, gauge_t value, cdtime_t now);
+
+	/* 配置 */
+	uint64_t m_series{100};
+	size_t m_valuesPerSeries{1};
+	int m_dsType{DS_TYPE_GAUGE};
+	double m_rate{0.0};
+	uint64_t m_seed{1};
+	std::string m_type;
+
+	/* init 时由 types.db 解析出的各数据源类型，及提交用的值缓冲 */
+	std::vector<int> m_dsTypes;
+	std::vector<value_t> m_values;
+
+	/* 每个序列已提交的轮次，用于生成确定性的值 */
+	uint64_t m_round{0};
+	uint64_t m_cursor{0};
+
+	std::thread m_pacer;
+	std::atomic<bool> m_running{false};
+
+	std::atomic<uint64_t> m_sent{0};
+	std::atomic<uint64_t> m_failed{0};
+	std::atomic<uint64_t> m_received{0};
+	LatencyHistogram m_latency;
+	LatencySummary m_lastLatency;
+
+	uint64_t m_lastSent{0};
+	uint64_t m_lastReceived{0};
+	cdtime_t m_lastTime{0};
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+	
+#ifdef __cplusplus
+};
+#endif
@@ -4,9 +4,12 @@
 #include <time.h>
 #include <sstream>
 #include <mutex>
+#include <cstring>
+#include <cerrno>
 
 #include "logfile.h"
 #include "../daemon/PluginService.h"
+#include "../daemon/QuantileSketch.h"
 #include "../oconfig/configfile.h"
 
 int CLogfileModule::config(const std::string &key, const std::string &val)
@@ -46,6 +49,42 @@ int CLogfileModule::read()
 	return 0;
 }
 
+namespace
+{
+	/* 追加一行到 BaseDir/collect_data.log，线程安全 */
+	int appendLine(const std::string &line)
+	{
+		const std::string baseDir = ConfigManager::Instance().GetGlobalOption("BaseDir");
+		if (baseDir.empty())
+		{
+			ERROR("logfile: BaseDir未配置");
+			return -1;
+		}
+		const std::string logfile = baseDir + "/collect_data.log";
+
+		static std::mutex ioMtx;
+		std::lock_guard<std::mutex> lock(ioMtx);
+
+		FILE *fp = fopen(logfile.c_str(), "a");
+		if (!fp)
+		{
+			ERROR("logfile: 无法打开文件 %s: %s", logfile.c_str(), strerror(errno));
+			return -1;
+		}
+
+		fprintf(fp, "%s\n", line.c_str());
+		fclose(fp);
+		return 0;
+	}
+
+	void formatTime(time_t t, char *buf, size_t len)
+	{
+		struct tm timeinfo;
+		localtime_r(&t, &timeinfo);
+		strftime(buf, len, "%Y-%m-%d %H:%M:%S", &timeinfo);
+	}
+}
+
 int CLogfileModule::write(const data_set_t *ds, const value_list_t *vl)
 {
 	if (!ds || !vl || 0 != strcmp(ds->type, vl->type))
@@ -55,23 +94,9 @@ int CLogfileModule::write(const data_set_t *ds, const value_list_t *vl)
 		return -1;
 	}
 
-	// 获取基础路径
-	const std::string baseDir = ConfigManager::Instance().GetGlobalOption("BaseDir");
-	if (baseDir.empty())
-	{
-		ERROR("logfile: BaseDir未配置");
-		return -1;
-	}
-
-	// 创建日志文件路径
-	const std::string logfile = baseDir + "/collect_data.log";
-
 	// 获取当前时间格式化
-	std::time_t rawtime = time(nullptr);
-	struct tm timeinfo;
-	localtime_r(&rawtime, &timeinfo);
 	char timestr[64];
-	strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", &timeinfo);
+	formatTime(time(nullptr), timestr, sizeof(timestr));
 
 	// 创建日志行
 	std::ostringstream oss;
@@ -113,26 +138,38 @@ int CLogfileModule::write(const data_set_t *ds, const value_list_t *vl)
 			case DS_TYPE_ABSOLUTE:
 				oss << static_cast<uint64_t>(val.absolute);
 				break;
+			case DS_TYPE_SKETCH:
+				if (val.sketch)
+					oss << "{count=" << val.sketch->count() << " p50=" << val.sketch->quantile(0.5)
+					    << " p90=" << val.sketch->quantile(0.9) << " p99=" << val.sketch->quantile(0.99)
+					    << " max=" << val.sketch->max() << "}";
+				else
+					oss << "{}";
+				break;
 			default:
 				oss << "未知类型";
 		}
 	}
 
-	// 线程安全写入文件
-	static std::mutex ioMtx;
-	std::lock_guard<std::mutex> lock(ioMtx);
-	
-	FILE *fp = fopen(logfile.c_str(), "a");
-	if (!fp)
-	{
-		ERROR("logfile: 无法打开文件 %s: %s", logfile.c_str(), strerror(errno));
+	return appendLine(oss.str());
+}
+
+int CLogfileModule::notification(const notification_t *n)
+{
+	if (!n)
 		return -1;
-	}
 
-	fprintf(fp, "%s\n", oss.str().c_str());
-	fclose(fp);
-	
-	return 0;
+	char timestr[64];
+	formatTime(CDTIME_T_TO_TIME_T(n->time ? n->time : cdtime()), timestr, sizeof(timestr));
+
+	const char *severity = n->severity == NOTIF_FAILURE ? "FAILURE"
+	                     : n->severity == NOTIF_WARNING ? "WARNING"
+	                     : n->severity == NOTIF_OKAY    ? "OKAY"
+	                                                    : "UNKNOWN";
+
+	std::ostringstream oss;
+	oss << timestr << " Notification: severity = " << severity << ", message = " << n->message;
+	return appendLine(oss.str());
 }
 
 CAbstractUserModule *CreateModule()
@@ -14,8 +14,12 @@ public:
 
 	int read();
 
+	int write(const data_set_t *ds, const value_list_t *vl);
+
 	int flush();
 
+	int notification(const notification_t *n);
+
 private:
 };
 
@@ -9,6 +9,7 @@
 #include "memory.h"
 #include "../daemon/utils/utils.h"
 #include "../daemon/PluginService.h"
+#include "../daemon/ProcfsCache.h"
 #include "../oconfig/configfile.h"
 
 static constexpr char const *OUTPUT_FILENAME = "mmz_info.txt";
@@ -56,95 +57,91 @@ int CMemoryModule::config(const std::string& key, const std::string& val)
 	return 0;
 }
 
-bool CMemoryModule::parseLine(const std::string &line, const char *key_to_match, gauge_t &target_value_ref)
+bool CMemoryModule::parseLine(std::string_view line, const char *key_to_match, gauge_t &target_value_ref)
 {
-	if (line.rfind(key_to_match, 0) == 0)
+	const char *p = line.data();
+	const char *end = p + line.size();
+	const char *key = key_to_match;
+	while (*key && p < end && *p == *key)
 	{
-		size_t colon_pos = line.find(':');
-		if (colon_pos == std::string::npos)
-		{
-			return false;
-		}
-
-		// 从冒号后开始查找第一个非空字符作为数值的开始
-		size_t value_start_pos = line.find_first_not_of(" \t", colon_pos + 1);
-		if (value_start_pos == std::string::npos)
-		{
-			return false; // 冒号后全是空格或没有内容
-		}
-
-		// 从数值开始处查找第一个空白字符作为数值的结束
-		size_t value_end_pos = line.find_first_of(" \t", value_start_pos);
-		std::string value_str;
-		if (value_end_pos == std::string::npos)
-		{
-			value_str = line.substr(value_start_pos);
-		}
-		else
-		{
-			value_str = line.substr(value_start_pos, value_end_pos - value_start_pos);
-		}
+		++p;
+		++key;
+	}
+	if (*key)
+	{
+		return false;
+	}
 
-		if (value_str.empty())
-			return false;
+	// 跳过键名后的空白，取连续数字（单位 kB）
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++p;
 
-		try
-		{
-			target_value_ref = std::stod(value_str) * 1024.0; // 转换为字节
-			return true;
-		}
-		catch (const std::invalid_argument &ia)
-		{
-			WARNING("Failed to parse numeric value for key '%s' from substring '%s'. Invalid argument: %s", key_to_match, value_str.c_str(), ia.what());
-		}
-		catch (const std::out_of_range &oor)
-		{
-			WARNING("Numeric value out of range for key '%s' from substring '%s'. Out of range: %s", key_to_match, value_str.c_str(), oor.what());
-		}
+	const char *value_start = p;
+	uint64_t value = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		value = value * 10 + static_cast<uint64_t>(*p - '0');
+		++p;
+	}
+	if (p == value_start)
+	{
+		WARNING("Failed to parse numeric value for key '%s'.", key_to_match);
 		return false;
 	}
-	return false;
+
+	target_value_ref = static_cast<gauge_t>(value) * 1024.0; // 转换为字节
+	return true;
 }
 
-bool CMemoryModule::parseMemInfo(ParsedMemInfo &data_out)
+bool CMemoryModule::parseMemInfo(const char *path, ParsedMemInfo &data_out)
 {
-	std::ifstream meminfo_file("/proc/meminfo");
-	if (!meminfo_file.is_open())
+	ProcfsSnapshot snap;
+	const int status = ProcfsCache::Instance().get(path, snap);
+	if (status != 0)
 	{
-		ERROR("Failed to open /proc/meminfo: %s", strerror(errno));
+		ERROR("Failed to open %s: %s", path, strerror(status));
 		return false;
 	}
+	const std::string_view text = snap.view();
 
 	data_out = ParsedMemInfo{};
 
-	std::string current_line;
-	while (std::getline(meminfo_file, current_line))
+	// 所需字段都在文件前部，全部取到即停止
+	int remaining = 8;
+	size_t line_start = 0;
+	while (line_start < text.size() && remaining > 0)
 	{
+		size_t line_end = text.find('\n', line_start);
+		if (line_end == std::string_view::npos)
+			line_end = text.size();
+		const std::string_view current_line = text.substr(line_start, line_end - line_start);
+		line_start = line_end + 1;
+
 		if (parseLine(current_line, "MemTotal:", data_out.mem_total))
-			continue;
+			--remaining;
 		else if (parseLine(current_line, "MemFree:", data_out.mem_free))
-			continue;
+			--remaining;
 		else if (parseLine(current_line, "Buffers:", data_out.mem_buffered))
-			continue;
+			--remaining;
 		else if (parseLine(current_line, "Cached:", data_out.mem_cached))
-			continue;
+			--remaining;
 		else if (parseLine(current_line, "Slab:", data_out.mem_slab_total))
-			continue;
+			--remaining;
 		else if (parseLine(current_line, "SReclaimable:", data_out.mem_slab_reclaimable))
 		{
 			data_out.detailed_slab_info_present = true; // 标记Slab详细信息存在
-			continue;
+			--remaining;
 		}
 		else if (parseLine(current_line, "SUnreclaim:", data_out.mem_slab_unreclaimable))
 		{
 			// SReclaimable 和 SUnreclaim 通常一起出现，所以设置 detailed_slab_info_present 是合理的
 			data_out.detailed_slab_info_present = true;
-			continue;
+			--remaining;
 		}
 		else if (parseLine(current_line, "MemAvailable:", data_out.mem_available))
 		{
 			data_out.mem_available_info_present = true; // 标记MemAvailable信息存在
-			continue;
+			--remaining;
 		}
 	}
 
@@ -233,7 +230,7 @@ int CMemoryModule::read()
 	INFO("Memory read() method called.");
 	ParsedMemInfo current_mem_data;
 
-	if (!parseMemInfo(current_mem_data))
+	if (!parseMemInfo("/proc/meminfo", current_mem_data))
 	{
 		ERROR("Failed to parse memory information from /proc/meminfo.");
 		return -1;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "ModuleBase.h"
@@ -34,10 +35,12 @@ public:
 	int config(const std::string& key,
  			   const std::string& val)    override;
 
+	/* 解析 /proc/meminfo 格式文件，bench 亦直接调用 */
+	bool parseMemInfo(const char *path, ParsedMemInfo &data_out);
+
 private:
-	bool parseMemInfo(ParsedMemInfo &data_out);
 
-	bool parseLine(const std::string &line, const char *key_to_match, gauge_t &target_value_ref);
+	bool parseLine(std::string_view line, const char *key_to_match, gauge_t &target_value_ref);
 
 	void submitAvailableMetric(gauge_t mem_available_value);
 
@@ -1,18 +1,82 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "ModuleBase.h"
 
+/*
+ * 网络状态：
+ * read()  经 NETLINK_SOCK_DIAG 一次性转储全部 TCP 套接字（IPv4 + IPv6），不 fork netstat，上报 GAUGE：
+ *   tcp_connections-<状态>                  各状态套接字数（ESTABLISHED、TIME_WAIT 等）
+ *   tcp_connections-total / <状态>           plugin_instance 为 "port-<本地端口>"，只取套接字最多的 TopPorts 个端口
+ *   tcp_retrans-sockets                      正处于超时重传中的连接数
+ *   tcp_rtt-lt1ms / lt10ms / lt100ms / lt1s / ge1s   ESTABLISHED 连接按平滑 RTT 分桶的连接数
+ * 以及 DERIVE：
+ *   derive-tcp_retrans_segs                  全机累计重传段数（/proc/net/snmp 的 Tcp: RetransSegs）
+ * flush() 把接口、地址、路由、DNS、套接字列表（netstat -anp）与 ARP 写入 BaseDir/network_status.txt，
+ *   另附一节 sock_diag 取得的 TCP / UDP 套接字 RTT 与重传。
+ *
+ * 配置示例：
+ *   <Plugin network>
+ *     SocketSummary true   # false 时 read() 不采集
+ *     TopPorts 10          # 0 表示不按端口上报
+ *   </Plugin>
+ */
 class CNetworkModule final : public CAbstractUserModule
 {
 public:
 	CNetworkModule() = default;
-	~CNetworkModule() override = default;
+	~CNetworkModule() override;
 
 	int config(const std::string &key, const std::string &val);
+	int read() override;
+	int shutdown() override;
 
 	int flush();
 
+	/* 一个 TCP / UDP 套接字的摘要 */
+	struct InetSock
+	{
+		uint8_t protocol = 0;
+		uint8_t family = 0;
+		uint8_t state = 0;
+		uint16_t localPort = 0;
+		uint16_t remotePort = 0;
+		uint32_t localAddr[4] = {};
+		uint32_t remoteAddr[4] = {};
+		uint32_t uid = 0;
+		uint32_t inode = 0;
+		bool hasInfo = false;   ///< TIME_WAIT、半连接等没有 tcp_info
+		uint32_t rttUs = 0;
+		uint32_t retransmits = 0;
+		uint32_t totalRetrans = 0;
+	};
+
+	/* 经 sock_diag 转储某协议（IPPROTO_TCP / IPPROTO_UDP）的全部套接字到 out（先清空），返回 0 或 errno */
+	static int dumpSockets(int fd, uint8_t protocol, std::vector<InetSock> &out, std::vector<char> &buf);
+
 private:
+	struct PortStat
+	{
+		uint32_t total = 0;
+		uint32_t states[16] = {};
+	};
+
+	void submitSummary();
+
+	bool m_socketSummary = true;
+	size_t m_topPorts = 10;
+
+	int m_diagFd = -1;
+
+	/* read() 复用的缓冲 */
+	std::vector<InetSock> m_socks;
+	std::vector<char> m_recvBuf;
+	std::unordered_map<uint16_t, PortStat> m_ports;
+	std::vector<uint16_t> m_order;
 };
 
 #ifdef __cplusplus
@@ -26,4 +90,3 @@ extern "C"
 #ifdef __cplusplus
 };
 #endif
-
@@ -0,0 +1,396 @@
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "network_in.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/utils/utils.h"
+#include "../oconfig/configfile.h"
+
+namespace
+{
+	/* 单个 TCP 连接允许积压的未成帧数据上限 */
+	const size_t kMaxPending = 2 * VC_MAX_FRAME;
+
+	/* 对端地址的数字形式；IPv4 映射的 IPv6 地址还原为点分形式 */
+	void peerName(const struct sockaddr *sa, socklen_t len, std::string &out)
+	{
+		char host[NI_MAXHOST];
+		if (getnameinfo(sa, len, host, sizeof(host), nullptr, 0, NI_NUMERICHOST) != 0)
+		{
+			out = "unknown";
+			return;
+		}
+		out = strncmp(host, "::ffff:", 7) == 0 && strchr(host + 7, '.') ? host + 7 : host;
+	}
+}
+
+CNetworkInModule::~CNetworkInModule()
+{
+	shutdown();
+}
+
+int CNetworkInModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Listen")
+	{
+		m_listen = val;
+	}
+	else if (key == "Port")
+	{
+		m_port = val;
+	}
+	else if (key == "Protocol")
+	{
+		if (val != "udp" && val != "tcp")
+		{
+			ERROR("network_in plugin: Protocol must be \"udp\" or \"tcp\".");
+			return -1;
+		}
+		m_tcp = (val == "tcp");
+	}
+	else if (key == "TagSender")
+	{
+		m_tagSender = IS_TRUE(val.c_str());
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+int CNetworkInModule::listenOn()
+{
+	struct addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = m_tcp ? SOCK_STREAM : SOCK_DGRAM;
+	hints.ai_flags = AI_PASSIVE;
+	struct addrinfo *res = nullptr;
+	int status = getaddrinfo(m_listen.empty() ? nullptr : m_listen.c_str(),
+	                         m_port.c_str(), &hints, &res);
+	if (status != 0)
+	{
+		ERROR("network_in plugin: resolve %s:%s failed: %s",
+		      m_listen.c_str(), m_port.c_str(), gai_strerror(status));
+		return -1;
+	}
+
+	for (struct addrinfo *ai = res; ai; ai = ai->ai_next)
+	{
+		int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		                ai->ai_protocol);
+		if (fd < 0)
+			continue;
+
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (!m_tcp)
+		{
+			/* 突发流量时尽量少丢包 */
+			int rcvbuf = 4 * 1024 * 1024;
+			setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+		}
+
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+		    (!m_tcp || listen(fd, 128) == 0))
+		{
+			m_fd = fd;
+			break;
+		}
+		close(fd);
+	}
+	freeaddrinfo(res);
+
+	if (m_fd < 0)
+	{
+		ERROR("network_in plugin: listen %s:%s failed: %s",
+		      m_listen.c_str(), m_port.c_str(), strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+int CNetworkInModule::init()
+{
+	if (listenOn() != 0)
+		return -1;
+
+	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_epollFd < 0 || m_wakeFd < 0)
+	{
+		ERROR("network_in plugin: epoll setup failed: %s", strerror(errno));
+		shutdown();
+		return -1;
+	}
+
+	struct epoll_event ev{};
+	ev.events = EPOLLIN;
+	ev.data.fd = m_fd;
+	epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_fd, &ev);
+	ev.data.fd = m_wakeFd;
+	epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev);
+
+	if (!m_tcp)
+	{
+		m_bufs.resize(static_cast<size_t>(kBatch) * kDatagramSize);
+		for (int i = 0; i < kBatch; ++i)
+		{
+			m_iovs[i].iov_base = m_bufs.data() + static_cast<size_t>(i) * kDatagramSize;
+			m_iovs[i].iov_len = kDatagramSize;
+			memset(&m_msgs[i], 0, sizeof(m_msgs[i]));
+			m_msgs[i].msg_hdr.msg_name = &m_addrs[i];
+			m_msgs[i].msg_hdr.msg_iov = &m_iovs[i];
+			m_msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+	}
+
+	m_dispatch = [this](value_list_t &vl, const uint8_t *dsTypes) {
+		if (m_rejected)
+			return;
+		const data_set_t *ds = ConfigManager::Instance().GetDataSetByName(vl.type);
+		if (!vc_match_dataset(ds, vl, dsTypes))
+		{
+			/* 类型不符的值不能交给按 ds 解释 value_t 的下游 */
+			m_rejected = true;
+			return;
+		}
+		if (m_tagSender)
+			tagSender(vl);
+		m_samples.fetch_add(1, std::memory_order_relaxed);
+		PluginService::Instance().dispatchValues(&vl);
+	};
+
+	m_running.store(true);
+	m_thread = std::thread(&CNetworkInModule::serveLoop, this);
+	INFO("network_in plugin: listening on %s:%s/%s",
+	     m_listen.c_str(), m_port.c_str(), m_tcp ? "tcp" : "udp");
+	return 0;
+}
+
+void CNetworkInModule::tagSender(value_list_t &vl)
+{
+	m_instanceBuf = m_dec.host().empty() ? *m_peer : m_dec.host();
+	if (vl.plugin_instance[0] != '\0')
+		m_instanceBuf.append(1, ':').append(vl.plugin_instance);
+	sstrncpy(vl.plugin_instance, m_instanceBuf.c_str(), sizeof(vl.plugin_instance));
+}
+
+ssize_t CNetworkInModule::decodeFrames(const uint8_t *data, size_t len, const std::string &peer)
+{
+	m_peer = &peer;
+	size_t off = 0;
+	while (off < len)
+	{
+		size_t used = 0;
+		m_rejected = false;
+		int status = m_dec.decode(data + off, len - off, used, m_dispatch);
+		if (status == EAGAIN)
+			break;
+		if (status != 0 || m_rejected)
+		{
+			m_badFrames.fetch_add(1, std::memory_order_relaxed);
+			return -1;
+		}
+		m_frames.fetch_add(1, std::memory_order_relaxed);
+		off += used;
+	}
+	return static_cast<ssize_t>(off);
+}
+
+void CNetworkInModule::onDatagrams()
+{
+	for (;;)
+	{
+		for (int i = 0; i < kBatch; ++i)
+		{
+			m_msgs[i].msg_hdr.msg_namelen = sizeof(m_addrs[i]);
+		}
+		int n = recvmmsg(m_fd, m_msgs, kBatch, MSG_DONTWAIT, nullptr);
+		if (n < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				WARNING("network_in plugin: recvmmsg failed: %s", strerror(errno));
+			return;
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			const uint8_t *p = static_cast<const uint8_t *>(m_iovs[i].iov_base);
+			const size_t len = m_msgs[i].msg_len;
+			if (m_tagSender)
+				peerName(reinterpret_cast<const struct sockaddr *>(&m_addrs[i]), m_msgs[i].msg_hdr.msg_namelen, m_peerBuf);
+			/* 数据报应恰好包含整帧，残缺即视为坏帧 */
+			ssize_t used = decodeFrames(p, len, m_peerBuf);
+			if (used >= 0 && static_cast<size_t>(used) != len)
+				m_badFrames.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		if (n < kBatch)
+			return;
+	}
+}
+
+void CNetworkInModule::onAccept()
+{
+	for (;;)
+	{
+		struct sockaddr_storage addr;
+		socklen_t addrLen = sizeof(addr);
+		int fd = accept4(m_fd, reinterpret_cast<struct sockaddr *>(&addr), &addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+
+		struct epoll_event ev{};
+		ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.fd = fd;
+		if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+		{
+			close(fd);
+			continue;
+		}
+		peerName(reinterpret_cast<const struct sockaddr *>(&addr), addrLen, m_conns[fd].peer);
+	}
+}
+
+void CNetworkInModule::onStream(int fd, Conn &conn)
+{
+	std::string &buf = conn.buf;
+	char chunk[65536];
+	for (;;)
+	{
+		ssize_t n = ::read(fd, chunk, sizeof(chunk));
+		if (n > 0)
+		{
+			buf.append(chunk, static_cast<size_t>(n));
+			/* 边读边检查积压，对端持续发送时缓冲也不会无限增长 */
+			if (buf.size() > kMaxPending && !drainStream(fd, conn))
+				return;
+			continue;
+		}
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n < 0 && errno == EINTR)
+			continue;
+		/* 对端关闭：先处理已收到的数据 */
+		decodeFrames(reinterpret_cast<const uint8_t *>(buf.data()), buf.size(), conn.peer);
+		closeConn(fd);
+		return;
+	}
+
+	drainStream(fd, conn);
+}
+
+bool CNetworkInModule::drainStream(int fd, Conn &conn)
+{
+	std::string &buf = conn.buf;
+	ssize_t used = decodeFrames(reinterpret_cast<const uint8_t *>(buf.data()), buf.size(), conn.peer);
+	if (used < 0 || buf.size() - static_cast<size_t>(used) > kMaxPending)
+	{
+		WARNING("network_in plugin: dropping connection after a malformed or oversized frame.");
+		closeConn(fd);
+		return false;
+	}
+	buf.erase(0, static_cast<size_t>(used));
+	return true;
+}
+
+void CNetworkInModule::closeConn(int fd)
+{
+	epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+	close(fd);
+	m_conns.erase(fd);
+}
+
+void CNetworkInModule::serveLoop()
+{
+	struct epoll_event events[64];
+	while (m_running.load(std::memory_order_acquire))
+	{
+		int n = epoll_wait(m_epollFd, events, 64, -1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ERROR("network_in plugin: epoll_wait failed: %s", strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			const int fd = events[i].data.fd;
+			if (fd == m_wakeFd)
+				return;
+			if (fd == m_fd)
+			{
+				if (m_tcp)
+					onAccept();
+				else
+					onDatagrams();
+				continue;
+			}
+
+			auto it = m_conns.find(fd);
+			if (it != m_conns.end())
+				onStream(fd, it->second);
+		}
+	}
+}
+
+int CNetworkInModule::shutdown()
+{
+	if (m_running.exchange(false))
+	{
+		uint64_t one = 1;
+		if (::write(m_wakeFd, &one, sizeof(one)) < 0)
+			ERROR("network_in plugin: wake receiver thread failed: %s", strerror(errno));
+	}
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+		INFO("network_in plugin: %llu frame(s) / %llu sample(s) received, %llu bad frame(s).",
+		     static_cast<unsigned long long>(m_frames.load()),
+		     static_cast<unsigned long long>(m_samples.load()),
+		     static_cast<unsigned long long>(m_badFrames.load()));
+	}
+
+	for (auto &kv : m_conns)
+	{
+		close(kv.first);
+	}
+	m_conns.clear();
+
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+	if (m_epollFd >= 0)
+	{
+		close(m_epollFd);
+		m_epollFd = -1;
+	}
+	if (m_wakeFd >= 0)
+	{
+		close(m_wakeFd);
+		m_wakeFd = -1;
+	}
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CNetworkInModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != nullptr);
+	delete pUserModule;
+}
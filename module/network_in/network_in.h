@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "ModuleBase.h"
+#include "../daemon/ValueCodec.h"
+
+/*
+ * 二进制网络接收端：接收 network_out 发出的 ValueCodec 帧，
+ * 解码后经 dispatchValues 重新进入本机的分发队列（过滤链、各 writer）。
+ *
+ * 配置示例：
+ *   <Plugin network_in>
+ *     Listen "0.0.0.0"
+ *     Port "25826"
+ *     Protocol "udp"          # udp / tcp
+ *     TagSender true          # plugin_instance 前加 "<发送端>:"，缺省 true
+ *   </Plugin>
+ *
+ * UDP 以 recvmmsg 一次收取多个数据报；TCP 按连接缓存字节流，凑齐整帧再解码，
+ * 校验失败的 TCP 连接直接断开。
+ * 样本的值个数与类型须与本机 types.db 一致，否则丢弃该帧余下的样本并计为坏帧。
+ * 发送端标识取帧内的 Hostname，未配置时取对端 IP；多台设备的同名序列据此区分，
+ * 如 cpu/0 变为 cpu/edge-17:0（plugin_instance 为空时即为发送端标识）。
+ * 同一节点同时加载 network_out 时，应以过滤链 write target 避免回环转发。
+ */
+class CNetworkInModule final : public CAbstractUserModule
+{
+public:
+	CNetworkInModule() = default;
+	~CNetworkInModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int shutdown() override;
+
+private:
+	enum { kBatch = 32, kDatagramSize = 65536 };
+
+	struct Conn
+	{
+		std::string buf;  ///< 未成帧的字节
+		std::string peer; ///< 对端 IP
+	};
+
+	int listenOn();
+	void serveLoop();
+	void onDatagrams();
+	void onAccept();
+	void onStream(int fd, Conn &conn);
+	/* 解码连接缓冲中的整帧；帧损坏或积压超过上限时断开连接并返回 false */
+	bool drainStream(int fd, Conn &conn);
+	void closeConn(int fd);
+	/* 解码 data 中的完整帧，返回已消费字节数；出错返回 -1。peer 为无 Hostname 时的发送端标识 */
+	ssize_t decodeFrames(const uint8_t *data, size_t len, const std::string &peer);
+	/* 把发送端标识并入 plugin_instance */
+	void tagSender(value_list_t &vl);
+
+	std::string m_listen = "0.0.0.0";
+	std::string m_port = "25826";
+	bool m_tcp = false;
+	bool m_tagSender = true;
+
+	int m_fd = -1;
+	int m_epollFd = -1;
+	int m_wakeFd = -1;
+	std::unordered_map<int, Conn> m_conns;
+
+	/* recvmmsg 批量接收缓冲，仅服务线程使用 */
+	std::vector<uint8_t> m_bufs;
+	struct mmsghdr m_msgs[kBatch];
+	struct iovec m_iovs[kBatch];
+	struct sockaddr_storage m_addrs[kBatch];
+	std::string m_peerBuf;
+	std::string m_instanceBuf;
+
+	ValueDecoder m_dec;
+	ValueDecoder::Callback m_dispatch;
+	bool m_rejected = false;          ///< 当前帧出现与 types.db 不符的样本，仅服务线程使用
+	const std::string *m_peer = nullptr; ///< 当前帧的对端 IP，仅服务线程使用
+
+	std::thread m_thread;
+	std::atomic<bool> m_running{false};
+
+	std::atomic<uint64_t> m_frames{0};
+	std::atomic<uint64_t> m_samples{0};
+	std::atomic<uint64_t> m_badFrames{0};
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+	
+#ifdef __cplusplus
+};
+#endif
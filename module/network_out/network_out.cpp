@@ -0,0 +1,241 @@
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "network_out.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/utils/utils.h"
+
+namespace
+{
+	const double kReconnectDelay = 5.0;
+}
+
+CNetworkOutModule::~CNetworkOutModule()
+{
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+int CNetworkOutModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Server")
+	{
+		m_server = val;
+	}
+	else if (key == "Port")
+	{
+		m_port = val;
+	}
+	else if (key == "Protocol")
+	{
+		if (val != "udp" && val != "tcp")
+		{
+			ERROR("network_out plugin: Protocol must be \"udp\" or \"tcp\".");
+			return -1;
+		}
+		m_tcp = (val == "tcp");
+	}
+	else if (key == "Hostname")
+	{
+		if (val.size() >= DATA_MAX_NAME_LEN)
+		{
+			ERROR("network_out plugin: Hostname is too long.");
+			return -1;
+		}
+		m_enc.setHost(val);
+	}
+	else if (key == "Compress")
+	{
+		m_compress = IS_TRUE(val.c_str());
+	}
+	else if (key == "MaxPacketSize" || key == "BatchSize")
+	{
+		const long n = atol(val.c_str());
+		/* 至少容纳帧头和一个样本 */
+		if (n < 512 || n > static_cast<long>(VC_MAX_FRAME))
+		{
+			ERROR("network_out plugin: %s out of range.", key.c_str());
+			return -1;
+		}
+		if (key == "MaxPacketSize")
+		{
+			if (n > 65507)
+			{
+				ERROR("network_out plugin: MaxPacketSize exceeds the UDP limit.");
+				return -1;
+			}
+			m_maxPacketSize = static_cast<size_t>(n);
+		}
+		else
+		{
+			m_batchSize = static_cast<size_t>(n);
+		}
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+int CNetworkOutModule::connectSocket()
+{
+	struct addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = m_tcp ? SOCK_STREAM : SOCK_DGRAM;
+	struct addrinfo *res = nullptr;
+	int status = getaddrinfo(m_server.c_str(), m_port.c_str(), &hints, &res);
+	if (status != 0)
+	{
+		ERROR("network_out plugin: resolve %s:%s failed: %s",
+		      m_server.c_str(), m_port.c_str(), gai_strerror(status));
+		return -1;
+	}
+
+	for (struct addrinfo *ai = res; ai; ai = ai->ai_next)
+	{
+		int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+
+		/* 发送超时，避免对端卡住时阻塞分发线程 */
+		struct timeval tv = {1, 0};
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+		{
+			m_fd = fd;
+			break;
+		}
+		close(fd);
+	}
+	freeaddrinfo(res);
+
+	if (m_fd < 0)
+	{
+		WARNING("network_out plugin: connect %s:%s failed: %s",
+		        m_server.c_str(), m_port.c_str(), strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+int CNetworkOutModule::init()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	/* TCP 对端暂不可用不视为初始化失败，发送时再重连 */
+	if (connectSocket() != 0 && !m_tcp)
+		return -1;
+	return 0;
+}
+
+int CNetworkOutModule::sendFrame()
+{
+	if (m_enc.empty())
+		return 0;
+
+	m_frame.clear();
+	m_enc.finish(m_frame, m_compress);
+
+	if (m_fd < 0)
+	{
+		const cdtime_t now = cdtime();
+		if (now < m_nextConnect || connectSocket() != 0)
+		{
+			m_nextConnect = now + DOUBLE_TO_CDTIME_T(kReconnectDelay);
+			++m_framesDropped;
+			return -1;
+		}
+	}
+
+	size_t off = 0;
+	while (off < m_frame.size())
+	{
+		ssize_t n = send(m_fd, m_frame.data() + off, m_frame.size() - off, MSG_NOSIGNAL);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (m_tcp)
+			{
+				/* 流已不完整，只能断开重连 */
+				WARNING("network_out plugin: send failed: %s", strerror(errno));
+				close(m_fd);
+				m_fd = -1;
+				m_nextConnect = cdtime() + DOUBLE_TO_CDTIME_T(kReconnectDelay);
+			}
+			++m_framesDropped;
+			return -1;
+		}
+		off += static_cast<size_t>(n);
+	}
+
+	++m_framesSent;
+	m_bytesSent += m_frame.size();
+	return 0;
+}
+
+int CNetworkOutModule::write(const data_set_t *ds, const value_list_t *vl)
+{
+	if (!ds || !vl || ds->ds_num != vl->values_len)
+		return -1;
+
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	const size_t limit = frameLimit() - sizeof(ValueFrameHeader);
+	if (!m_enc.empty() && m_enc.estimate(ds, vl) > limit)
+		sendFrame();
+
+	if (m_enc.add(ds, vl) != 0)
+		return -1;
+
+	if (m_enc.size() >= limit)
+		sendFrame();
+	return 0;
+}
+
+int CNetworkOutModule::read()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	sendFrame();
+	return 0;
+}
+
+int CNetworkOutModule::flush()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	return sendFrame();
+}
+
+int CNetworkOutModule::shutdown()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	sendFrame();
+	INFO("network_out plugin: %llu frame(s) / %llu byte(s) sent, %llu frame(s) dropped.",
+	     static_cast<unsigned long long>(m_framesSent),
+	     static_cast<unsigned long long>(m_bytesSent),
+	     static_cast<unsigned long long>(m_framesDropped));
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CNetworkOutModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != nullptr);
+	delete pUserModule;
+}
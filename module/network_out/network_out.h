@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "ModuleBase.h"
+#include "../daemon/ValueCodec.h"
+
+/*
+ * 二进制网络 writer：把样本批量编码成 ValueCodec 帧（驻留表 + varint + 可选 LZ4），
+ * 经 UDP 或 TCP 发往汇聚节点上的 network_in。
+ *
+ * 配置示例：
+ *   <Plugin network_out>
+ *     Server "10.0.0.1"
+ *     Port "25826"
+ *     Protocol "udp"          # udp / tcp
+ *     Hostname "edge-17"      # 帧内携带的发送端标识，缺省不带（接收端改用对端地址）
+ *     Compress true
+ *     MaxPacketSize 1452      # UDP 单包上限（负载字节）
+ *     BatchSize 65536         # TCP 单帧上限
+ *   </Plugin>
+ *
+ * 帧在达到上限或每个采集周期（read）/ flush 时发出；
+ * TCP 断开后最多每 5 秒重连一次，期间的帧被丢弃并计数。
+ */
+class CNetworkOutModule final : public CAbstractUserModule
+{
+public:
+	CNetworkOutModule() = default;
+	~CNetworkOutModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int read() override;
+	int write(const data_set_t *ds, const value_list_t *vl) override;
+	int flush() override;
+	int shutdown() override;
+
+private:
+	int connectSocket();
+	int sendFrame();
+	size_t frameLimit() const { return m_tcp ? m_batchSize : m_maxPacketSize; }
+
+	std::string m_server = "127.0.0.1";
+	std::string m_port = "25826";
+	bool m_tcp = false;
+	bool m_compress = true;
+	size_t m_maxPacketSize = 1452;
+	size_t m_batchSize = 65536;
+
+	std::mutex m_mutex;
+	ValueEncoder m_enc;
+	std::string m_frame;
+	int m_fd = -1;
+	cdtime_t m_nextConnect = 0;
+
+	uint64_t m_framesSent = 0;
+	uint64_t m_framesDropped = 0;
+	uint64_t m_bytesSent = 0;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+	
+#ifdef __cplusplus
+};
+#endif
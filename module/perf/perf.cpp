@@ -0,0 +1,474 @@
+#include <algorithm>
+#include <assert.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perf.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/utils/utils.h"
+
+namespace
+{
+	struct EventDef
+	{
+		const char *name;
+		uint32_t type;
+		uint64_t config;
+	};
+
+	/* 下标与 CPerfModule::Event 一致 */
+	const EventDef kEvents[] = {
+		{"task_clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+		{"context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+		{"cpu_migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+		{"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+		{"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		{"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	};
+
+	int perfEventOpen(struct perf_event_attr *attr, int pid, int cpu, int groupFd)
+	{
+		return static_cast<int>(syscall(__NR_perf_event_open, attr, pid, cpu, groupFd, PERF_FLAG_FD_CLOEXEC));
+	}
+
+	/* 解析 /sys/devices/system/cpu/online（如 "0-3,6"）；读取失败时按配置的 CPU 数 */
+	void onlineCpus(std::vector<int> &out)
+	{
+		out.clear();
+		char buf[1024];
+		FILE *fp = fopen("/sys/devices/system/cpu/online", "r");
+		if (fp && fgets(buf, sizeof(buf), fp))
+		{
+			const char *p = buf;
+			while (*p >= '0' && *p <= '9')
+			{
+				char *end;
+				const long first = strtol(p, &end, 10);
+				long last = first;
+				if (*end == '-')
+					last = strtol(end + 1, &end, 10);
+				for (long cpu = first; cpu <= last; ++cpu)
+				{
+					out.push_back(static_cast<int>(cpu));
+				}
+				p = (*end == ',') ? end + 1 : end;
+			}
+		}
+		if (fp)
+			fclose(fp);
+
+		if (out.empty())
+		{
+			const long cpus = sysconf(_SC_NPROCESSORS_CONF);
+			for (int cpu = 0; cpu < cpus; ++cpu)
+			{
+				out.push_back(cpu);
+			}
+		}
+	}
+}
+
+CPerfModule::~CPerfModule()
+{
+	shutdown();
+}
+
+int CPerfModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Process")
+	{
+		Target t;
+		t.name = val;
+		m_targets.push_back(t);
+	}
+	else if (key == "SystemWide")
+	{
+		m_systemWide = IS_TRUE(val.c_str());
+		m_systemWideSet = true;
+	}
+	else if (key == "Hardware")
+		m_hardware = IS_TRUE(val.c_str());
+	else if (key == "MaxThreads")
+		m_maxThreads = static_cast<unsigned>(strtoul(val.c_str(), nullptr, 10));
+	else
+		return -1;
+	return 0;
+}
+
+void CPerfModule::closeGroup(Group &g)
+{
+	for (int fd : g.fds)
+	{
+		close(fd);
+	}
+	g.fds.clear();
+}
+
+int CPerfModule::openGroup(Group &g, Event first, Event last, int pid, int cpu, bool inherit)
+{
+	closeGroup(g);
+	g.single = inherit;
+	for (int e = first; e < last; ++e)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = kEvents[e].type;
+		attr.config = kEvents[e].config;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		if (!inherit)
+			attr.read_format |= PERF_FORMAT_GROUP;
+		attr.inherit = inherit ? 1 : 0;
+		attr.exclude_hv = 1;
+		attr.exclude_kernel = m_excludeKernel ? 1 : 0;
+
+		const int fd = perfEventOpen(&attr, pid, cpu, (inherit || g.fds.empty()) ? -1 : g.fds[0]);
+		if (fd < 0)
+		{
+			const int err = errno;
+			closeGroup(g);
+			return err;
+		}
+		g.fds.push_back(fd);
+	}
+	return 0;
+}
+
+int CPerfModule::openMember(Member &m, int pid, int cpu, bool inherit)
+{
+	const int err = openGroup(m.sw, TASK_CLOCK, SW_NUM, pid, cpu, inherit);
+	if (err != 0)
+		return err;
+
+	/* 硬件组失败（线程已退出、计数器被占满）只影响本成员 */
+	if (m_hardware)
+		openGroup(m.hw, CYCLES, EVENT_NUM, pid, cpu, inherit);
+	return 0;
+}
+
+bool CPerfModule::readGroup(const Group &g, size_t count, uint64_t *out)
+{
+	if (g.fds.empty())
+		return false;
+
+	if (g.single)
+	{
+		/* 无 PERF_FORMAT_GROUP：每个描述符 value, time_enabled, time_running */
+		if (g.fds.size() != count)
+			return false;
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint64_t one[3];
+			if (::read(g.fds[i], one, sizeof(one)) != static_cast<ssize_t>(sizeof(one)))
+				return false;
+			uint64_t v = one[0];
+			if (one[2] > 0 && one[2] < one[1])
+				v = static_cast<uint64_t>(static_cast<double>(v) * one[1] / one[2]);
+			out[i] = one[2] > 0 ? v : 0;
+		}
+		return true;
+	}
+
+	/* PERF_FORMAT_GROUP：nr, time_enabled, time_running, values[nr] */
+	uint64_t buf[3 + EVENT_NUM];
+	const ssize_t want = static_cast<ssize_t>((3 + count) * sizeof(uint64_t));
+	if (::read(g.fds[0], buf, want) != want || buf[0] != count)
+		return false;
+
+	const uint64_t enabled = buf[1];
+	const uint64_t running = buf[2];
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t v = buf[3 + i];
+		/* 被多路复用时按运行时间占比放大 */
+		if (running > 0 && running < enabled)
+			v = static_cast<uint64_t>(static_cast<double>(v) * enabled / running);
+		out[i] = running > 0 ? v : 0;
+	}
+	return true;
+}
+
+void CPerfModule::retire(Target &t, Member &m)
+{
+	/* 退出线程的计数仍可读取，并入累计值后关闭 */
+	uint64_t v[EVENT_NUM] = {};
+	if (readGroup(m.sw, SW_NUM, v))
+	{
+		for (int e = TASK_CLOCK; e < SW_NUM; ++e)
+			t.retired[e] += v[e];
+	}
+	if (readGroup(m.hw, EVENT_NUM - SW_NUM, v + SW_NUM))
+	{
+		for (int e = SW_NUM; e < EVENT_NUM; ++e)
+			t.retired[e] += v[e];
+	}
+	closeGroup(m.sw);
+	closeGroup(m.hw);
+}
+
+void CPerfModule::closeTarget(Target &t)
+{
+	for (auto &kv : t.members)
+	{
+		closeGroup(kv.second.sw);
+		closeGroup(kv.second.hw);
+	}
+	t.members.clear();
+	memset(t.retired, 0, sizeof(t.retired));
+	t.hwSeen = false;
+	t.inherit = false;
+	t.pid = -1;
+}
+
+void CPerfModule::noteOpen(Target &t, int err, const char *what, int id)
+{
+	if (err == t.openErr)
+		return;
+	if (err != 0)
+		ERROR("perf plugin: perf_event_open for %s %s %d failed: %s (retrying silently)",
+		      t.name.c_str(), what, id, strerror(err));
+	else
+		INFO("perf plugin: perf_event_open for %s succeeds again.", t.name.c_str());
+	t.openErr = err;
+}
+
+void CPerfModule::refreshProcess(Target &t)
+{
+	int pid = -1;
+	int count = 1;
+	if (get_pid_by_name(t.name.c_str(), &pid, &count) != 0 || count == 0)
+	{
+		if (t.pid >= 0)
+			INFO("perf plugin: process '%s' is gone.", t.name.c_str());
+		closeTarget(t);
+		return;
+	}
+	if (pid != t.pid)
+	{
+		/* 进程重启，计数从头开始 */
+		closeTarget(t);
+		t.pid = pid;
+	}
+
+	if (!t.inherit)
+	{
+		m_tids.clear();
+		char path[64];
+		snprintf(path, sizeof(path), "/proc/%d/task", pid);
+		DIR *dir = opendir(path);
+		if (!dir)
+			return;
+		struct dirent *ent;
+		while ((ent = readdir(dir)) != nullptr)
+		{
+			const int tid = atoi(ent->d_name);
+			if (tid > 0)
+				m_tids.push_back(tid);
+		}
+		closedir(dir);
+
+		if (m_tids.size() > m_maxThreads)
+		{
+			WARNING("perf plugin: '%s' has %zu threads (MaxThreads %u), switching to inherited counters "
+			        "on the main thread; threads that already exist are no longer counted.",
+			        t.name.c_str(), m_tids.size(), m_maxThreads);
+			for (auto &kv : t.members)
+			{
+				retire(t, kv.second);
+			}
+			t.members.clear();
+			t.inherit = true;
+		}
+	}
+
+	if (t.inherit)
+	{
+		/* 主线程上一组 inherit 计数器，打开失败时每周期重试 */
+		if (t.members.empty())
+		{
+			Member m;
+			const int err = openMember(m, pid, -1, true);
+			if (err == 0)
+				t.members.emplace(pid, m);
+			noteOpen(t, err == ESRCH ? 0 : err, "process", pid);
+		}
+		return;
+	}
+
+	std::sort(m_tids.begin(), m_tids.end());
+	for (auto it = t.members.begin(); it != t.members.end();)
+	{
+		if (std::binary_search(m_tids.begin(), m_tids.end(), it->first))
+		{
+			++it;
+			continue;
+		}
+		retire(t, it->second);
+		it = t.members.erase(it);
+	}
+	int failed = 0;
+	for (int tid : m_tids)
+	{
+		if (t.members.count(tid))
+			continue;
+		Member m;
+		const int err = openMember(m, tid, -1);
+		if (err == 0)
+			t.members.emplace(tid, m);
+		else if (err != ESRCH)
+		{
+			noteOpen(t, err, "thread", tid);
+			failed = err;
+		}
+	}
+	if (failed == 0)
+		noteOpen(t, 0, "thread", 0);
+}
+
+void CPerfModule::refreshSystem(Target &t)
+{
+	/* 已打开的 CPU 下线后计数保留；新上线的 CPU 补开 */
+	onlineCpus(m_tids);
+	int failed = 0;
+	for (int cpu : m_tids)
+	{
+		if (t.members.count(cpu))
+			continue;
+		Member m;
+		const int err = openMember(m, -1, cpu);
+		if (err == 0)
+			t.members.emplace(cpu, m);
+		else if (err != ENODEV)
+		{
+			noteOpen(t, err, "cpu", cpu);
+			failed = err;
+		}
+	}
+	if (failed == 0)
+		noteOpen(t, 0, "cpu", 0);
+}
+
+void CPerfModule::submit(Target &t)
+{
+	if (t.members.empty())
+		return;
+
+	uint64_t total[EVENT_NUM];
+	memcpy(total, t.retired, sizeof(total));
+	for (auto &kv : t.members)
+	{
+		uint64_t v[EVENT_NUM] = {};
+		if (readGroup(kv.second.sw, SW_NUM, v))
+		{
+			for (int e = TASK_CLOCK; e < SW_NUM; ++e)
+				total[e] += v[e];
+		}
+		if (readGroup(kv.second.hw, EVENT_NUM - SW_NUM, v + SW_NUM))
+		{
+			t.hwSeen = true;
+			for (int e = SW_NUM; e < EVENT_NUM; ++e)
+				total[e] += v[e];
+		}
+	}
+
+	value_t value;
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = &value;
+	vl.values_len = 1;
+	sstrncpy(vl.plugin, "perf", sizeof(vl.plugin));
+	sstrncpy(vl.plugin_instance, t.name.c_str(), sizeof(vl.plugin_instance));
+	sstrncpy(vl.type, "perf_counter", sizeof(vl.type));
+
+	const int last = t.hwSeen ? EVENT_NUM : SW_NUM;
+	for (int e = TASK_CLOCK; e < last; ++e)
+	{
+		sstrncpy(vl.type_instance, kEvents[e].name, sizeof(vl.type_instance));
+		value.derive = static_cast<derive_t>(total[e]);
+		PluginService::Instance().dispatchValues(&vl);
+	}
+}
+
+int CPerfModule::init()
+{
+	if (!m_systemWideSet)
+		m_systemWide = m_targets.empty();
+	if (m_systemWide)
+	{
+		Target t;
+		t.name = "all";
+		t.system = true;
+		m_targets.push_back(t);
+	}
+	if (m_targets.empty())
+	{
+		ERROR("perf plugin: nothing to count, configure Process or SystemWide.");
+		return -1;
+	}
+
+	/* 在自身上探测一次内核态权限：perf_event_paranoid 不允许时之后全部只统计用户态 */
+	Group probe;
+	int err = openGroup(probe, TASK_CLOCK, SW_NUM, 0, -1);
+	closeGroup(probe);
+	if (err == EACCES || err == EPERM)
+	{
+		m_excludeKernel = true;
+		err = openGroup(probe, TASK_CLOCK, SW_NUM, 0, -1);
+		closeGroup(probe);
+		if (err == 0)
+			WARNING("perf plugin: kernel-mode counting not permitted, counting user mode only.");
+	}
+
+	/* 硬件事件同样先在自身上探测：虚拟机、容器里常见无 PMU 或被禁止 */
+	if (m_hardware)
+	{
+		err = openGroup(probe, CYCLES, EVENT_NUM, 0, -1);
+		closeGroup(probe);
+		if (err != 0)
+		{
+			INFO("perf plugin: hardware counters unavailable (%s), using software events only.", strerror(err));
+			m_hardware = false;
+		}
+	}
+	return 0;
+}
+
+int CPerfModule::read()
+{
+	for (auto &t : m_targets)
+	{
+		if (t.system)
+			refreshSystem(t);
+		else
+			refreshProcess(t);
+		submit(t);
+	}
+	return 0;
+}
+
+int CPerfModule::shutdown()
+{
+	for (auto &t : m_targets)
+	{
+		closeTarget(t);
+	}
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CPerfModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != NULL);
+
+	delete pUserModule;
+	pUserModule = NULL;
+}
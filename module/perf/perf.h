@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ModuleBase.h"
+
+/*
+ * perf_event 计数：软件事件 task_clock（纳秒）、context_switches、cpu_migrations、page_faults，
+ * 以及 PMU 可用时的硬件事件 cycles、instructions，按配置的进程或全系统上报
+ *   perf_counter-<事件名>   DERIVE   plugin_instance 为进程名，全系统为 "all"
+ *
+ * 软件事件与硬件事件各组成一个事件组（PERF_FORMAT_GROUP），每组每周期一次 read() 取回全部计数；
+ * 硬件事件按启用 / 运行时间换算多路复用。虚拟机等无 PMU 时 init() 探测失败，只采集软件事件。
+ * init() 在自身上探测一次是否允许统计内核态（perf_event_paranoid），不允许时全部计数只统计用户态。
+ *
+ * 进程按线程逐个挂接（perf 对进程计数只覆盖打开时指定的那个线程），每周期比对 /proc/<pid>/task：
+ * 新线程补开计数组，已退出线程的最终计数并入累计值后关闭，保证上报值单调。
+ * 每个线程占用 4～6 个描述符；线程数超过 MaxThreads 时关闭逐线程计数（累计值保留），
+ * 改为在主线程上打开带 inherit 的独立计数器（inherit 不支持 PERF_FORMAT_GROUP，逐个读取），
+ * 此后只覆盖主线程与之后创建的线程，直到进程重启，切换时记一次日志。
+ * 全系统模式为每个在线 CPU 一组，后上线的 CPU 在下一周期补开。
+ * perf_event_open 失败的线程 / CPU 每周期重试，同一错误只记一次日志。
+ *
+ * 配置示例：
+ *   <Plugin perf>
+ *     Process "m320_app"   # 可重复
+ *     SystemWide true      # 未配置 Process 时缺省为 true
+ *     Hardware true        # false 时不尝试硬件事件
+ *     MaxThreads 128       # 每个进程逐线程计数的上限
+ *   </Plugin>
+ */
+class CPerfModule final : public CAbstractUserModule
+{
+public:
+	CPerfModule() = default;
+	~CPerfModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int read() override;
+	int shutdown() override;
+
+private:
+	enum Event
+	{
+		TASK_CLOCK = 0, CONTEXT_SWITCHES, CPU_MIGRATIONS, PAGE_FAULTS,
+		SW_NUM,
+		CYCLES = SW_NUM, INSTRUCTIONS,
+		EVENT_NUM
+	};
+
+	struct Group
+	{
+		std::vector<int> fds; ///< fds[0] 为组长
+		bool single = false;  ///< inherit 计数器：各自独立、逐个读取
+	};
+
+	/* 一个线程或一个 CPU 上的计数组 */
+	struct Member
+	{
+		Group sw;
+		Group hw;
+	};
+
+	struct Target
+	{
+		std::string name;                 ///< 进程名；全系统为 "all"
+		bool system = false;
+		int pid = -1;
+		std::map<int, Member> members;    ///< tid 或 CPU 编号 -> 计数组
+		uint64_t retired[EVENT_NUM] = {}; ///< 已关闭成员的累计计数
+		bool hwSeen = false;
+		bool inherit = false;             ///< 线程数超限，已改为主线程上的 inherit 计数
+		int openErr = 0;                  ///< 已记过日志的 perf_event_open 错误
+	};
+
+	int openGroup(Group &g, Event first, Event last, int pid, int cpu, bool inherit = false);
+	int openMember(Member &m, int pid, int cpu, bool inherit = false);
+	static void closeGroup(Group &g);
+	static bool readGroup(const Group &g, size_t count, uint64_t *out);
+	void retire(Target &t, Member &m);
+	void closeTarget(Target &t);
+	/* 记录本轮 perf_event_open 的结果；错误与上次不同时才记日志 */
+	static void noteOpen(Target &t, int err, const char *what, int id);
+
+	void refreshProcess(Target &t);
+	void refreshSystem(Target &t);
+	void submit(Target &t);
+
+	std::vector<Target> m_targets;
+	bool m_systemWide = false;
+	bool m_systemWideSet = false;
+	bool m_hardware = true;
+	bool m_excludeKernel = false;
+	unsigned m_maxThreads = 128;
+
+	std::vector<int> m_tids; ///< 复用的线程 / CPU 列表
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+
+#ifdef __cplusplus
+};
+#endif
@@ -0,0 +1,291 @@
+#include <assert.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "pressure.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/utils/utils.h"
+
+namespace
+{
+	const char *const kPressureDir = "/proc/pressure/";
+	const char *const kDefaultResources[] = {"cpu", "memory", "io"};
+
+	/* 在 line 中找 "key=" 并解析其后的数值 */
+	bool fieldOf(const char *line, const char *key, double &out)
+	{
+		const char *p = strstr(line, key);
+		if (!p)
+			return false;
+		char *end;
+		out = strtod(p + strlen(key), &end);
+		return end != p + strlen(key);
+	}
+}
+
+CPressureModule::~CPressureModule()
+{
+	shutdown();
+}
+
+int CPressureModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Resource")
+	{
+		if (val != "cpu" && val != "memory" && val != "io")
+		{
+			ERROR("pressure plugin: unknown resource '%s'.", val.c_str());
+			return -1;
+		}
+		m_resources.push_back(val);
+	}
+	else if (key == "Trigger")
+	{
+		Trigger t;
+		char resource[16], kind[8];
+		unsigned long long stall, window;
+		if (sscanf(val.c_str(), "%15s %7s %llu %llu", resource, kind, &stall, &window) != 4 ||
+		    (strcmp(kind, "some") != 0 && strcmp(kind, "full") != 0))
+		{
+			ERROR("pressure plugin: Trigger must be \"<resource> <some|full> <stall us> <window us>\".");
+			return -1;
+		}
+		if (window < 500000 || window > 10000000 || stall == 0 || stall > window)
+		{
+			ERROR("pressure plugin: Trigger window must be 500000..10000000 us and stall within it.");
+			return -1;
+		}
+		t.resource = resource;
+		t.kind = kind;
+		t.stallUs = stall;
+		t.windowUs = window;
+		m_triggers.push_back(t);
+	}
+	else
+		return -1;
+	return 0;
+}
+
+int CPressureModule::armTrigger(Trigger &t)
+{
+	const std::string path = kPressureDir + t.resource;
+	t.fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (t.fd < 0)
+	{
+		ERROR("pressure plugin: open %s failed: %s", path.c_str(), strerror(errno));
+		return -1;
+	}
+
+	/* 写入的字符串须包含结尾的 '\0' */
+	char spec[64];
+	const int len = snprintf(spec, sizeof(spec), "%s %llu %llu", t.kind.c_str(),
+	                         static_cast<unsigned long long>(t.stallUs),
+	                         static_cast<unsigned long long>(t.windowUs));
+	if (::write(t.fd, spec, len + 1) < 0)
+	{
+		/* EINVAL 多为无 CAP_SYS_RESOURCE 时窗口不是 2s 的整数倍 */
+		ERROR("pressure plugin: register trigger '%s' on %s failed: %s",
+		      spec, path.c_str(), strerror(errno));
+		close(t.fd);
+		t.fd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+int CPressureModule::init()
+{
+	if (m_resources.empty())
+		m_resources.assign(std::begin(kDefaultResources), std::end(kDefaultResources));
+
+	if (access(kPressureDir, R_OK) != 0)
+	{
+		ERROR("pressure plugin: %s not available (kernel without CONFIG_PSI?).", kPressureDir);
+		return -1;
+	}
+
+	/* 触发器注册失败只记日志，周期采集照常进行 */
+	bool armed = false;
+	for (auto &t : m_triggers)
+	{
+		armed = armTrigger(t) == 0 || armed;
+	}
+	if (!armed)
+		return 0;
+
+	m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_wakeFd < 0)
+	{
+		ERROR("pressure plugin: eventfd failed: %s", strerror(errno));
+		return -1;
+	}
+	m_running.store(true);
+	m_thread = std::thread(&CPressureModule::monitorLoop, this);
+	return 0;
+}
+
+int CPressureModule::readResource(const char *path, const char *resource)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		ERROR("pressure plugin: open %s failed: %s", path, strerror(errno));
+		return -1;
+	}
+	/* 文件仅两行，一次 read 即可读完 */
+	char buf[256];
+	const ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+	{
+		ERROR("pressure plugin: read %s failed: %s", path, n < 0 ? strerror(errno) : "empty");
+		return -1;
+	}
+	buf[n] = '\0';
+
+	value_t values[3];
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = values;
+	sstrncpy(vl.plugin, "pressure", sizeof(vl.plugin));
+	sstrncpy(vl.plugin_instance, resource, sizeof(vl.plugin_instance));
+
+	char *save = nullptr;
+	for (char *line = strtok_r(buf, "\n", &save); line; line = strtok_r(nullptr, "\n", &save))
+	{
+		const char *kind = strncmp(line, "some ", 5) == 0 ? "some"
+		                 : strncmp(line, "full ", 5) == 0 ? "full" : nullptr;
+		double avg10, avg60, avg300, total;
+		if (!kind || !fieldOf(line, "avg10=", avg10) || !fieldOf(line, "avg60=", avg60) ||
+		    !fieldOf(line, "avg300=", avg300) || !fieldOf(line, "total=", total))
+			continue;
+
+		sstrncpy(vl.type_instance, kind, sizeof(vl.type_instance));
+
+		values[0].gauge = avg10;
+		values[1].gauge = avg60;
+		values[2].gauge = avg300;
+		vl.values_len = 3;
+		sstrncpy(vl.type, "pressure", sizeof(vl.type));
+		PluginService::Instance().dispatchValues(&vl);
+
+		values[0].derive = static_cast<derive_t>(total);
+		vl.values_len = 1;
+		sstrncpy(vl.type, "pressure_stall", sizeof(vl.type));
+		PluginService::Instance().dispatchValues(&vl);
+	}
+	return 0;
+}
+
+int CPressureModule::read()
+{
+	int status = 0;
+	for (auto &r : m_resources)
+	{
+		const std::string path = kPressureDir + r;
+		if (readResource(path.c_str(), r.c_str()) != 0)
+			status = -1;
+	}
+	return status;
+}
+
+void CPressureModule::notifyTrigger(const Trigger &t)
+{
+	notification_t n;
+	memset(&n, 0, sizeof(n));
+	n.severity = NOTIF_WARNING;
+	n.time = cdtime();
+	sstrncpy(n.plugin, "pressure", sizeof(n.plugin));
+	sstrncpy(n.plugin_instance, t.resource.c_str(), sizeof(n.plugin_instance));
+	sstrncpy(n.type, "pressure", sizeof(n.type));
+	sstrncpy(n.type_instance, t.kind.c_str(), sizeof(n.type_instance));
+	snprintf(n.message, sizeof(n.message),
+	         "pressure: %s %s stall exceeded %llu us within a %llu us window.",
+	         t.resource.c_str(), t.kind.c_str(),
+	         static_cast<unsigned long long>(t.stallUs), static_cast<unsigned long long>(t.windowUs));
+	PluginService::Instance().dispatchNotification(&n);
+}
+
+void CPressureModule::monitorLoop()
+{
+	std::vector<struct pollfd> fds;
+	std::vector<const Trigger *> owners;
+	fds.push_back({m_wakeFd, POLLIN, 0});
+	owners.push_back(nullptr);
+	for (auto &t : m_triggers)
+	{
+		if (t.fd < 0)
+			continue;
+		fds.push_back({t.fd, POLLPRI, 0});
+		owners.push_back(&t);
+	}
+
+	while (m_running.load(std::memory_order_acquire))
+	{
+		int n = poll(fds.data(), fds.size(), -1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ERROR("pressure plugin: poll failed: %s", strerror(errno));
+			break;
+		}
+
+		if (fds[0].revents & POLLIN)
+			return;
+		for (size_t i = 1; i < fds.size(); ++i)
+		{
+			if (fds[i].revents & POLLERR)
+			{
+				/* 监视的 cgroup / 文件消失，停止监视该触发器 */
+				ERROR("pressure plugin: trigger on %s lost.", owners[i]->resource.c_str());
+				fds[i].fd = -1;
+			}
+			else if (fds[i].revents & POLLPRI)
+			{
+				notifyTrigger(*owners[i]);
+			}
+		}
+	}
+}
+
+int CPressureModule::shutdown()
+{
+	if (m_running.exchange(false))
+	{
+		uint64_t one = 1;
+		if (::write(m_wakeFd, &one, sizeof(one)) < 0)
+			ERROR("pressure plugin: wake monitor thread failed: %s", strerror(errno));
+	}
+	if (m_thread.joinable())
+		m_thread.join();
+
+	for (auto &t : m_triggers)
+	{
+		if (t.fd >= 0)
+			close(t.fd);
+		t.fd = -1;
+	}
+	if (m_wakeFd >= 0)
+		close(m_wakeFd);
+	m_wakeFd = -1;
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CPressureModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != NULL);
+
+	delete pUserModule;
+	pUserModule = NULL;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ModuleBase.h"
+
+/*
+ * PSI（Pressure Stall Information）：每个周期读取 /proc/pressure/{cpu,memory,io}，
+ * 每种资源（plugin_instance）按 some / full（type_instance）上报
+ *   pressure        avg10, avg60, avg300   GAUGE，停顿时间占比（%）
+ *   pressure_stall  total                  DERIVE，累计停顿微秒数
+ *
+ * 可选 PSI 触发器：向 /proc/pressure/<资源> 写入 "<some|full> <停顿微秒> <窗口微秒>"，
+ * 内核在窗口内停顿超过阈值时置 POLLPRI，后台线程 poll 到后立即发出告警通知，
+ * 不必提高轮询频率即可捕获短时尖峰。窗口须在 500ms～10s 之间，内核每个窗口至多触发一次；
+ * 进程无 CAP_SYS_RESOURCE 时（内核 6.5 起）窗口还须为 2s 的整数倍。
+ *
+ * 配置示例：
+ *   <Plugin pressure>
+ *     Resource "memory"                     # 可重复；缺省 cpu、memory、io
+ *     Resource "io"
+ *     Trigger "memory some 150000 2000000"  # 2 秒内停顿超过 150ms
+ *     Trigger "io full 500000 2000000"
+ *   </Plugin>
+ */
+class CPressureModule final : public CAbstractUserModule
+{
+public:
+	CPressureModule() = default;
+	~CPressureModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int read() override;
+	int shutdown() override;
+
+	/* 解析一个 /proc/pressure 文件并上报，bench 亦直接调用 */
+	int readResource(const char *path, const char *resource);
+
+private:
+	struct Trigger
+	{
+		std::string resource;
+		std::string kind;      ///< some / full
+		uint64_t stallUs = 0;
+		uint64_t windowUs = 0;
+		int fd = -1;
+	};
+
+	int armTrigger(Trigger &t);
+	void monitorLoop();
+	void notifyTrigger(const Trigger &t);
+
+	std::vector<std::string> m_resources;
+	std::vector<Trigger> m_triggers;
+
+	int m_wakeFd = -1;
+	std::thread m_thread;
+	std::atomic<bool> m_running{false};
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+
+#ifdef __cplusplus
+};
+#endif
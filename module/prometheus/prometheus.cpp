@@ -0,0 +1,664 @@
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "prometheus.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/QuantileSketch.h"
+#include "../daemon/utils/utils.h"
+
+namespace
+{
+	/* 数值字段定宽：1 个分隔空格 + 24 字符（%.17g 的最长输出） */
+	const size_t kValueWidth = 25;
+
+	/* sketch 数据源展开成 summary 的各行 */
+	const struct
+	{
+		const char *quantile; ///< nullptr 表示 _sum / _count 行
+		const char *suffix;
+		double q;
+	} kSketchParts[] = {
+		{"0.5", "", 0.5},
+		{"0.9", "", 0.9},
+		{"0.99", "", 0.99},
+		{nullptr, "_sum", 0.0},
+		{nullptr, "_count", 0.0},
+	};
+	const int kSketchPartNum = sizeof(kSketchParts) / sizeof(kSketchParts[0]);
+	const size_t kMaxRequest = 8192;
+	/* 过期清理的最短间隔（秒） */
+	const double kExpirePeriod = 5.0;
+
+	void appendSanitized(std::string &out, const char *s)
+	{
+		for (; *s; ++s)
+		{
+			const char c = *s;
+			const bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+			                (c >= '0' && c <= '9') || c == '_' || c == ':';
+			out += ok ? c : '_';
+		}
+	}
+
+	void appendLabel(std::string &out, bool &first, const char *key, const char *val)
+	{
+		if (!val[0])
+			return;
+		out += first ? '{' : ',';
+		first = false;
+		out += key;
+		out += "=\"";
+		for (; *val; ++val)
+		{
+			if (*val == '\\' || *val == '"')
+			{
+				out += '\\';
+				out += *val;
+			}
+			else if (*val == '\n')
+			{
+				out += "\\n";
+			}
+			else
+			{
+				out += *val;
+			}
+		}
+		out += '"';
+	}
+
+	const char *typeName(int dsType)
+	{
+		switch (dsType)
+		{
+		case DS_TYPE_GAUGE:   return "gauge";
+		case DS_TYPE_COUNTER:
+		case DS_TYPE_DERIVE:  return "counter";
+		case DS_TYPE_SKETCH:  return "summary";
+		default:              return "untyped";
+		}
+	}
+}
+
+CPrometheusModule::~CPrometheusModule()
+{
+	shutdown();
+}
+
+int CPrometheusModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Listen")
+	{
+		m_listen = val;
+	}
+	else if (key == "ExpireIntervals")
+	{
+		const double n = atof(val.c_str());
+		if (!(n >= 1.0))
+		{
+			ERROR("prometheus plugin: ExpireIntervals must be at least 1.");
+			return -1;
+		}
+		m_expireIntervals = n;
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+int CPrometheusModule::listenOn()
+{
+	if (m_listen.compare(0, 5, "unix:") == 0)
+	{
+		m_unixPath = m_listen.substr(5);
+		struct sockaddr_un sun{};
+		if (m_unixPath.empty() || m_unixPath.size() >= sizeof(sun.sun_path))
+		{
+			ERROR("prometheus plugin: invalid unix socket path '%s'.", m_unixPath.c_str());
+			return -1;
+		}
+		sun.sun_family = AF_UNIX;
+		memcpy(sun.sun_path, m_unixPath.c_str(), m_unixPath.size() + 1);
+
+		m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		unlink(m_unixPath.c_str());
+		if (m_listenFd < 0 ||
+		    bind(m_listenFd, reinterpret_cast<struct sockaddr *>(&sun), sizeof(sun)) != 0)
+		{
+			ERROR("prometheus plugin: bind %s failed: %s", m_unixPath.c_str(), strerror(errno));
+			return -1;
+		}
+	}
+	else
+	{
+		const size_t colon = m_listen.rfind(':');
+		if (colon == std::string::npos)
+		{
+			ERROR("prometheus plugin: Listen must be \"host:port\" or \"unix:/path\".");
+			return -1;
+		}
+		std::string host = m_listen.substr(0, colon);
+		const std::string port = m_listen.substr(colon + 1);
+		if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+			host = host.substr(1, host.size() - 2);
+
+		struct addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+		struct addrinfo *res = nullptr;
+		int status = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res);
+		if (status != 0)
+		{
+			ERROR("prometheus plugin: resolve %s failed: %s", m_listen.c_str(), gai_strerror(status));
+			return -1;
+		}
+
+		for (struct addrinfo *ai = res; ai; ai = ai->ai_next)
+		{
+			m_listenFd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+			if (m_listenFd < 0)
+				continue;
+			int one = 1;
+			setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+			if (bind(m_listenFd, ai->ai_addr, ai->ai_addrlen) == 0)
+				break;
+			close(m_listenFd);
+			m_listenFd = -1;
+		}
+		freeaddrinfo(res);
+
+		if (m_listenFd < 0)
+		{
+			ERROR("prometheus plugin: bind %s failed: %s", m_listen.c_str(), strerror(errno));
+			return -1;
+		}
+	}
+
+	if (listen(m_listenFd, 16) != 0)
+	{
+		ERROR("prometheus plugin: listen %s failed: %s", m_listen.c_str(), strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+int CPrometheusModule::init()
+{
+	if (listenOn() != 0)
+	{
+		shutdown();
+		return -1;
+	}
+
+	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_epollFd < 0 || m_wakeFd < 0)
+	{
+		ERROR("prometheus plugin: epoll setup failed: %s", strerror(errno));
+		shutdown();
+		return -1;
+	}
+
+	struct epoll_event ev{};
+	ev.events = EPOLLIN;
+	ev.data.fd = m_listenFd;
+	epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &ev);
+	ev.data.fd = m_wakeFd;
+	epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev);
+
+	m_running.store(true);
+	m_thread = std::thread(&CPrometheusModule::serveLoop, this);
+	INFO("prometheus plugin: serving /metrics on %s", m_listen.c_str());
+	return 0;
+}
+
+CPrometheusModule::Series *CPrometheusModule::lookup(const value_list_t *vl,
+                                                     const data_set_t *ds, size_t i, int part)
+{
+	/* 序列键：标识 + 数据源名（+ summary 行号） */
+	m_key.assign(vl->plugin).append("/").append(vl->plugin_instance).append("/")
+	     .append(vl->type).append("/").append(vl->type_instance).append("/")
+	     .append(ds->ds[i].name);
+	if (part >= 0)
+		m_key.append("/").append(1, static_cast<char>('0' + part));
+
+	auto it = m_series.find(m_key);
+	if (it != m_series.end())
+		return &it->second;
+
+	std::string name = "collect_";
+	appendSanitized(name, vl->plugin);
+	name += '_';
+	appendSanitized(name, vl->type);
+	if (ds->ds_num > 1 || strcmp(ds->ds[i].name, "value") != 0)
+	{
+		name += '_';
+		appendSanitized(name, ds->ds[i].name);
+	}
+
+	auto fit = m_familyIds.find(name);
+	uint32_t fid;
+	if (fit == m_familyIds.end())
+	{
+		fid = static_cast<uint32_t>(m_families.size());
+		m_families.emplace_back();
+		m_families.back().typeLine = "# TYPE " + name + " " + typeName(ds->ds[i].type) + "\n";
+		m_familyIds.emplace(name, fid);
+	}
+	else
+	{
+		fid = fit->second;
+	}
+
+	/* 新序列：追加一行，数值字段先填 NaN；指标族的序列都已过期时先补回 TYPE 行 */
+	Family &family = m_families[fid];
+	std::string &text = family.text;
+	if (text.empty())
+		text = family.typeLine;
+	const uint32_t line = static_cast<uint32_t>(text.size());
+	text += name;
+	if (part >= 0)
+		text += kSketchParts[part].suffix;
+	bool first = true;
+	appendLabel(text, first, "plugin_instance", vl->plugin_instance);
+	appendLabel(text, first, "type_instance", vl->type_instance);
+	if (part >= 0 && kSketchParts[part].quantile)
+		appendLabel(text, first, "quantile", kSketchParts[part].quantile);
+	if (!first)
+		text += '}';
+
+	Series s{fid, line, static_cast<uint32_t>(text.size()), 0, 0};
+	text.append(kValueWidth - 3, ' ');
+	text += "NaN\n";
+
+	Series *added = &m_series.emplace(m_key, s).first->second;
+	family.series.push_back(added);
+	return added;
+}
+
+void CPrometheusModule::expire(cdtime_t now)
+{
+	m_nextExpire = now + DOUBLE_TO_CDTIME_T(kExpirePeriod);
+
+	auto stale = [&](const Series &s) {
+		return now - s.lastUpdate > static_cast<cdtime_t>(m_expireIntervals * s.interval);
+	};
+
+	/* 按指标族重排：保留未过期的行并修正偏移 */
+	bool any = false;
+	std::string text;
+	for (auto &f : m_families)
+	{
+		size_t live = 0;
+		for (const Series *s : f.series)
+		{
+			live += stale(*s) ? 0 : 1;
+		}
+		if (live == f.series.size())
+			continue;
+		any = true;
+
+		text.clear();
+		if (live > 0)
+			text = f.typeLine;
+		size_t kept = 0;
+		for (Series *s : f.series)
+		{
+			if (stale(*s))
+				continue;
+			const size_t len = s->offset + kValueWidth + 1 - s->line;
+			const uint32_t line = static_cast<uint32_t>(text.size());
+			text.append(f.text, s->line, len);
+			s->offset = line + (s->offset - s->line);
+			s->line = line;
+			f.series[kept++] = s;
+		}
+		f.series.resize(kept);
+		f.text.swap(text);
+		if (f.text.capacity() > 2 * f.text.size() + 4096)
+			f.text.shrink_to_fit();
+	}
+	if (!any)
+		return;
+
+	size_t removed = 0;
+	for (auto it = m_series.begin(); it != m_series.end();)
+	{
+		if (stale(it->second))
+		{
+			it = m_series.erase(it);
+			++removed;
+		}
+		else
+		{
+			++it;
+		}
+	}
+	DEBUG("prometheus plugin: expired %zu series.", removed);
+}
+
+void CPrometheusModule::setValue(const Series &s, int dsType, const value_t &v)
+{
+	char buf[32];
+	int n;
+	switch (dsType)
+	{
+	case DS_TYPE_GAUGE:
+		if (std::isnan(v.gauge))
+			n = snprintf(buf, sizeof(buf), "NaN");
+		else if (std::isinf(v.gauge))
+			n = snprintf(buf, sizeof(buf), v.gauge > 0 ? "+Inf" : "-Inf");
+		else
+			n = snprintf(buf, sizeof(buf), "%.17g", v.gauge);
+		break;
+	case DS_TYPE_DERIVE:
+		n = snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v.derive));
+		break;
+	case DS_TYPE_COUNTER:
+		n = snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v.counter));
+		break;
+	default:
+		n = snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v.absolute));
+		break;
+	}
+	if (n <= 0 || static_cast<size_t>(n) >= kValueWidth)
+		return;
+
+	/* 原地覆盖定宽字段：右对齐，左侧补空格 */
+	char *field = &m_families[s.family].text[s.offset];
+	memset(field, ' ', kValueWidth - n);
+	memcpy(field + kValueWidth - n, buf, n);
+}
+
+int CPrometheusModule::write(const data_set_t *ds, const value_list_t *vl)
+{
+	if (!ds || !vl || ds->ds_num != vl->values_len)
+		return -1;
+
+	/* 未带间隔的样本按 10 秒计 */
+	const cdtime_t now = cdtime();
+	const cdtime_t interval = vl->interval ? vl->interval : TIME_T_TO_CDTIME_T(10);
+
+	std::lock_guard<std::mutex> lk(m_mutex);
+	if (now >= m_nextExpire)
+		expire(now);
+
+	for (size_t i = 0; i < ds->ds_num; ++i)
+	{
+		if (ds->ds[i].type != DS_TYPE_SKETCH)
+		{
+			Series *s = lookup(vl, ds, i);
+			s->lastUpdate = now;
+			s->interval = interval;
+			setValue(*s, ds->ds[i].type, vl->values[i]);
+			continue;
+		}
+
+		/* 首次出现时各行依次追加，保证同一 summary 的行在指标族内连续 */
+		const QuantileSketch *sk = vl->values[i].sketch;
+		for (int part = 0; part < kSketchPartNum; ++part)
+		{
+			value_t v;
+			if (!sk)
+				v.gauge = NAN;
+			else if (kSketchParts[part].quantile)
+				v.gauge = sk->quantile(kSketchParts[part].q);
+			else
+				v.gauge = (part == kSketchPartNum - 1) ? static_cast<double>(sk->count()) : sk->sum();
+			Series *s = lookup(vl, ds, i, part);
+			s->lastUpdate = now;
+			s->interval = interval;
+			setValue(*s, DS_TYPE_GAUGE, v);
+		}
+	}
+	return 0;
+}
+
+void CPrometheusModule::closeConn(int fd)
+{
+	epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+	close(fd);
+	m_conns.erase(fd);
+}
+
+void CPrometheusModule::onAccept()
+{
+	for (;;)
+	{
+		int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+
+		struct epoll_event ev{};
+		ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.fd = fd;
+		if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+		{
+			close(fd);
+			continue;
+		}
+		m_conns[fd].fd = fd;
+	}
+}
+
+void CPrometheusModule::respond(Conn &c)
+{
+	const bool metrics = c.in.compare(0, 13, "GET /metrics ") == 0 ||
+	                     c.in.compare(0, 13, "GET /metrics?") == 0;
+	if (!metrics)
+	{
+		static const char kNotFound[] =
+			"HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		c.out.assign(kNotFound, sizeof(kNotFound) - 1);
+		onWritable(c);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	size_t body = 0;
+	for (const auto &f : m_families)
+	{
+		body += f.text.size();
+	}
+
+	char header[192];
+	const int hlen = snprintf(header, sizeof(header),
+	                          "HTTP/1.1 200 OK\r\n"
+	                          "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+	                          "Content-Length: %zu\r\n"
+	                          "Connection: close\r\n\r\n", body);
+
+	/* 头 + 各指标族文本直接作为 iovec，超出 IOV_MAX 的部分留给后续写 */
+	std::vector<struct iovec> iov;
+	iov.reserve(m_families.size() + 1);
+	iov.push_back({header, static_cast<size_t>(hlen)});
+	for (auto &f : m_families)
+	{
+		iov.push_back({&f.text[0], f.text.size()});
+	}
+
+	const size_t batch = iov.size() < IOV_MAX ? iov.size() : IOV_MAX;
+	ssize_t n = writev(c.fd, iov.data(), static_cast<int>(batch));
+	size_t done = n > 0 ? static_cast<size_t>(n) : 0;
+
+	/* 未发完的部分拷到连接缓冲，等 EPOLLOUT 继续（此时数值可能已更新，拷贝保证一致） */
+	for (const auto &v : iov)
+	{
+		if (done >= v.iov_len)
+		{
+			done -= v.iov_len;
+			continue;
+		}
+		c.out.append(static_cast<const char *>(v.iov_base) + done, v.iov_len - done);
+		done = 0;
+	}
+	c.sent = 0;
+
+	if (c.out.empty())
+	{
+		closeConn(c.fd);
+		return;
+	}
+
+	struct epoll_event ev{};
+	ev.events = EPOLLOUT | EPOLLRDHUP;
+	ev.data.fd = c.fd;
+	epoll_ctl(m_epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+void CPrometheusModule::onReadable(Conn &c)
+{
+	char buf[2048];
+	bool eof = false;
+	for (;;)
+	{
+		ssize_t n = ::read(c.fd, buf, sizeof(buf));
+		if (n > 0)
+		{
+			c.in.append(buf, static_cast<size_t>(n));
+			if (c.in.size() > kMaxRequest)
+			{
+				closeConn(c.fd);
+				return;
+			}
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		eof = (n == 0);
+		if (n < 0 && errno != EAGAIN)
+			eof = true;
+		break;
+	}
+
+	if (c.in.find("\r\n\r\n") != std::string::npos)
+		respond(c);
+	else if (eof)
+		closeConn(c.fd);
+}
+
+void CPrometheusModule::onWritable(Conn &c)
+{
+	while (c.sent < c.out.size())
+	{
+		ssize_t n = ::write(c.fd, c.out.data() + c.sent, c.out.size() - c.sent);
+		if (n > 0)
+		{
+			c.sent += static_cast<size_t>(n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno == EAGAIN)
+		{
+			struct epoll_event ev{};
+			ev.events = EPOLLOUT | EPOLLRDHUP;
+			ev.data.fd = c.fd;
+			epoll_ctl(m_epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+			return;
+		}
+		break;
+	}
+	closeConn(c.fd);
+}
+
+void CPrometheusModule::serveLoop()
+{
+	struct epoll_event events[64];
+	while (m_running.load(std::memory_order_acquire))
+	{
+		int n = epoll_wait(m_epollFd, events, 64, -1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ERROR("prometheus plugin: epoll_wait failed: %s", strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			const int fd = events[i].data.fd;
+			if (fd == m_wakeFd)
+				return;
+			if (fd == m_listenFd)
+			{
+				onAccept();
+				continue;
+			}
+
+			auto it = m_conns.find(fd);
+			if (it == m_conns.end())
+				continue;
+			Conn &c = it->second;
+
+			if (events[i].events & (EPOLLERR | EPOLLHUP))
+				closeConn(fd);
+			else if (events[i].events & EPOLLOUT)
+				onWritable(c);
+			else if (events[i].events & (EPOLLIN | EPOLLRDHUP))
+				onReadable(c);
+		}
+	}
+}
+
+int CPrometheusModule::shutdown()
+{
+	if (m_running.exchange(false))
+	{
+		uint64_t one = 1;
+		if (::write(m_wakeFd, &one, sizeof(one)) < 0)
+			ERROR("prometheus plugin: wake server thread failed: %s", strerror(errno));
+	}
+	if (m_thread.joinable())
+		m_thread.join();
+
+	for (auto &kv : m_conns)
+	{
+		close(kv.first);
+	}
+	m_conns.clear();
+
+	if (m_listenFd >= 0)
+		close(m_listenFd);
+	if (m_epollFd >= 0)
+		close(m_epollFd);
+	if (m_wakeFd >= 0)
+		close(m_wakeFd);
+	m_listenFd = m_epollFd = m_wakeFd = -1;
+
+	if (!m_unixPath.empty())
+	{
+		unlink(m_unixPath.c_str());
+		m_unixPath.clear();
+	}
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CPrometheusModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != nullptr);
+	delete pUserModule;
+}
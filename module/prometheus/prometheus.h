@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ModuleBase.h"
+
+/*
+ * Prometheus 文本格式导出 writer：
+ *   每个指标族（metric family）维护一段预渲染好的文本，
+ *   每条序列在其中占一行，数值字段定宽右对齐，更新时原地覆盖，
+ *   抓取时以一次 writev 把 HTTP 头和各指标族文本直接发出，不做重新格式化。
+ *
+ *   HTTP 服务为单线程 epoll，仅支持 GET /metrics，响应后关闭连接。
+ *
+ * 配置示例：
+ *   <Plugin prometheus>
+ *     Listen "127.0.0.1:9103"     # 或 "unix:/run/collect/metrics.sock"
+ *     ExpireIntervals 3           # 超过该数量的采集间隔未更新的序列不再导出，缺省 3
+ *   </Plugin>
+ *
+ * 过期的序列在 write() 中定期清除：重排所属指标族的文本并修正其余序列的偏移，
+ * 进程号、端口、线程名等标识频繁变化时，内存与抓取大小不会持续增长。
+ *
+ * 指标名：collect_<plugin>_<type>[_<数据源>]，标签 plugin_instance / type_instance
+ * （不用 instance，以免与 Prometheus 的目标标签冲突）。
+ * sketch 数据源导出为 summary：quantile="0.5|0.9|0.99" 三行及 _sum / _count。
+ */
+class CPrometheusModule final : public CAbstractUserModule
+{
+public:
+	CPrometheusModule() = default;
+	~CPrometheusModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int write(const data_set_t *ds, const value_list_t *vl) override;
+	int shutdown() override;
+
+private:
+	struct Series;
+
+	struct Family
+	{
+		std::string typeLine;         ///< "# TYPE ..." 行
+		std::string text;             ///< typeLine + 各序列行；没有序列时为空
+		std::vector<Series *> series; ///< 与 text 中的行同序
+	};
+
+	struct Series
+	{
+		uint32_t family;
+		uint32_t line;          ///< 行在 Family::text 中的起始位置
+		uint32_t offset;        ///< 数值字段在 Family::text 中的起始位置
+		cdtime_t lastUpdate;
+		cdtime_t interval;
+	};
+
+	struct Conn
+	{
+		int fd = -1;
+		std::string in;
+		std::string out;  ///< writev 未能一次发完的剩余部分
+		size_t sent = 0;
+	};
+
+	int listenOn();
+	void serveLoop();
+	void onAccept();
+	void onReadable(Conn &c);
+	void onWritable(Conn &c);
+	void respond(Conn &c);
+	void closeConn(int fd);
+
+	/* part >= 0 时为 sketch 数据源展开成 summary 的第 part 行（见 kSketchParts） */
+	Series *lookup(const value_list_t *vl, const data_set_t *ds, size_t i, int part = -1);
+	void setValue(const Series &s, int dsType, const value_t &v);
+	/* 删除超过 ExpireIntervals 个间隔未更新的序列并重排其指标族 */
+	void expire(cdtime_t now);
+
+	std::string m_listen = "127.0.0.1:9103";
+	double m_expireIntervals = 3.0;
+	cdtime_t m_nextExpire = 0;
+
+	std::mutex m_mutex;
+	std::vector<Family> m_families;
+	std::unordered_map<std::string, uint32_t> m_familyIds;
+	std::unordered_map<std::string, Series> m_series;
+	std::string m_key; ///< write() 复用的序列键缓冲
+
+	int m_listenFd = -1;
+	int m_epollFd = -1;
+	int m_wakeFd = -1;
+	std::string m_unixPath;
+	std::unordered_map<int, Conn> m_conns;
+	std::thread m_thread;
+	std::atomic<bool> m_running{false};
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+	
+#ifdef __cplusplus
+};
+#endif
@@ -0,0 +1,559 @@
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rrd.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/QuantileSketch.h"
+#include "../daemon/utils/utils.h"
+
+namespace
+{
+	/* "10s" / "1min" / "1h" / "1d" / "1w" / "1y" -> 秒；无单位按秒，非法返回 0 */
+	uint64_t parseDuration(const std::string &s)
+	{
+		char *end = nullptr;
+		const unsigned long long n = strtoull(s.c_str(), &end, 10);
+		if (end == s.c_str())
+			return 0;
+
+		const std::string unit(end);
+		if (unit.empty() || unit == "s")   return n;
+		if (unit == "m" || unit == "min")  return n * 60;
+		if (unit == "h")                   return n * 3600;
+		if (unit == "d")                   return n * 86400;
+		if (unit == "w")                   return n * 604800;
+		if (unit == "y")                   return n * 31536000;
+		return 0;
+	}
+
+	size_t align8(size_t n)
+	{
+		return (n + 7) & ~static_cast<size_t>(7);
+	}
+
+	/* 把原始值换算成归并用的值：GAUGE 原样，SKETCH 取中位数，其余为每秒速率；首个样本返回 NaN */
+	double toRate(RrdDsState &st, const value_t &cur, cdtime_t t)
+	{
+		if (st.type == DS_TYPE_GAUGE)
+			return cur.gauge;
+		if (st.type == DS_TYPE_SKETCH)
+			return sketch_scalar(cur);
+
+		double rate = NAN;
+		if (st.valid && t > st.lastTime)
+		{
+			const double dt = CDTIME_T_TO_DOUBLE(t - st.lastTime);
+			switch (st.type)
+			{
+			case DS_TYPE_DERIVE:
+				rate = static_cast<double>(cur.derive - st.last.derive) / dt;
+				break;
+			case DS_TYPE_COUNTER:
+			{
+				uint64_t diff = cur.counter - st.last.counter;
+				/* 32 位计数器回绕 */
+				if (cur.counter < st.last.counter && st.last.counter <= UINT32_MAX)
+					diff = cur.counter + (static_cast<uint64_t>(UINT32_MAX) + 1 - st.last.counter);
+				rate = static_cast<double>(diff) / dt;
+				break;
+			}
+			case DS_TYPE_ABSOLUTE:
+				rate = static_cast<double>(cur.absolute) / dt;
+				break;
+			}
+		}
+		if (!st.valid || t > st.lastTime)
+		{
+			st.last = cur;
+			st.lastTime = t;
+			st.valid = 1;
+		}
+		return rate;
+	}
+
+	void clearRow(RrdCell *row, uint32_t dsNum)
+	{
+		for (uint32_t d = 0; d < dsNum; ++d)
+		{
+			row[d].avg = row[d].min = row[d].max = NAN;
+		}
+	}
+}
+
+CRrdModule::~CRrdModule()
+{
+	closeAll();
+}
+
+int CRrdModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "DataDir")
+	{
+		m_dataDir = val;
+		while (m_dataDir.size() > 1 && m_dataDir.back() == '/')
+			m_dataDir.pop_back();
+	}
+	else if (key == "Archive")
+	{
+		const size_t colon = val.find(':');
+		const uint64_t step = (colon == std::string::npos) ? 0 : parseDuration(val.substr(0, colon));
+		const uint64_t span = (colon == std::string::npos) ? 0 : parseDuration(val.substr(colon + 1));
+		if (step == 0 || span < step || step > UINT32_MAX || span / step > UINT32_MAX)
+		{
+			ERROR("rrd plugin: invalid Archive '%s', expected \"<step>:<span>\".", val.c_str());
+			return -1;
+		}
+		m_archives.push_back(RrdArchiveDef{static_cast<uint32_t>(step),
+		                                   static_cast<uint32_t>(span / step)});
+	}
+	else if (key == "IdleTimeout")
+	{
+		const double sec = atof(val.c_str());
+		if (sec <= 0)
+		{
+			ERROR("rrd plugin: invalid IdleTimeout '%s'.", val.c_str());
+			return -1;
+		}
+		m_idleTimeout = DOUBLE_TO_CDTIME_T(sec);
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+size_t CRrdModule::fileSize(size_t dsNum) const
+{
+	size_t size = sizeof(RrdFileHeader) + dsNum * sizeof(RrdDsState) +
+	              m_archives.size() * sizeof(RrdArchiveHeader);
+	size = align8(size + m_archives.size() * dsNum * sizeof(uint32_t));
+	for (const auto &a : m_archives)
+	{
+		size += static_cast<size_t>(a.rows) * dsNum * sizeof(RrdCell);
+	}
+	return size;
+}
+
+int CRrdModule::init()
+{
+	if (m_archives.empty())
+	{
+		m_archives = {{10, 360}, {60, 1440}, {3600, 8760}};
+	}
+	std::sort(m_archives.begin(), m_archives.end(),
+	          [](const RrdArchiveDef &a, const RrdArchiveDef &b) { return a.step < b.step; });
+
+	if (check_create_dir((m_dataDir + "/").c_str()) != 0)
+	{
+		ERROR("rrd plugin: cannot create %s.", m_dataDir.c_str());
+		return -1;
+	}
+
+	INFO("rrd plugin: %zu archive(s), %zu bytes per single-value series.",
+	     m_archives.size(), fileSize(1));
+	return 0;
+}
+
+bool CRrdModule::valid(const File &f)
+{
+	const RrdFileHeader *h = f.header();
+	if (f.size < sizeof(RrdFileHeader) || memcmp(h->magic, RRD_MAGIC, sizeof(h->magic)) != 0 ||
+	    h->version != RRD_VERSION || h->fileSize != f.size ||
+	    sizeof(RrdFileHeader) + static_cast<uint64_t>(h->dsNum) * sizeof(RrdDsState) +
+	            static_cast<uint64_t>(h->archiveNum) * sizeof(RrdArchiveHeader) > f.size)
+		return false;
+
+	for (uint32_t i = 0; i < h->archiveNum; ++i)
+	{
+		const RrdArchiveHeader *a = f.archive(i);
+		if (a->step == 0 || a->rows == 0 ||
+		    a->countOffset + h->dsNum * sizeof(uint32_t) > f.size ||
+		    a->dataOffset + static_cast<uint64_t>(a->rows) * h->dsNum * sizeof(RrdCell) > f.size)
+			return false;
+	}
+	return true;
+}
+
+bool CRrdModule::matches(const File &f, const data_set_t *ds) const
+{
+	if (!valid(f))
+		return false;
+	const RrdFileHeader *h = f.header();
+	if (h->dsNum != ds->ds_num || h->archiveNum != m_archives.size() || f.size != fileSize(ds->ds_num))
+		return false;
+
+	for (uint32_t i = 0; i < h->archiveNum; ++i)
+	{
+		const RrdArchiveHeader *a = f.archive(i);
+		if (a->step != m_archives[i].step || a->rows != m_archives[i].rows)
+			return false;
+	}
+
+	/* 数据源类型决定速率换算方式，类型变了旧状态与数据都不可用 */
+	for (uint32_t d = 0; d < h->dsNum; ++d)
+	{
+		if (f.ds()[d].type != ds->ds[d].type)
+			return false;
+	}
+	return true;
+}
+
+int CRrdModule::create(const std::string &path, const data_set_t *ds, File &f)
+{
+	const size_t size = fileSize(ds->ds_num);
+
+	const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		ERROR("rrd plugin: create %s failed: %s", path.c_str(), strerror(errno));
+		return -1;
+	}
+
+	/* 预分配全部磁盘块，之后只原地更新 */
+	int err = posix_fallocate(fd, 0, static_cast<off_t>(size));
+	if (err != 0)
+	{
+		ERROR("rrd plugin: allocate %s failed: %s", path.c_str(), strerror(err));
+		::close(fd);
+		unlink(path.c_str());
+		return -1;
+	}
+
+	/* 映射不依赖 fd，建立后即关闭 */
+	void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	err = errno;
+	::close(fd);
+	if (map == MAP_FAILED)
+	{
+		ERROR("rrd plugin: mmap %s failed: %s", path.c_str(), strerror(err));
+		unlink(path.c_str());
+		return -1;
+	}
+	f.map = static_cast<uint8_t *>(map);
+	f.size = size;
+
+	RrdFileHeader *h = f.header();
+	memcpy(h->magic, RRD_MAGIC, sizeof(h->magic));
+	h->version = RRD_VERSION;
+	h->dsNum = static_cast<uint32_t>(ds->ds_num);
+	h->archiveNum = static_cast<uint32_t>(m_archives.size());
+	h->fileSize = size;
+	h->lastUpdate = 0;
+
+	for (uint32_t d = 0; d < h->dsNum; ++d)
+	{
+		RrdDsState &st = f.ds()[d];
+		st.type = ds->ds[d].type;
+		st.valid = 0;
+		st.lastTime = 0;
+	}
+
+	size_t offset = align8(sizeof(RrdFileHeader) + h->dsNum * sizeof(RrdDsState) +
+	                       h->archiveNum * sizeof(RrdArchiveHeader) +
+	                       h->archiveNum * h->dsNum * sizeof(uint32_t));
+	for (uint32_t i = 0; i < h->archiveNum; ++i)
+	{
+		RrdArchiveHeader *a = f.archive(i);
+		a->step = m_archives[i].step;
+		a->rows = m_archives[i].rows;
+		a->slot = -1;
+		a->countOffset = sizeof(RrdFileHeader) + h->dsNum * sizeof(RrdDsState) +
+		                 h->archiveNum * sizeof(RrdArchiveHeader) +
+		                 i * h->dsNum * sizeof(uint32_t);
+		a->dataOffset = offset;
+		offset += static_cast<size_t>(a->rows) * h->dsNum * sizeof(RrdCell);
+
+		for (uint32_t r = 0; r < a->rows; ++r)
+		{
+			clearRow(f.row(a, r), h->dsNum);
+		}
+	}
+	return 0;
+}
+
+CRrdModule::File *CRrdModule::open(const std::string &ident, const data_set_t *ds)
+{
+	auto it = m_files.find(ident);
+	if (it != m_files.end())
+		return it->second.get();
+
+	const std::string path = m_dataDir + "/" + ident + ".rra";
+	if (check_create_dir(path.c_str()) != 0)
+		return nullptr;
+
+	std::unique_ptr<File> f(new File);
+
+	const int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+	if (fd >= 0)
+	{
+		struct stat st;
+		if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(RrdFileHeader))
+		{
+			void *map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (map != MAP_FAILED)
+			{
+				f->map = static_cast<uint8_t *>(map);
+				f->size = static_cast<size_t>(st.st_size);
+			}
+		}
+		::close(fd);
+
+		if (!f->map || !matches(*f, ds))
+		{
+			WARNING("rrd plugin: %s does not match the configured archives or data sources, recreating.", path.c_str());
+			closeFile(*f);
+			rename(path.c_str(), (path + ".old").c_str());
+		}
+	}
+
+	if (!f->map && create(path, ds, *f) != 0)
+		return nullptr;
+
+	File *raw = f.get();
+	m_files.emplace(ident, std::move(f));
+	return raw;
+}
+
+void CRrdModule::update(File &f, const std::vector<double> &values, cdtime_t t)
+{
+	RrdFileHeader *h = f.header();
+	const double sec = CDTIME_T_TO_DOUBLE(t);
+
+	for (uint32_t i = 0; i < h->archiveNum; ++i)
+	{
+		RrdArchiveHeader *a = f.archive(i);
+		const int64_t slot = static_cast<int64_t>(sec / a->step);
+		uint32_t *counts = f.counts(a);
+
+		if (slot < a->slot)
+			continue; /* 早于当前槽的样本直接丢弃 */
+
+		if (slot > a->slot)
+		{
+			/* 进入新槽：清掉跳过的行（最多一整圈），保证 O(rows) 上界 */
+			const int64_t gap = (a->slot < 0) ? 1 : std::min<int64_t>(slot - a->slot, a->rows);
+			for (int64_t k = 0; k < gap; ++k)
+			{
+				clearRow(f.row(a, static_cast<uint64_t>(slot - k)), h->dsNum);
+			}
+			memset(counts, 0, h->dsNum * sizeof(uint32_t));
+			a->slot = slot;
+		}
+
+		RrdCell *row = f.row(a, static_cast<uint64_t>(slot));
+		for (uint32_t d = 0; d < h->dsNum; ++d)
+		{
+			const double v = values[d];
+			if (std::isnan(v))
+				continue;
+
+			RrdCell &c = row[d];
+			const uint32_t n = counts[d];
+			if (n == 0)
+			{
+				c.avg = c.min = c.max = v;
+			}
+			else
+			{
+				c.avg += (v - c.avg) / (n + 1);
+				if (v < c.min) c.min = v;
+				if (v > c.max) c.max = v;
+			}
+			counts[d] = n + 1;
+		}
+	}
+	h->lastUpdate = t;
+}
+
+int CRrdModule::write(const data_set_t *ds, const value_list_t *vl)
+{
+	if (!ds || !vl || ds->ds_num != vl->values_len)
+		return -1;
+
+	char ident[512];
+	if (FORMAT_VL(ident, sizeof(ident), vl) != 0)
+		return -1;
+
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	const cdtime_t now = cdtime();
+	if (now >= m_nextEvict)
+		evictIdle(now);
+
+	File *f = open(ident, ds);
+	if (!f)
+		return -1;
+	f->lastUse = now;
+
+	m_rates.resize(ds->ds_num);
+	for (size_t d = 0; d < ds->ds_num; ++d)
+	{
+		m_rates[d] = toRate(f->ds()[d], vl->values[d], vl->time);
+	}
+	update(*f, m_rates, vl->time);
+	return 0;
+}
+
+int CRrdModule::fetch(const std::string &ident, cdtime_t from, cdtime_t to, RrdFetchResult &out,
+                      uint32_t resolution)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	auto it = m_files.find(ident);
+	if (it != m_files.end())
+	{
+		readRange(*it->second, from, to, resolution, out);
+		return out.step ? 0 : ENOENT;
+	}
+
+	/* 未映射的序列：只读映射整个文件，实际只换入文件头与所选级别中被访问的行 */
+	const std::string path = m_dataDir + "/" + ident + ".rra";
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return errno;
+	File f;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(RrdFileHeader))
+	{
+		void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (map != MAP_FAILED)
+		{
+			f.map = static_cast<uint8_t *>(map);
+			f.size = static_cast<size_t>(st.st_size);
+		}
+	}
+	::close(fd);
+	if (!f.map)
+		return EIO;
+
+	int status = EINVAL;
+	if (valid(f))
+	{
+		readRange(f, from, to, resolution, out);
+		status = out.step ? 0 : ENOENT;
+	}
+	munmap(f.map, f.size);
+	return status;
+}
+
+void CRrdModule::readRange(const File &f, cdtime_t from, cdtime_t to, uint32_t resolution,
+                           RrdFetchResult &out) const
+{
+	const RrdFileHeader *h = f.header();
+	const double fromSec = CDTIME_T_TO_DOUBLE(from);
+	const double toSec = CDTIME_T_TO_DOUBLE(to);
+
+	out.step = 0;
+	out.dsNum = h->dsNum;
+	out.cells.clear();
+
+	/* 满足分辨率的级别中，覆盖 from 的取最细，否则取最粗；没有满足分辨率的就取最粗的 */
+	const RrdArchiveHeader *covering = nullptr;
+	const RrdArchiveHeader *coarsest = nullptr;
+	const RrdArchiveHeader *fallback = nullptr;
+	for (uint32_t i = 0; i < h->archiveNum; ++i)
+	{
+		const RrdArchiveHeader *a = f.archive(i);
+		if (a->slot < 0)
+			continue;
+		if (!fallback || a->step > fallback->step)
+			fallback = a;
+		if (a->step < resolution)
+			continue;
+		if (!coarsest || a->step > coarsest->step)
+			coarsest = a;
+		const bool covers = (a->slot - a->rows + 1) * static_cast<double>(a->step) <= fromSec;
+		if (covers && (!covering || a->step < covering->step))
+			covering = a;
+	}
+	const RrdArchiveHeader *a = covering ? covering : coarsest ? coarsest : fallback;
+	if (!a)
+		return;
+
+	int64_t first = static_cast<int64_t>(fromSec / a->step);
+	int64_t last = static_cast<int64_t>(toSec / a->step);
+	first = std::max<int64_t>({first, a->slot - a->rows + 1, 0});
+	last = std::min<int64_t>(last, a->slot);
+
+	out.step = a->step;
+	out.start = TIME_T_TO_CDTIME_T(first * a->step);
+	for (int64_t s = first; s <= last; ++s)
+	{
+		const RrdCell *row = f.row(a, static_cast<uint64_t>(s));
+		out.cells.insert(out.cells.end(), row, row + h->dsNum);
+	}
+}
+
+void CRrdModule::evictIdle(cdtime_t now)
+{
+	/* 每个超时周期最多扫描两次 */
+	m_nextEvict = now + m_idleTimeout / 2;
+	for (auto it = m_files.begin(); it != m_files.end();)
+	{
+		if (now - it->second->lastUse < m_idleTimeout)
+		{
+			++it;
+			continue;
+		}
+		closeFile(*it->second);
+		it = m_files.erase(it);
+	}
+}
+
+int CRrdModule::flush()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	for (auto &kv : m_files)
+	{
+		msync(kv.second->map, kv.second->size, MS_ASYNC);
+	}
+	return 0;
+}
+
+void CRrdModule::closeFile(File &f)
+{
+	if (f.map)
+	{
+		msync(f.map, f.size, MS_ASYNC);
+		munmap(f.map, f.size);
+	}
+	f.map = nullptr;
+	f.size = 0;
+}
+
+void CRrdModule::closeAll()
+{
+	for (auto &kv : m_files)
+	{
+		closeFile(*kv.second);
+	}
+	m_files.clear();
+}
+
+int CRrdModule::shutdown()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	closeAll();
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CRrdModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != nullptr);
+	delete pUserModule;
+}
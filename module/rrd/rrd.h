@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ModuleBase.h"
+
+/*
+ * 环形定长归档 writer（类 RRD）：
+ *   每个标识一个预分配的 mmap 文件，内含若干归档级别，
+ *   每级按固定步长保存 avg/min/max，行号 = 时间槽 % 行数，原地更新，
+ *   文件大小在配置时即可确定，不随运行时间增长。
+ *
+ * COUNTER/DERIVE/ABSOLUTE 先换算成每秒速率再归并，GAUGE 直接归并。
+ *
+ * 配置示例（步长:跨度，单位 s/min/h/d/w/y）：
+ *   <Plugin rrd>
+ *     DataDir "/mnt/data/collect/rrd"
+ *     Archive "10s:1h"
+ *     Archive "1min:1d"
+ *     Archive "1h:1y"
+ *     IdleTimeout 3600   # 超过该秒数未写入的文件解除映射，缺省 3600
+ *   </Plugin>
+ *
+ * 修改 Archive 或 types.db 中的数据源后已有文件与配置不符，会被改名为 *.rra.old 并重建。
+ * 映射建立后即关闭 fd，长时间不再写入的序列解除映射，打开的文件数不随序列数增长。
+ *
+ * fetch() 按时间范围与分辨率选一个归档级别，只读取落在范围内的行：
+ * 查询一年的 1h 级别约为 8760 行 × 每数据源 24 字节，不必扫描细粒度归档。
+ */
+
+#define RRD_MAGIC "RRDA"
+#define RRD_VERSION 1
+
+struct RrdFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t dsNum;
+	uint32_t archiveNum;
+	uint64_t fileSize;
+	cdtime_t lastUpdate;
+};
+
+/* 每个数据源上一次的原始值，用于计算速率 */
+struct RrdDsState
+{
+	int32_t type;
+	int32_t valid;
+	value_t last;
+	cdtime_t lastTime;
+};
+
+struct RrdArchiveHeader
+{
+	uint32_t step;       ///< 秒
+	uint32_t rows;
+	int64_t slot;        ///< 当前正在归并的时间槽，-1 表示尚无数据
+	uint64_t dataOffset; ///< 行数据在文件中的偏移
+	uint64_t countOffset;///< 当前槽内各数据源已归并的样本数（uint32 数组）
+};
+
+struct RrdCell
+{
+	double avg;
+	double min;
+	double max;
+};
+
+/* fetch 结果：按时间顺序的行，每行 dsNum 个 RrdCell，无数据时为 NaN */
+struct RrdFetchResult
+{
+	cdtime_t start = 0;
+	uint32_t step = 0;
+	uint32_t dsNum = 0;
+	std::vector<RrdCell> cells;
+};
+
+struct RrdArchiveDef
+{
+	uint32_t step;
+	uint32_t rows;
+};
+
+class CRrdModule final : public CAbstractUserModule
+{
+public:
+	CRrdModule() = default;
+	~CRrdModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int write(const data_set_t *ds, const value_list_t *vl) override;
+	int flush() override;
+	int shutdown() override;
+
+	/*
+	 * 取 ident 在 [from, to] 的数据。resolution（秒）非 0 时只考虑步长不小于它的级别，
+	 * 其中选保留窗口仍覆盖 from 的最细级别，都覆盖不到时用最粗的。
+	 * 已淘汰或本次运行未写过的序列临时只读映射，只有用到的行会被读入。
+	 */
+	int fetch(const std::string &ident, cdtime_t from, cdtime_t to, RrdFetchResult &out,
+	          uint32_t resolution = 0);
+
+	/* 单个文件的字节数，dsNum 个数据源 */
+	size_t fileSize(size_t dsNum) const;
+
+private:
+	struct File
+	{
+		uint8_t *map = nullptr;
+		size_t size = 0;
+		cdtime_t lastUse = 0; ///< 最近一次写入，用于空闲淘汰
+
+		RrdFileHeader *header() const { return reinterpret_cast<RrdFileHeader *>(map); }
+		RrdDsState *ds() const { return reinterpret_cast<RrdDsState *>(map + sizeof(RrdFileHeader)); }
+		RrdArchiveHeader *archive(uint32_t i) const
+		{
+			return reinterpret_cast<RrdArchiveHeader *>(
+				map + sizeof(RrdFileHeader) + header()->dsNum * sizeof(RrdDsState)) + i;
+		}
+		RrdCell *row(const RrdArchiveHeader *a, uint64_t slot) const
+		{
+			return reinterpret_cast<RrdCell *>(map + a->dataOffset) + (slot % a->rows) * header()->dsNum;
+		}
+		uint32_t *counts(const RrdArchiveHeader *a) const
+		{
+			return reinterpret_cast<uint32_t *>(map + a->countOffset);
+		}
+	};
+
+	File *open(const std::string &ident, const data_set_t *ds);
+	int create(const std::string &path, const data_set_t *ds, File &f);
+	/* 文件头与各级别的偏移自洽，可以安全访问 */
+	static bool valid(const File &f);
+	bool matches(const File &f, const data_set_t *ds) const;
+	void readRange(const File &f, cdtime_t from, cdtime_t to, uint32_t resolution, RrdFetchResult &out) const;
+	void update(File &f, const std::vector<double> &values, cdtime_t t);
+	/* 解除空闲超过 IdleTimeout 的映射 */
+	void evictIdle(cdtime_t now);
+	static void closeFile(File &f);
+	void closeAll();
+
+	std::string m_dataDir = "/mnt/data/collect/rrd";
+	std::vector<RrdArchiveDef> m_archives;
+	cdtime_t m_idleTimeout = TIME_T_TO_CDTIME_T(3600);
+	cdtime_t m_nextEvict = 0;
+
+	std::mutex m_mutex;
+	std::unordered_map<std::string, std::unique_ptr<File>> m_files;
+	std::vector<double> m_rates; ///< write() 复用的缓冲
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+	
+#ifdef __cplusplus
+};
+#endif
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "self.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/SelfStats.h"
+#include "../daemon/FilterChain.h"
+#include "../daemon/ProcfsCache.h"
+#include "../daemon/utils/utils.h"
+
+int CSelfModule::config(const std::string &key, const std::string &val)
+{
+	if      (key == "ReportReadLatency")  m_bReadLatency  = IS_TRUE(val.c_str());
+	else if (key == "ReportWriteLatency") m_bWriteLatency = IS_TRUE(val.c_str());
+	else if (key == "ReportProcess")      m_bProcess      = IS_TRUE(val.c_str());
+	else if (key == "ReportProcfs")       m_bProcfs       = IS_TRUE(val.c_str());
+	else return -1;
+
+	return 0;
+}
+
+void CSelfModule::submitGauge(const std::string &pluginInstance, const char *type,
+                              const char *typeInstance, gauge_t value, cdtime_t now)
+{
+	value_list_t vl = VALUE_LIST_INIT;
+	value_t tmp = {.gauge = value};
+
+	vl.values = &tmp;
+	vl.values_len = 1;
+	vl.time = now;
+
+	sstrncpy(vl.plugin, "self", sizeof(vl.plugin));
+	sstrncpy(vl.plugin_instance, pluginInstance.c_str(), sizeof(vl.plugin_instance));
+	sstrncpy(vl.type, type, sizeof(vl.type));
+	sstrncpy(vl.type_instance, typeInstance, sizeof(vl.type_instance));
+
+	PluginService::Instance().dispatchValues(&vl);
+}
+
+void CSelfModule::submitDerive(const std::string &pluginInstance, const char *type,
+                               const char *typeInstance, derive_t value, cdtime_t now)
+{
+	value_list_t vl = VALUE_LIST_INIT;
+	value_t tmp = {.derive = value};
+
+	vl.values = &tmp;
+	vl.values_len = 1;
+	vl.time = now;
+
+	sstrncpy(vl.plugin, "self", sizeof(vl.plugin));
+	sstrncpy(vl.plugin_instance, pluginInstance.c_str(), sizeof(vl.plugin_instance));
+	sstrncpy(vl.type, type, sizeof(vl.type));
+	sstrncpy(vl.type_instance, typeInstance, sizeof(vl.type_instance));
+
+	PluginService::Instance().dispatchValues(&vl);
+}
+
+void CSelfModule::submitLatency(const std::string &pluginInstance,
+                                const LatencySummary &s, cdtime_t now)
+{
+	submitGauge(pluginInstance, "latency", "avg", s.average(), now);
+	submitGauge(pluginInstance, "latency", "max", s.maxNs / 1e9, now);
+	submitGauge(pluginInstance, "latency", "p50", s.quantile(0.50), now);
+	submitGauge(pluginInstance, "latency", "p90", s.quantile(0.90), now);
+	submitGauge(pluginInstance, "latency", "p99", s.quantile(0.99), now);
+	submitGauge(pluginInstance, "count", "calls", static_cast<gauge_t>(s.count), now);
+	submitGauge(pluginInstance, "count", "errors", static_cast<gauge_t>(s.errors), now);
+}
+
+void CSelfModule::submitProcess(cdtime_t now)
+{
+	/* RSS：/proc/self/statm 第二列为驻留页数 */
+	FILE *fp = fopen("/proc/self/statm", "r");
+	if (fp)
+	{
+		unsigned long size = 0, resident = 0;
+		if (fscanf(fp, "%lu %lu", &size, &resident) == 2)
+		{
+			const long pageSize = sysconf(_SC_PAGESIZE);
+			submitGauge("process", "ps_rss", "",
+			            static_cast<gauge_t>(resident) * pageSize, now);
+		}
+		fclose(fp);
+	}
+	else
+	{
+		ERROR("self plugin: open /proc/self/statm failed: %s", strerror(errno));
+	}
+
+	DIR *dir = opendir("/proc/self/fd");
+	if (dir)
+	{
+		int fds = 0;
+		struct dirent *ent;
+		while ((ent = readdir(dir)) != nullptr)
+		{
+			if (ent->d_name[0] != '.')
+				++fds;
+		}
+		closedir(dir);
+		/* 不计 opendir 自身占用的描述符 */
+		submitGauge("process", "file_handles", "open", static_cast<gauge_t>(fds - 1), now);
+	}
+	else
+	{
+		ERROR("self plugin: open /proc/self/fd failed: %s", strerror(errno));
+	}
+}
+
+void CSelfModule::submitProcfs(cdtime_t now)
+{
+	std::vector<ProcfsFileStats> files;
+	ProcfsCache::Instance().snapshot(files);
+
+	for (const auto &f : files)
+	{
+		/* /proc/pid/task/pid/stat -> procfs-pid_task_pid_stat */
+		std::string name = f.path.compare(0, 6, "/proc/") == 0 ? f.path.substr(6) : f.path;
+		std::replace(name.begin(), name.end(), '/', '_');
+		const std::string instance = "procfs-" + name;
+
+		submitDerive(instance, "derive", "reads", static_cast<derive_t>(f.reads), now);
+		submitDerive(instance, "derive", "hits", static_cast<derive_t>(f.hits), now);
+		submitDerive(instance, "derive", "errors", static_cast<derive_t>(f.errors), now);
+		submitDerive(instance, "derive", "bytes", static_cast<derive_t>(f.bytes), now);
+		submitDerive(instance, "derive", "read_ns", static_cast<derive_t>(f.ns), now);
+	}
+}
+
+int CSelfModule::read()
+{
+	SelfStatsSnapshot snap;
+	SelfStats::Instance().snapshot(snap);
+
+	const cdtime_t now = cdtime();
+
+	for (const auto &p : snap.plugins)
+	{
+		if (m_bReadLatency && p.read.count > 0)
+			submitLatency("read-" + p.plugin, p.read, now);
+		if (m_bWriteLatency && p.write.count > 0)
+			submitLatency("write-" + p.plugin, p.write, now);
+	}
+
+	submitGauge("dispatcher", "queue_length", "depth",
+	            static_cast<gauge_t>(snap.queueDepth), now);
+	submitGauge("dispatcher", "queue_length", "high_water",
+	            static_cast<gauge_t>(snap.queueHighWater), now);
+
+	submitDerive("dispatcher", "derive", "enqueued", static_cast<derive_t>(snap.enqueued), now);
+	submitDerive("dispatcher", "derive", "written", static_cast<derive_t>(snap.written), now);
+	submitDerive("dispatcher", "derive", "dropped", static_cast<derive_t>(snap.dropped), now);
+	submitDerive("dispatcher", "derive", "filtered",
+	             static_cast<derive_t>(FilterChain::Instance().droppedCount()), now);
+
+	if (m_lastTime != 0 && now > m_lastTime)
+	{
+		const double elapsed = CDTIME_T_TO_DOUBLE(now - m_lastTime);
+		submitGauge("dispatcher", "operations_per_second", "enqueued",
+		            (snap.enqueued - m_lastEnqueued) / elapsed, now);
+		submitGauge("dispatcher", "operations_per_second", "written",
+		            (snap.written - m_lastWritten) / elapsed, now);
+	}
+	m_lastEnqueued = snap.enqueued;
+	m_lastWritten = snap.written;
+	m_lastTime = now;
+
+	if (m_bProcess)
+		submitProcess(now);
+
+	if (m_bProcfs)
+		submitProcfs(now);
+
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CSelfModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != nullptr);
+	delete pUserModule;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+#include "ModuleBase.h"
+
+struct LatencySummary;
+
+class CSelfModule final : public CAbstractUserModule
+{
+public:
+	CSelfModule() = default;
+	~CSelfModule() override = default;
+
+	int config(const std::string &key, const std::string &val) override;
+	int read() override;
+
+private:
+	void submitGauge(const std::string &pluginInstance, const char *type,
+	                 const char *typeInstance, gauge_t value, cdtime_t now);
+	void submitDerive(const std::string &pluginInstance, const char *type,
+	                  const char *typeInstance, derive_t value, cdtime_t now);
+	void submitLatency(const std::string &pluginInstance,
+	                   const LatencySummary &s, cdtime_t now);
+	void submitProcess(cdtime_t now);
+	void submitProcfs(cdtime_t now);
+
+	bool m_bReadLatency{true};
+	bool m_bWriteLatency{true};
+	bool m_bProcess{true};
+	bool m_bProcfs{true};
+
+	/* 上次读取的累计计数，用于计算每秒速率 */
+	uint64_t m_lastEnqueued{0};
+	uint64_t m_lastWritten{0};
+	cdtime_t m_lastTime{0};
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+	
+#ifdef __cplusplus
+};
+#endif
@@ -0,0 +1,239 @@
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "shm.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/QuantileSketch.h"
+#include "../daemon/utils/utils.h"
+
+namespace
+{
+	double toDouble(int dsType, const value_t &v)
+	{
+		switch (dsType)
+		{
+		case DS_TYPE_GAUGE:    return v.gauge;
+		case DS_TYPE_DERIVE:   return static_cast<double>(v.derive);
+		case DS_TYPE_COUNTER:  return static_cast<double>(v.counter);
+		case DS_TYPE_ABSOLUTE: return static_cast<double>(v.absolute);
+		case DS_TYPE_SKETCH:   return sketch_scalar(v);
+		}
+		return 0.0;
+	}
+
+	uint64_t roundUpPow2(uint64_t n)
+	{
+		uint64_t p = 1;
+		while (p < n)
+			p <<= 1;
+		return p;
+	}
+}
+
+CShmModule::~CShmModule()
+{
+	unmap();
+}
+
+int CShmModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "Name")
+	{
+		if (val.empty() || val[0] != '/' || val.find('/', 1) != std::string::npos)
+		{
+			ERROR("shm plugin: Name must look like \"/name\".");
+			return -1;
+		}
+		m_name = val;
+	}
+	else if (key == "Series")
+	{
+		const long n = atol(val.c_str());
+		if (n <= 0)
+		{
+			ERROR("shm plugin: Series must be positive.");
+			return -1;
+		}
+		m_seriesCapacity = static_cast<uint32_t>(n);
+	}
+	else if (key == "RingSize")
+	{
+		const long n = atol(val.c_str());
+		if (n <= 0)
+		{
+			ERROR("shm plugin: RingSize must be positive.");
+			return -1;
+		}
+		m_ringCapacity = roundUpPow2(static_cast<uint64_t>(n));
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+int CShmModule::init()
+{
+	/* 旧对象可能仍被读端映射：先 unlink 再新建，读端通过 closed/generation 感知并重新 open */
+	shm_unlink(m_name.c_str());
+
+	int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+	{
+		ERROR("shm plugin: shm_open %s failed: %s", m_name.c_str(), strerror(errno));
+		return -1;
+	}
+
+	m_size = collect::shmRingSize(m_seriesCapacity, m_ringCapacity);
+	if (ftruncate(fd, static_cast<off_t>(m_size)) != 0)
+	{
+		ERROR("shm plugin: ftruncate %s failed: %s", m_name.c_str(), strerror(errno));
+		close(fd);
+		shm_unlink(m_name.c_str());
+		return -1;
+	}
+
+	void *p = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+	{
+		ERROR("shm plugin: mmap %s failed: %s", m_name.c_str(), strerror(errno));
+		shm_unlink(m_name.c_str());
+		return -1;
+	}
+
+	/* ftruncate 出来的内存已清零，原子变量的零值即初始状态 */
+	m_base = static_cast<uint8_t *>(p);
+	m_header = reinterpret_cast<collect::ShmRingHeader *>(m_base);
+	m_series = reinterpret_cast<collect::ShmSeriesEntry *>(m_base + sizeof(collect::ShmRingHeader));
+	m_ring = reinterpret_cast<collect::ShmRingSlot *>(m_series + m_seriesCapacity);
+
+	m_header->version = collect::kShmVersion;
+	m_header->seriesCapacity = m_seriesCapacity;
+	m_header->ringCapacity = m_ringCapacity;
+	m_header->generation = cdtime();
+	std::atomic_thread_fence(std::memory_order_release);
+	/* magic 最后写入，读端看到 magic 即表示头部完整 */
+	memcpy(m_header->magic, collect::kShmMagic, sizeof(collect::kShmMagic));
+
+	INFO("shm plugin: exporting to %s (%zu bytes, %u series, ring %llu).", m_name.c_str(),
+	     m_size, m_seriesCapacity, static_cast<unsigned long long>(m_ringCapacity));
+	return 0;
+}
+
+int CShmModule::seriesIndex(const std::string &name, int dsType)
+{
+	auto it = m_index.find(name);
+	if (it != m_index.end())
+		return static_cast<int>(it->second);
+
+	const uint32_t idx = m_header->seriesCount.load(std::memory_order_relaxed);
+	if (idx >= m_seriesCapacity)
+	{
+		if (!m_fullWarned)
+		{
+			WARNING("shm plugin: series table full (%u), new series are not exported.", m_seriesCapacity);
+			m_fullWarned = true;
+		}
+		return -1;
+	}
+
+	collect::ShmSeriesEntry &e = m_series[idx];
+	sstrncpy(e.name, name.c_str(), sizeof(e.name));
+	e.dsType = dsType;
+	/* 名称写好后再发布计数，读端看到的序列名总是完整的 */
+	m_header->seriesCount.store(idx + 1, std::memory_order_release);
+
+	m_index.emplace(name, idx);
+	return static_cast<int>(idx);
+}
+
+void CShmModule::publish(uint32_t idx, cdtime_t time, double value)
+{
+	const uint64_t bits = collect::shmDoubleToBits(value);
+
+	/* 序列最新值：seqlock 写 */
+	collect::ShmSeriesEntry &e = m_series[idx];
+	const uint32_t s = e.seq.load(std::memory_order_relaxed);
+	e.seq.store(s + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	e.time.store(time, std::memory_order_relaxed);
+	e.value.store(bits, std::memory_order_relaxed);
+	e.updates.store(e.updates.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	e.seq.store(s + 2, std::memory_order_release);
+
+	/* 更新环：槽内 seq 编码位置，读端据此识别覆盖 */
+	const uint64_t pos = m_header->head.load(std::memory_order_relaxed);
+	collect::ShmRingSlot &slot = m_ring[pos & (m_ringCapacity - 1)];
+	slot.seq.store(2 * pos + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.series.store(idx, std::memory_order_relaxed);
+	slot.time.store(time, std::memory_order_relaxed);
+	slot.value.store(bits, std::memory_order_relaxed);
+	slot.seq.store(2 * pos + 2, std::memory_order_release);
+	m_header->head.store(pos + 1, std::memory_order_release);
+}
+
+int CShmModule::write(const data_set_t *ds, const value_list_t *vl)
+{
+	if (!ds || !vl || ds->ds_num != vl->values_len)
+		return -1;
+
+	char ident[512];
+	if (FORMAT_VL(ident, sizeof(ident), vl) != 0)
+		return -1;
+
+	std::lock_guard<std::mutex> lk(m_mutex);
+	if (!m_base)
+		return -1;
+
+	for (size_t i = 0; i < ds->ds_num; ++i)
+	{
+		m_key.assign(ident);
+		m_key += ':';
+		m_key += ds->ds[i].name;
+
+		const int idx = seriesIndex(m_key, ds->ds[i].type);
+		if (idx < 0)
+			continue;
+		publish(static_cast<uint32_t>(idx), vl->time, toDouble(ds->ds[i].type, vl->values[i]));
+	}
+	return 0;
+}
+
+void CShmModule::unmap()
+{
+	if (!m_base)
+		return;
+	m_header->closed.store(1, std::memory_order_release);
+	munmap(m_base, m_size);
+	m_base = nullptr;
+	m_header = nullptr;
+	m_series = nullptr;
+	m_ring = nullptr;
+}
+
+int CShmModule::shutdown()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	unmap();
+	shm_unlink(m_name.c_str());
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CShmModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != nullptr);
+	delete pUserModule;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "ModuleBase.h"
+#include "shm_ring.h"
+
+/*
+ * 共享内存导出 writer：把样本写入 POSIX 共享内存中的序列表 + 更新环，
+ * 同机进程通过 shm_ring.h 中的 collect::ShmReader 无系统调用地读取。
+ *
+ * 配置示例：
+ *   <Plugin shm>
+ *     Name "/collect"
+ *     Series 4096        # 序列表容量，写满后新序列被忽略
+ *     RingSize 65536     # 更新环槽数，向上取 2 的幂
+ *   </Plugin>
+ */
+class CShmModule final : public CAbstractUserModule
+{
+public:
+	CShmModule() = default;
+	~CShmModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int write(const data_set_t *ds, const value_list_t *vl) override;
+	int shutdown() override;
+
+private:
+	/* 返回序列下标，表满时返回 -1 */
+	int seriesIndex(const std::string &name, int dsType);
+	void publish(uint32_t idx, cdtime_t time, double value);
+	void unmap();
+
+	std::string m_name = "/collect";
+	uint32_t m_seriesCapacity = 4096;
+	uint64_t m_ringCapacity = 65536;
+
+	std::mutex m_mutex;
+	uint8_t *m_base = nullptr;
+	size_t m_size = 0;
+	collect::ShmRingHeader *m_header = nullptr;
+	collect::ShmSeriesEntry *m_series = nullptr;
+	collect::ShmRingSlot *m_ring = nullptr;
+
+	std::unordered_map<std::string, uint32_t> m_index;
+	std::string m_key; ///< write() 复用的序列名缓冲
+	bool m_fullWarned = false;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+	
+#ifdef __cplusplus
+};
+#endif
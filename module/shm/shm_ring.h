@@ -0,0 +1,254 @@
+#pragma once
+
+/*
+ * collect 共享内存导出格式 + 只读客户端库（header-only，不依赖守护进程代码）。
+ *
+ * 布局（shm_open 对象，默认 "/collect"）：
+ *   ShmRingHeader
+ *   ShmSeriesEntry[seriesCapacity]   每条序列的最新值，逐条 seqlock
+ *   ShmRingSlot[ringCapacity]        所有更新按顺序写入的环，逐槽 seqlock
+ *
+ * 写端只有一个（shm 插件），读端任意多个。读端 open() 之后的读取
+ * 全部在映射内存上完成，无系统调用；数据以 seqlock 读出，写端不会被阻塞。
+ *
+ * 用法：
+ *   collect::ShmReader r;
+ *   if (r.open("/collect") == 0) {
+ *       int idx = r.find("cpu-0/cpu-idle:value");
+ *       collect::ShmSample s;
+ *       if (idx >= 0 && r.latest(idx, s)) ...
+ *
+ *       uint64_t pos = r.head();        // 之后用 next() 追新的更新
+ *       while (r.next(pos, s)) ...
+ *   }
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace collect
+{
+
+static const char kShmMagic[8] = {'C', 'O', 'L', 'S', 'H', 'M', '0', '1'};
+static const uint32_t kShmVersion = 1;
+static const size_t kShmNameLen = 192;
+/* seqlock 读重试上限：写端在写入中途崩溃时避免读端死循环 */
+static const int kShmMaxRetries = 1024;
+
+struct ShmRingHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t seriesCapacity;
+	uint64_t ringCapacity;             ///< 2 的幂
+	uint64_t generation;               ///< 写端每次启动不同，读端可据此判断需要重新 open
+	std::atomic<uint32_t> seriesCount; ///< 已发布的序列数，只增不减
+	std::atomic<uint32_t> closed;      ///< 写端已退出
+	std::atomic<uint64_t> head;        ///< 下一个要写入的环位置（单调递增）
+};
+
+struct ShmSeriesEntry
+{
+	/* 以下字段在 seriesCount 发布前写好，之后不再改变 */
+	char name[kShmNameLen];            ///< "<标识>:<数据源>"
+	int32_t dsType;
+	uint32_t reserved;
+
+	/* seqlock 保护的最新值 */
+	std::atomic<uint32_t> seq;
+	std::atomic<uint64_t> time;        ///< cdtime_t
+	std::atomic<uint64_t> value;       ///< double 的位模式
+	std::atomic<uint64_t> updates;
+};
+
+struct ShmRingSlot
+{
+	std::atomic<uint64_t> seq;         ///< 2*pos+1 写入中，2*pos+2 写入完成
+	std::atomic<uint32_t> series;
+	std::atomic<uint64_t> time;
+	std::atomic<uint64_t> value;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm ring requires lock-free 64-bit atomics");
+
+inline size_t shmRingSize(uint32_t seriesCapacity, uint64_t ringCapacity)
+{
+	return sizeof(ShmRingHeader) + seriesCapacity * sizeof(ShmSeriesEntry) +
+	       ringCapacity * sizeof(ShmRingSlot);
+}
+
+inline double shmBitsToDouble(uint64_t u)
+{
+	double d;
+	memcpy(&d, &u, sizeof(d));
+	return d;
+}
+
+inline uint64_t shmDoubleToBits(double d)
+{
+	uint64_t u;
+	memcpy(&u, &d, sizeof(u));
+	return u;
+}
+
+struct ShmSample
+{
+	uint32_t series = 0;
+	uint64_t time = 0;    ///< cdtime_t（2^-30 秒）
+	double value = 0.0;
+	uint64_t updates = 0; ///< 仅 latest() 填写
+};
+
+class ShmReader
+{
+public:
+	ShmReader() = default;
+	~ShmReader() { close(); }
+
+	ShmReader(const ShmReader &) = delete;
+	ShmReader &operator=(const ShmReader &) = delete;
+
+	/* 成功返回 0，否则返回 errno */
+	int open(const char *name)
+	{
+		close();
+		int fd = shm_open(name, O_RDONLY, 0);
+		if (fd < 0)
+			return errno;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader))
+		{
+			::close(fd);
+			return EINVAL;
+		}
+		void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (p == MAP_FAILED)
+			return errno;
+
+		m_base = static_cast<const uint8_t *>(p);
+		m_size = static_cast<size_t>(st.st_size);
+
+		const ShmRingHeader *h = header();
+		if (memcmp(h->magic, kShmMagic, sizeof(kShmMagic)) != 0 || h->version != kShmVersion ||
+		    shmRingSize(h->seriesCapacity, h->ringCapacity) > m_size)
+		{
+			close();
+			return EINVAL;
+		}
+		m_series = reinterpret_cast<const ShmSeriesEntry *>(m_base + sizeof(ShmRingHeader));
+		m_ring = reinterpret_cast<const ShmRingSlot *>(m_series + h->seriesCapacity);
+		m_mask = h->ringCapacity - 1;
+		return 0;
+	}
+
+	void close()
+	{
+		if (m_base)
+			munmap(const_cast<uint8_t *>(m_base), m_size);
+		m_base = nullptr;
+		m_size = 0;
+	}
+
+	bool isOpen() const { return m_base != nullptr; }
+	const ShmRingHeader *header() const { return reinterpret_cast<const ShmRingHeader *>(m_base); }
+
+	/* 写端已退出或已重启时需要重新 open */
+	bool stale(uint64_t generation) const
+	{
+		return header()->closed.load(std::memory_order_acquire) != 0 ||
+		       header()->generation != generation;
+	}
+
+	uint32_t seriesCount() const { return header()->seriesCount.load(std::memory_order_acquire); }
+	const char *name(uint32_t idx) const { return m_series[idx].name; }
+	int dsType(uint32_t idx) const { return m_series[idx].dsType; }
+
+	/* 按名称线性查找，返回下标；调用方应缓存结果 */
+	int find(const char *name) const
+	{
+		const uint32_t n = seriesCount();
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			if (strncmp(m_series[i].name, name, kShmNameLen) == 0)
+				return static_cast<int>(i);
+		}
+		return -1;
+	}
+
+	/* 读取某序列的最新值；尚无数据时返回 false */
+	bool latest(uint32_t idx, ShmSample &out) const
+	{
+		if (idx >= seriesCount())
+			return false;
+		const ShmSeriesEntry &e = m_series[idx];
+		for (int retry = 0; retry < kShmMaxRetries; ++retry)
+		{
+			const uint32_t s1 = e.seq.load(std::memory_order_acquire);
+			if (s1 & 1)
+				continue;
+			out.series = idx;
+			out.time = e.time.load(std::memory_order_relaxed);
+			out.value = shmBitsToDouble(e.value.load(std::memory_order_relaxed));
+			out.updates = e.updates.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (e.seq.load(std::memory_order_relaxed) == s1)
+				return s1 != 0;
+		}
+		return false;
+	}
+
+	uint64_t head() const { return header()->head.load(std::memory_order_acquire); }
+
+	/*
+	 * 顺序读取环：pos 为下一个要读的位置，成功时前移。
+	 * 已追上写端返回 false；落后超过一圈时 pos 跳到仍然有效的最旧位置。
+	 */
+	bool next(uint64_t &pos, ShmSample &out) const
+	{
+		for (int retry = 0; retry < kShmMaxRetries; ++retry)
+		{
+			const uint64_t h = head();
+			if (pos >= h)
+				return false;
+			if (h - pos > m_mask + 1)
+				pos = h - (m_mask + 1);
+
+			const ShmRingSlot &slot = m_ring[pos & m_mask];
+			const uint64_t s1 = slot.seq.load(std::memory_order_acquire);
+			if (s1 != 2 * pos + 2)
+			{
+				/* 已被下一圈覆盖（或正在覆盖）则跳过该位置 */
+				if (s1 < 2 * pos + 2)
+					return false;
+				++pos;
+				continue;
+			}
+			out.series = slot.series.load(std::memory_order_relaxed);
+			out.time = slot.time.load(std::memory_order_relaxed);
+			out.value = shmBitsToDouble(slot.value.load(std::memory_order_relaxed));
+			out.updates = 0;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.seq.load(std::memory_order_relaxed) != s1)
+				continue;
+			++pos;
+			return true;
+		}
+		return false;
+	}
+
+private:
+	const uint8_t *m_base = nullptr;
+	size_t m_size = 0;
+	const ShmSeriesEntry *m_series = nullptr;
+	const ShmRingSlot *m_ring = nullptr;
+	uint64_t m_mask = 0;
+};
+
+} // namespace collect
@@ -13,11 +13,13 @@
 #include <chrono>
 #include <set>
 #include <cstring>
+#include <string_view>
 #include <thread>
 #include <assert.h>
 
 #include "thread.h"
 #include "../daemon/PluginService.h"
+#include "../daemon/ProcfsCache.h"
 #include "../daemon/utils/utils.h"
 #include "../oconfig/configfile.h"
 
@@ -58,7 +60,14 @@ std::string sched_policy_to_string(long policy_num)
 	return it != policy_map.end() ? it->second : "UNKNOWN_POLICY";
 }
 
-CThreadModule::CThreadModule() : m_nHz(0), m_bIsfirstCall(true) {}
+CThreadModule::CThreadModule() : m_nHz(sysconf(_SC_CLK_TCK))
+{
+	if (m_nHz <= 0)
+	{
+		ERROR("Warning: Using fallback HZ=100");
+		m_nHz = 100;
+	}
+}
 
 int CThreadModule::config(const std::string &key, const std::string &val)
 {
@@ -66,25 +75,15 @@ int CThreadModule::config(const std::string &key, const std::string &val)
 }
 
 // 收集线程数据但不输出
-ThreadDataSnapshot CThreadModule::collectThreadData()
+ThreadDataSnapshot CThreadModule::collectThreadData(ThreadCpuBaseline& base, bool refresh)
 {
 	ThreadDataSnapshot snapshot;
 
-	if (m_nHz == 0)
-	{
-		m_nHz = sysconf(_SC_CLK_TCK);
-		if (m_nHz <= 0)
-		{
-			ERROR("Warning: Using fallback HZ=100");
-			m_nHz = 100;
-		}
-	}
-
 	snapshot.timestamp = std::chrono::steady_clock::now();
-	if (!m_bIsfirstCall)
+	if (!base.first)
 	{
 		auto duration = std::chrono::duration_cast<std::chrono::duration<double>>(
-			snapshot.timestamp - prev_timestamp);
+			snapshot.timestamp - base.prev_timestamp);
 		snapshot.time_delta_seconds = duration.count();
 	}
 
@@ -116,30 +115,38 @@ ThreadDataSnapshot CThreadModule::collectThreadData()
 		info.tid = tid;
 		snapshot.current_tids.insert(tid);
 
+		const std::string tid_dir = task_dir + "/" + entry->d_name;
+		ProcfsSnapshot snap;
+		std::string_view text;
+
 		// 获取线程名
-		std::string comm_path = task_dir + "/" + entry->d_name + "/comm";
-		std::ifstream comm_file(comm_path);
-		if (comm_file) std::getline(comm_file, info.name);
-
-		// 解析stat文件
-		std::string stat_path = task_dir + "/" + entry->d_name + "/stat";
-		std::ifstream stat_file(stat_path);
-		if (stat_file)
+		if (ProcfsCache::Instance().get((tid_dir + "/comm").c_str(), snap, refresh) == 0)
 		{
-			std::string line;
-			std::getline(stat_file, line);
-			std::istringstream ss(line);
-			std::vector<std::string> fields{
-			    std::istream_iterator<std::string>{ss},
-			    std::istream_iterator<std::string>{}
-			};
-
-			if (fields.size() > 2) info.state = fields[2][0];
-			if (fields.size() > 13) info.utime = std::stoul(fields[13]);
-			if (fields.size() > 14) info.stime = std::stoul(fields[14]);
-			if (fields.size() > 18) info.nice = std::stol(fields[18]);
-			if (fields.size() > 39) info.rt_priority = std::stol(fields[39]);
-			if (fields.size() > 40) info.sched_policy = std::stol(fields[40]);
+			text = snap.view();
+			info.name.assign(text.substr(0, text.find('\n')));
+		}
+
+		// 解析stat文件：线程名可能含空格，从最后一个 ')' 之后按空格切分，第一个字段为第 2 列 state
+		if (ProcfsCache::Instance().get((tid_dir + "/stat").c_str(), snap, refresh) == 0)
+		{
+			text = snap.view();
+			const size_t rparen = text.rfind(')');
+			const char *p = text.data() + (rparen == std::string_view::npos ? text.size() : rparen + 1);
+			const char *end = text.data() + text.size();
+			for (int field = 2; field <= 40; ++field)
+			{
+				while (p < end && *p == ' ') ++p;
+				if (p >= end || *p == '\n') break;
+
+				if (field == 2) info.state = *p;
+				else if (field == 13) info.utime = strtoul(p, nullptr, 10);
+				else if (field == 14) info.stime = strtoul(p, nullptr, 10);
+				else if (field == 18) info.nice = strtol(p, nullptr, 10);
+				else if (field == 39) info.rt_priority = strtol(p, nullptr, 10);
+				else if (field == 40) info.sched_policy = strtol(p, nullptr, 10);
+
+				while (p < end && *p != ' ' && *p != '\n') ++p;
+			}
 		}
 
 		// 计算CPU时间
@@ -148,10 +155,10 @@ ThreadDataSnapshot CThreadModule::collectThreadData()
 		info.total_time = info.user_time + info.sys_time;
 
 		// CPU使用率计算
-		if (!m_bIsfirstCall)
+		if (!base.first)
 		{
-			auto prev_it = prev_cpu_times.find(tid);
-			if (prev_it != prev_cpu_times.end())
+			auto prev_it = base.prev_cpu_times.find(tid);
+			if (prev_it != base.prev_cpu_times.end())
 			{
 				unsigned long delta = 
 				    (info.utime - prev_it->second.first) + 
@@ -162,23 +169,16 @@ ThreadDataSnapshot CThreadModule::collectThreadData()
 		}
 
 		// 获取栈内存
-		std::string status_path = task_dir + "/" + entry->d_name + "/status";
-		std::ifstream status_file(status_path);
-		if (status_file)
+		if (ProcfsCache::Instance().get((tid_dir + "/status").c_str(), snap, refresh) == 0)
 		{
-			std::string line;
-			while (std::getline(status_file, line))
-			{
-				if (line.compare(0, 6, "VmStk:") == 0)
-				{
-					info.vm_stack_kb = std::stoul(line.substr(6));
-					break;
-				}
-			}
+			text = snap.view();
+			const size_t pos = text.find("\nVmStk:");
+			if (pos != std::string_view::npos)
+				info.vm_stack_kb = strtoul(text.data() + pos + 7, nullptr, 10);
 		}
 
 		// 统计文件描述符
-		std::string fd_path = task_dir + "/" + entry->d_name + "/fd";
+		std::string fd_path = tid_dir + "/fd";
 		DIR *fd_dir = opendir(fd_path.c_str());
 		if (fd_dir)
 		{
@@ -194,16 +194,16 @@ ThreadDataSnapshot CThreadModule::collectThreadData()
 		}
 
 		snapshot.threads.push_back(info);
-		prev_cpu_times[tid] = {info.utime, info.stime};
+		base.prev_cpu_times[tid] = {info.utime, info.stime};
 	}
 	closedir(dir);
 
 	// 清理不存在的线程
-	for (auto it = prev_cpu_times.begin(); it != prev_cpu_times.end(); )
+	for (auto it = base.prev_cpu_times.begin(); it != base.prev_cpu_times.end(); )
 	{
 		if (!snapshot.current_tids.count(it->first))
 		{
-			it = prev_cpu_times.erase(it);
+			it = base.prev_cpu_times.erase(it);
 		}
 		else
 		{
@@ -211,8 +211,8 @@ ThreadDataSnapshot CThreadModule::collectThreadData()
 		}
 	}
 
-	prev_timestamp = snapshot.timestamp;
-	if (m_bIsfirstCall) m_bIsfirstCall = false;
+	base.prev_timestamp = snapshot.timestamp;
+	base.first = false;
 
 	return snapshot;
 }
@@ -291,13 +291,53 @@ void CThreadModule::outputThreadReport(const ThreadDataSnapshot& snapshot, std::
 		   << " CPU:" << std::setw(6) << t.cpu_usage << "%\n";
 	}
 
-	if (m_bIsfirstCall)
+	if (snapshot.time_delta_seconds <= 0.0)
 	{
 		os << " (CPU usage initialized)\n";
 	}
 	os << "\n--- Report End ---\n\n";
 }
 
+// 上报线程数与按线程名汇总的 CPU 使用率（同名线程之和可超过 100，故不用 percent）
+int CThreadModule::read()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	const bool first = m_readBaseline.first;
+	const ThreadDataSnapshot snapshot = collectThreadData(m_readBaseline);
+	if (snapshot.current_tids.empty())
+		return -1;
+
+	value_t value;
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = &value;
+	vl.values_len = 1;
+	sstrncpy(vl.plugin, "thread", sizeof(vl.plugin));
+	sstrncpy(vl.plugin_instance, TARGET_PROCESS, sizeof(vl.plugin_instance));
+
+	sstrncpy(vl.type, "threads", sizeof(vl.type));
+	value.gauge = static_cast<gauge_t>(snapshot.threads.size());
+	PluginService::Instance().dispatchValues(&vl);
+
+	// 首次采集没有 CPU 基准
+	if (first)
+		return 0;
+
+	std::map<std::string, double> cpu_by_name;
+	for (const auto &t : snapshot.threads)
+	{
+		cpu_by_name[t.name] += t.cpu_usage;
+	}
+
+	sstrncpy(vl.type, "cpu_percent", sizeof(vl.type));
+	for (const auto &kv : cpu_by_name)
+	{
+		sstrncpy(vl.type_instance, kv.first.c_str(), sizeof(vl.type_instance));
+		value.gauge = kv.second;
+		PluginService::Instance().dispatchValues(&vl);
+	}
+	return 0;
+}
+
 int CThreadModule::flush()
 {
 	INFO("Collecting thread data for '%s'...", TARGET_PROCESS);
@@ -309,8 +349,10 @@ int CThreadModule::flush()
 	}
 	const std::string outPath = strDir + "/" + OUTPUT_FILENAME;
 
-	// 第一次收集（初始化CPU计算基准）
-	collectThreadData();
+	// 第一次收集（初始化CPU计算基准）；flush 不在采集节拍内，强制重新读取 procfs。
+	// 基准只属于本次 flush，不影响 read 的采样间隔，等待期间也不阻塞 read
+	ThreadCpuBaseline base;
+	collectThreadData(base, true);
 	std::this_thread::sleep_for(std::chrono::seconds(1));
 
 	// 第二次收集并输出到文件
@@ -321,7 +363,7 @@ int CThreadModule::flush()
 		return -1;
 	}
 
-	outputThreadReport(collectThreadData(), outfile);
+	outputThreadReport(collectThreadData(base, true), outfile);
 	INFO("Thread report saved to %s", outPath.c_str());
 	return 0;
 }
@@ -5,6 +5,7 @@
 #include <map>
 #include <set>
 #include <chrono>
+#include <mutex>
 #include "ModuleBase.h"
 
 // 线程信息结构体
@@ -40,6 +41,14 @@ struct ThreadDataSnapshot
 	std::set<pid_t> current_tids;                    // 当前活跃TID集合
 };
 
+// CPU使用率计算基准：上次采样的各线程CPU时间与时间戳
+struct ThreadCpuBaseline
+{
+	bool first = true;                                                       // 尚无基准
+	std::map<pid_t, std::pair<unsigned long, unsigned long>> prev_cpu_times; // 历史CPU时间
+	std::chrono::steady_clock::time_point prev_timestamp;                    // 上次时间戳
+};
+
 class CThreadModule final : public CAbstractUserModule
 {
 public:
@@ -47,15 +56,16 @@ public:
 	~CThreadModule() override = default;
 
 	int config(const std::string &key, const std::string &val) override;
+	int read() override;
 	int flush() override;
 
 private:
+	std::mutex m_mutex;                                // 保护 read 的基准；flush 用自己的基准，不取此锁
 	long m_nHz;                                        // 时钟频率
-	bool m_bIsfirstCall;                               // 首次调用标志
-	std::map<pid_t, std::pair<unsigned long, unsigned long>> prev_cpu_times; // 历史CPU时间
-	std::chrono::steady_clock::time_point prev_timestamp; // 上次时间戳
+	ThreadCpuBaseline m_readBaseline;                  // read 的CPU基准
 
-	ThreadDataSnapshot collectThreadData();        // 收集线程数据
+	ThreadDataSnapshot collectThreadData(          // 收集线程数据并更新 base，refresh 时绕过本周期 procfs 快照
+		ThreadCpuBaseline& base, bool refresh = false);
 	void outputThreadReport(                       // 输出线程报告
 		const ThreadDataSnapshot& snapshot, 
 		std::ostream& os);
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+ * Gorilla 风格的时间序列块编码（header-only，tsdb 模块与 bench 共用）：
+ *   - 时间戳（毫秒）：首个原样 64 位，其后按 delta-of-delta 变长编码
+ *       '0'                  dod == 0
+ *       '10'   + 7 位        dod ∈ [-64, 63]
+ *       '110'  + 9 位        dod ∈ [-256, 255]
+ *       '1110' + 12 位       dod ∈ [-2048, 2047]
+ *       '1111' + 64 位       其它
+ *   - 数值：首个原样 64 位，其后与前值的位模式做 XOR
+ *       '0'                  与前值相同
+ *       '10'  + 有效位       有效位落在上一次的前导/尾随零窗口内
+ *       '11'  + 5 位前导零 + 6 位(有效位长度-1) + 有效位
+ * 规则采样时每个样本约 1~2 字节。
+ */
+
+namespace gorilla
+{
+
+class BitWriter
+{
+public:
+	void write(uint64_t v, int nbits)
+	{
+		while (nbits > 0)
+		{
+			if (m_free == 0)
+			{
+				m_buf.push_back(0);
+				m_free = 8;
+			}
+			const int n = nbits < m_free ? nbits : m_free;
+			const uint8_t chunk = static_cast<uint8_t>((v >> (nbits - n)) & ((1u << n) - 1));
+			m_buf.back() |= static_cast<uint8_t>(chunk << (m_free - n));
+			m_free -= n;
+			nbits -= n;
+		}
+	}
+
+	void writeBit(bool b) { write(b ? 1 : 0, 1); }
+
+	const std::vector<uint8_t> &bytes() const { return m_buf; }
+	size_t size() const { return m_buf.size(); }
+
+	void clear()
+	{
+		m_buf.clear();
+		m_free = 0;
+	}
+
+private:
+	std::vector<uint8_t> m_buf;
+	int m_free = 0; ///< 最后一个字节剩余的空闲位数
+};
+
+class BitReader
+{
+public:
+	BitReader(const uint8_t *data, size_t len) : m_data(data), m_bits(len * 8) {}
+
+	/* 越界返回 false */
+	bool read(int nbits, uint64_t &out)
+	{
+		if (m_pos + nbits > m_bits)
+			return false;
+		uint64_t v = 0;
+		while (nbits > 0)
+		{
+			const size_t byte = m_pos >> 3;
+			const int avail = 8 - static_cast<int>(m_pos & 7);
+			const int n = nbits < avail ? nbits : avail;
+			const uint8_t chunk = static_cast<uint8_t>((m_data[byte] >> (avail - n)) & ((1u << n) - 1));
+			v = (v << n) | chunk;
+			m_pos += n;
+			nbits -= n;
+		}
+		out = v;
+		return true;
+	}
+
+	bool readBit(bool &b)
+	{
+		uint64_t v;
+		if (!read(1, v))
+			return false;
+		b = (v != 0);
+		return true;
+	}
+
+private:
+	const uint8_t *m_data;
+	size_t m_bits;
+	size_t m_pos = 0;
+};
+
+inline int64_t signExtend(uint64_t v, int nbits)
+{
+	const uint64_t m = 1ULL << (nbits - 1);
+	v &= (nbits == 64) ? ~0ULL : ((1ULL << nbits) - 1);
+	return static_cast<int64_t>((v ^ m) - m);
+}
+
+inline uint64_t doubleBits(double d)
+{
+	uint64_t u;
+	memcpy(&u, &d, sizeof(u));
+	return u;
+}
+
+inline double bitsDouble(uint64_t u)
+{
+	double d;
+	memcpy(&d, &u, sizeof(d));
+	return d;
+}
+
+class Encoder
+{
+public:
+	void append(int64_t t, double v)
+	{
+		const uint64_t bits = doubleBits(v);
+
+		if (m_count == 0)
+		{
+			m_out.write(static_cast<uint64_t>(t), 64);
+			m_out.write(bits, 64);
+			m_tmin = t;
+		}
+		else
+		{
+			const int64_t delta = t - m_prevT;
+			const int64_t dod = delta - m_prevDelta;
+			if (dod == 0)
+				m_out.write(0, 1);
+			else if (dod >= -64 && dod <= 63)
+			{
+				m_out.write(0x2, 2);
+				m_out.write(static_cast<uint64_t>(dod), 7);
+			}
+			else if (dod >= -256 && dod <= 255)
+			{
+				m_out.write(0x6, 3);
+				m_out.write(static_cast<uint64_t>(dod), 9);
+			}
+			else if (dod >= -2048 && dod <= 2047)
+			{
+				m_out.write(0xE, 4);
+				m_out.write(static_cast<uint64_t>(dod), 12);
+			}
+			else
+			{
+				m_out.write(0xF, 4);
+				m_out.write(static_cast<uint64_t>(dod), 64);
+			}
+			m_prevDelta = delta;
+
+			const uint64_t x = bits ^ m_prevBits;
+			if (x == 0)
+			{
+				m_out.write(0, 1);
+			}
+			else
+			{
+				int lead = __builtin_clzll(x);
+				const int trail = __builtin_ctzll(x);
+				if (lead > 31)
+					lead = 31;
+
+				if (m_prevLead >= 0 && lead >= m_prevLead && trail >= m_prevTrail)
+				{
+					const int sig = 64 - m_prevLead - m_prevTrail;
+					m_out.write(0x2, 2);
+					m_out.write(x >> m_prevTrail, sig);
+				}
+				else
+				{
+					const int sig = 64 - lead - trail;
+					m_out.write(0x3, 2);
+					m_out.write(static_cast<uint64_t>(lead), 5);
+					m_out.write(static_cast<uint64_t>(sig - 1), 6);
+					m_out.write(x >> trail, sig);
+					m_prevLead = lead;
+					m_prevTrail = trail;
+				}
+			}
+		}
+
+		m_prevT = t;
+		m_prevBits = bits;
+		m_tmax = t;
+		++m_count;
+	}
+
+	uint32_t count() const { return m_count; }
+	int64_t tmin() const { return m_tmin; }
+	int64_t tmax() const { return m_tmax; }
+	const std::vector<uint8_t> &bytes() const { return m_out.bytes(); }
+
+	void reset()
+	{
+		m_out.clear();
+		m_count = 0;
+		m_prevT = m_prevDelta = 0;
+		m_prevBits = 0;
+		m_prevLead = -1;
+		m_prevTrail = 0;
+		m_tmin = m_tmax = 0;
+	}
+
+private:
+	BitWriter m_out;
+	uint32_t m_count = 0;
+	int64_t m_prevT = 0;
+	int64_t m_prevDelta = 0;
+	uint64_t m_prevBits = 0;
+	int m_prevLead = -1; ///< -1 表示尚无可复用的窗口
+	int m_prevTrail = 0;
+	int64_t m_tmin = 0;
+	int64_t m_tmax = 0;
+};
+
+/* 解码 count 个样本，逐个回调 fn(t, v)；数据损坏时返回 false */
+template <typename Fn>
+bool decode(const uint8_t *data, size_t len, uint32_t count, Fn &&fn)
+{
+	BitReader in(data, len);
+	uint64_t t = 0, bits = 0;
+	int64_t delta = 0;
+	int lead = 0, trail = 0;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (i == 0)
+		{
+			if (!in.read(64, t) || !in.read(64, bits))
+				return false;
+		}
+		else
+		{
+			/* 前缀最多 4 个 1 */
+			int ones = 0;
+			bool b = true;
+			while (ones < 4)
+			{
+				if (!in.readBit(b))
+					return false;
+				if (!b)
+					break;
+				++ones;
+			}
+
+			static const int kDodBits[5] = {0, 7, 9, 12, 64};
+			int64_t dod = 0;
+			if (ones > 0)
+			{
+				uint64_t raw;
+				if (!in.read(kDodBits[ones], raw))
+					return false;
+				dod = signExtend(raw, kDodBits[ones]);
+			}
+			delta += dod;
+			t += static_cast<uint64_t>(delta);
+
+			bool nonzero;
+			if (!in.readBit(nonzero))
+				return false;
+			if (nonzero)
+			{
+				bool fresh;
+				if (!in.readBit(fresh))
+					return false;
+				if (fresh)
+				{
+					uint64_t l, s;
+					if (!in.read(5, l) || !in.read(6, s))
+						return false;
+					lead = static_cast<int>(l);
+					trail = 64 - lead - static_cast<int>(s + 1);
+				}
+				uint64_t x;
+				const int sig = 64 - lead - trail;
+				if (!in.read(sig, x))
+					return false;
+				bits ^= (x << trail);
+			}
+		}
+		fn(static_cast<int64_t>(t), bitsDouble(bits));
+	}
+	return true;
+}
+
+} // namespace gorilla
@@ -0,0 +1,550 @@
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tsdb.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/QuantileSketch.h"
+#include "../daemon/utils/utils.h"
+
+namespace
+{
+	const char *const kDictFile = "series.dict";
+
+	int64_t nowMs()
+	{
+		return static_cast<int64_t>(CDTIME_T_TO_MS(cdtime()));
+	}
+
+	double toDouble(int dsType, const value_t &v)
+	{
+		switch (dsType)
+		{
+		case DS_TYPE_GAUGE:    return v.gauge;
+		case DS_TYPE_DERIVE:   return static_cast<double>(v.derive);
+		case DS_TYPE_COUNTER:  return static_cast<double>(v.counter);
+		case DS_TYPE_ABSOLUTE: return static_cast<double>(v.absolute);
+		case DS_TYPE_SKETCH:   return sketch_scalar(v);
+		}
+		return 0.0;
+	}
+
+	/* 读取整个文件；失败返回 false */
+	bool readFile(const std::string &path, std::string &out)
+	{
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return false;
+		out.clear();
+		char buf[65536];
+		ssize_t n;
+		while ((n = ::read(fd, buf, sizeof(buf))) > 0)
+		{
+			out.append(buf, static_cast<size_t>(n));
+		}
+		close(fd);
+		return n == 0;
+	}
+
+	bool writeAll(int fd, const void *data, size_t len)
+	{
+		const char *p = static_cast<const char *>(data);
+		while (len > 0)
+		{
+			ssize_t n = ::write(fd, p, len);
+			if (n < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			p += n;
+			len -= static_cast<size_t>(n);
+		}
+		return true;
+	}
+}
+
+CTsdbModule::~CTsdbModule()
+{
+	closeSegment();
+	if (m_dictFd >= 0)
+		close(m_dictFd);
+}
+
+int CTsdbModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "DataDir")
+	{
+		m_dataDir = val;
+		while (m_dataDir.size() > 1 && m_dataDir.back() == '/')
+			m_dataDir.pop_back();
+	}
+	else if (key == "SegmentSize")
+	{
+		const long mib = atol(val.c_str());
+		if (mib <= 0)
+		{
+			ERROR("tsdb plugin: SegmentSize must be positive.");
+			return -1;
+		}
+		m_segmentSize = static_cast<size_t>(mib) << 20;
+	}
+	else if (key == "BlockPoints")
+	{
+		const long n = atol(val.c_str());
+		if (n <= 0)
+		{
+			ERROR("tsdb plugin: BlockPoints must be positive.");
+			return -1;
+		}
+		m_blockPoints = static_cast<uint32_t>(n);
+	}
+	else if (key == "MaxSegments")
+	{
+		m_maxSegments = static_cast<size_t>(atol(val.c_str()));
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+std::string CTsdbModule::segmentPath(uint32_t seq, const char *ext) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/seg-%08u.%s", seq, ext);
+	return m_dataDir + name;
+}
+
+int CTsdbModule::loadDictionary()
+{
+	const std::string path = m_dataDir + "/" + kDictFile;
+
+	std::string text;
+	if (readFile(path, text))
+	{
+		size_t pos = 0;
+		while (pos < text.size())
+		{
+			size_t eol = text.find('\n', pos);
+			if (eol == std::string::npos)
+				break; /* 末尾的残行为崩溃时未写完的记录，忽略 */
+			const size_t tab = text.find('\t', pos);
+			if (tab != std::string::npos && tab < eol)
+			{
+				const uint32_t id = static_cast<uint32_t>(strtoul(text.c_str() + pos, nullptr, 10));
+				std::string name = text.substr(tab + 1, eol - tab - 1);
+				if (id == m_names.size())
+				{
+					m_ids.emplace(name, id);
+					m_names.push_back(std::move(name));
+				}
+			}
+			pos = eol + 1;
+		}
+	}
+	m_open.resize(m_names.size());
+
+	m_dictFd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (m_dictFd < 0)
+	{
+		ERROR("tsdb plugin: open %s failed: %s", path.c_str(), strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+uint32_t CTsdbModule::seriesId(const std::string &name)
+{
+	auto it = m_ids.find(name);
+	if (it != m_ids.end())
+		return it->second;
+
+	const uint32_t id = static_cast<uint32_t>(m_names.size());
+	char prefix[16];
+	const int n = snprintf(prefix, sizeof(prefix), "%u\t", id);
+	std::string line(prefix, static_cast<size_t>(n));
+	line += name;
+	line += '\n';
+	if (!writeAll(m_dictFd, line.data(), line.size()))
+		ERROR("tsdb plugin: append series dictionary failed: %s", strerror(errno));
+
+	m_ids.emplace(name, id);
+	m_names.push_back(name);
+	m_open.emplace_back();
+	return id;
+}
+
+int CTsdbModule::openSegment(uint32_t seq, bool create)
+{
+	const std::string path = segmentPath(seq, "dat");
+	int fd = open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0644);
+	if (fd < 0)
+	{
+		ERROR("tsdb plugin: open %s failed: %s", path.c_str(), strerror(errno));
+		return -1;
+	}
+
+	size_t size = m_segmentSize;
+	if (create)
+	{
+		/* 预先分配磁盘块：空间不足在这里报错，而不是写映射时 SIGBUS */
+		int err = posix_fallocate(fd, 0, static_cast<off_t>(size));
+		if (err != 0)
+		{
+			ERROR("tsdb plugin: allocate %s failed: %s", path.c_str(), strerror(err));
+			close(fd);
+			unlink(path.c_str());
+			return -1;
+		}
+	}
+	else
+	{
+		struct stat st;
+		if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TsdbSegmentHeader))
+		{
+			close(fd);
+			return -1;
+		}
+		size = static_cast<size_t>(st.st_size);
+	}
+
+	void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+	{
+		ERROR("tsdb plugin: mmap %s failed: %s", path.c_str(), strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	auto *hdr = static_cast<TsdbSegmentHeader *>(map);
+	if (create)
+	{
+		memcpy(hdr->magic, TSDB_SEGMENT_MAGIC, sizeof(hdr->magic));
+		hdr->version = TSDB_VERSION;
+		hdr->size = size;
+		hdr->used = sizeof(TsdbSegmentHeader);
+		hdr->createdMs = nowMs();
+	}
+	else if (memcmp(hdr->magic, TSDB_SEGMENT_MAGIC, sizeof(hdr->magic)) != 0 ||
+	         hdr->version != TSDB_VERSION || hdr->size != size || hdr->used > size)
+	{
+		ERROR("tsdb plugin: %s is not a valid segment.", path.c_str());
+		munmap(map, size);
+		close(fd);
+		return -1;
+	}
+
+	const std::string idxPath = segmentPath(seq, "idx");
+	int idxFd = open(idxPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (idxFd < 0)
+	{
+		ERROR("tsdb plugin: open %s failed: %s", idxPath.c_str(), strerror(errno));
+		munmap(map, size);
+		close(fd);
+		return -1;
+	}
+
+	m_cur.seq = seq;
+	m_cur.fd = fd;
+	m_cur.idxFd = idxFd;
+	m_cur.map = static_cast<uint8_t *>(map);
+	m_cur.size = size;
+	return 0;
+}
+
+void CTsdbModule::closeSegment()
+{
+	if (m_cur.map)
+	{
+		msync(m_cur.map, m_cur.size, MS_ASYNC);
+		munmap(m_cur.map, m_cur.size);
+	}
+	if (m_cur.fd >= 0)
+		close(m_cur.fd);
+	if (m_cur.idxFd >= 0)
+		close(m_cur.idxFd);
+	m_cur = Segment{};
+}
+
+int CTsdbModule::rollSegment()
+{
+	const uint32_t next = m_cur.seq + 1;
+	closeSegment();
+
+	if (openSegment(next, true) != 0)
+		return -1;
+	m_segments.push_back(next);
+
+	/* 保留最近 MaxSegments 个段，磁盘占用上限 = MaxSegments * SegmentSize */
+	while (m_maxSegments > 0 && m_segments.size() > m_maxSegments)
+	{
+		const uint32_t oldest = m_segments.front();
+		m_segments.pop_front();
+		unlink(segmentPath(oldest, "dat").c_str());
+		unlink(segmentPath(oldest, "idx").c_str());
+	}
+	return 0;
+}
+
+int CTsdbModule::init()
+{
+	/* 最坏情况每样本约 19 字节（68 位时间戳 + 77 位数值） */
+	if (sizeof(TsdbSegmentHeader) + sizeof(TsdbBlockHeader) + 16 + 19ull * m_blockPoints > m_segmentSize)
+	{
+		ERROR("tsdb plugin: SegmentSize too small for BlockPoints %u.", m_blockPoints);
+		return -1;
+	}
+
+	if (check_create_dir((m_dataDir + "/").c_str()) != 0)
+	{
+		ERROR("tsdb plugin: cannot create %s.", m_dataDir.c_str());
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	if (loadDictionary() != 0)
+		return -1;
+
+	DIR *dir = opendir(m_dataDir.c_str());
+	if (!dir)
+	{
+		ERROR("tsdb plugin: opendir %s failed: %s", m_dataDir.c_str(), strerror(errno));
+		return -1;
+	}
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != nullptr)
+	{
+		unsigned seq;
+		char ext[8];
+		if (sscanf(ent->d_name, "seg-%8u.%3s", &seq, ext) == 2 && strcmp(ext, "dat") == 0)
+			m_segments.push_back(seq);
+	}
+	closedir(dir);
+	std::sort(m_segments.begin(), m_segments.end());
+
+	/* 续写最后一个段；没有段或最后一段损坏时新建 */
+	if (!m_segments.empty() && openSegment(m_segments.back(), false) == 0)
+		return 0;
+
+	const uint32_t seq = m_segments.empty() ? 1 : m_segments.back() + 1;
+	if (openSegment(seq, true) != 0)
+		return -1;
+	m_segments.push_back(seq);
+	return 0;
+}
+
+int CTsdbModule::sealBlock(uint32_t id)
+{
+	gorilla::Encoder *enc = m_open[id].get();
+	if (!enc || enc->count() == 0)
+		return 0;
+	if (!m_cur.map)
+		return -1;
+
+	const auto &payload = enc->bytes();
+	const size_t need = sizeof(TsdbBlockHeader) + payload.size();
+	if (m_cur.header()->used + need > m_cur.size)
+	{
+		if (rollSegment() != 0)
+			return -1;
+	}
+
+	TsdbSegmentHeader *seg = m_cur.header();
+	const uint64_t offset = seg->used;
+
+	TsdbBlockHeader blk;
+	blk.magic = TSDB_BLOCK_MAGIC;
+	blk.seriesId = id;
+	blk.count = enc->count();
+	blk.bytes = static_cast<uint32_t>(payload.size());
+	blk.tminMs = enc->tmin();
+	blk.tmaxMs = enc->tmax();
+	memcpy(m_cur.map + offset, &blk, sizeof(blk));
+	memcpy(m_cur.map + offset + sizeof(blk), payload.data(), payload.size());
+	seg->used = offset + need;
+
+	/* 索引在块写入之后追加：崩溃时最多丢索引，不会指向半个块 */
+	TsdbIndexEntry ie{id, blk.count, offset, blk.tminMs, blk.tmaxMs};
+	if (!writeAll(m_cur.idxFd, &ie, sizeof(ie)))
+		ERROR("tsdb plugin: append index failed: %s", strerror(errno));
+
+	enc->reset();
+	return 0;
+}
+
+int CTsdbModule::sealAll()
+{
+	int status = 0;
+	for (uint32_t id = 0; id < m_open.size(); ++id)
+	{
+		if (sealBlock(id) != 0)
+			status = -1;
+	}
+	if (m_cur.map)
+		msync(m_cur.map, m_cur.size, MS_ASYNC);
+	return status;
+}
+
+int CTsdbModule::write(const data_set_t *ds, const value_list_t *vl)
+{
+	if (!ds || !vl || ds->ds_num != vl->values_len)
+		return -1;
+
+	char ident[512];
+	if (FORMAT_VL(ident, sizeof(ident), vl) != 0)
+		return -1;
+
+	const int64_t t = static_cast<int64_t>(CDTIME_T_TO_MS(vl->time));
+
+	std::lock_guard<std::mutex> lk(m_mutex);
+	int status = 0;
+	for (size_t i = 0; i < ds->ds_num; ++i)
+	{
+		m_key.assign(ident);
+		m_key += ':';
+		m_key += ds->ds[i].name;
+
+		const uint32_t id = seriesId(m_key);
+		auto &enc = m_open[id];
+		if (!enc)
+			enc.reset(new gorilla::Encoder);
+
+		enc->append(t, toDouble(ds->ds[i].type, vl->values[i]));
+		if (enc->count() >= m_blockPoints && sealBlock(id) != 0)
+			status = -1;
+	}
+	return status;
+}
+
+int CTsdbModule::flush()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	return sealAll();
+}
+
+int CTsdbModule::shutdown()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	const int status = sealAll();
+	closeSegment();
+	return status;
+}
+
+int CTsdbModule::scanSegment(uint32_t seq, uint32_t id, int64_t fromMs, int64_t toMs,
+                             std::vector<std::pair<cdtime_t, double>> &out)
+{
+	std::string idx;
+	if (!readFile(segmentPath(seq, "idx"), idx))
+		return -1;
+
+	const auto *entries = reinterpret_cast<const TsdbIndexEntry *>(idx.data());
+	const size_t n = idx.size() / sizeof(TsdbIndexEntry);
+
+	/* 当前段直接用写入映射，历史段只读映射 */
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+	void *roMap = MAP_FAILED;
+	int fd = -1;
+
+	auto emit = [&](int64_t t, double v) {
+		if (t >= fromMs && t <= toMs)
+			out.emplace_back(MS_TO_CDTIME_T(t), v);
+	};
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		const TsdbIndexEntry &e = entries[i];
+		if (e.seriesId != id || e.tmaxMs < fromMs || e.tminMs > toMs)
+			continue;
+
+		if (!data)
+		{
+			if (seq == m_cur.seq && m_cur.map)
+			{
+				data = m_cur.map;
+				size = m_cur.size;
+			}
+			else
+			{
+				fd = open(segmentPath(seq, "dat").c_str(), O_RDONLY | O_CLOEXEC);
+				struct stat st;
+				if (fd < 0 || fstat(fd, &st) != 0)
+					break;
+				size = static_cast<size_t>(st.st_size);
+				roMap = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+				if (roMap == MAP_FAILED)
+					break;
+				data = static_cast<const uint8_t *>(roMap);
+			}
+		}
+
+		if (e.offset + sizeof(TsdbBlockHeader) > size)
+			continue;
+		TsdbBlockHeader blk;
+		memcpy(&blk, data + e.offset, sizeof(blk));
+		if (blk.magic != TSDB_BLOCK_MAGIC || blk.seriesId != id ||
+		    e.offset + sizeof(blk) + blk.bytes > size)
+			continue;
+
+		gorilla::decode(data + e.offset + sizeof(blk), blk.bytes, blk.count, emit);
+	}
+
+	if (roMap != MAP_FAILED)
+		munmap(roMap, size);
+	if (fd >= 0)
+		close(fd);
+	return 0;
+}
+
+int CTsdbModule::query(const std::string &series, cdtime_t from, cdtime_t to,
+                       std::vector<std::pair<cdtime_t, double>> &out)
+{
+	const int64_t fromMs = static_cast<int64_t>(CDTIME_T_TO_MS(from));
+	const int64_t toMs = static_cast<int64_t>(CDTIME_T_TO_MS(to));
+
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	auto it = m_ids.find(series);
+	if (it == m_ids.end())
+		return ENOENT;
+	const uint32_t id = it->second;
+
+	for (uint32_t seq : m_segments)
+	{
+		scanSegment(seq, id, fromMs, toMs, out);
+	}
+
+	const gorilla::Encoder *enc = m_open[id].get();
+	if (enc && enc->count() > 0 && enc->tmax() >= fromMs && enc->tmin() <= toMs)
+	{
+		gorilla::decode(enc->bytes().data(), enc->bytes().size(), enc->count(),
+		                [&](int64_t t, double v) {
+			                if (t >= fromMs && t <= toMs)
+				                out.emplace_back(MS_TO_CDTIME_T(t), v);
+		                });
+	}
+	return 0;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CTsdbModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != nullptr);
+	delete pUserModule;
+}
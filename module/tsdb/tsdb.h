@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ModuleBase.h"
+#include "gorilla.h"
+
+/*
+ * 压缩列式时序存储 writer：
+ *   每个 (标识, 数据源) 为一条序列，样本在内存中按 Gorilla 编码攒成块，
+ *   满 BlockPoints 个样本（或 flush / shutdown）时追加到 mmap 的定长段文件，
+ *   同时在段的 .idx 文件中追加一条 (序列, 时间范围, 偏移) 索引。
+ *
+ * 目录布局（DataDir 下）：
+ *   series.dict        序列 id 与名称，文本 "<id>\t<名称>\n"，只追加
+ *   seg-NNNNNNNN.dat   段文件，固定 SegmentSize 字节，TsdbSegmentHeader + 若干块
+ *   seg-NNNNNNNN.idx   该段的块索引，TsdbIndexEntry 数组
+ *
+ * 配置示例：
+ *   <Plugin tsdb>
+ *     DataDir "/mnt/data/collect/tsdb"
+ *     SegmentSize 16      # MiB
+ *     BlockPoints 120
+ *     MaxSegments 32      # 0 表示不限制，超过时删除最旧的段
+ *   </Plugin>
+ */
+
+#define TSDB_SEGMENT_MAGIC "TSEG"
+#define TSDB_BLOCK_MAGIC 0x4B4C4254u /* "TBLK" */
+#define TSDB_VERSION 1
+
+struct TsdbSegmentHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t size;      ///< 段文件总大小
+	uint64_t used;      ///< 已写入的字节数（含本头部）
+	int64_t createdMs;
+	uint8_t reserved[32];
+};
+
+struct TsdbBlockHeader
+{
+	uint32_t magic;
+	uint32_t seriesId;
+	uint32_t count;     ///< 样本数
+	uint32_t bytes;     ///< 编码后负载字节数
+	int64_t tminMs;
+	int64_t tmaxMs;
+};
+
+struct TsdbIndexEntry
+{
+	uint32_t seriesId;
+	uint32_t count;
+	uint64_t offset;    ///< 块头在段文件中的偏移
+	int64_t tminMs;
+	int64_t tmaxMs;
+};
+
+class CTsdbModule final : public CAbstractUserModule
+{
+public:
+	CTsdbModule() = default;
+	~CTsdbModule() override;
+
+	int config(const std::string &key, const std::string &val) override;
+	int init() override;
+	int write(const data_set_t *ds, const value_list_t *vl) override;
+	int flush() override;
+	int shutdown() override;
+
+	/* 范围查询：读取 series 在 [from, to] 内的样本（含尚未落盘的块），按写入顺序返回 */
+	int query(const std::string &series, cdtime_t from, cdtime_t to,
+	          std::vector<std::pair<cdtime_t, double>> &out);
+
+private:
+	struct Segment
+	{
+		uint32_t seq = 0;
+		int fd = -1;
+		int idxFd = -1;
+		uint8_t *map = nullptr;
+		size_t size = 0;
+
+		TsdbSegmentHeader *header() const { return reinterpret_cast<TsdbSegmentHeader *>(map); }
+	};
+
+	std::string segmentPath(uint32_t seq, const char *ext) const;
+	int loadDictionary();
+	uint32_t seriesId(const std::string &name);
+	int openSegment(uint32_t seq, bool create);
+	void closeSegment();
+	int rollSegment();
+	int sealBlock(uint32_t id);
+	int sealAll();
+	int scanSegment(uint32_t seq, uint32_t id, int64_t fromMs, int64_t toMs,
+	                std::vector<std::pair<cdtime_t, double>> &out);
+
+	/* 配置 */
+	std::string m_dataDir = "/mnt/data/collect/tsdb";
+	size_t m_segmentSize = 16u << 20;
+	uint32_t m_blockPoints = 120;
+	size_t m_maxSegments = 0;
+
+	std::mutex m_mutex;
+
+	/* 序列字典与各序列正在编码的块 */
+	std::unordered_map<std::string, uint32_t> m_ids;
+	std::vector<std::string> m_names;
+	std::vector<std::unique_ptr<gorilla::Encoder>> m_open;
+	int m_dictFd = -1;
+	std::string m_key; ///< write() 复用的序列名缓冲
+
+	std::deque<uint32_t> m_segments; ///< 现存段的序号，升序
+	Segment m_cur;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+	
+#ifdef __cplusplus
+};
+#endif
@@ -0,0 +1,210 @@
+#include <assert.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#include "vmstat.h"
+#include "../daemon/PluginService.h"
+#include "../daemon/ProcfsCache.h"
+#include "../daemon/utils/utils.h"
+#include "../daemon/utils/utils_parse.h"
+
+namespace
+{
+	/*
+	 * 逐行遍历 "<name> <value> ..." 格式的内容，对名字在 names 中的行取首个数值。
+	 * 命中的下标在 found 中置位，全部命中后提前结束。
+	 */
+	template <size_t N>
+	void scanKeys(std::string_view text, const char *const (&names)[N], uint64_t (&values)[N], bool (&found)[N])
+	{
+		size_t remain = N;
+		const char *p = text.data();
+		const char *end = p + text.size();
+		while (p < end && remain > 0)
+		{
+			const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+			if (!eol)
+				eol = end;
+			const char *nameEnd = p;
+			while (nameEnd < eol && *nameEnd != ' ')
+				++nameEnd;
+			const size_t len = static_cast<size_t>(nameEnd - p);
+
+			for (size_t i = 0; i < N; ++i)
+			{
+				if (found[i] || strncmp(names[i], p, len) != 0 || names[i][len] != '\0')
+					continue;
+				if (parseU64(skipSpace(nameEnd, eol), eol, values[i]))
+				{
+					found[i] = true;
+					--remain;
+				}
+				break;
+			}
+			p = eol + 1;
+		}
+	}
+
+	int snapshot(const char *path, ProcfsSnapshot &snap)
+	{
+		const int status = ProcfsCache::Instance().get(path, snap);
+		if (status != 0)
+		{
+			ERROR("vmstat plugin: read %s failed: %s", path, strerror(status));
+			return -1;
+		}
+		return 0;
+	}
+}
+
+int CVmstatModule::config(const std::string &key, const std::string &val)
+{
+	if (key == "ReportLoad")
+		m_reportLoad = IS_TRUE(val.c_str());
+	else if (key == "ReportVmstat")
+		m_reportVmstat = IS_TRUE(val.c_str());
+	else if (key == "ReportProcStat")
+		m_reportProcStat = IS_TRUE(val.c_str());
+	else
+		return -1;
+	return 0;
+}
+
+void CVmstatModule::submit(const char *type, const char *typeInstance, value_t *values, size_t n)
+{
+	value_list_t vl = VALUE_LIST_INIT;
+	vl.values = values;
+	vl.values_len = n;
+	sstrncpy(vl.plugin, "vmstat", sizeof(vl.plugin));
+	sstrncpy(vl.type, type, sizeof(vl.type));
+	sstrncpy(vl.type_instance, typeInstance, sizeof(vl.type_instance));
+	PluginService::Instance().dispatchValues(&vl);
+}
+
+int CVmstatModule::readLoadavg(const char *path)
+{
+	ProcfsSnapshot snap;
+	if (snapshot(path, snap) != 0)
+		return -1;
+	const std::string_view text = snap.view();
+
+	/* "0.52 0.58 0.59 1/467 12345"，快照不以 '\0' 结尾，先拷贝 */
+	char buf[128];
+	const size_t len = text.size() < sizeof(buf) - 1 ? text.size() : sizeof(buf) - 1;
+	memcpy(buf, text.data(), len);
+	buf[len] = '\0';
+
+	value_t values[3];
+	if (sscanf(buf, "%lf %lf %lf", &values[0].gauge, &values[1].gauge, &values[2].gauge) != 3)
+	{
+		ERROR("vmstat plugin: unexpected content in %s.", path);
+		return -1;
+	}
+	submit("load", "", values, 3);
+	return 0;
+}
+
+int CVmstatModule::readVmstat(const char *path)
+{
+	ProcfsSnapshot snap;
+	if (snapshot(path, snap) != 0)
+		return -1;
+	const std::string_view text = snap.view();
+
+	enum { PGFAULT = 0, PGMAJFAULT, PSWPIN, PSWPOUT, OOM_KILL };
+	static const char *const kNames[] = {"pgfault", "pgmajfault", "pswpin", "pswpout", "oom_kill"};
+	uint64_t v[5] = {};
+	bool found[5] = {};
+	scanKeys(text, kNames, v, found);
+
+	value_t values[2];
+	if (found[PGFAULT] && found[PGMAJFAULT])
+	{
+		/* pgfault 含主缺页，与 collectd 一致拆成 minflt / majflt */
+		const uint64_t minor = v[PGFAULT] >= v[PGMAJFAULT] ? v[PGFAULT] - v[PGMAJFAULT] : 0;
+		values[0].derive = static_cast<derive_t>(minor);
+		values[1].derive = static_cast<derive_t>(v[PGMAJFAULT]);
+		submit("vmpage_faults", "", values, 2);
+	}
+	if (found[PSWPIN] && found[PSWPOUT])
+	{
+		values[0].derive = static_cast<derive_t>(v[PSWPIN]);
+		values[1].derive = static_cast<derive_t>(v[PSWPOUT]);
+		submit("vmpage_io", "swap", values, 2);
+	}
+	if (found[OOM_KILL])
+	{
+		values[0].derive = static_cast<derive_t>(v[OOM_KILL]);
+		submit("vmpage_action", "oom_kill", values, 1);
+	}
+	return 0;
+}
+
+int CVmstatModule::readProcStat(const char *path)
+{
+	ProcfsSnapshot snap;
+	if (snapshot(path, snap) != 0)
+		return -1;
+	const std::string_view text = snap.view();
+
+	enum { CTXT = 0, INTR, PROCESSES, RUNNING, BLOCKED };
+	static const char *const kNames[] = {"ctxt", "intr", "processes", "procs_running", "procs_blocked"};
+	uint64_t v[5] = {};
+	bool found[5] = {};
+	scanKeys(text, kNames, v, found);
+
+	value_t value;
+	if (found[CTXT])
+	{
+		value.derive = static_cast<derive_t>(v[CTXT]);
+		submit("contextswitch", "", &value, 1);
+	}
+	if (found[INTR])
+	{
+		value.derive = static_cast<derive_t>(v[INTR]);
+		submit("irq", "", &value, 1);
+	}
+	if (found[PROCESSES])
+	{
+		value.derive = static_cast<derive_t>(v[PROCESSES]);
+		submit("fork_rate", "", &value, 1);
+	}
+	if (found[RUNNING])
+	{
+		value.gauge = static_cast<gauge_t>(v[RUNNING]);
+		submit("ps_state", "running", &value, 1);
+	}
+	if (found[BLOCKED])
+	{
+		value.gauge = static_cast<gauge_t>(v[BLOCKED]);
+		submit("ps_state", "blocked", &value, 1);
+	}
+	return 0;
+}
+
+int CVmstatModule::read()
+{
+	int status = 0;
+	if (m_reportLoad && readLoadavg("/proc/loadavg") != 0)
+		status = -1;
+	if (m_reportVmstat && readVmstat("/proc/vmstat") != 0)
+		status = -1;
+	if (m_reportProcStat && readProcStat("/proc/stat") != 0)
+		status = -1;
+	return status;
+}
+
+CAbstractUserModule *CreateModule()
+{
+	return new CVmstatModule();
+}
+
+void DestroyModule(CAbstractUserModule *pUserModule)
+{
+	assert(pUserModule != NULL);
+
+	delete pUserModule;
+	pUserModule = NULL;
+}
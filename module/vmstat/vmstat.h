@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+
+#include "ModuleBase.h"
+
+/*
+ * 系统负载与调度统计（plugin 为 "vmstat"）：
+ *   /proc/loadavg  load               shortterm, midterm, longterm  GAUGE
+ *   /proc/vmstat   vmpage_faults      minflt, majflt                DERIVE
+ *                  vmpage_io-swap     in, out（pswpin / pswpout）     DERIVE
+ *                  vmpage_action-oom_kill                           DERIVE
+ *   /proc/stat     contextswitch      ctxt                          DERIVE
+ *                  irq                intr 首列（中断总数）              DERIVE
+ *                  fork_rate          processes                     DERIVE
+ *                  ps_state-running / ps_state-blocked              GAUGE
+ *
+ * 三个文件均经 ProcfsCache 读取，/proc/stat 与 cpu 插件共用同一周期的快照。
+ * 内核未提供的字段（如旧内核无 oom_kill）不上报。
+ *
+ * 配置示例：
+ *   <Plugin vmstat>
+ *     ReportLoad true
+ *     ReportVmstat true
+ *     ReportProcStat true
+ *   </Plugin>
+ */
+class CVmstatModule final : public CAbstractUserModule
+{
+public:
+	CVmstatModule() = default;
+	~CVmstatModule() override = default;
+
+	int config(const std::string &key, const std::string &val) override;
+	int read() override;
+
+	/* 以下解析函数各自读取并上报一个文件，bench 亦直接调用 */
+	int readLoadavg(const char *path);
+	int readVmstat(const char *path);
+	int readProcStat(const char *path);
+
+private:
+	void submit(const char *type, const char *typeInstance, value_t *values, size_t n);
+
+	bool m_reportLoad = true;
+	bool m_reportVmstat = true;
+	bool m_reportProcStat = true;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	CAbstractUserModule* CreateModule();
+	void DestroyModule(CAbstractUserModule *pUserModule);
+
+#ifdef __cplusplus
+};
+#endif
@@ -6,6 +6,12 @@
 
 #include "../daemon/ModuleLoader.h"
 #include "../daemon/ModuleBase.h"
+#include "../daemon/FilterChain.h"
+#include "../daemon/Aggregation.h"
+#include "../daemon/FlushPool.h"
+#include "../daemon/Spool.h"
+#include "../daemon/Threshold.h"
+#include "../daemon/Trace.h"
 
 ConfigManager::ConfigManager()
 {
@@ -133,8 +139,7 @@ int ConfigManager::DispatchBlockPlugin(OConfigItem& ci)
 
 int ConfigManager::FcConfigure(OConfigItem& ci)
 {
-	std::cout << "[fc_configure] key=" << ci.key << "\n";
-	return 0;
+	return FilterChain::Instance().configure(ci);
 }
 
 int ConfigManager::DispatchGlobalOption(OConfigItem& ci)
@@ -175,6 +180,10 @@ int ConfigManager::DispatchBlock(OConfigItem& ci)
 	if (key == "LoadPlugin") return DispatchLoadPlugin(ci);
 	if (key == "Plugin") return DispatchBlockPlugin(ci);
 	if (key == "Chain") return FcConfigure(ci);
+	if (key == "Spool") return SpoolManager::Instance().configure(ci);
+	if (key == "Aggregation") return Aggregation::Instance().configure(ci);
+	if (key == "Threshold") return Threshold::Instance().configure(ci);
+	if (key == "Flush") return FlushPool::Instance().configure(ci);
 
 	return 0;
 }
@@ -203,6 +212,8 @@ int ConfigManager::Read(const char *filename)
 		return -1;
 	}
 
+	TRACE_SCOPE("config", "parse", filename);
+
 	auto oconfig_parser = ConfigParser::create(); 
 	auto root = oconfig_parser->parseFile(filename);
 	if (root == nullptr)
@@ -245,6 +256,7 @@ int ConfigManager::Read(const char *filename)
 	else
 	{
 	    std::cout << "ConfigManager::Read: Attempting to parse TypesDB from: " << types_db_path << std::endl;
+	    TRACE_SCOPE("config", "types_db", types_db_path.c_str());
 	    if (TypesDbParser::parse_file(types_db_path.c_str(), type_datasets_) != 0)
 		{
 	        std::cerr << "ConfigManager::Read: Failed to parse TypesDB file: " << types_db_path << std::endl;
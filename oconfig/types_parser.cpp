@@ -25,6 +25,7 @@ static int parse_ds_type(const std::string& type_str) {
     if (type_str == "COUNTER") return DS_TYPE_COUNTER;
     if (type_str == "DERIVE") return DS_TYPE_DERIVE;
     if (type_str == "ABSOLUTE") return DS_TYPE_ABSOLUTE;
+    if (type_str == "SKETCH") return DS_TYPE_SKETCH;
     std::cerr << "TypesDbParser: Unknown data source type: " << type_str << std::endl;
     return DS_TYPE_UNDEFINED;
 }